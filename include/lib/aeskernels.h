@@ -0,0 +1,127 @@
+#ifndef AESKERNELS_H
+#define AESKERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ciphermode.h"
+
+namespace Crypto::BlockCipher::Aes
+{
+
+///
+/// \brief	Holds the AES kernels selected for the running CPU.
+/// 
+///			All kernels expect the round keys as \c rounds + 1 consecutive 16 byte blocks in the byte order of FIPS 197. Input and output may alias
+///			exactly but must not overlap otherwise.
+/// 
+/// \since	1.0
+///
+struct Kernels
+{
+	///
+	/// \brief	Encrypts \a blockCount consecutive blocks of \a input into \a output.
+	/// 
+	/// \since	1.0
+	///
+	void (*encryptBlocks)(const uint8_t *roundKeys, const uint32_t rounds, const uint8_t *input, uint8_t *output, const size_t blockCount);
+	
+	///
+	/// \brief	Decrypts \a blockCount consecutive blocks of \a input into \a output using the round keys of the equivalent inverse cipher.
+	/// 
+	/// \since	1.0
+	///
+	void (*decryptBlocks)(const uint8_t *roundKeys, const uint32_t rounds, const uint8_t *input, uint8_t *output, const size_t blockCount);
+	
+	///
+	/// \brief	XORs \a size bytes of \a input with the keystream generated from the big endian 128 bit \a counter and writes them to \a output.
+	/// 
+	///			\a counter is advanced by the number of keystream blocks used, including a trailing partial block. \a output may be equal to
+	///			\a input; every byte is read before it is overwritten, so in place encryption touches each cache line once.
+	/// 
+	/// \since	1.0
+	///
+	void (*ctr)(const uint8_t *roundKeys, const uint32_t rounds, uint8_t *counter, const uint8_t *input, uint8_t *output, const size_t size);
+	
+	///
+	/// \brief	Behaves like ctr() but writes \a output with non-temporal stores and prefetches \a input ahead.
+	/// 
+	///			Meant for buffers much larger than the last level cache, whose output would otherwise evict the working set of the application.
+	///			Non-temporal stores are only used if \a output is 16 byte aligned. The portable kernels fall back to ctr().
+	/// 
+	/// \since	1.0
+	///
+	void (*ctrStreaming)(const uint8_t *roundKeys, const uint32_t rounds, uint8_t *counter, const uint8_t *input, uint8_t *output, const size_t size);
+	
+	///
+	/// \brief	Applies the counter mode keystream to all \a messageCount \a messages.
+	/// 
+	///			Counter blocks of consecutive messages are packed into the same pipeline, so short messages do not leave lanes idle.
+	/// 
+	/// \since	1.0
+	///
+	void (*ctrBatch)(const uint8_t *roundKeys, const uint32_t rounds, const Mode::CtrMessage *messages, const size_t messageCount);
+	
+	///
+	/// \brief	Expands \a keyCount consecutive keys of \a keySize bytes each from \a keys into encryption round keys.
+	/// 
+	///			The round keys are stored round major: round key \c r of key \c k starts at \a roundKeys + (\c r * \a keyCount + \c k) * 16. For a
+	///			single key this is the layout all other kernels expect.
+	/// 
+	/// \since	1.0
+	///
+	void (*expandKeys)(const uint8_t *keys, const uint32_t keySize, const size_t keyCount, uint8_t *roundKeys);
+	
+	///
+	/// \brief	Encrypts block \c k of \a input with key \c k of the round major \a roundKeys produced by expandKeys() for all \a keyCount keys.
+	/// 
+	/// \since	1.0
+	///
+	void (*encryptBlocksMultiKey)(const uint8_t *roundKeys, const uint32_t rounds, const size_t keyCount, const uint8_t *input, uint8_t *output);
+	
+	///
+	/// \brief	Applies the counter mode keystream of key \c k of the round major \a roundKeys to message \c k for all \a keyCount \a messages.
+	/// 
+	///			Every lane of the pipeline works through one message with its own key and takes over the next message when it is done, so
+	///			messages of different sizes keep all lanes busy.
+	/// 
+	/// \since	1.0
+	///
+	void (*ctrMultiKey)(const uint8_t *roundKeys, const uint32_t rounds, const size_t keyCount, const Mode::CtrMessage *messages);
+	
+	///
+	/// \brief	The name of the kernel set for diagnostics.
+	/// 
+	/// \since	1.0
+	///
+	const char *name;
+};
+
+///
+/// \brief	Returns the fastest kernels allowed by Crypto::Cpu::features().
+/// 
+///			The kernels are selected on first use and again by selectKernels(), so the features are not checked on every call.
+/// 
+/// \since	1.0
+///
+const Kernels &kernels();
+
+///
+/// \brief	Selects the kernels returned by kernels() again for the current Crypto::Cpu::features().
+/// 
+///			Crypto::Cpu::restrictFeatures() calls it after changing the features.
+/// 
+/// \since	1.0
+///
+void selectKernels();
+
+///
+/// \brief	Returns the portable T-table kernels.
+/// 
+/// \since	1.0
+///
+const Kernels &genericKernels();
+
+} // namespace Crypto::BlockCipher::Aes
+
+#endif // AESKERNELS_H
@@ -0,0 +1,249 @@
+#ifndef AESKEYSCHEDULE_H
+#define AESKEYSCHEDULE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "aesconstants.h"
+#include "aeskernels.h"
+#include "aestraits.h"
+#include "cipherkey.h"
+#include "ciphermode.h"
+#include "cryptoglobals.h"
+
+namespace Crypto::BlockCipher::Aes
+{
+
+///
+/// \brief	Holds the expanded encryption and decryption round keys for AES with \a keySize.
+/// 
+///			A key schedule is immutable after construction and can be shared by reference between any number of threads and mode invocations.
+///			It is neither copyable nor movable so that the key material exists exactly once and is safely discarded on destruction. Its storage
+///			is cache line aligned.
+/// 
+/// \since	1.0
+///
+template <uint32_t keySize>
+class alignas(64) KeySchedule
+{
+public:
+	///
+	/// \brief	A type containing information about the properties of the instantiated type's properties.
+	/// 
+	/// \since	1.0
+	///
+	using TraitsType = Traits<keySize>;
+	
+	///
+	/// \brief	The corresponding key type.
+	/// 
+	/// \since	1.0
+	///
+	using KeyType = Key<keySize>;
+	
+	///
+	/// \brief	The size of the round keys for each direction in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t roundKeysSize = TraitsType::blockSize * (TraitsType::rounds + 1);
+	
+	///
+	/// \brief	Expands \a key.
+	/// 
+	/// \since	1.0
+	///
+	explicit KeySchedule(const KeyType &key) :
+		KeySchedule(key.key)
+	{
+	}
+	
+	///
+	/// \brief	Expands \a key.
+	/// 
+	///			The memory associated with \a key must be of the required key size.
+	/// 
+	/// \since	1.0
+	///
+	explicit KeySchedule(const uint8_t *key)
+	{
+		this->_expandKey(key);
+	}
+	
+	KeySchedule(const KeySchedule &other) = delete;
+	KeySchedule &operator=(const KeySchedule &other) = delete;
+	
+	///
+	/// \brief	Destructs the key schedule and safely discards the round keys.
+	/// 
+	/// \since	1.0
+	///
+	~KeySchedule()
+	{
+		safeSetZero(this->_encryptionKeys, sizeof (this->_encryptionKeys));
+		safeSetZero(this->_decryptionKeys, sizeof (this->_decryptionKeys));
+	}
+	
+	///
+	/// \brief	Returns the round keys for encryption in FIPS 197 byte order.
+	/// 
+	/// \since	1.0
+	///
+	const uint8_t *encryptionKeys() const
+	{
+		return this->_encryptionKeys;
+	}
+	
+	///
+	/// \brief	Returns the round keys for the equivalent inverse cipher in FIPS 197 byte order.
+	/// 
+	/// \since	1.0
+	///
+	const uint8_t *decryptionKeys() const
+	{
+		return this->_decryptionKeys;
+	}
+	
+	///
+	/// \brief	Returns the kernels selected when the schedule was constructed.
+	/// 
+	/// \since	1.0
+	///
+	const Kernels &kernels() const
+	{
+		return *this->_kernels;
+	}
+	
+	///
+	/// \brief	Encrypts \a blockCount consecutive blocks of \a plaintext and stores the ciphertext in \a ciphertext.
+	/// 
+	/// \warning
+	///			No checks for null pointers or lengths are performed. The correctness of the input must be garuanteed by the caller.
+	/// 
+	/// \since	1.0
+	///
+	void encryptBlocks(const uint8_t *plaintext, uint8_t *ciphertext, const size_t blockCount) const
+	{
+		this->_kernels->encryptBlocks(this->_encryptionKeys, TraitsType::rounds, plaintext, ciphertext, blockCount);
+	}
+	
+	///
+	/// \brief	Decrypts \a blockCount consecutive blocks of \a ciphertext and stores the plaintext in \a plaintext.
+	/// 
+	/// \warning
+	///			No checks for null pointers or lengths are performed. The correctness of the input must be garuanteed by the caller.
+	/// 
+	/// \since	1.0
+	///
+	void decryptBlocks(const uint8_t *ciphertext, uint8_t *plaintext, const size_t blockCount) const
+	{
+		this->_kernels->decryptBlocks(this->_decryptionKeys, TraitsType::rounds, ciphertext, plaintext, blockCount);
+	}
+	
+	///
+	/// \brief	XORs \a size bytes of \a input with the counter mode keystream starting at \a counter and stores the result in \a output.
+	/// 
+	///			\a counter is a big endian 128 bit integer and is advanced by the number of keystream blocks used. \a output may be equal to
+	///			\a input but must not overlap it otherwise.
+	/// 
+	/// \warning
+	///			No checks for null pointers or lengths are performed. The correctness of the input must be garuanteed by the caller.
+	/// 
+	/// \since	1.0
+	///
+	void applyKeystream(uint8_t *counter, const uint8_t *input, uint8_t *output, const size_t size) const
+	{
+		this->_kernels->ctr(this->_encryptionKeys, TraitsType::rounds, counter, input, output, size);
+	}
+	
+	///
+	/// \brief	Behaves like applyKeystream() but bypasses the caches when writing \a output.
+	/// 
+	///			Use it for outputs much larger than the last level cache that are not read again soon.
+	/// 
+	/// \since	1.0
+	///
+	void applyKeystreamStreaming(uint8_t *counter, const uint8_t *input, uint8_t *output, const size_t size) const
+	{
+		this->_kernels->ctrStreaming(this->_encryptionKeys, TraitsType::rounds, counter, input, output, size);
+	}
+	
+	///
+	/// \brief	Applies the counter mode keystream to all \a messageCount \a messages.
+	/// 
+	/// \warning
+	///			No checks for null pointers or lengths are performed. The correctness of the input must be garuanteed by the caller.
+	/// 
+	/// \since	1.0
+	///
+	void applyKeystream(const Mode::CtrMessage *messages, const size_t messageCount) const
+	{
+		this->_kernels->ctrBatch(this->_encryptionKeys, TraitsType::rounds, messages, messageCount);
+	}
+	
+private:
+	static constexpr uint8_t blockSizeWords = uint8_t(TraitsType::blockSize / sizeof (uint32_t));
+	
+	alignas(64) uint8_t _encryptionKeys[roundKeysSize];
+	alignas(16) uint8_t _decryptionKeys[roundKeysSize];
+	const Kernels *_kernels = &Aes::kernels();
+	
+	void _expandKey(const uint8_t *key)
+	{
+		this->_kernels->expandKeys(key, TraitsType::keySize, 1, this->_encryptionKeys);
+		
+		// Equivalent inverse cipher: reverse the round order and apply InvMixColumns to all but the first and last round key
+		for (uint8_t round = 0; round <= TraitsType::rounds; round++)
+		{
+			for (uint8_t column = 0; column < blockSizeWords; column++)
+			{
+				uint32_t word = _loadWord(this->_encryptionKeys + ((TraitsType::rounds - round) * blockSizeWords + column) * sizeof (uint32_t));
+				
+				if ((round != 0) && (round != TraitsType::rounds))
+				{
+					word = _inverseMixColumn(word);
+				}
+				
+				_storeWord(this->_decryptionKeys + (round * blockSizeWords + column) * sizeof (uint32_t), word);
+			}
+		}
+	}
+	
+	static uint32_t _loadWord(const uint8_t *source)
+	{
+		uint32_t word = 0;
+		
+		memcpy(&word, source, sizeof (word));
+		
+		return changeEndianness(word);
+	}
+	
+	static void _storeWord(uint8_t *destination, const uint32_t word)
+	{
+		const uint32_t value = changeEndianness(word);
+		
+		memcpy(destination, &value, sizeof (value));
+	}
+	
+	static uint32_t _inverseMixColumn(const uint32_t word)
+	{
+		const uint8_t b0 = uint8_t(word >> 24);
+		const uint8_t b1 = uint8_t(word >> 16);
+		const uint8_t b2 = uint8_t(word >> 8);
+		const uint8_t b3 = uint8_t(word);
+		
+		return (uint32_t(galoisMultiply_e[b0] ^ galoisMultiply_b[b1] ^ galoisMultiply_d[b2] ^ galoisMultiply_9[b3]) << 24) |
+				(uint32_t(galoisMultiply_9[b0] ^ galoisMultiply_e[b1] ^ galoisMultiply_b[b2] ^ galoisMultiply_d[b3]) << 16) |
+				(uint32_t(galoisMultiply_d[b0] ^ galoisMultiply_9[b1] ^ galoisMultiply_e[b2] ^ galoisMultiply_b[b3]) << 8) |
+				uint32_t(galoisMultiply_b[b0] ^ galoisMultiply_d[b1] ^ galoisMultiply_9[b2] ^ galoisMultiply_e[b3]);
+	}
+};
+
+using KeySchedule128 = KeySchedule<AES_128_KEY_SIZE>;
+using KeySchedule192 = KeySchedule<AES_192_KEY_SIZE>;
+using KeySchedule256 = KeySchedule<AES_256_KEY_SIZE>;
+
+} // namespace Crypto::BlockCipher::Aes
+
+#endif // AESKEYSCHEDULE_H
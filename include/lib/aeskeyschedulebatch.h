@@ -0,0 +1,153 @@
+#ifndef AESKEYSCHEDULEBATCH_H
+#define AESKEYSCHEDULEBATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "aesconstants.h"
+#include "aeskernels.h"
+#include "aestraits.h"
+#include "cryptoglobals.h"
+
+namespace Crypto::BlockCipher::Aes
+{
+
+///
+/// \brief	Holds the encryption round keys of many AES keys with \a keySize, expanded together.
+/// 
+///			Workloads that rekey for almost every message spend most of their time in the key expansion. The batch expands all keys in one
+///			pass, several keys per vector register when AES-NI is available, and stores them round major: round key \c r of key \c k directly
+///			follows round key \c r of key \c k - 1. The multi key kernels load the round keys of consecutive keys with a single contiguous read,
+///			both for single blocks and for whole counter mode messages with one key each.
+/// 
+///			Only encryption round keys are expanded; the batch serves counter based modes and the generation of derived material.
+/// 
+/// \since	1.0
+///
+template <uint32_t keySize>
+class KeyScheduleBatch
+{
+public:
+	///
+	/// \brief	A type containing information about the properties of the instantiated type's properties.
+	/// 
+	/// \since	1.0
+	///
+	using TraitsType = Traits<keySize>;
+	
+	///
+	/// \brief	The size of the round keys of a single key in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t roundKeysSize = TraitsType::blockSize * (TraitsType::rounds + 1);
+	
+	///
+	/// \brief	Expands \a keyCount keys stored back to back in \a keys.
+	/// 
+	///			The memory associated with \a keys must be \a keyCount times the required key size.
+	/// 
+	/// \since	1.0
+	///
+	KeyScheduleBatch(const uint8_t *keys, const size_t keyCount) :
+		_roundKeys(roundKeysSize * keyCount),
+		_keyCount(keyCount)
+	{
+		this->_kernels->expandKeys(keys, TraitsType::keySize, keyCount, this->_roundKeys.data());
+	}
+	
+	KeyScheduleBatch(const KeyScheduleBatch &other) = delete;
+	KeyScheduleBatch &operator=(const KeyScheduleBatch &other) = delete;
+	
+	///
+	/// \brief	Destructs the batch and safely discards the round keys.
+	/// 
+	/// \since	1.0
+	///
+	~KeyScheduleBatch()
+	{
+		safeSetZero(this->_roundKeys.data(), this->_roundKeys.size());
+	}
+	
+	///
+	/// \brief	Returns the number of keys in the batch.
+	/// 
+	/// \since	1.0
+	///
+	size_t keyCount() const
+	{
+		return this->_keyCount;
+	}
+	
+	///
+	/// \brief	Returns the round major round keys of all keys in FIPS 197 byte order.
+	/// 
+	/// \since	1.0
+	///
+	const uint8_t *roundKeys() const
+	{
+		return this->_roundKeys.data();
+	}
+	
+	///
+	/// \brief	Returns round key \a round of key \a index.
+	/// 
+	/// \since	1.0
+	///
+	const uint8_t *roundKey(const size_t index, const uint32_t round) const
+	{
+		return this->_roundKeys.data() + (round * this->_keyCount + index) * TraitsType::blockSize;
+	}
+	
+	///
+	/// \brief	Returns the kernels selected when the batch was constructed.
+	/// 
+	/// \since	1.0
+	///
+	const Kernels &kernels() const
+	{
+		return *this->_kernels;
+	}
+	
+	///
+	/// \brief	Encrypts one block of \a plaintext per key, block \c k with key \c k, and stores the ciphertext in \a ciphertext.
+	/// 
+	/// \warning
+	///			No checks for null pointers or lengths are performed. The correctness of the input must be garuanteed by the caller.
+	/// 
+	/// \since	1.0
+	///
+	void encryptBlocks(const uint8_t *plaintext, uint8_t *ciphertext) const
+	{
+		this->_kernels->encryptBlocksMultiKey(this->_roundKeys.data(), TraitsType::rounds, this->_keyCount, plaintext, ciphertext);
+	}
+	
+	///
+	/// \brief	Applies the counter mode keystream of key \c k to message \c k of \a messages, for all keys of the batch.
+	/// 
+	///			The counter of each message starts at its initialization vector. Encryption and decryption are the same operation.
+	/// 
+	/// \warning
+	///			No checks for null pointers or lengths are performed. The correctness of the input must be garuanteed by the caller.
+	/// 
+	/// \since	1.0
+	///
+	void applyKeystream(const Mode::CtrMessage *messages) const
+	{
+		this->_kernels->ctrMultiKey(this->_roundKeys.data(), TraitsType::rounds, this->_keyCount, messages);
+	}
+	
+private:
+	std::vector<uint8_t> _roundKeys;
+	size_t _keyCount;
+	const Kernels *_kernels = &Aes::kernels();
+};
+
+using KeyScheduleBatch128 = KeyScheduleBatch<AES_128_KEY_SIZE>;
+using KeyScheduleBatch192 = KeyScheduleBatch<AES_192_KEY_SIZE>;
+using KeyScheduleBatch256 = KeyScheduleBatch<AES_256_KEY_SIZE>;
+
+} // namespace Crypto::BlockCipher::Aes
+
+#endif // AESKEYSCHEDULEBATCH_H
@@ -0,0 +1,556 @@
+#ifndef AESKEYSCHEDULECACHE_H
+#define AESKEYSCHEDULECACHE_H
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "aeskeyschedule.h"
+#include "cipherkey.h"
+#include "securearena.h"
+
+namespace Crypto::BlockCipher::Aes
+{
+
+///
+/// \brief	Caches up to a fixed number of key schedules for \a keySize by key ID and evicts the least recently used one.
+/// 
+///			Schedules live in a SecureArena and are zeroized on eviction. All bookkeeping is allocated up front, so neither hits nor misses
+///			allocate heap memory. A mutex guards only the bookkeeping: keys are fetched and expanded outside of it, so a slow key fetch does not
+///			hold up the lookups of other keys, and the returned leases can be used concurrently without holding it. Leased schedules are pinned
+///			and never evicted.
+/// 
+/// \since	1.0
+///
+template <uint32_t keySize>
+class KeyScheduleCache
+{
+public:
+	using ScheduleType = KeySchedule<keySize>;
+	using KeyType = Key<keySize>;
+	using KeyIdType = uint64_t;
+	
+private:
+	struct Entry;
+	
+public:
+	///
+	/// \brief	Pins a cached key schedule for as long as it exists.
+	/// 
+	/// \since	1.0
+	///
+	class Lease
+	{
+	public:
+		Lease() = default;
+		
+		Lease(const Lease &other) = delete;
+		Lease &operator=(const Lease &other) = delete;
+		
+		Lease(Lease &&other) :
+			_entry(other._entry)
+		{
+			other._entry = nullptr;
+		}
+		
+		Lease &operator=(Lease &&other)
+		{
+			if (this != &other)
+			{
+				this->release();
+				this->_entry = other._entry;
+				other._entry = nullptr;
+			}
+			
+			return *this;
+		}
+		
+		~Lease()
+		{
+			this->release();
+		}
+		
+		///
+		/// \brief	Returns \c true if the lease holds a schedule.
+		/// 
+		/// \since	1.0
+		///
+		explicit operator bool() const
+		{
+			return (this->_entry != nullptr);
+		}
+		
+		///
+		/// \brief	Returns the leased schedule.
+		/// 
+		/// \since	1.0
+		///
+		const ScheduleType &schedule() const
+		{
+			return *this->_entry->schedule;
+		}
+		
+		///
+		/// \brief	Unpins the schedule before the lease is destroyed.
+		/// 
+		/// \since	1.0
+		///
+		void release()
+		{
+			if (this->_entry != nullptr)
+			{
+				this->_entry->pins.fetch_sub(1, std::memory_order_release);
+				this->_entry = nullptr;
+			}
+		}
+		
+	private:
+		friend class KeyScheduleCache;
+		
+		Entry *_entry = nullptr;
+		
+		explicit Lease(Entry *entry) :
+			_entry(entry)
+		{
+		}
+	};
+	
+	///
+	/// \brief	Constructs a cache for \a capacity schedules.
+	/// 
+	/// \since	1.0
+	///
+	explicit KeyScheduleCache(const size_t capacity) :
+		_arena(sizeof (ScheduleType), capacity, alignof (ScheduleType)),
+		_entries(capacity),
+		_buckets(_bucketCount(capacity), _emptyBucket)
+	{
+		this->_freeEntries.reserve(capacity);
+		
+		for (size_t index = capacity; index > 0; index--)
+		{
+			this->_freeEntries.push_back(uint32_t(index - 1));
+		}
+	}
+	
+	KeyScheduleCache(const KeyScheduleCache &other) = delete;
+	KeyScheduleCache &operator=(const KeyScheduleCache &other) = delete;
+	
+	///
+	/// \brief	Destructs the cache and zeroizes all schedules.
+	/// 
+	///			No leases may be outstanding.
+	/// 
+	/// \since	1.0
+	///
+	~KeyScheduleCache()
+	{
+		this->clear();
+	}
+	
+	///
+	/// \brief	Returns the schedule for \a keyId, expanding \a key on a miss.
+	/// 
+	///			The returned lease is empty if the cache is full and every schedule is pinned.
+	/// 
+	/// \since	1.0
+	///
+	Lease acquire(const KeyIdType keyId, const KeyType &key)
+	{
+		return this->acquire(keyId, [&key]() -> const KeyType & { return key; });
+	}
+	
+	///
+	/// \brief	Returns the schedule for \a keyId, expanding the key returned by \a loader on a miss.
+	/// 
+	///			\a loader is only called on a miss, so key material only needs to be fetched for cold keys. It runs without the lock in an entry
+	///			reserved for the key, so threads missing the same key at once may each call it; the first schedule inserted is kept. If \a loader
+	///			throws, the reserved entry is given back and the exception propagates. The returned lease is empty if the cache is full and every
+	///			schedule is pinned or reserved.
+	/// 
+	/// \since	1.0
+	///
+	template <typename Loader>
+	Lease acquire(const KeyIdType keyId, Loader loader)
+	{
+		Lease returnValue;
+		uint32_t index = _noEntry;
+		
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			
+			const uint32_t cachedIndex = this->_find(keyId);
+			
+			if (cachedIndex != _noEntry)
+			{
+				this->_hits++;
+				this->_unlink(cachedIndex);
+				returnValue = this->_pin(cachedIndex);
+			}
+			else
+			{
+				// The reserved entry is neither in the table nor in the list, so no other thread can reach it until it is inserted
+				this->_misses++;
+				index = this->_allocateEntry();
+				
+				if (index != _noEntry)
+				{
+					this->_entries[index].slot = this->_arena.allocate();
+				}
+			}
+		}
+		
+		if (index != _noEntry)
+		{
+			Entry &entry = this->_entries[index];
+			
+			try
+			{
+				entry.schedule = new (entry.slot) ScheduleType(loader());
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(this->_mutex);
+				
+				this->_discard(index);
+				
+				throw;
+			}
+			
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			
+			const uint32_t cachedIndex = this->_find(keyId);
+			
+			// Another thread may have inserted the key meanwhile, whose schedule is kept
+			if (cachedIndex != _noEntry)
+			{
+				this->_discard(index);
+				this->_unlink(cachedIndex);
+				index = cachedIndex;
+			}
+			else
+			{
+				entry.keyId = keyId;
+				this->_insert(keyId, index);
+			}
+			
+			returnValue = this->_pin(index);
+		}
+		
+		return returnValue;
+	}
+	
+	///
+	/// \brief	Removes the schedule for \a keyId, e.g. after the key was rotated.
+	/// 
+	///			Returns \c false if the schedule is not cached or currently leased.
+	/// 
+	/// \since	1.0
+	///
+	bool evict(const KeyIdType keyId)
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		
+		bool returnValue = false;
+		const uint32_t index = this->_find(keyId);
+		
+		if ((index != _noEntry) && (this->_entries[index].pins.load(std::memory_order_acquire) == 0))
+		{
+			this->_unlink(index);
+			this->_release(index);
+			returnValue = true;
+		}
+		
+		return returnValue;
+	}
+	
+	///
+	/// \brief	Removes all schedules that are not leased.
+	/// 
+	/// \since	1.0
+	///
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		
+		uint32_t index = this->_head;
+		
+		while (index != _noEntry)
+		{
+			const uint32_t next = this->_entries[index].next;
+			
+			if (this->_entries[index].pins.load(std::memory_order_acquire) == 0)
+			{
+				this->_unlink(index);
+				this->_release(index);
+			}
+			
+			index = next;
+		}
+	}
+	
+	///
+	/// \brief	Returns the maximum number of schedules.
+	/// 
+	/// \since	1.0
+	///
+	size_t capacity() const
+	{
+		return this->_entries.size();
+	}
+	
+	///
+	/// \brief	Returns the number of lookups served from the cache.
+	/// 
+	/// \since	1.0
+	///
+	uint64_t hits() const
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		
+		return this->_hits;
+	}
+	
+	///
+	/// \brief	Returns the number of lookups that required a key expansion or failed.
+	/// 
+	/// \since	1.0
+	///
+	uint64_t misses() const
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		
+		return this->_misses;
+	}
+	
+	///
+	/// \brief	Returns \c true if the schedules are locked into memory.
+	/// 
+	/// \since	1.0
+	///
+	bool isLocked() const
+	{
+		return this->_arena.isLocked();
+	}
+	
+private:
+	static constexpr uint32_t _noEntry = ~uint32_t(0);
+	static constexpr uint32_t _emptyBucket = ~uint32_t(0);
+	
+	struct Entry
+	{
+		KeyIdType keyId = 0;
+		ScheduleType *schedule = nullptr;
+		void *slot = nullptr;
+		std::atomic<uint32_t> pins{0};
+		uint32_t previous = _noEntry;
+		uint32_t next = _noEntry;
+	};
+	
+	mutable std::mutex _mutex;
+	SecureArena _arena;
+	std::vector<Entry> _entries;
+	
+	// Open addressing table of entry indices with linear probing
+	std::vector<uint32_t> _buckets;
+	
+	// Most recently used entry first
+	uint32_t _head = _noEntry;
+	uint32_t _tail = _noEntry;
+	
+	// Indices of entries without a schedule
+	std::vector<uint32_t> _freeEntries;
+	
+	uint64_t _hits = 0;
+	uint64_t _misses = 0;
+	
+	static size_t _bucketCount(const size_t capacity)
+	{
+		size_t returnValue = 1;
+		
+		// Keep the load factor at or below one half
+		while (returnValue < capacity * 2)
+		{
+			returnValue <<= 1;
+		}
+		
+		return returnValue;
+	}
+	
+	size_t _bucketOf(const KeyIdType keyId) const
+	{
+		// Fibonacci hashing spreads sequential IDs
+		return size_t((keyId * 0x9e3779b97f4a7c15ull) >> 32) & (this->_buckets.size() - 1);
+	}
+	
+	uint32_t _find(const KeyIdType keyId) const
+	{
+		uint32_t returnValue = _noEntry;
+		
+		for (size_t bucket = this->_bucketOf(keyId); this->_buckets[bucket] != _emptyBucket; bucket = (bucket + 1) & (this->_buckets.size() - 1))
+		{
+			if (this->_entries[this->_buckets[bucket]].keyId == keyId)
+			{
+				returnValue = this->_buckets[bucket];
+				break;
+			}
+		}
+		
+		return returnValue;
+	}
+	
+	void _insert(const KeyIdType keyId, const uint32_t index)
+	{
+		size_t bucket = this->_bucketOf(keyId);
+		
+		while (this->_buckets[bucket] != _emptyBucket)
+		{
+			bucket = (bucket + 1) & (this->_buckets.size() - 1);
+		}
+		
+		this->_buckets[bucket] = index;
+	}
+	
+	void _erase(const KeyIdType keyId)
+	{
+		const size_t mask = this->_buckets.size() - 1;
+		size_t bucket = this->_bucketOf(keyId);
+		
+		while (this->_entries[this->_buckets[bucket]].keyId != keyId)
+		{
+			bucket = (bucket + 1) & mask;
+		}
+		
+		// Backward shift deletion keeps probe sequences intact without tombstones
+		size_t next = (bucket + 1) & mask;
+		
+		while (this->_buckets[next] != _emptyBucket)
+		{
+			const size_t home = this->_bucketOf(this->_entries[this->_buckets[next]].keyId);
+			
+			if (((next - home) & mask) >= ((next - bucket) & mask))
+			{
+				this->_buckets[bucket] = this->_buckets[next];
+				bucket = next;
+			}
+			
+			next = (next + 1) & mask;
+		}
+		
+		this->_buckets[bucket] = _emptyBucket;
+	}
+	
+	uint32_t _allocateEntry()
+	{
+		uint32_t returnValue = _noEntry;
+		
+		if (this->_freeEntries.empty())
+		{
+			// Evict the least recently used entry that is not pinned
+			uint32_t index = this->_tail;
+			
+			while ((index != _noEntry) && (this->_entries[index].pins.load(std::memory_order_acquire) != 0))
+			{
+				index = this->_entries[index].previous;
+			}
+			
+			if (index != _noEntry)
+			{
+				this->_unlink(index);
+				this->_release(index);
+			}
+		}
+		
+		// Never place key schedules in unprotected memory
+		if (!this->_freeEntries.empty() && this->_arena.isValid())
+		{
+			returnValue = this->_freeEntries.back();
+			this->_freeEntries.pop_back();
+		}
+		
+		return returnValue;
+	}
+	
+	void _release(const uint32_t index)
+	{
+		this->_erase(this->_entries[index].keyId);
+		this->_discard(index);
+	}
+	
+	void _discard(const uint32_t index)
+	{
+		Entry &entry = this->_entries[index];
+		
+		// The schedule zeroizes its round keys, the arena wipes the slot once more
+		if (entry.schedule != nullptr)
+		{
+			entry.schedule->~ScheduleType();
+			entry.schedule = nullptr;
+		}
+		
+		this->_arena.deallocate(entry.slot);
+		entry.slot = nullptr;
+		this->_freeEntries.push_back(index);
+	}
+	
+	Lease _pin(const uint32_t index)
+	{
+		this->_pushFront(index);
+		this->_entries[index].pins.fetch_add(1, std::memory_order_acquire);
+		
+		return Lease(&this->_entries[index]);
+	}
+	
+	void _unlink(const uint32_t index)
+	{
+		Entry &entry = this->_entries[index];
+		
+		if (entry.previous != _noEntry)
+		{
+			this->_entries[entry.previous].next = entry.next;
+		}
+		else if (this->_head == index)
+		{
+			this->_head = entry.next;
+		}
+		
+		if (entry.next != _noEntry)
+		{
+			this->_entries[entry.next].previous = entry.previous;
+		}
+		else if (this->_tail == index)
+		{
+			this->_tail = entry.previous;
+		}
+		
+		entry.previous = _noEntry;
+		entry.next = _noEntry;
+	}
+	
+	void _pushFront(const uint32_t index)
+	{
+		Entry &entry = this->_entries[index];
+		
+		entry.previous = _noEntry;
+		entry.next = this->_head;
+		
+		if (this->_head != _noEntry)
+		{
+			this->_entries[this->_head].previous = index;
+		}
+		
+		this->_head = index;
+		
+		if (this->_tail == _noEntry)
+		{
+			this->_tail = index;
+		}
+	}
+};
+
+} // namespace Crypto::BlockCipher::Aes
+
+#endif // AESKEYSCHEDULECACHE_H
@@ -0,0 +1,228 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace Crypto
+{
+
+///
+/// \brief	Recycles equally sized staging buffers for encryption pipelines.
+/// 
+///			Buffers are carved out of slabs of 2 MiB huge pages, which come from the huge page pool if pages are reserved and from transparent
+///			huge pages otherwise. Slabs are faulted in by the thread that maps them, so their memory is placed on that thread's NUMA node, and
+///			every node keeps its own list of free buffers. A thread leases from the list of the node it runs on and only maps a new slab if the
+///			list is empty, so buffers are reused without page faults once the pool is warm.
+/// 
+///			The pool is thread safe. It must outlive all of its leases.
+/// 
+/// \since	1.0
+///
+class BufferPool
+{
+public:
+	///
+	/// \brief	Owns one buffer of a pool and returns it on destruction.
+	/// 
+	/// \since	1.0
+	///
+	class Lease
+	{
+	public:
+		Lease() = default;
+		
+		Lease(const Lease &other) = delete;
+		Lease &operator=(const Lease &other) = delete;
+		
+		Lease(Lease &&other) :
+			_pool(other._pool),
+			_data(other._data),
+			_node(other._node)
+		{
+			other._data = nullptr;
+		}
+		
+		Lease &operator=(Lease &&other)
+		{
+			if (this != &other)
+			{
+				this->release();
+				this->_pool = other._pool;
+				this->_data = other._data;
+				this->_node = other._node;
+				other._data = nullptr;
+			}
+			
+			return *this;
+		}
+		
+		~Lease()
+		{
+			this->release();
+		}
+		
+		///
+		/// \brief	Returns \c true if the lease holds a buffer.
+		/// 
+		/// \since	1.0
+		///
+		bool isValid() const
+		{
+			return (this->_data != nullptr);
+		}
+		
+		///
+		/// \brief	Returns the buffer or \c nullptr if the lease is empty.
+		/// 
+		/// \since	1.0
+		///
+		uint8_t *data() const
+		{
+			return this->_data;
+		}
+		
+		///
+		/// \brief	Returns the size of the buffer in bytes or zero if the lease is empty.
+		/// 
+		/// \since	1.0
+		///
+		size_t size() const
+		{
+			return (this->_data != nullptr) ? this->_pool->bufferSize() : 0;
+		}
+		
+		///
+		/// \brief	Returns the buffer to the pool early, which zeroizes it if the pool was created that way.
+		/// 
+		/// \since	1.0
+		///
+		void release()
+		{
+			if (this->_data != nullptr)
+			{
+				this->_pool->_release(this->_data, this->_node);
+				this->_data = nullptr;
+			}
+		}
+	
+	private:
+		friend class BufferPool;
+		
+		BufferPool *_pool = nullptr;
+		uint8_t *_data = nullptr;
+		size_t _node = 0;
+		
+		Lease(BufferPool *pool, uint8_t *data, const size_t node) :
+			_pool(pool),
+			_data(data),
+			_node(node)
+		{
+		}
+	};
+	
+	///
+	/// \brief	The size of the huge pages slabs are made of.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t hugePageSize = 2 * 1024 * 1024;
+	
+	///
+	/// \brief	Creates an empty pool of buffers of \a bufferSize bytes aligned to \a alignment, which must be a power of two up to the page size.
+	/// 
+	///			If \a zeroize is \c true, buffers are cleared with safeSetZero() when they are returned, so no plaintext stays behind in the pool.
+	/// 
+	/// \since	1.0
+	///
+	BufferPool(const size_t bufferSize, const bool zeroize = true, const size_t alignment = 64);
+	
+	BufferPool(const BufferPool &other) = delete;
+	BufferPool &operator=(const BufferPool &other) = delete;
+	
+	///
+	/// \brief	Unmaps all slabs.
+	/// 
+	/// \since	1.0
+	///
+	~BufferPool();
+	
+	///
+	/// \brief	Leases a buffer local to the NUMA node of the calling thread.
+	/// 
+	///			The returned lease is empty if no memory could be mapped.
+	/// 
+	/// \since	1.0
+	///
+	Lease lease();
+	
+	///
+	/// \brief	Returns the size of each buffer in bytes.
+	/// 
+	/// \since	1.0
+	///
+	size_t bufferSize() const
+	{
+		return this->_bufferSize;
+	}
+	
+	///
+	/// \brief	Returns the number of buffers mapped so far, whether leased or free.
+	/// 
+	/// \since	1.0
+	///
+	size_t bufferCount() const;
+	
+	///
+	/// \brief	Returns the number of slabs that are backed by reserved huge pages rather than transparent huge pages.
+	/// 
+	/// \since	1.0
+	///
+	size_t hugePageSlabCount() const;
+	
+private:
+	///
+	/// \internal
+	/// 
+	/// \brief	Holds the free buffers of one NUMA node.
+	/// 
+	/// \since	1.0
+	///
+	struct _Node
+	{
+		std::mutex mutex;
+		std::vector<uint8_t *> freeBuffers;
+	};
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Describes one mapping buffers are carved out of.
+	/// 
+	/// \since	1.0
+	///
+	struct _Slab
+	{
+		uint8_t *data = nullptr;
+		size_t size = 0;
+		bool hugePages = false;
+	};
+	
+	size_t _bufferSize = 0;
+	size_t _slotSize = 0;
+	size_t _slabSize = 0;
+	bool _zeroize = true;
+	std::vector<std::unique_ptr<_Node>> _nodes;
+	mutable std::mutex _slabMutex;
+	std::vector<_Slab> _slabs;
+	
+	bool _mapSlab(_Node &node);
+	void _release(uint8_t *data, const size_t node);
+};
+
+} // namespace Crypto
+
+#endif // BUFFERPOOL_H
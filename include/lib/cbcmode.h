@@ -7,6 +7,7 @@
 #include "cipherkey.h"
 #include "ciphermode.h"
 #include "cryptoutilities.h"
+#include "fragmentcursor.h"
 #include "paddingtype.h"
 
 ///
@@ -18,7 +19,10 @@ namespace Crypto::Mode
 {
 
 ///
-/// \brief	Implements the counter (CTR) mode for \a BlockType.
+/// \brief	Implements the cipher block chaining (CBC) mode for \a BlockType.
+/// 
+///			PaddingType::CipherTextStealing implements CBC-CS3 of NIST SP 800-38A Addendum, which keeps the ciphertext the size of the plaintext
+///			but requires at least one complete block.
 /// 
 /// \since	1.0
 ///
@@ -27,52 +31,509 @@ class Cbc
 {
 public:
 	using KeyType = typename BlockType::KeyType;
+	using ScheduleType = typename BlockType::ScheduleType;
+	
+	///
+	/// \brief	Returned by encrypt() and decrypt() if the input cannot be processed with the requested padding.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t invalidSize = ~size_t(0);
 	
 	Cbc() = delete;
 	~Cbc() = delete;
 	
-	static void encrypt(const KeyType &key, const uint8_t *initializationVector, const uint8_t *plaintext, const size_t size, uint8_t *ciphertext,
-						const PaddingType padding = PaddingType::Nulls)
+	///
+	/// \brief	Returns the size of the ciphertext for \a size bytes of plaintext.
+	/// 
+	/// \since	1.0
+	///
+	static size_t ciphertextSize(const size_t size, const PaddingType padding = PaddingType::Nulls)
+	{
+		size_t returnValue = size;
+		
+		switch (padding)
+		{
+			case PaddingType::Nulls:
+				returnValue = calculateBlockCount<BlockType>(size) * blockSize;
+				break;
+			case PaddingType::NBytes:
+				returnValue = (size / blockSize + 1) * blockSize;
+				break;
+			case PaddingType::CipherTextStealing:
+				break;
+		}
+		
+		return returnValue;
+	}
+	
+	///
+	/// \brief	Returns the number of bytes at the end of a ciphertext of \a size bytes that are decrypted together to remove \a padding.
+	/// 
+	///			Everything before the tail is a run of whole blocks that chains like a message without padding.
+	/// 
+	/// \since	1.0
+	///
+	static size_t ciphertextTailSize(const size_t size, const PaddingType padding = PaddingType::Nulls)
+	{
+		size_t returnValue = _tailSize(size, padding);
+		
+		// The padding of NBytes always fills the last complete block
+		if (padding == PaddingType::NBytes)
+		{
+			returnValue = (size < blockSize) ? size : blockSize;
+		}
+		
+		return returnValue;
+	}
+	
+	static size_t encrypt(const KeyType &key, const uint8_t *initializationVector, const uint8_t *plaintext, const size_t size, uint8_t *ciphertext,
+						  const PaddingType padding = PaddingType::Nulls)
+	{
+		const ScheduleType schedule(key);
+		
+		return encrypt(schedule, initializationVector, plaintext, size, ciphertext, padding);
+	}
+	
+	///
+	/// \brief	Encrypts \a size bytes of \a plaintext using the shared key \a schedule and stores the result in \a ciphertext.
+	/// 
+	///			\a ciphertext must hold ciphertextSize() bytes. Returns the number of bytes written or #invalidSize if \a size is too small for
+	///			ciphertext stealing. \a ciphertext may be equal to \a plaintext if the padding does not enlarge the data.
+	/// 
+	/// \since	1.0
+	///
+	static size_t encrypt(const ScheduleType &schedule, const uint8_t *initializationVector, const uint8_t *plaintext, const size_t size,
+						  uint8_t *ciphertext, const PaddingType padding = PaddingType::Nulls)
+	{
+		const size_t completeBlocks = size / blockSize;
+		const size_t remainingBytes = size % blockSize;
+		size_t returnValue = ciphertextSize(size, padding);
+		
+		if ((padding == PaddingType::CipherTextStealing) && (size < blockSize))
+		{
+			returnValue = invalidSize;
+		}
+		else
+		{
+			uint8_t chainBlock[blockSize];
+			memcpy(chainBlock, initializationVector, blockSize);
+			
+			// Encrypt complete blocks
+			for (size_t blockIndex = 0; blockIndex < completeBlocks; blockIndex++)
+			{
+				_xorBlock(chainBlock, plaintext + blockIndex * blockSize, blockSize);
+				schedule.encryptBlocks(chainBlock, chainBlock, 1);
+				memcpy(ciphertext + blockIndex * blockSize, chainBlock, blockSize);
+			}
+			
+			// Encrypt last padded block
+			uint8_t lastBlock[blockSize];
+			memset(lastBlock, (padding == PaddingType::NBytes) ? int(blockSize - remainingBytes) : 0, blockSize);
+			
+			if (remainingBytes != 0)
+			{
+				memcpy(lastBlock, plaintext + completeBlocks * blockSize, remainingBytes);
+			}
+			
+			if (padding == PaddingType::CipherTextStealing)
+			{
+				if (completeBlocks > 1 || remainingBytes != 0)
+				{
+					_stealCiphertext(schedule, chainBlock, lastBlock, remainingBytes, completeBlocks, ciphertext);
+				}
+			}
+			else if ((padding == PaddingType::NBytes) || (remainingBytes != 0))
+			{
+				_xorBlock(chainBlock, lastBlock, blockSize);
+				schedule.encryptBlocks(chainBlock, ciphertext + completeBlocks * blockSize, 1);
+			}
+			
+			safeSetZero(lastBlock, sizeof (lastBlock));
+			safeSetZero(chainBlock, sizeof (chainBlock));
+		}
+		
+		return returnValue;
+	}
+	
+	static size_t decrypt(const KeyType &key, const uint8_t *initializationVector, const uint8_t *ciphertext, const size_t size, uint8_t *plaintext,
+						  const PaddingType padding = PaddingType::Nulls)
+	{
+		const ScheduleType schedule(key);
+		
+		return decrypt(schedule, initializationVector, ciphertext, size, plaintext, padding);
+	}
+	
+	///
+	/// \brief	Decrypts \a size bytes of \a ciphertext using the shared key \a schedule and stores the result in \a plaintext.
+	/// 
+	///			\a plaintext must hold \a size bytes and may be equal to \a ciphertext. Returns the size of the plaintext without padding or
+	///			#invalidSize if \a size does not fit the padding or the padding is malformed. Null padding cannot be told apart from the message
+	///			and is kept.
+	/// 
+	/// \since	1.0
+	///
+	static size_t decrypt(const ScheduleType &schedule, const uint8_t *initializationVector, const uint8_t *ciphertext, const size_t size,
+						  uint8_t *plaintext, const PaddingType padding = PaddingType::Nulls)
+	{
+		size_t returnValue = size;
+		
+		if (padding == PaddingType::CipherTextStealing)
+		{
+			if (size < blockSize)
+			{
+				returnValue = invalidSize;
+			}
+			else
+			{
+				_decryptStolenCiphertext(schedule, initializationVector, ciphertext, size, plaintext);
+			}
+		}
+		else if (((size % blockSize) != 0) || ((padding == PaddingType::NBytes) && (size == 0)))
+		{
+			returnValue = invalidSize;
+		}
+		else
+		{
+			_decryptBlocks(schedule, initializationVector, ciphertext, size / blockSize, plaintext);
+			
+			if (padding == PaddingType::NBytes)
+			{
+				returnValue = _removePadding(plaintext, size);
+			}
+		}
+		
+		return returnValue;
+	}
+	
+	static size_t encrypt(const KeyType &key, const uint8_t *initializationVector, const iovec *plaintext, const size_t plaintextCount,
+						  const iovec *ciphertext, const size_t ciphertextCount, const PaddingType padding = PaddingType::Nulls)
 	{
-		BlockType block(key);
+		const ScheduleType schedule(key);
 		
-		// Calculate block count
-		uint64_t blockCount = calculateBlockCount<BlockType>(size);
+		return encrypt(schedule, initializationVector, plaintext, plaintextCount, ciphertext, ciphertextCount, padding);
+	}
+	
+	///
+	/// \brief	Encrypts the concatenation of the \a plaintext fragments into the \a ciphertext fragments using the shared key \a schedule.
+	/// 
+	///			Fragments may have any sizes; blocks spanning fragment boundaries are gathered and scattered through a single block buffer, while
+	///			runs of whole blocks inside a fragment are encrypted in place. The ciphertext fragments must hold ciphertextSize() bytes. Returns
+	///			the number of bytes written or #invalidSize if the ciphertext fragments are too small or the plaintext is too small for
+	///			ciphertext stealing.
+	/// 
+	/// \since	1.0
+	///
+	static size_t encrypt(const ScheduleType &schedule, const uint8_t *initializationVector, const iovec *plaintext, const size_t plaintextCount,
+						  const iovec *ciphertext, const size_t ciphertextCount, const PaddingType padding = PaddingType::Nulls)
+	{
+		const size_t size = fragmentsSize(plaintext, plaintextCount);
+		size_t returnValue = ciphertextSize(size, padding);
 		
-		// Encrypt first complete block
-		if (blockCount > 0)
+		if (((padding == PaddingType::CipherTextStealing) && (size < blockSize)) || (fragmentsSize(ciphertext, ciphertextCount) < returnValue))
+		{
+			returnValue = invalidSize;
+		}
+		else
 		{
+			const size_t tailSize = _tailSize(size, padding);
+			FragmentCursor input(plaintext, plaintextCount);
+			FragmentCursor output(ciphertext, ciphertextCount);
+			uint8_t chainBlock[blockSize];
+			uint8_t tail[blockSize * 3];
+			
+			memcpy(chainBlock, initializationVector, blockSize);
+			
+			for (size_t blockCount = (size - tailSize) / blockSize; blockCount != 0;)
+			{
+				const size_t contiguousSize = (input.contiguousSize() < output.contiguousSize()) ? input.contiguousSize() : output.contiguousSize();
+				const size_t runBlocks = ((contiguousSize / blockSize) < blockCount) ? (contiguousSize / blockSize) : blockCount;
+				const size_t processedBlocks = (runBlocks != 0) ? runBlocks : 1;
+				
+				if (runBlocks != 0)
+				{
+					encrypt(schedule, chainBlock, input.data(), runBlocks * blockSize, output.data());
+					memcpy(chainBlock, output.data() + (runBlocks - 1) * blockSize, blockSize);
+					input.advance(runBlocks * blockSize);
+					output.advance(runBlocks * blockSize);
+				}
+				else
+				{
+					input.gather(tail, blockSize);
+					encrypt(schedule, chainBlock, tail, blockSize, chainBlock);
+					output.scatter(chainBlock, blockSize);
+				}
+				
+				blockCount -= processedBlocks;
+			}
 			
+			// Padding and ciphertext stealing only touch the last blocks, which continue the chain
+			input.gather(tail, tailSize);
+			output.scatter(tail, encrypt(schedule, chainBlock, tail, tailSize, tail, padding));
+			
+			safeSetZero(tail, sizeof (tail));
+			safeSetZero(chainBlock, sizeof (chainBlock));
 		}
 		
-		// Encrypt intermediate blocks
-		for (uint64_t blockIndex = 0; blockIndex < blockCount - 1; blockIndex++)
+		return returnValue;
+	}
+	
+	static size_t decrypt(const KeyType &key, const uint8_t *initializationVector, const iovec *ciphertext, const size_t ciphertextCount,
+						  const iovec *plaintext, const size_t plaintextCount, const PaddingType padding = PaddingType::Nulls)
+	{
+		const ScheduleType schedule(key);
+		
+		return decrypt(schedule, initializationVector, ciphertext, ciphertextCount, plaintext, plaintextCount, padding);
+	}
+	
+	///
+	/// \brief	Decrypts the concatenation of the \a ciphertext fragments into the \a plaintext fragments using the shared key \a schedule.
+	/// 
+	///			The plaintext fragments must hold as many bytes as the ciphertext. Returns the size of the plaintext without padding or
+	///			#invalidSize if the plaintext fragments are too small, the size does not fit the padding or the padding is malformed.
+	/// 
+	/// \since	1.0
+	///
+	static size_t decrypt(const ScheduleType &schedule, const uint8_t *initializationVector, const iovec *ciphertext, const size_t ciphertextCount,
+						  const iovec *plaintext, const size_t plaintextCount, const PaddingType padding = PaddingType::Nulls)
+	{
+		const size_t size = fragmentsSize(ciphertext, ciphertextCount);
+		const bool stealing = (padding == PaddingType::CipherTextStealing);
+		size_t returnValue = size;
+		
+		if ((stealing && (size < blockSize)) || (!stealing && (((size % blockSize) != 0) || ((padding == PaddingType::NBytes) && (size == 0))))
+				|| (fragmentsSize(plaintext, plaintextCount) < size))
+		{
+			returnValue = invalidSize;
+		}
+		else
 		{
-			uint8_t cipherBlock[BlockType::TraitsType::blockSize];
-			uint8_t plainBlock[BlockType::TraitsType::blockSize];
+			const size_t tailSize = ciphertextTailSize(size, padding);
+			FragmentCursor input(ciphertext, ciphertextCount);
+			FragmentCursor output(plaintext, plaintextCount);
+			uint8_t chainBlock[blockSize];
+			uint8_t nextChainBlock[blockSize];
+			uint8_t tail[blockSize * 3];
 			
-			// Copy current plaintext block
-			memcpy(plainBlock, plaintext + blockIndex * sizeof (plainBlock), sizeof (plainBlock));
+			memcpy(chainBlock, initializationVector, blockSize);
+			
+			for (size_t blockCount = (size - tailSize) / blockSize; blockCount != 0;)
+			{
+				const size_t contiguousSize = (input.contiguousSize() < output.contiguousSize()) ? input.contiguousSize() : output.contiguousSize();
+				const size_t runBlocks = ((contiguousSize / blockSize) < blockCount) ? (contiguousSize / blockSize) : blockCount;
+				const size_t processedBlocks = (runBlocks != 0) ? runBlocks : 1;
+				
+				// The last ciphertext block of the run chains into the next one and may be overwritten by in place decryption
+				if (runBlocks != 0)
+				{
+					memcpy(nextChainBlock, input.data() + (runBlocks - 1) * blockSize, blockSize);
+					_decryptBlocks(schedule, chainBlock, input.data(), runBlocks, output.data());
+					input.advance(runBlocks * blockSize);
+					output.advance(runBlocks * blockSize);
+				}
+				else
+				{
+					input.gather(nextChainBlock, blockSize);
+					_decryptBlocks(schedule, chainBlock, nextChainBlock, 1, tail);
+					output.scatter(tail, blockSize);
+				}
+				
+				memcpy(chainBlock, nextChainBlock, blockSize);
+				blockCount -= processedBlocks;
+			}
+			
+			input.gather(tail, tailSize);
+			
+			const size_t tailPlaintextSize = decrypt(schedule, chainBlock, tail, tailSize, tail, padding);
+			
+			if (tailPlaintextSize == invalidSize)
+			{
+				returnValue = invalidSize;
+			}
+			else
+			{
+				output.scatter(tail, tailPlaintextSize);
+				returnValue = size - tailSize + tailPlaintextSize;
+			}
+			
+			safeSetZero(tail, sizeof (tail));
+			safeSetZero(chainBlock, sizeof (chainBlock));
+		}
+		
+		return returnValue;
+	}
+	
+private:
+	static constexpr size_t blockSize = BlockType::TraitsType::blockSize;
+	
+	///
+	/// \brief	The number of blocks decrypted with one kernel call.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t tileBlocks = 64;
+	
+	///
+	/// \brief	Returns the number of bytes at the end of a message of \a size bytes that are affected by \a padding.
+	/// 
+	///			Everything before the tail is a run of whole blocks that chains like a message without padding.
+	/// 
+	/// \since	1.0
+	///
+	static size_t _tailSize(const size_t size, const PaddingType padding)
+	{
+		size_t returnValue = size % blockSize;
+		
+		// Ciphertext stealing swaps the last two blocks, even if both are complete
+		if ((padding == PaddingType::CipherTextStealing) && (size >= blockSize * 2))
+		{
+			returnValue += blockSize;
+			returnValue += (returnValue == blockSize) ? blockSize : 0;
+		}
+		else if (padding == PaddingType::CipherTextStealing)
+		{
+			returnValue = size;
+		}
+		
+		return returnValue;
+	}
+	
+	static void _xorBlock(uint8_t *destination, const uint8_t *source, const size_t size)
+	{
+		for (size_t byte = 0; byte < size; byte++)
+		{
+			destination[byte] ^= source[byte];
+		}
+	}
+	
+	static void _stealCiphertext(const ScheduleType &schedule, const uint8_t *chainBlock, const uint8_t *lastBlock, const size_t remainingBytes,
+								 const size_t completeBlocks, uint8_t *ciphertext)
+	{
+		// The last complete ciphertext block becomes the partial block at the end, the encrypted padded remainder takes its place
+		uint8_t lastCipherBlock[blockSize];
+		const size_t partialBytes = (remainingBytes == 0) ? blockSize : remainingBytes;
+		const size_t lastCompleteBlock = (remainingBytes == 0) ? (completeBlocks - 2) : (completeBlocks - 1);
+		
+		if (remainingBytes == 0)
+		{
+			// Every block is complete; CS3 still swaps the last two blocks
+			memcpy(lastCipherBlock, ciphertext + (completeBlocks - 1) * blockSize, blockSize);
+			memcpy(ciphertext + (completeBlocks - 1) * blockSize, ciphertext + lastCompleteBlock * blockSize, blockSize);
+			memcpy(ciphertext + lastCompleteBlock * blockSize, lastCipherBlock, blockSize);
+		}
+		else
+		{
+			memcpy(lastCipherBlock, chainBlock, blockSize);
+			_xorBlock(lastCipherBlock, lastBlock, blockSize);
+			schedule.encryptBlocks(lastCipherBlock, lastCipherBlock, 1);
 			
-			// Copy initialization vector in counter
-			memcpy(cipherBlock, initializationVector, (BlockType::TraitsType::blockSize));
+			memcpy(ciphertext + (lastCompleteBlock + 1) * blockSize, chainBlock, partialBytes);
+			memcpy(ciphertext + lastCompleteBlock * blockSize, lastCipherBlock, blockSize);
 		}
 		
-		// Encrypt last possibly incomplete block
-		if (blockCount == 0)
+		safeSetZero(lastCipherBlock, sizeof (lastCipherBlock));
+	}
+	
+	static void _decryptBlocks(const ScheduleType &schedule, const uint8_t *initializationVector, const uint8_t *ciphertext, const size_t blockCount,
+							   uint8_t *plaintext)
+	{
+		uint8_t previousBlock[blockSize];
+		uint8_t decryptedBlocks[tileBlocks * blockSize];
+		
+		memcpy(previousBlock, initializationVector, blockSize);
+		
+		// Blocks are independent for decryption, so whole tiles are decrypted at once and chained afterwards
+		for (size_t tile = 0; tile < blockCount; tile += tileBlocks)
 		{
+			const size_t tileBlockCount = ((blockCount - tile) < tileBlocks) ? (blockCount - tile) : tileBlocks;
+			const uint8_t *tileCiphertext = ciphertext + tile * blockSize;
+			uint8_t *tilePlaintext = plaintext + tile * blockSize;
+			uint8_t nextPreviousBlock[blockSize];
 			
+			schedule.decryptBlocks(tileCiphertext, decryptedBlocks, tileBlockCount);
+			memcpy(nextPreviousBlock, tileCiphertext + (tileBlockCount - 1) * blockSize, blockSize);
+			
+			// Walk backwards so in place decryption still sees the preceding ciphertext block
+			for (size_t blockIndex = tileBlockCount; blockIndex > 0; blockIndex--)
+			{
+				const uint8_t *chainBlock = (blockIndex == 1) ? previousBlock : (tileCiphertext + (blockIndex - 2) * blockSize);
+				uint8_t *decryptedBlock = decryptedBlocks + (blockIndex - 1) * blockSize;
+				
+				_xorBlock(decryptedBlock, chainBlock, blockSize);
+				memcpy(tilePlaintext + (blockIndex - 1) * blockSize, decryptedBlock, blockSize);
+			}
+			
+			memcpy(previousBlock, nextPreviousBlock, blockSize);
+		}
+		
+		safeSetZero(decryptedBlocks, sizeof (decryptedBlocks));
+		safeSetZero(previousBlock, sizeof (previousBlock));
+	}
+	
+	static void _decryptStolenCiphertext(const ScheduleType &schedule, const uint8_t *initializationVector, const uint8_t *ciphertext, const size_t size,
+										 uint8_t *plaintext)
+	{
+		const size_t blockCount = calculateBlockCount<BlockType>(size);
+		const size_t partialBytes = size - (blockCount - 1) * blockSize;
+		
+		if (blockCount == 1)
+		{
+			_decryptBlocks(schedule, initializationVector, ciphertext, 1, plaintext);
 		}
 		else
 		{
+			// Restore the original order of the last two blocks
+			uint8_t lastCipherBlock[blockSize];
+			uint8_t secondLastCipherBlock[blockSize];
+			uint8_t decryptedBlock[blockSize];
+			uint8_t chainBlock[blockSize];
+			
+			const size_t secondLastOffset = (blockCount - 2) * blockSize;
+			
+			memcpy(lastCipherBlock, ciphertext + secondLastOffset, blockSize);
+			memcpy(chainBlock, (blockCount > 2) ? (ciphertext + secondLastOffset - blockSize) : initializationVector, blockSize);
+			
+			// The tail of the decrypted last block equals the stolen tail of the second last ciphertext block
+			schedule.decryptBlocks(lastCipherBlock, decryptedBlock, 1);
+			memcpy(secondLastCipherBlock, decryptedBlock, blockSize);
+			memcpy(secondLastCipherBlock, ciphertext + secondLastOffset + blockSize, partialBytes);
 			
+			_decryptBlocks(schedule, initializationVector, ciphertext, blockCount - 2, plaintext);
+			
+			// Last partial plaintext block
+			_xorBlock(decryptedBlock, secondLastCipherBlock, partialBytes);
+			memcpy(plaintext + secondLastOffset + blockSize, decryptedBlock, partialBytes);
+			
+			// Second last plaintext block
+			schedule.decryptBlocks(secondLastCipherBlock, decryptedBlock, 1);
+			_xorBlock(decryptedBlock, chainBlock, blockSize);
+			memcpy(plaintext + secondLastOffset, decryptedBlock, blockSize);
+			
+			safeSetZero(decryptedBlock, sizeof (decryptedBlock));
 		}
 	}
 	
-	static void decrypt(const KeyType &key, const uint8_t *initializationVector, const uint8_t *ciphertext, const size_t size, uint8_t *plaintext,
-						const PaddingType padding = PaddingType::Nulls)
+	static size_t _removePadding(const uint8_t *plaintext, const size_t size)
 	{
+		size_t returnValue = invalidSize;
+		const uint8_t paddingBytes = plaintext[size - 1];
+		
+		if ((paddingBytes > 0) && (paddingBytes <= blockSize))
+		{
+			uint8_t mismatch = 0;
+			
+			for (size_t byte = size - paddingBytes; byte < size; byte++)
+			{
+				mismatch |= uint8_t(plaintext[byte] ^ paddingBytes);
+			}
+			
+			if (mismatch == 0)
+			{
+				returnValue = size - paddingBytes;
+			}
+		}
 		
+		return returnValue;
 	}
 };
 
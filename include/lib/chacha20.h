@@ -0,0 +1,242 @@
+#ifndef CHACHA20_H
+#define CHACHA20_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chachakernels.h"
+#include "cipherkey.h"
+#include "cryptoglobals.h"
+
+///
+/// \brief	Contains implementations of stream ciphers.
+/// 
+/// \since	1.0
+///
+namespace Crypto::StreamCipher
+{
+
+///
+/// \brief	Implements the ChaCha20 stream cipher as described in RFC 8439.
+/// 
+///			The interface follows Mode::Ctr: the keystream starts at block counter zero, any byte of it can be reached through a stream
+///			offset, and long messages are split into chunks processed by several threads. The block function runs in the widest vector
+///			kernel of ChaCha::kernels(), which needs no table lookups and runs in constant time on every CPU.
+/// 
+///			The block counter has 32 bits, so a key and nonce pair covers #maxStreamSize bytes, 256 GiB, of keystream. Requests beyond it are
+///			rejected, since the counter would wrap around and repeat the keystream.
+/// 
+/// \since	1.0
+///
+class ChaCha20
+{
+public:
+	using KeyType = Key<32>;
+	
+	///
+	/// \brief	The size of the key in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t keySize = 32;
+	
+	///
+	/// \brief	The size of the nonce in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t nonceSize = 12;
+	
+	///
+	/// \brief	The size of a keystream block in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t blockSize = ChaCha::blockSize;
+	
+	///
+	/// \brief	The number of bytes processed by one thread at a time.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t chunkSize = 1024 * blockSize;
+	
+	///
+	/// \brief	The number of keystream bytes of a key and nonce pair, 2^32 blocks.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr uint64_t maxStreamSize = uint64_t(1) << 38;
+	
+	ChaCha20() = delete;
+	~ChaCha20() = delete;
+	
+	///
+	/// \brief	Encrypts \a size bytes of \a plaintext with \a key and \a nonce and stores the result in \a ciphertext.
+	/// 
+	///			\a ciphertext may be equal to \a plaintext for in place encryption but must not overlap it otherwise. Returns \c false without
+	///			encrypting anything if \a size exceeds #maxStreamSize.
+	/// 
+	/// \since	1.0
+	///
+	static bool encrypt(const KeyType &key, const uint8_t *nonce, const uint8_t *plaintext, const size_t size, uint8_t *ciphertext)
+	{
+		return encrypt(key, nonce, 0, plaintext, size, ciphertext);
+	}
+	
+	///
+	/// \brief	Encrypts \a size bytes of \a plaintext located at byte \a streamOffset of the keystream of \a key and \a nonce.
+	/// 
+	///			Only the keystream of the requested range is generated, so the cost does not depend on \a streamOffset. The offset does not need
+	///			to be block aligned; the initial counter 1 of RFC 8439 corresponds to the offset #blockSize. Returns \c false without encrypting
+	///			anything if the range ends beyond #maxStreamSize.
+	/// 
+	/// \since	1.0
+	///
+	static bool encrypt(const KeyType &key, const uint8_t *nonce, const uint64_t streamOffset, const uint8_t *plaintext, const size_t size,
+			uint8_t *ciphertext)
+	{
+		const bool returnValue = isWithinStream(streamOffset, size);
+		
+		if (returnValue)
+		{
+			uint32_t state[16];
+			
+			initializeState(key, nonce, state);
+			transform(state, streamOffset, plaintext, size, ciphertext);
+			
+			safeSetZero(state, sizeof (state));
+		}
+		
+		return returnValue;
+	}
+	
+	static bool decrypt(const KeyType &key, const uint8_t *nonce, const uint8_t *ciphertext, const size_t size, uint8_t *plaintext)
+	{
+		return encrypt(key, nonce, 0, ciphertext, size, plaintext);
+	}
+	
+	static bool decrypt(const KeyType &key, const uint8_t *nonce, const uint64_t streamOffset, const uint8_t *ciphertext, const size_t size,
+			uint8_t *plaintext)
+	{
+		return encrypt(key, nonce, streamOffset, ciphertext, size, plaintext);
+	}
+	
+	///
+	/// \brief	Returns \c true if the \a size bytes at \a streamOffset lie within the #maxStreamSize bytes of keystream.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr bool isWithinStream(const uint64_t streamOffset, const uint64_t size)
+	{
+		return (streamOffset <= maxStreamSize) && (size <= (maxStreamSize - streamOffset));
+	}
+	
+	///
+	/// \brief	Writes the initial block state of \a key and \a nonce with counter zero to the 16 words of \a state.
+	/// 
+	/// \since	1.0
+	///
+	static void initializeState(const KeyType &key, const uint8_t *nonce, uint32_t *state)
+	{
+		// "expand 32-byte k"
+		state[0] = 0x61707865;
+		state[1] = 0x3320646e;
+		state[2] = 0x79622d32;
+		state[3] = 0x6b206574;
+		
+		for (size_t word = 0; word < 8; word++)
+		{
+			state[4 + word] = _load32(key.key + word * 4);
+		}
+		
+		state[12] = 0;
+		
+		for (size_t word = 0; word < 3; word++)
+		{
+			state[13 + word] = _load32(nonce + word * 4);
+		}
+	}
+	
+	///
+	/// \brief	XORs the keystream of \a state starting at byte \a streamOffset into \a size bytes of \a input and stores the result in \a output.
+	/// 
+	///			The counter word of \a state is ignored. Chunks of #chunkSize bytes are distributed over threads. The range must lie within
+	///			#maxStreamSize, see isWithinStream().
+	/// 
+	/// \since	1.0
+	///
+	static void transform(const uint32_t *state, const uint64_t streamOffset, const uint8_t *input, const size_t size, uint8_t *output)
+	{
+		const ChaCha::Kernels &kernels = ChaCha::kernels();
+		const size_t skippedBytes = streamOffset % blockSize;
+		const size_t blockRemainder = (blockSize - skippedBytes) % blockSize;
+		const size_t leadingBytes = (blockRemainder < size) ? blockRemainder : size;
+		const size_t blockCount = (size - leadingBytes) / blockSize;
+		const size_t trailingBytes = size - leadingBytes - blockCount * blockSize;
+		const uint32_t firstCounter = uint32_t(streamOffset / blockSize) + ((leadingBytes != 0) ? 1 : 0);
+		
+		// Partial blocks at both ends use the middle of a keystream block
+		if (leadingBytes != 0)
+		{
+			_transformPartial(kernels, state, uint32_t(streamOffset / blockSize), skippedBytes, input, leadingBytes, output);
+		}
+		
+		const size_t chunkBlocks = chunkSize / blockSize;
+		const size_t chunkCount = (blockCount + chunkBlocks - 1) / chunkBlocks;
+		const uint8_t *blockInput = input + leadingBytes;
+		uint8_t *blockOutput = output + leadingBytes;
+		
+		// Chunks are independent because each one derives its starting counter from the offset
+#pragma omp parallel for schedule(static) if (chunkCount > 1)
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			const size_t firstBlock = chunk * chunkBlocks;
+			const size_t chunkBlockCount = ((blockCount - firstBlock) < chunkBlocks) ? (blockCount - firstBlock) : chunkBlocks;
+			uint32_t chunkState[16];
+			
+			memcpy(chunkState, state, sizeof (chunkState));
+			chunkState[12] = firstCounter + uint32_t(firstBlock);
+			kernels.xorBlocks(chunkState, blockInput + firstBlock * blockSize, blockOutput + firstBlock * blockSize, chunkBlockCount);
+			
+			safeSetZero(chunkState, sizeof (chunkState));
+		}
+		
+		if (trailingBytes != 0)
+		{
+			const size_t offset = size - trailingBytes;
+			
+			_transformPartial(kernels, state, firstCounter + uint32_t(blockCount), 0, input + offset, trailingBytes, output + offset);
+		}
+	}
+	
+private:
+	static uint32_t _load32(const uint8_t *bytes)
+	{
+		return uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+	}
+	
+	static void _transformPartial(const ChaCha::Kernels &kernels, const uint32_t *state, const uint32_t counter, const size_t skippedBytes,
+			const uint8_t *input, const size_t size, uint8_t *output)
+	{
+		uint8_t keystream[blockSize] = {};
+		uint32_t blockState[16];
+		
+		memcpy(blockState, state, sizeof (blockState));
+		blockState[12] = counter;
+		kernels.xorBlocks(blockState, keystream, keystream, 1);
+		
+		for (size_t byte = 0; byte < size; byte++)
+		{
+			output[byte] = input[byte] ^ keystream[skippedBytes + byte];
+		}
+		
+		safeSetZero(keystream, sizeof (keystream));
+		safeSetZero(blockState, sizeof (blockState));
+	}
+};
+
+} // namespace Crypto::StreamCipher
+
+#endif // CHACHA20_H
@@ -0,0 +1,230 @@
+#ifndef CHACHA20POLY1305_H
+#define CHACHA20POLY1305_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chacha20.h"
+#include "cryptoglobals.h"
+#include "nonceallocator.h"
+#include "poly1305.h"
+
+namespace Crypto::StreamCipher
+{
+
+///
+/// \brief	Implements the ChaCha20-Poly1305 authenticated encryption of RFC 8439.
+/// 
+///			The Poly1305 key is taken from the first keystream block and the message is encrypted from counter one on. Encryption runs tile by
+///			tile, so each tile of ciphertext is authenticated while it is still in the cache. Decryption verifies the tag over the whole
+///			ciphertext first and only then decrypts with all threads, so no plaintext is released for a forged message.
+/// 
+/// \since	1.0
+///
+class ChaCha20Poly1305
+{
+public:
+	using KeyType = ChaCha20::KeyType;
+	
+	///
+	/// \brief	The size of the nonce in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t nonceSize = ChaCha20::nonceSize;
+	
+	///
+	/// \brief	The size of the authentication tag in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t tagSize = Hash::Poly1305::macSize;
+	
+	///
+	/// \brief	The number of bytes encrypted and authenticated together, sized to stay in the L2 cache.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t tileSize = 64 * 1024;
+	
+	///
+	/// \brief	The maximum size of a message in bytes, the keystream of a nonce minus the block of the Poly1305 key.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr uint64_t maxMessageSize = ChaCha20::maxStreamSize - ChaCha20::blockSize;
+	
+	static_assert(Mode::NonceAllocator::nonceSize == nonceSize, "Allocated nonces must fit ChaCha20");
+	
+	ChaCha20Poly1305() = delete;
+	~ChaCha20Poly1305() = delete;
+	
+	///
+	/// \brief	Encrypts \a size bytes of \a plaintext, authenticates them together with \a aadSize bytes of \a additionalData and writes the
+	///			ciphertext to \a ciphertext and the tag of #tagSize bytes to \a tag.
+	/// 
+	///			\a ciphertext may be equal to \a plaintext for in place encryption but must not overlap it otherwise. A \a nonce must never be
+	///			used twice with the same \a key. Returns \c false without writing anything if \a size exceeds #maxMessageSize, beyond which the
+	///			block counter would wrap around to the block of the Poly1305 key.
+	/// 
+	/// \since	1.0
+	///
+	static bool encrypt(const KeyType &key, const uint8_t *nonce, const uint8_t *additionalData, const size_t aadSize, const uint8_t *plaintext,
+			const size_t size, uint8_t *ciphertext, uint8_t *tag)
+	{
+		const bool returnValue = (size <= maxMessageSize);
+		
+		if (returnValue)
+		{
+			uint32_t state[16];
+			uint8_t authenticationKey[Hash::Poly1305::keySize];
+			
+			ChaCha20::initializeState(key, nonce, state);
+			_authenticationKey(state, authenticationKey);
+			
+			Hash::Poly1305 authenticator(authenticationKey);
+			
+			safeSetZero(authenticationKey, sizeof (authenticationKey));
+			authenticator.update(additionalData, aadSize);
+			_pad(authenticator, aadSize);
+			
+			for (size_t offset = 0; offset < size; offset += tileSize)
+			{
+				const size_t tileBytes = ((size - offset) < tileSize) ? (size - offset) : tileSize;
+				
+				ChaCha20::transform(state, ChaCha20::blockSize + offset, plaintext + offset, tileBytes, ciphertext + offset);
+				authenticator.update(ciphertext + offset, tileBytes);
+			}
+			
+			_finalize(authenticator, aadSize, size, tag);
+			
+			safeSetZero(state, sizeof (state));
+		}
+		
+		return returnValue;
+	}
+	
+	///
+	/// \brief	Encrypts like encrypt() with the next nonce of \a lane, which is written to \a nonce.
+	/// 
+	///			Returns \c false without encrypting anything if the lane ran out of nonces or \a size exceeds #maxMessageSize; no nonce is used up
+	///			in the latter case.
+	/// 
+	/// \since	1.0
+	///
+	static bool encrypt(const KeyType &key, Mode::NonceAllocator::Lane &lane, const uint8_t *additionalData, const size_t aadSize,
+			const uint8_t *plaintext, const size_t size, uint8_t *ciphertext, uint8_t *tag, uint8_t *nonce)
+	{
+		const bool returnValue = (size <= maxMessageSize) && lane.nextNonce(nonce);
+		
+		return returnValue && encrypt(key, nonce, additionalData, aadSize, plaintext, size, ciphertext, tag);
+	}
+	
+	///
+	/// \brief	Verifies \a tag over \a size bytes of \a ciphertext and \a aadSize bytes of \a additionalData and decrypts \a ciphertext to
+	///			\a plaintext if it matches.
+	/// 
+	///			Returns \c false without writing to \a plaintext if the tag does not match or \a size exceeds #maxMessageSize. The comparison
+	///			takes the same time for every tag.
+	/// 
+	/// \since	1.0
+	///
+	static bool decrypt(const KeyType &key, const uint8_t *nonce, const uint8_t *additionalData, const size_t aadSize, const uint8_t *ciphertext,
+			const size_t size, const uint8_t *tag, uint8_t *plaintext)
+	{
+		bool returnValue = (size <= maxMessageSize);
+		
+		if (returnValue)
+		{
+			uint32_t state[16];
+			uint8_t authenticationKey[Hash::Poly1305::keySize];
+			uint8_t expectedTag[tagSize];
+			
+			ChaCha20::initializeState(key, nonce, state);
+			_authenticationKey(state, authenticationKey);
+			
+			Hash::Poly1305 authenticator(authenticationKey);
+			
+			safeSetZero(authenticationKey, sizeof (authenticationKey));
+			authenticator.update(additionalData, aadSize);
+			_pad(authenticator, aadSize);
+			authenticator.update(ciphertext, size);
+			_finalize(authenticator, aadSize, size, expectedTag);
+			
+			uint8_t difference = 0;
+			
+			for (size_t byte = 0; byte < tagSize; byte++)
+			{
+				difference |= expectedTag[byte] ^ tag[byte];
+			}
+			
+			returnValue = (difference == 0);
+			
+			if (returnValue)
+			{
+				ChaCha20::transform(state, ChaCha20::blockSize, ciphertext, size, plaintext);
+			}
+			
+			safeSetZero(state, sizeof (state));
+			safeSetZero(expectedTag, sizeof (expectedTag));
+		}
+		
+		return returnValue;
+	}
+	
+private:
+	///
+	/// \internal
+	/// 
+	/// \brief	Writes the one-time Poly1305 key, the start of keystream block zero of \a state, to \a authenticationKey.
+	/// 
+	/// \since	1.0
+	///
+	static void _authenticationKey(const uint32_t *state, uint8_t *authenticationKey)
+	{
+		memset(authenticationKey, 0, Hash::Poly1305::keySize);
+		ChaCha20::transform(state, 0, authenticationKey, Hash::Poly1305::keySize, authenticationKey);
+	}
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Appends zeros to a message part of \a size bytes up to the next multiple of 16 bytes.
+	/// 
+	/// \since	1.0
+	///
+	static void _pad(Hash::Poly1305 &authenticator, const uint64_t size)
+	{
+		static const uint8_t zeros[16] = {};
+		
+		authenticator.update(zeros, size_t((16 - (size % 16)) % 16));
+	}
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Pads the ciphertext, appends both lengths as 64 bit little endian numbers and writes the tag.
+	/// 
+	/// \since	1.0
+	///
+	static void _finalize(Hash::Poly1305 &authenticator, const uint64_t aadSize, const uint64_t size, uint8_t *tag)
+	{
+		uint8_t lengths[16];
+		
+		_pad(authenticator, size);
+		
+		for (size_t byte = 0; byte < 8; byte++)
+		{
+			lengths[byte] = uint8_t(aadSize >> (8 * byte));
+			lengths[8 + byte] = uint8_t(size >> (8 * byte));
+		}
+		
+		authenticator.update(lengths, sizeof (lengths));
+		authenticator.finalize(tag);
+	}
+};
+
+} // namespace Crypto::StreamCipher
+
+#endif // CHACHA20POLY1305_H
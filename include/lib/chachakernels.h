@@ -0,0 +1,75 @@
+#ifndef CHACHAKERNELS_H
+#define CHACHAKERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+///
+/// \brief	Contains the ChaCha specific implementations.
+/// 
+/// \since	1.0
+///
+namespace Crypto::StreamCipher::ChaCha
+{
+
+///
+/// \brief	The size of a ChaCha block in bytes.
+/// 
+/// \since	1.0
+///
+static constexpr size_t blockSize = 64;
+
+///
+/// \brief	Holds the ChaCha20 kernels selected for the running CPU.
+/// 
+/// \since	1.0
+///
+struct Kernels
+{
+	///
+	/// \brief	XORs \a blockCount blocks of ChaCha20 keystream into \a input and stores the result in \a output.
+	/// 
+	///			\a state holds the 16 words of the initial state of the first block in host order; word 12 is the block counter, which wraps
+	///			around after 2^32 blocks as in RFC 8439. \a output may be equal to \a input. Vector kernels compute several blocks with each
+	///			instruction stream.
+	/// 
+	/// \since	1.0
+	///
+	void (*xorBlocks)(const uint32_t *state, const uint8_t *input, uint8_t *output, const size_t blockCount);
+	
+	///
+	/// \brief	The name of the kernel set for diagnostics.
+	/// 
+	/// \since	1.0
+	///
+	const char *name;
+};
+
+///
+/// \brief	Returns the fastest kernels allowed by Crypto::Cpu::features().
+/// 
+///			The kernels are selected on first use and again by selectKernels(), so the features are not checked on every call.
+/// 
+/// \since	1.0
+///
+const Kernels &kernels();
+
+///
+/// \brief	Selects the kernels returned by kernels() again for the current Crypto::Cpu::features().
+/// 
+///			Crypto::Cpu::restrictFeatures() calls it after changing the features.
+/// 
+/// \since	1.0
+///
+void selectKernels();
+
+///
+/// \brief	Returns the portable kernels.
+/// 
+/// \since	1.0
+///
+const Kernels &genericKernels();
+
+} // namespace Crypto::StreamCipher::ChaCha
+
+#endif // CHACHAKERNELS_H
@@ -0,0 +1,238 @@
+#ifndef CHUNKEDCONTAINER_H
+#define CHUNKEDCONTAINER_H
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "aesblock.h"
+#include "aeskeyschedule.h"
+
+///
+/// \brief	Contains the chunked authenticated container format.
+/// 
+///			A container consists of
+/// 
+///			- a header of \c headerSize bytes: the magic \c "CRYPTOC1", the big endian 32 bit version and chunk size, the 16 byte object nonce and
+///			  16 reserved zero bytes,
+///			- the AES-256-CTR ciphertext of all chunks, each of them of chunk size bytes except for the last one,
+///			- the index of the HMAC-SHA-256 tags of all chunks in chunk order and
+///			- a trailer of \c trailerSize bytes: the big endian 64 bit chunk count and plaintext size followed by the root tag.
+/// 
+///			Encryption and authentication keys are derived per object from the master key and the object nonce. The counter of chunk \c i starts at
+///			the big endian 64 bit \c i followed by 64 zero bits, so chunks are independent. A chunk tag covers the chunk index and the ciphertext,
+///			the root tag covers the header, the index and the trailer fields, which detects reordered, exchanged and truncated chunks. As all
+///			chunks but the last have the same size, chunk offsets follow directly from the chunk index and the index only holds the tags.
+/// 
+/// \since	1.0
+///
+namespace Crypto::Container
+{
+
+///
+/// \brief	The size of the container header in bytes.
+/// 
+/// \since	1.0
+///
+static constexpr size_t headerSize = 48;
+
+///
+/// \brief	The size of the container trailer in bytes.
+/// 
+/// \since	1.0
+///
+static constexpr size_t trailerSize = 48;
+
+///
+/// \brief	The size of the object nonce in bytes.
+/// 
+/// \since	1.0
+///
+static constexpr size_t nonceSize = 16;
+
+///
+/// \brief	The size of chunk and root tags in bytes.
+/// 
+/// \since	1.0
+///
+static constexpr size_t tagSize = 32;
+
+///
+/// \brief	The chunk size used if none is specified.
+/// 
+/// \since	1.0
+///
+static constexpr uint32_t defaultChunkSize = 64 * 1024;
+
+///
+/// \brief	Writes a container to a stream that only needs to support sequential output.
+/// 
+///			Data passed to write() is buffered until a batch of chunks is complete, which is then encrypted and authenticated in parallel.
+/// 
+/// \since	1.0
+///
+class Writer
+{
+public:
+	///
+	/// \brief	Starts a container on \a stream.
+	/// 
+	///			\a objectNonce of nonceSize bytes must never be reused for another object under the same \a masterKey. \a batchChunks chunks are
+	///			processed in parallel at a time.
+	/// 
+	/// \since	1.0
+	///
+	Writer(std::ostream &stream, const BlockCipher::Aes256Key &masterKey, const uint8_t *objectNonce, const uint32_t chunkSize = defaultChunkSize,
+			const size_t batchChunks = 64);
+	
+	Writer(const Writer &other) = delete;
+	Writer &operator=(const Writer &other) = delete;
+	
+	///
+	/// \brief	Discards all buffered data and key material.
+	/// 
+	/// \since	1.0
+	///
+	~Writer();
+	
+	///
+	/// \brief	Appends \a size bytes of \a data to the object.
+	/// 
+	///			Returns \c false if the stream failed or the container was already finished.
+	/// 
+	/// \since	1.0
+	///
+	bool write(const uint8_t *data, size_t size);
+	
+	///
+	/// \brief	Writes the remaining data, the index and the trailer.
+	/// 
+	///			Returns \c false if the stream failed or the container was already finished.
+	/// 
+	/// \since	1.0
+	///
+	bool finish();
+	
+private:
+	std::ostream &_stream;
+	std::unique_ptr<BlockCipher::Aes::KeySchedule256> _schedule;
+	uint8_t _macKey[tagSize];
+	uint8_t _header[headerSize];
+	uint32_t _chunkSize;
+	size_t _batchChunks;
+	std::vector<uint8_t> _buffer;
+	std::vector<uint8_t> _ciphertext;
+	size_t _bufferSize = 0;
+	std::vector<uint8_t> _tags;
+	uint64_t _size = 0;
+	bool _finished = false;
+	
+	bool _flush(const size_t size);
+};
+
+///
+/// \brief	Reads any chunk or byte range of a container from a seekable stream.
+/// 
+///			The header, index and trailer are authenticated on construction. Afterwards every range read only touches the chunks it covers, which
+///			are verified and decrypted in parallel.
+/// 
+/// \since	1.0
+///
+class Reader
+{
+public:
+	///
+	/// \brief	Opens the container in \a stream.
+	/// 
+	///			Check isValid() to find out whether the container could be authenticated with \a masterKey.
+	/// 
+	/// \since	1.0
+	///
+	Reader(std::istream &stream, const BlockCipher::Aes256Key &masterKey);
+	
+	Reader(const Reader &other) = delete;
+	Reader &operator=(const Reader &other) = delete;
+	
+	///
+	/// \brief	Discards all key material.
+	/// 
+	/// \since	1.0
+	///
+	~Reader();
+	
+	///
+	/// \brief	Returns \c true if the header, the index and the trailer are authentic.
+	/// 
+	/// \since	1.0
+	///
+	bool isValid() const
+	{
+		return (this->_schedule != nullptr);
+	}
+	
+	///
+	/// \brief	Returns the plaintext size of the object in bytes.
+	/// 
+	/// \since	1.0
+	///
+	uint64_t size() const
+	{
+		return this->_size;
+	}
+	
+	///
+	/// \brief	Returns the number of chunks.
+	/// 
+	/// \since	1.0
+	///
+	uint64_t chunkCount() const
+	{
+		return this->_chunkCount;
+	}
+	
+	///
+	/// \brief	Returns the size of all but the last chunk in bytes.
+	/// 
+	/// \since	1.0
+	///
+	uint32_t chunkSize() const
+	{
+		return this->_chunkSize;
+	}
+	
+	///
+	/// \brief	Verifies and decrypts \a count chunks starting at \a firstChunk into \a plaintext.
+	/// 
+	///			\a plaintext must be large enough for all requested chunks. Returns \c false if the range is out of bounds, the stream failed or
+	///			any chunk is not authentic. In the latter case the whole range in \a plaintext is zeroed, so unauthenticated plaintext is never released.
+	/// 
+	/// \since	1.0
+	///
+	bool readChunks(const uint64_t firstChunk, const uint64_t count, uint8_t *plaintext);
+	
+	///
+	/// \brief	Verifies and decrypts \a size bytes of the object starting at \a offset into \a plaintext.
+	/// 
+	///			Returns \c false under the same conditions as readChunks().
+	/// 
+	/// \since	1.0
+	///
+	bool read(const uint64_t offset, const size_t size, uint8_t *plaintext);
+	
+private:
+	std::istream &_stream;
+	std::unique_ptr<BlockCipher::Aes::KeySchedule256> _schedule;
+	uint8_t _macKey[tagSize];
+	uint32_t _chunkSize = 0;
+	uint64_t _chunkCount = 0;
+	uint64_t _size = 0;
+	std::vector<uint8_t> _tags;
+	std::vector<uint8_t> _ciphertext;
+};
+
+} // namespace Crypto::Container
+
+#endif // CHUNKEDCONTAINER_H
@@ -1,8 +1,13 @@
 #ifndef CIPHERMODE_H
 #define CIPHERMODE_H
 
+#include <atomic>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cryptoglobals.h"
 
 namespace Crypto::Mode
 {
@@ -10,9 +15,9 @@ namespace Crypto::Mode
 template <typename BlockType>
 static inline size_t calculateBlockCount(const size_t size)
 {
-	size_t returnValue = (size / BlockType::TraitsType::keySize);
+	size_t returnValue = (size / BlockType::TraitsType::blockSize);
 	
-	if (size % (BlockType::TraitsType::keySize) != 0)
+	if (size % (BlockType::TraitsType::blockSize) != 0)
 	{
 		returnValue++;
 	}
@@ -20,6 +25,160 @@ static inline size_t calculateBlockCount(const size_t size)
 	return returnValue;
 }
 
+///
+/// \brief	Describes one message of a batched counter mode call.
+/// 
+///			\a input and \a output may alias exactly but must not overlap otherwise or with any other message of the batch.
+/// 
+/// \since	1.0
+///
+struct CtrMessage
+{
+	///
+	/// \brief	The initial big endian 128 bit counter of the message, it is not modified.
+	/// 
+	/// \since	1.0
+	///
+	const uint8_t *initializationVector;
+	
+	///
+	/// \brief	The plaintext or ciphertext of the message.
+	/// 
+	/// \since	1.0
+	///
+	const uint8_t *input;
+	
+	///
+	/// \brief	The size of the message in bytes.
+	/// 
+	/// \since	1.0
+	///
+	size_t size;
+	
+	///
+	/// \brief	Receives \a size bytes of ciphertext or plaintext.
+	/// 
+	/// \since	1.0
+	///
+	uint8_t *output;
+};
+
+///
+/// \brief	Selects which side of a cipher operation is fed to the digest of a fused encrypt and hash call.
+/// 
+/// \since	1.0
+///
+enum class HashedData
+{
+	Plaintext,
+	Ciphertext
+};
+
+///
+/// \brief	Adds \a blocks to the big endian 128 bit \a counter, propagating the carry across all of its bytes.
+/// 
+/// \since	1.0
+///
+static inline void addToCounter(uint8_t *counter, const uint64_t blocks)
+{
+	uint64_t high = 0;
+	uint64_t low = 0;
+	
+	memcpy(&high, counter, sizeof (high));
+	memcpy(&low, counter + sizeof (high), sizeof (low));
+	
+	const uint64_t sum = changeEndianness(low) + blocks;
+	
+	high = changeEndianness(changeEndianness(high) + uint64_t(sum < blocks));
+	low = changeEndianness(sum);
+	
+	memcpy(counter, &high, sizeof (high));
+	memcpy(counter + sizeof (high), &low, sizeof (low));
+}
+
+///
+/// \brief	XORs \a size bytes of \a input with \a keystream and writes them to \a output, which may be equal to \a input.
+/// 
+///			Words are moved with memcpy(), which compiles to full width loads and stores regardless of alignment and reads each word before
+///			it is overwritten when working in place.
+/// 
+/// \since	1.0
+///
+static inline void xorKeystream(const uint8_t *input, const uint8_t *keystream, uint8_t *output, const size_t size)
+{
+	size_t byte = 0;
+	
+	for (; (byte + sizeof (uint64_t)) <= size; byte += sizeof (uint64_t))
+	{
+		uint64_t data = 0;
+		uint64_t key = 0;
+		
+		memcpy(&data, input + byte, sizeof (data));
+		memcpy(&key, keystream + byte, sizeof (key));
+		data ^= key;
+		memcpy(output + byte, &data, sizeof (data));
+	}
+	
+	for (; byte < size; byte++)
+	{
+		output[byte] = input[byte] ^ keystream[byte];
+	}
+}
+
+///
+/// \brief	The streaming threshold used if the size of the last level cache is unknown.
+/// 
+/// \since	1.0
+///
+static constexpr size_t defaultStreamingThreshold = 32 * 1024 * 1024;
+
+///
+/// \internal
+/// 
+/// \brief	Holds the streaming threshold, which defaults to four times the size of the last level cache.
+/// 
+///			The function is inline rather than static, so all translation units share a single threshold.
+/// 
+/// \since	1.0
+///
+inline std::atomic<size_t> &_streamingThreshold()
+{
+	static std::atomic<size_t> threshold([](){
+		long cacheSize = 0;
+		
+#ifdef _SC_LEVEL3_CACHE_SIZE
+		cacheSize = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+		
+		return (cacheSize > 0) ? size_t(cacheSize) * 4 : defaultStreamingThreshold;
+	}());
+	
+	return threshold;
+}
+
+///
+/// \brief	Returns the size in bytes from which bulk operations write their output with non-temporal stores.
+/// 
+///			Output written that way bypasses the caches, so encrypting a buffer much larger than the last level cache neither evicts the
+///			working set of the application nor reads the destination into the cache before overwriting it.
+/// 
+/// \since	1.0
+///
+inline size_t streamingThreshold()
+{
+	return _streamingThreshold().load(std::memory_order_relaxed);
+}
+
+///
+/// \brief	Sets the size in bytes from which bulk operations write their output with non-temporal stores, \c SIZE_MAX disables them.
+/// 
+/// \since	1.0
+///
+inline void setStreamingThreshold(const size_t threshold)
+{
+	_streamingThreshold().store(threshold, std::memory_order_relaxed);
+}
+
 } // namespace Crypto::Mode
 
 #endif // CIPHERMODE_H
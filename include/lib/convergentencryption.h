@@ -0,0 +1,222 @@
+#ifndef CONVERGENTENCRYPTION_H
+#define CONVERGENTENCRYPTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ciphermode.h"
+#include "cryptoglobals.h"
+#include "ctrmode.h"
+#include "sha2digest.h"
+#include "sha2multidigest.h"
+
+namespace Crypto::Mode
+{
+
+///
+/// \brief	Describes one chunk of a convergent encryption batch.
+/// 
+/// \since	1.0
+///
+struct ConvergentChunk
+{
+	///
+	/// \brief	The plaintext of the chunk.
+	/// 
+	/// \since	1.0
+	///
+	const uint8_t *plaintext;
+	
+	///
+	/// \brief	The size of the chunk in bytes.
+	/// 
+	/// \since	1.0
+	///
+	size_t size;
+	
+	///
+	/// \brief	Receives \a size bytes of ciphertext, may be equal to \a plaintext.
+	/// 
+	/// \since	1.0
+	///
+	uint8_t *ciphertext;
+	
+	///
+	/// \brief	Receives the chunk ID of ConvergentEncryption::chunkIdSize bytes.
+	/// 
+	/// \since	1.0
+	///
+	uint8_t *chunkId;
+	
+	///
+	/// \brief	Receives the chunk key of ConvergentEncryption::keySize bytes, which is needed for decryption.
+	/// 
+	/// \since	1.0
+	///
+	uint8_t *key;
+};
+
+///
+/// \brief	Implements convergent encryption of chunks for deduplicated storage with \a BlockType in counter mode.
+/// 
+///			The key of a chunk is the SHA-256 hash of its plaintext, truncated to the key size, and the chunk is encrypted with it from an all
+///			zero counter; the key is never used for other content, so the fixed counter is safe. The chunk ID is the SHA-256 hash of the
+///			plaintext hash. Equal plaintexts therefore yield equal ciphertexts and IDs, while the ID reveals nothing about the key. As with any
+///			convergent scheme, whoever can guess a chunk's content can confirm the guess through its ID.
+/// 
+///			A batch is split into groups of #groupSize chunks that are processed in parallel. Within a group the plaintexts are hashed in the
+///			lanes of Hash::Sha2::MultiDigest256, the IDs are hashed the same way, and then the keys of the group are expanded together and all
+///			chunks are encrypted in the lanes of the multi key counter mode kernel while they are still in the cache. Callers ingesting a stream
+///			pass it in batches as chunks arrive.
+/// 
+/// \since	1.0
+///
+template <typename BlockType>
+class ConvergentEncryption
+{
+public:
+	using ScheduleType = typename BlockType::ScheduleType;
+	using ScheduleBatchType = typename BlockType::ScheduleBatchType;
+	
+	///
+	/// \brief	The size of a chunk key in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t keySize = BlockType::TraitsType::keySize;
+	
+	///
+	/// \brief	The size of a chunk ID in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t chunkIdSize = SHA256_DIGEST_SIZE;
+	
+	///
+	/// \brief	The number of chunks hashed together, one per lane of the multi-buffer hash.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t groupSize = Hash::Sha2::MultiDigest256::laneCount;
+	
+	static_assert(keySize <= SHA256_DIGEST_SIZE, "The key is taken from a SHA-256 hash value");
+	
+	ConvergentEncryption() = delete;
+	~ConvergentEncryption() = delete;
+	
+	///
+	/// \brief	Encrypts the \a size bytes of \a plaintext into \a ciphertext and writes the chunk ID to \a chunkId and the key to \a key.
+	/// 
+	/// \since	1.0
+	///
+	static void encrypt(const uint8_t *plaintext, const size_t size, uint8_t *ciphertext, uint8_t *chunkId, uint8_t *key)
+	{
+		const ConvergentChunk chunk = {plaintext, size, ciphertext, chunkId, key};
+		
+		encrypt(&chunk, 1);
+	}
+	
+	///
+	/// \brief	Encrypts all \a chunkCount \a chunks and writes their IDs and keys.
+	/// 
+	/// \since	1.0
+	///
+	static void encrypt(const ConvergentChunk *chunks, const size_t chunkCount)
+	{
+		const size_t groupCount = (chunkCount + groupSize - 1) / groupSize;
+		
+		// Chunk sizes vary with content defined chunking, so groups are handed out as threads become free
+#pragma omp parallel for schedule(dynamic) if (groupCount > 1)
+		for (size_t group = 0; group < groupCount; group++)
+		{
+			const size_t first = group * groupSize;
+			
+			_encryptGroup(chunks + first, ((chunkCount - first) < groupSize) ? (chunkCount - first) : groupSize);
+		}
+	}
+	
+	///
+	/// \brief	Decrypts \a size bytes of \a ciphertext with the chunk \a key into \a plaintext and checks the plaintext against the key.
+	/// 
+	///			Returns \c false if the plaintext does not hash to \a key, i.e. the ciphertext or the key is corrupted. Decryption and hashing
+	///			share a single pass over the data.
+	/// 
+	/// \since	1.0
+	///
+	static bool decrypt(const uint8_t *key, const uint8_t *ciphertext, const size_t size, uint8_t *plaintext)
+	{
+		const ScheduleType schedule(key);
+		const uint8_t counter[BlockType::TraitsType::blockSize] = {};
+		uint8_t plaintextHash[SHA256_DIGEST_SIZE];
+		uint8_t difference = 0;
+		
+		Ctr<BlockType>::template decryptAndHash<Hash::Sha2::Digest256>(schedule, counter, ciphertext, size, plaintext, HashedData::Plaintext,
+				plaintextHash);
+		
+		for (size_t byte = 0; byte < keySize; byte++)
+		{
+			difference |= plaintextHash[byte] ^ key[byte];
+		}
+		
+		safeSetZero(plaintextHash, sizeof (plaintextHash));
+		
+		return (difference == 0);
+	}
+	
+private:
+	///
+	/// \internal
+	/// 
+	/// \brief	Hashes the \a chunkCount \a chunks of a group lane by lane and encrypts them with one batch of key schedules.
+	/// 
+	/// \since	1.0
+	///
+	static void _encryptGroup(const ConvergentChunk *chunks, const size_t chunkCount)
+	{
+		const uint8_t *messages[groupSize] = {};
+		size_t messageSizes[groupSize] = {};
+		uint8_t plaintextHashes[groupSize * SHA256_DIGEST_SIZE];
+		uint8_t chunkIds[groupSize * chunkIdSize];
+		uint8_t keys[groupSize * keySize];
+		const uint8_t counter[BlockType::TraitsType::blockSize] = {};
+		CtrMessage ctrMessages[groupSize];
+		
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			messages[chunk] = chunks[chunk].plaintext;
+			messageSizes[chunk] = chunks[chunk].size;
+		}
+		
+		Hash::Sha2::MultiDigest256::hash(messages, messageSizes, chunkCount, plaintextHashes);
+		
+		// The IDs are single block messages, which fill all lanes at once
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			messages[chunk] = plaintextHashes + chunk * SHA256_DIGEST_SIZE;
+			messageSizes[chunk] = SHA256_DIGEST_SIZE;
+		}
+		
+		Hash::Sha2::MultiDigest256::hash(messages, messageSizes, chunkCount, chunkIds);
+		
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			memcpy(keys + chunk * keySize, plaintextHashes + chunk * SHA256_DIGEST_SIZE, keySize);
+			ctrMessages[chunk] = {counter, chunks[chunk].plaintext, chunks[chunk].size, chunks[chunk].ciphertext};
+			memcpy(chunks[chunk].key, keys + chunk * keySize, keySize);
+			memcpy(chunks[chunk].chunkId, chunkIds + chunk * chunkIdSize, chunkIdSize);
+		}
+		
+		// Hashing comes first, so the plaintext may be overwritten by the ciphertext
+		const ScheduleBatchType schedules(keys, chunkCount);
+		
+		schedules.applyKeystream(ctrMessages);
+		
+		safeSetZero(plaintextHashes, sizeof (plaintextHashes));
+		safeSetZero(keys, sizeof (keys));
+	}
+};
+
+} // namespace Crypto::Mode
+
+#endif // CONVERGENTENCRYPTION_H
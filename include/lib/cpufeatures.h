@@ -0,0 +1,92 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+///
+/// \file
+/// \author	Niklas Dallmann
+/// \brief	Runtime CPU feature detection used to select kernels.
+/// 
+///			The features reported by the CPU can be restricted via the \c CRYPTO_CPU_FEATURES environment variable or restrictFeatures(), e.g. to
+///			benchmark the portable kernels on a machine supporting AES-NI. The variable holds a comma separated list of feature names as returned
+///			by featureName(), or \c generic to disable all extensions.
+/// 
+/// \since	1.0
+///
+
+#include <stdint.h>
+
+///
+/// \brief	Contains the CPU feature detection.
+/// 
+/// \since	1.0
+///
+namespace Crypto::Cpu
+{
+
+///
+/// \brief	Defines the instruction set extensions kernels can be selected for.
+/// 
+/// \since	1.0
+///
+enum Feature : uint32_t
+{
+	Sse2 = 1u << 0,
+	Ssse3 = 1u << 1,
+	Sse41 = 1u << 2,
+	AesNi = 1u << 3,
+	Pclmul = 1u << 4,
+	Avx = 1u << 5,
+	Avx2 = 1u << 6,
+	Avx512f = 1u << 7,
+	Sha = 1u << 8,
+	
+	/// All features known to this library.
+	AllFeatures = (1u << 9) - 1
+};
+
+///
+/// \brief	Returns the features supported by the CPU and operating system, ignoring any restriction.
+/// 
+/// \since	1.0
+///
+uint32_t detectedFeatures();
+
+///
+/// \brief	Returns the features kernels may use.
+/// 
+///			That is the detected features restricted by \c CRYPTO_CPU_FEATURES and restrictFeatures().
+/// 
+/// \since	1.0
+///
+uint32_t features();
+
+///
+/// \brief	Returns \c true if kernels may use all features in \a featureMask.
+/// 
+/// \since	1.0
+///
+inline bool hasFeatures(const uint32_t featureMask)
+{
+	return ((features() & featureMask) == featureMask);
+}
+
+///
+/// \brief	Restricts the features kernels may use to \a featureMask, overriding \c CRYPTO_CPU_FEATURES.
+/// 
+///			Features the CPU does not support are never enabled. The kernel tables of the library are selected again; objects that already
+///			selected their kernels keep them.
+/// 
+/// \since	1.0
+///
+void restrictFeatures(const uint32_t featureMask);
+
+///
+/// \brief	Returns the name of a single \a feature.
+/// 
+/// \since	1.0
+///
+const char *featureName(const Feature feature);
+
+} // namespace Crypto::Cpu
+
+#endif // CPUFEATURES_H
@@ -8,64 +8,12 @@
 /// \since	1.0
 ///
 
-#ifdef CRYPTO_NO_DEBUG
-#define INFO(text)
-#define DEBUG(text)
-#define WARN(text)
-#define ERROR(text)
-#else
-
-#include <bitset>
-#include <iomanip>
-#include <iostream>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
-#include <sstream>
 #include <type_traits>
 
-#include "aesconstants.h"
-
-///
-/// \internal
-/// 
-/// \brief	Implements CRYPTO's info output.
-/// 
-/// \since	3.0
-///
-#define INFO(text) \
-	std::cout << "[\x1B[34mINFO\x1B[0m]	" << text << std::endl;
-
-///
-/// \internal
-/// 
-/// \brief	Implements CRYPTO's debug output.
-/// 
-/// \since	3.0
-///
-#define DEBUG(text) \
-	std::cout << "[\x1B[36mDEBUG\x1B[0m]	" << text << std::endl;
-
-///
-/// \internal
-/// 
-/// \brief	Implements CRYPTO's warning output.
-/// 
-/// \since	3.0
-///
-#define WARN(text) \
-	std::cout << "[\x1B[33mWARN\x1B[0m]	" << text << std::endl;
-
-///
-/// \internal
-/// 
-/// \brief	Implements CRYPTO's error output.
-/// 
-/// \since	3.0
-///
-#define ERROR(text) \
-	std::cout << "[\x1B[31mERROR\x1B[0m]	" << text << std::endl;
-
-#endif
+#include "cryptolog.h"
 
 ///
 /// \internal
@@ -98,6 +46,18 @@
 #define CRYPTO_SSE2_SUPPORT
 #endif
 
+#if defined(__x86_64__) || defined(__i386__)
+///
+/// \internal
+/// 
+/// \brief	Defined if the target architecture is x86. Kernels for its instruction set extensions are compiled with function level target
+///			attributes and selected at runtime, independent of the compiler flags.
+/// 
+/// \since	1.0
+///
+#define CRYPTO_ARCH_X86
+#endif
+
 #if defined(__GNUC__)
 ///
 /// \brief	Defined if compiler is GCC.
@@ -137,7 +97,7 @@ inline void safeSetZero(void *source, size_t size)
 }
 
 template <typename T>
-T rotateLeft(T value, size_t bitCount)
+constexpr T rotateLeft(T value, size_t bitCount)
 {
 	static_assert (std::is_integral<T>::value, "Type is no integral type");
 	
@@ -145,7 +105,7 @@ T rotateLeft(T value, size_t bitCount)
 }
 
 template <typename T>
-T rotateRight(T value, size_t bitCount)
+constexpr T rotateRight(T value, size_t bitCount)
 {
 	static_assert (std::is_integral<T>::value, "Type is no integral type");
 	
@@ -153,7 +113,7 @@ T rotateRight(T value, size_t bitCount)
 }
 
 template <typename T>
-T shiftLeft(T value, size_t bitCount)
+constexpr T shiftLeft(T value, size_t bitCount)
 {
 	static_assert (std::is_integral<T>::value, "Type is no integral type");
 	
@@ -161,7 +121,7 @@ T shiftLeft(T value, size_t bitCount)
 }
 
 template <typename T>
-T shiftRight(T value, size_t bitCount)
+constexpr T shiftRight(T value, size_t bitCount)
 {
 	static_assert (std::is_integral<T>::value, "Type is no integral type");
 	
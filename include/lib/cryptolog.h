@@ -0,0 +1,175 @@
+#ifndef CRYPTOLOG_H
+#define CRYPTOLOG_H
+
+///
+/// \file
+/// \author	Niklas Dallmann
+/// \brief	CRYPTO's logging header.
+/// 
+///			Messages below #CRYPTO_LOG_LEVEL are removed by the preprocessor, including the evaluation of their arguments. Emitted messages are
+///			passed to a sink that can be replaced at runtime via Crypto::Log::setSink().
+/// 
+/// \since	1.0
+///
+
+#include <string>
+
+/// Disables all log output.
+#define CRYPTO_LOG_LEVEL_NONE	0
+
+/// Enables error messages.
+#define CRYPTO_LOG_LEVEL_ERROR	1
+
+/// Enables warnings and error messages.
+#define CRYPTO_LOG_LEVEL_WARN	2
+
+/// Enables info messages, warnings and error messages.
+#define CRYPTO_LOG_LEVEL_INFO	3
+
+/// Enables all messages.
+#define CRYPTO_LOG_LEVEL_DEBUG	4
+
+#ifndef CRYPTO_LOG_LEVEL
+#if defined(CRYPTO_NO_DEBUG)
+///
+/// \brief	The compile time log level.
+/// 
+///			Defaults to #CRYPTO_LOG_LEVEL_NONE if \c CRYPTO_NO_DEBUG is defined, to #CRYPTO_LOG_LEVEL_WARN for release builds and to
+///			#CRYPTO_LOG_LEVEL_DEBUG otherwise.
+/// 
+/// \since	1.0
+///
+#define CRYPTO_LOG_LEVEL CRYPTO_LOG_LEVEL_NONE
+#elif defined(NDEBUG)
+#define CRYPTO_LOG_LEVEL CRYPTO_LOG_LEVEL_WARN
+#else
+#define CRYPTO_LOG_LEVEL CRYPTO_LOG_LEVEL_DEBUG
+#endif
+#endif
+
+#if CRYPTO_LOG_LEVEL > CRYPTO_LOG_LEVEL_NONE
+#include <sstream>
+#endif
+
+///
+/// \brief	Contains CRYPTO's logging facilities.
+/// 
+/// \since	1.0
+///
+namespace Crypto::Log
+{
+
+///
+/// \brief	Defines the severity of a log message.
+/// 
+/// \since	1.0
+///
+enum class Level
+{
+	Error = CRYPTO_LOG_LEVEL_ERROR,
+	Warn = CRYPTO_LOG_LEVEL_WARN,
+	Info = CRYPTO_LOG_LEVEL_INFO,
+	Debug = CRYPTO_LOG_LEVEL_DEBUG
+};
+
+///
+/// \brief	The signature of a log sink.
+/// 
+///			Sinks may be called concurrently from multiple threads.
+/// 
+/// \since	1.0
+///
+using Sink = void (*)(const Level level, const std::string &message);
+
+///
+/// \brief	Writes \a message to \c std::cout prefixed with its \a level.
+/// 
+/// \since	1.0
+///
+void defaultSink(const Level level, const std::string &message);
+
+///
+/// \brief	Replaces the current sink with \a sink.
+/// 
+///			Passing \c nullptr discards all messages.
+/// 
+/// \since	1.0
+///
+void setSink(Sink sink);
+
+///
+/// \brief	Passes \a message of \a level to the current sink.
+/// 
+/// \since	1.0
+///
+void write(const Level level, const std::string &message);
+
+} // namespace Crypto::Log
+
+///
+/// \internal
+/// 
+/// \brief	Formats \a text using stream operators and passes it to the sink.
+/// 
+/// \since	1.0
+///
+#define CRYPTO_LOG(level, text) \
+	{ \
+		std::ostringstream cryptoLogStream; \
+		cryptoLogStream << text; \
+		::Crypto::Log::write(level, cryptoLogStream.str()); \
+	}
+
+#if CRYPTO_LOG_LEVEL >= CRYPTO_LOG_LEVEL_ERROR
+///
+/// \internal
+/// 
+/// \brief	Implements CRYPTO's error output.
+/// 
+/// \since	3.0
+///
+#define ERROR(text) CRYPTO_LOG(::Crypto::Log::Level::Error, text)
+#else
+#define ERROR(text)
+#endif
+
+#if CRYPTO_LOG_LEVEL >= CRYPTO_LOG_LEVEL_WARN
+///
+/// \internal
+/// 
+/// \brief	Implements CRYPTO's warning output.
+/// 
+/// \since	3.0
+///
+#define WARN(text) CRYPTO_LOG(::Crypto::Log::Level::Warn, text)
+#else
+#define WARN(text)
+#endif
+
+#if CRYPTO_LOG_LEVEL >= CRYPTO_LOG_LEVEL_INFO
+///
+/// \internal
+/// 
+/// \brief	Implements CRYPTO's info output.
+/// 
+/// \since	3.0
+///
+#define INFO(text) CRYPTO_LOG(::Crypto::Log::Level::Info, text)
+#else
+#define INFO(text)
+#endif
+
+#if CRYPTO_LOG_LEVEL >= CRYPTO_LOG_LEVEL_DEBUG
+///
+/// \internal
+/// 
+/// \brief	Implements CRYPTO's debug output.
+/// 
+/// \since	3.0
+///
+#define DEBUG(text) CRYPTO_LOG(::Crypto::Log::Level::Debug, text)
+#else
+#define DEBUG(text)
+#endif
+
+#endif // CRYPTOLOG_H
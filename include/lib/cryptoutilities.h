@@ -10,8 +10,10 @@
 
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <stdint.h>
 
+#include "aesconstants.h"
 #include "cryptoglobals.h"
 
 [[maybe_unused]] static inline void printBuffer(const uint8_t *buffer, size_t size)
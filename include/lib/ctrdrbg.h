@@ -0,0 +1,418 @@
+#ifndef CTRDRBG_H
+#define CTRDRBG_H
+
+#include <optional>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ciphermode.h"
+#include "cryptoglobals.h"
+
+///
+/// \brief	Contains deterministic random bit generators.
+/// 
+/// \since	1.0
+///
+namespace Crypto::Random
+{
+
+///
+/// \brief	Fills \a buffer with \a size bytes from the kernel's random number generator and returns \c true on success.
+/// 
+/// \since	1.0
+///
+bool readSystemEntropy(uint8_t *buffer, const size_t size);
+
+///
+/// \brief	Returns a number that changes in every child process created by fork().
+/// 
+/// \since	1.0
+///
+uint64_t forkGeneration();
+
+///
+/// \brief	Implements CTR_DRBG of NIST SP 800-90A without derivation function for \a BlockType.
+/// 
+///			Output is generated a buffer of #bufferSize bytes at a time with the multi-block counter mode path and handed out from there, so
+///			small requests such as a single operator() call cost a copy instead of a cipher call. Every refill is one generate request of the
+///			standard including its closing update, which provides backtracking resistance for everything generated before it. Bytes are
+///			zeroized in the buffer once they are handed out. Large fill() requests are generated directly into the destination.
+/// 
+///			A generator is not thread safe; threadLocal() gives every thread its own independently seeded instance, so threads never share
+///			state or a lock. Generators seeded from the system reseed themselves in child processes after fork(), so parent and child never
+///			return the same output.
+/// 
+///			The class satisfies the \c UniformRandomBitGenerator requirements and can be passed to the distributions of \c <random>.
+/// 
+/// \since	1.0
+///
+template <typename BlockType>
+class CtrDrbg
+{
+public:
+	using ScheduleType = typename BlockType::ScheduleType;
+	using result_type = uint64_t;
+	
+	///
+	/// \brief	The size of the key in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t keySize = BlockType::TraitsType::keySize;
+	
+	///
+	/// \brief	The size of entropy input, personalization strings and additional input in bytes, \c seedlen of the standard.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t seedSize = keySize + BlockType::TraitsType::blockSize;
+	
+	///
+	/// \brief	The number of bytes generated per refill of the buffer.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t bufferSize = 4096;
+	
+	///
+	/// \brief	The maximum number of bytes per generate request, 2^19 bits as allowed for block cipher based generators.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t maxRequestSize = 65536;
+	
+	///
+	/// \brief	The number of generate requests after which the generator reseeds itself from the system.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr uint64_t reseedInterval = uint64_t(1) << 48;
+	
+	///
+	/// \brief	Instantiates the generator with entropy from the system.
+	/// 
+	///			Check isValid() to find out whether the system provided entropy.
+	/// 
+	/// \since	1.0
+	///
+	CtrDrbg()
+	{
+		this->_reseedFromSystem(true);
+	}
+	
+	///
+	/// \brief	Instantiates the generator with #seedSize bytes of full entropy \a entropy and optionally #seedSize bytes of \a personalization.
+	/// 
+	///			Such a generator is deterministic and never reseeds itself from the system.
+	/// 
+	/// \since	1.0
+	///
+	CtrDrbg(const uint8_t *entropy, const uint8_t *personalization = nullptr) :
+		_fromSystem(false)
+	{
+		this->_instantiate(entropy, personalization);
+	}
+	
+	CtrDrbg(const CtrDrbg &other) = delete;
+	CtrDrbg &operator=(const CtrDrbg &other) = delete;
+	
+	///
+	/// \brief	Zeroizes the internal state and the buffered output.
+	/// 
+	/// \since	1.0
+	///
+	~CtrDrbg()
+	{
+		safeSetZero(this->_buffer, sizeof (this->_buffer));
+		safeSetZero(this->_counter, sizeof (this->_counter));
+	}
+	
+	///
+	/// \brief	Returns the smallest value returned by operator().
+	/// 
+	/// \since	1.0
+	///
+	static constexpr result_type min()
+	{
+		return 0;
+	}
+	
+	///
+	/// \brief	Returns the largest value returned by operator().
+	/// 
+	/// \since	1.0
+	///
+	static constexpr result_type max()
+	{
+		return ~result_type(0);
+	}
+	
+	///
+	/// \brief	Returns the generator of the calling thread, which is instantiated with entropy from the system on first use.
+	/// 
+	/// \since	1.0
+	///
+	static CtrDrbg &threadLocal()
+	{
+		thread_local CtrDrbg generator;
+		
+		return generator;
+	}
+	
+	///
+	/// \brief	Returns \c true if the generator is instantiated and may be used.
+	/// 
+	/// \since	1.0
+	///
+	bool isValid() const
+	{
+		return this->_schedule.has_value();
+	}
+	
+	///
+	/// \brief	Reseeds the generator with entropy from the system and returns \c true on success.
+	/// 
+	///			Buffered output is discarded.
+	/// 
+	/// \since	1.0
+	///
+	bool reseed()
+	{
+		return this->_reseedFromSystem(false);
+	}
+	
+	///
+	/// \brief	Reseeds the generator with #seedSize bytes of \a entropy and optionally #seedSize bytes of \a additionalInput.
+	/// 
+	///			Buffered output is discarded.
+	/// 
+	/// \since	1.0
+	///
+	void reseed(const uint8_t *entropy, const uint8_t *additionalInput = nullptr)
+	{
+		uint8_t seedMaterial[seedSize];
+		
+		_combine(entropy, additionalInput, seedMaterial);
+		
+		if (this->isValid())
+		{
+			this->_update(seedMaterial);
+			this->_reseedCounter = 1;
+			this->_discardBuffer();
+		}
+		else
+		{
+			this->_instantiate(seedMaterial, nullptr);
+		}
+		
+		safeSetZero(seedMaterial, sizeof (seedMaterial));
+	}
+	
+	///
+	/// \brief	Fills \a buffer with \a size random bytes.
+	/// 
+	///			Returns \c false without writing anything if the generator is not valid or could not reseed after fork(). Returns \c false as
+	///			well if a reseed after #reseedInterval requests fails; \a buffer is then only partly filled and must not be used.
+	/// 
+	/// \since	1.0
+	///
+	bool fill(uint8_t *buffer, size_t size)
+	{
+		bool returnValue = this->isValid();
+		
+		// A child must not hand out the buffered or future output of its parent, so it fails until a reseed succeeds
+		if (returnValue && this->_fromSystem && (this->_forkGeneration != forkGeneration()))
+		{
+			returnValue = this->_reseedFromSystem(false);
+		}
+		
+		while (returnValue && (size != 0))
+		{
+			const size_t buffered = bufferSize - this->_bufferOffset;
+			
+			if (buffered != 0)
+			{
+				const size_t bytes = (buffered < size) ? buffered : size;
+				
+				memcpy(buffer, this->_buffer + this->_bufferOffset, bytes);
+				safeSetZero(this->_buffer + this->_bufferOffset, bytes);
+				this->_bufferOffset += bytes;
+				buffer += bytes;
+				size -= bytes;
+			}
+			else if (size >= bufferSize)
+			{
+				// Whole blocks are generated in place; only a remainder smaller than the buffer goes through it
+				const size_t wholeBlocks = size - (size % BlockType::TraitsType::blockSize);
+				const size_t bytes = (wholeBlocks < maxRequestSize) ? wholeBlocks : maxRequestSize;
+				
+				returnValue = this->_generate(buffer, bytes);
+				buffer += bytes;
+				size -= bytes;
+			}
+			else
+			{
+				returnValue = this->_generate(this->_buffer, bufferSize);
+				this->_bufferOffset = returnValue ? 0 : bufferSize;
+			}
+		}
+		
+		return returnValue;
+	}
+	
+	///
+	/// \brief	Returns 64 random bits.
+	/// 
+	///			There is no value left to signal a failure, so the process is aborted if the generator is invalid or cannot reseed, e.g. in a
+	///			child after fork(); returning a fixed number would hand a predictable nonce or token to the caller. Use fill() to handle such
+	///			failures.
+	/// 
+	/// \since	1.0
+	///
+	result_type operator()()
+	{
+		result_type returnValue = 0;
+		
+		if (!this->fill(reinterpret_cast<uint8_t *>(&returnValue), sizeof (returnValue)))
+		{
+			ERROR("The random bit generator failed, aborting")
+			abort();
+		}
+		
+		return returnValue;
+	}
+	
+private:
+	static constexpr size_t blockSize = BlockType::TraitsType::blockSize;
+	
+	static_assert((bufferSize % blockSize) == 0, "The buffer must consist of whole blocks");
+	
+	std::optional<ScheduleType> _schedule;
+	uint8_t _counter[blockSize];
+	uint64_t _reseedCounter = 0;
+	uint64_t _forkGeneration = 0;
+	bool _fromSystem = true;
+	alignas(64) uint8_t _buffer[bufferSize];
+	size_t _bufferOffset = bufferSize;
+	
+	static void _combine(const uint8_t *data, const uint8_t *otherData, uint8_t *combination)
+	{
+		memcpy(combination, data, seedSize);
+		
+		for (size_t byte = 0; (otherData != nullptr) && (byte < seedSize); byte++)
+		{
+			combination[byte] ^= otherData[byte];
+		}
+	}
+	
+	void _instantiate(const uint8_t *entropy, const uint8_t *personalization)
+	{
+		uint8_t seedMaterial[seedSize];
+		const uint8_t key[keySize] = {};
+		
+		_combine(entropy, personalization, seedMaterial);
+		
+		// The counter always holds V + 1, which is the first block encrypted next
+		this->_schedule.emplace(key);
+		memset(this->_counter, 0, blockSize);
+		Mode::addToCounter(this->_counter, 1);
+		this->_update(seedMaterial);
+		this->_reseedCounter = 1;
+		this->_discardBuffer();
+		
+		safeSetZero(seedMaterial, sizeof (seedMaterial));
+	}
+	
+	bool _reseedFromSystem(const bool instantiate)
+	{
+		uint8_t entropy[seedSize];
+		const uint64_t generation = forkGeneration();
+		const bool returnValue = readSystemEntropy(entropy, seedSize);
+		
+		// The generation is only taken over on success, so a child retries instead of continuing the output of its parent
+		if (!returnValue)
+		{
+			ERROR("Failed to read entropy from the system")
+		}
+		else if (instantiate)
+		{
+			this->_instantiate(entropy, nullptr);
+			this->_forkGeneration = generation;
+		}
+		else
+		{
+			this->reseed(entropy);
+			this->_forkGeneration = generation;
+		}
+		
+		safeSetZero(entropy, sizeof (entropy));
+		
+		return returnValue;
+	}
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Implements \c CTR_DRBG_Update with \a providedData, which may be \c nullptr for all zeros.
+	/// 
+	/// \since	1.0
+	///
+	void _update(const uint8_t *providedData)
+	{
+		uint8_t temp[seedSize] = {};
+		
+		this->_schedule->applyKeystream(this->_counter, temp, temp, seedSize);
+		
+		for (size_t byte = 0; (providedData != nullptr) && (byte < seedSize); byte++)
+		{
+			temp[byte] ^= providedData[byte];
+		}
+		
+		this->_schedule.emplace(temp);
+		memcpy(this->_counter, temp + keySize, blockSize);
+		Mode::addToCounter(this->_counter, 1);
+		
+		safeSetZero(temp, sizeof (temp));
+	}
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Implements \c CTR_DRBG_Generate without additional input for \a size bytes, a multiple of the block size.
+	/// 
+	///			Returns \c false without generating anything if a required reseed fails.
+	/// 
+	/// \since	1.0
+	///
+	bool _generate(uint8_t *output, const size_t size)
+	{
+		bool returnValue = true;
+		
+		if (this->_fromSystem && (this->_reseedCounter > reseedInterval))
+		{
+			returnValue = this->_reseedFromSystem(false);
+		}
+		
+		if (returnValue)
+		{
+			memset(output, 0, size);
+			this->_schedule->applyKeystream(this->_counter, output, output, size);
+			this->_update(nullptr);
+			this->_reseedCounter++;
+		}
+		
+		return returnValue;
+	}
+	
+	void _discardBuffer()
+	{
+		safeSetZero(this->_buffer + this->_bufferOffset, bufferSize - this->_bufferOffset);
+		this->_bufferOffset = bufferSize;
+	}
+};
+
+} // namespace Crypto::Random
+
+#endif // CTRDRBG_H
@@ -0,0 +1,224 @@
+#ifndef CTRKEYSTREAM_H
+#define CTRKEYSTREAM_H
+
+#include <atomic>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "ctrmode.h"
+
+namespace Crypto::Mode
+{
+
+///
+/// \brief	Precomputes the counter mode keystream of one message ahead of its data.
+/// 
+///			The reservoir holds the first capacity() bytes of the keystream started by an initialization vector. They can be generated on the
+///			calling thread in idle cycles with generate() or by a background thread with generateInBackground(). Once the data arrives, apply()
+///			only XORs it with the ready keystream; any part of the message that is not generated yet, including everything beyond the
+///			capacity, is encrypted directly at its stream offset, so apply() never waits.
+/// 
+///			One thread may consume with apply() while another one generates. The key schedule must outlive the reservoir.
+/// 
+/// \since	1.0
+///
+template <typename BlockType>
+class CtrKeystream
+{
+public:
+	using ScheduleType = typename BlockType::ScheduleType;
+	
+	///
+	/// \brief	The number of bytes generated before they are published to apply().
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t sliceSize = 4096;
+	
+	///
+	/// \brief	Creates an empty reservoir for up to \a capacity bytes of the keystream of \a schedule and \a initializationVector.
+	/// 
+	/// \since	1.0
+	///
+	CtrKeystream(const ScheduleType &schedule, const uint8_t *initializationVector, const size_t capacity) :
+		_schedule(schedule),
+		_keystream(capacity),
+		_generated(0),
+		_stop(false)
+	{
+		memcpy(this->_initializationVector, initializationVector, blockSize);
+		memcpy(this->_counter, initializationVector, blockSize);
+	}
+	
+	CtrKeystream(const CtrKeystream &other) = delete;
+	CtrKeystream &operator=(const CtrKeystream &other) = delete;
+	
+	///
+	/// \brief	Stops background generation and zeroizes the keystream.
+	/// 
+	/// \since	1.0
+	///
+	~CtrKeystream()
+	{
+		this->_stopBackground();
+		safeSetZero(this->_keystream.data(), this->_keystream.size());
+		safeSetZero(this->_counter, sizeof (this->_counter));
+	}
+	
+	///
+	/// \brief	Returns the number of keystream bytes the reservoir can hold.
+	/// 
+	/// \since	1.0
+	///
+	size_t capacity() const
+	{
+		return this->_keystream.size();
+	}
+	
+	///
+	/// \brief	Returns the number of generated keystream bytes that have not been consumed yet.
+	/// 
+	/// \since	1.0
+	///
+	size_t available() const
+	{
+		const size_t generated = this->_generated.load(std::memory_order_acquire);
+		
+		return (generated > this->_consumed) ? (generated - this->_consumed) : 0;
+	}
+	
+	///
+	/// \brief	Generates at least \a size more bytes of keystream on the calling thread, up to the capacity, and returns the number generated.
+	/// 
+	///			Generation stops at a block boundary, so \a size is rounded up to whole blocks.
+	/// 
+	/// \since	1.0
+	///
+	size_t generate(const size_t size)
+	{
+		std::lock_guard<std::mutex> lock(this->_producerMutex);
+		const size_t first = this->_generated.load(std::memory_order_relaxed);
+		
+		this->_stop = false;
+		this->_generate(size);
+		
+		return this->_generated.load(std::memory_order_relaxed) - first;
+	}
+	
+	///
+	/// \brief	Starts a thread that fills the rest of the reservoir.
+	/// 
+	///			Does nothing if a background thread is already running.
+	/// 
+	/// \since	1.0
+	///
+	void generateInBackground()
+	{
+		if (!this->_background.joinable())
+		{
+			this->_stop = false;
+			this->_background = std::thread([this](){
+				std::lock_guard<std::mutex> lock(this->_producerMutex);
+				
+				this->_generate(this->capacity());
+			});
+		}
+	}
+	
+	///
+	/// \brief	Encrypts or decrypts the next \a size bytes of the message from \a input into \a output, which may be equal.
+	/// 
+	/// \since	1.0
+	///
+	void apply(const uint8_t *input, const size_t size, uint8_t *output)
+	{
+		const size_t generated = this->_generated.load(std::memory_order_acquire);
+		const size_t ready = (generated > this->_consumed) ? (generated - this->_consumed) : 0;
+		const size_t reservoirBytes = (ready < size) ? ready : size;
+		const uint8_t *keystream = this->_keystream.data() + this->_consumed;
+		
+		xorKeystream(input, keystream, output, reservoirBytes);
+		
+		// The keystream that is not ready yet is computed directly instead of waiting for it
+		if (reservoirBytes < size)
+		{
+			Ctr<BlockType>::encrypt(this->_schedule, this->_initializationVector, uint64_t(this->_consumed + reservoirBytes), input + reservoirBytes,
+					size - reservoirBytes, output + reservoirBytes);
+		}
+		
+		this->_consumed += size;
+	}
+	
+	///
+	/// \brief	Discards the reservoir and starts over for the message of \a initializationVector.
+	/// 
+	/// \since	1.0
+	///
+	void reset(const uint8_t *initializationVector)
+	{
+		this->_stopBackground();
+		this->_stop = false;
+		
+		memcpy(this->_initializationVector, initializationVector, blockSize);
+		memcpy(this->_counter, initializationVector, blockSize);
+		this->_generated.store(0, std::memory_order_relaxed);
+		this->_consumed = 0;
+	}
+	
+private:
+	static constexpr size_t blockSize = BlockType::TraitsType::blockSize;
+	
+	static_assert((sliceSize % blockSize) == 0, "Slices must consist of whole blocks");
+	
+	const ScheduleType &_schedule;
+	uint8_t _initializationVector[blockSize];
+	uint8_t _counter[blockSize];
+	std::vector<uint8_t> _keystream;
+	std::atomic<size_t> _generated;
+	size_t _consumed = 0;
+	std::mutex _producerMutex;
+	std::thread _background;
+	std::atomic<bool> _stop;
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Generates up to \a size more bytes slice by slice and publishes each one; the producer mutex must be held.
+	/// 
+	/// \since	1.0
+	///
+	void _generate(const size_t size)
+	{
+		const size_t first = this->_generated.load(std::memory_order_relaxed);
+		const size_t wholeBlocks = ((size + blockSize - 1) / blockSize) * blockSize;
+		const size_t last = ((this->capacity() - first) < wholeBlocks) ? this->capacity() : (first + wholeBlocks);
+		
+		for (size_t offset = first; (offset < last) && !this->_stop.load(std::memory_order_relaxed); offset += sliceSize)
+		{
+			const size_t bytes = ((last - offset) < sliceSize) ? (last - offset) : sliceSize;
+			uint8_t *slice = this->_keystream.data() + offset;
+			
+			// Slices start on block boundaries; only the last one of the reservoir may end inside a block
+			memset(slice, 0, bytes);
+			this->_schedule.applyKeystream(this->_counter, slice, slice, bytes);
+			this->_generated.store(offset + bytes, std::memory_order_release);
+		}
+	}
+	
+	void _stopBackground()
+	{
+		if (this->_background.joinable())
+		{
+			this->_stop = true;
+			this->_background.join();
+		}
+	}
+};
+
+} // namespace Crypto::Mode
+
+#endif // CTRKEYSTREAM_H
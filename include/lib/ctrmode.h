@@ -7,6 +7,8 @@
 #include "cipherkey.h"
 #include "ciphermode.h"
 #include "cryptoutilities.h"
+#include "fragmentcursor.h"
+#include "nonceallocator.h"
 
 ///
 /// \brief	Contains implementations of block cipher modes.
@@ -19,6 +21,8 @@ namespace Crypto::Mode
 ///
 /// \brief	Implements the counter (CTR) mode for \a BlockType.
 /// 
+///			The whole initialization vector is used as a big endian 128 bit counter as described in NIST SP 800-38A.
+/// 
 /// \since	1.0
 ///
 template <typename BlockType>
@@ -26,69 +30,283 @@ class Ctr
 {
 public:
 	using KeyType = typename BlockType::KeyType;
+	using ScheduleType = typename BlockType::ScheduleType;
+	
+	///
+	/// \brief	The number of bytes processed by one thread at a time.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t chunkSize = 1024 * BlockType::TraitsType::blockSize;
+	
+	///
+	/// \brief	The number of messages of a batch processed by one thread at a time.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t messageChunkSize = 256;
+	
+	///
+	/// \brief	The number of bytes encrypted and hashed together by encryptAndHash(), sized to stay in the L2 cache.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t tileSize = 64 * 1024;
 	
 	Ctr() = delete;
 	~Ctr() = delete;
 	
 	static void encrypt(const KeyType &key, const uint8_t *initializationVector, const uint8_t *plaintext, const size_t size, uint8_t *ciphertext)
 	{
-		BlockType block(key);
+		const ScheduleType schedule(key);
 		
-		// Calculate block count
-		uint64_t blockCount = calculateBlockCount<BlockType>(size);
+		encrypt(schedule, initializationVector, plaintext, size, ciphertext);
+	}
+	
+	///
+	/// \brief	Encrypts \a size bytes of \a plaintext using the shared key \a schedule and stores the result in \a ciphertext.
+	/// 
+	///			\a ciphertext may be equal to \a plaintext for in place encryption but must not overlap it otherwise. From streamingThreshold()
+	///			bytes on the ciphertext is written with non-temporal stores.
+	/// 
+	/// \since	1.0
+	///
+	static void encrypt(const ScheduleType &schedule, const uint8_t *initializationVector, const uint8_t *plaintext, const size_t size, uint8_t *ciphertext)
+	{
+		const size_t chunkCount = (size + chunkSize - 1) / chunkSize;
+		const bool streaming = (size >= streamingThreshold());
 		
-		// Iterate through the first n-1 blocks and encrypt plaintext
-#pragma omp parallel for schedule(static)
-		for (uint64_t blockIndex = 0; blockIndex < blockCount - 1; blockIndex++)
+		// Chunks are independent because each one derives its starting counter from the initialization vector
+#pragma omp parallel for schedule(static) if (chunkCount > 1)
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
 		{
-			BlockType localBlock = block;
-			uint8_t outputBlock[BlockType::TraitsType::blockSize];
-			uint8_t plainBlock[BlockType::TraitsType::blockSize];
+			const size_t offset = chunk * chunkSize;
+			const size_t chunkBytes = ((size - offset) < chunkSize) ? (size - offset) : chunkSize;
 			uint8_t counter[BlockType::TraitsType::blockSize];
 			
-			// Copy current plaintext block
-			memcpy(plainBlock, plaintext + blockIndex * sizeof (plainBlock), sizeof (plainBlock));
+			// Copy initialization vector in counter and advance it to the chunk's first block
+			memcpy(counter, initializationVector, BlockType::TraitsType::blockSize);
+			addToCounter(counter, offset / BlockType::TraitsType::blockSize);
 			
-			// Copy initialization vector in counter
-			memcpy(counter, initializationVector, (BlockType::TraitsType::blockSize));
-			
-			// Set lower half of counter with block index, i.e. the actual counter
-			*(reinterpret_cast<uint64_t *>(counter) + 1) = changeEndianness(changeEndianness(*(reinterpret_cast<uint64_t *>(counter) + 1)) + blockIndex);
+			if (streaming)
+			{
+				schedule.applyKeystreamStreaming(counter, plaintext + offset, ciphertext + offset, chunkBytes);
+			}
+			else
+			{
+				schedule.applyKeystream(counter, plaintext + offset, ciphertext + offset, chunkBytes);
+			}
+		}
+	}
+	
+	static void encrypt(const KeyType &key, const uint8_t *initializationVector, const uint64_t streamOffset, const uint8_t *plaintext, const size_t size,
+			uint8_t *ciphertext)
+	{
+		const ScheduleType schedule(key);
+		
+		encrypt(schedule, initializationVector, streamOffset, plaintext, size, ciphertext);
+	}
+	
+	///
+	/// \brief	Encrypts \a size bytes of \a plaintext located at byte \a streamOffset of the stream started by \a initializationVector.
+	/// 
+	///			Only the keystream of the requested range is generated, so the cost does not depend on \a streamOffset. The offset does not need
+	///			to be block aligned. \a ciphertext may be equal to \a plaintext.
+	/// 
+	/// \since	1.0
+	///
+	static void encrypt(const ScheduleType &schedule, const uint8_t *initializationVector, const uint64_t streamOffset, const uint8_t *plaintext,
+			const size_t size, uint8_t *ciphertext)
+	{
+		constexpr size_t blockSize = BlockType::TraitsType::blockSize;
+		const size_t skippedBytes = streamOffset % blockSize;
+		size_t leadingBytes = 0;
+		uint8_t counter[blockSize];
+		
+		// Seek to the block containing the offset; the addition carries across all 128 bits
+		memcpy(counter, initializationVector, blockSize);
+		addToCounter(counter, streamOffset / blockSize);
+		
+		// Use the tail of the first keystream block if the offset is not block aligned
+		if ((skippedBytes != 0) && (size != 0))
+		{
+			uint8_t keystream[blockSize] = {};
 			
-			// Encrypt counter
-			block.encrypt(counter, outputBlock);
+			schedule.applyKeystream(counter, keystream, keystream, blockSize);
+			leadingBytes = ((blockSize - skippedBytes) < size) ? (blockSize - skippedBytes) : size;
 			
-			// XOR output block with plain block and write to ciphertext
-			for (uint8_t byte = 0; byte < sizeof (plainBlock); byte++)
+			for (size_t byte = 0; byte < leadingBytes; byte++)
 			{
-				ciphertext[byte + sizeof (plainBlock) * blockIndex] = plainBlock[byte] ^ outputBlock[byte];
+				ciphertext[byte] = plaintext[byte] ^ keystream[skippedBytes + byte];
 			}
+			
+			safeSetZero(keystream, sizeof (keystream));
 		}
 		
-		// Encrypt last possibly incomplete block
-		BlockType localBlock = block;
-		uint8_t outputBlock[BlockType::TraitsType::blockSize];
-		uint8_t plainBlock[BlockType::TraitsType::blockSize];
-		uint8_t counter[BlockType::TraitsType::blockSize];
+		encrypt(schedule, counter, plaintext + leadingBytes, size - leadingBytes, ciphertext + leadingBytes);
+	}
+	
+	static bool encrypt(const KeyType &key, const uint8_t *initializationVector, const iovec *plaintext, const size_t plaintextCount,
+			const iovec *ciphertext, const size_t ciphertextCount)
+	{
+		const ScheduleType schedule(key);
 		
-		// Copy current plaintext block
-		memcpy(plainBlock, plaintext + (blockCount - 1) * sizeof (plainBlock), sizeof (plainBlock));
+		return encrypt(schedule, initializationVector, plaintext, plaintextCount, ciphertext, ciphertextCount);
+	}
+	
+	///
+	/// \brief	Encrypts the concatenation of the \a plaintext fragments into the \a ciphertext fragments using the shared key \a schedule.
+	/// 
+	///			The fragments of both lists may have any sizes and do not need to be block aligned; the keystream continues across their
+	///			boundaries. Both lists may describe the same memory for in place encryption. Returns \c false without encrypting anything if the
+	///			lists differ in total size.
+	/// 
+	/// \since	1.0
+	///
+	static bool encrypt(const ScheduleType &schedule, const uint8_t *initializationVector, const iovec *plaintext, const size_t plaintextCount,
+			const iovec *ciphertext, const size_t ciphertextCount)
+	{
+		const size_t size = fragmentsSize(plaintext, plaintextCount);
+		const bool returnValue = (size == fragmentsSize(ciphertext, ciphertextCount));
+		FragmentCursor input(plaintext, plaintextCount);
+		FragmentCursor output(ciphertext, ciphertextCount);
 		
-		// Copy initialization vector in counter
-		memcpy(counter, initializationVector, BlockType::TraitsType::blockSize);
+		// Each piece that is contiguous in both lists is encrypted at its offset in the stream
+		for (uint64_t offset = 0; returnValue && (offset < size);)
+		{
+			const size_t pieceSize = (input.contiguousSize() < output.contiguousSize()) ? input.contiguousSize() : output.contiguousSize();
+			
+			encrypt(schedule, initializationVector, offset, input.data(), pieceSize, output.data());
+			input.advance(pieceSize);
+			output.advance(pieceSize);
+			offset += pieceSize;
+		}
+		
+		return returnValue;
+	}
+	
+	static void encrypt(const KeyType &key, const CtrMessage *messages, const size_t messageCount)
+	{
+		const ScheduleType schedule(key);
+		
+		encrypt(schedule, messages, messageCount);
+	}
+	
+	///
+	/// \brief	Encrypts all \a messageCount \a messages, each with its own initialization vector, using the shared key \a schedule.
+	/// 
+	///			Counter blocks of consecutive messages share the cipher pipeline, which makes many short messages almost as cheap as one long
+	///			message of the same total size.
+	/// 
+	/// \since	1.0
+	///
+	static void encrypt(const ScheduleType &schedule, const CtrMessage *messages, const size_t messageCount)
+	{
+		const size_t chunkCount = (messageCount + messageChunkSize - 1) / messageChunkSize;
+		
+#pragma omp parallel for schedule(static) if (chunkCount > 1)
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			const size_t first = chunk * messageChunkSize;
+			const size_t count = ((messageCount - first) < messageChunkSize) ? (messageCount - first) : messageChunkSize;
+			
+			schedule.applyKeystream(messages + first, count);
+		}
+	}
+	
+	static bool encrypt(const KeyType &key, NonceAllocator::Lane &lane, const uint8_t *plaintext, const size_t size, uint8_t *ciphertext,
+			uint8_t *initializationVector)
+	{
+		const ScheduleType schedule(key);
+		
+		return encrypt(schedule, lane, plaintext, size, ciphertext, initializationVector);
+	}
+	
+	///
+	/// \brief	Encrypts \a size bytes of \a plaintext under a fresh initialization vector from \a lane, which is stored in \a initializationVector.
+	/// 
+	///			Returns \c false without encrypting anything if the lane is exhausted or the message is longer than
+	///			NonceAllocator::maxMessageBlocks, whose counters would run into the next initialization vector.
+	/// 
+	/// \since	1.0
+	///
+	static bool encrypt(const ScheduleType &schedule, NonceAllocator::Lane &lane, const uint8_t *plaintext, const size_t size, uint8_t *ciphertext,
+			uint8_t *initializationVector)
+	{
+		static_assert(NonceAllocator::initializationVectorSize == BlockType::TraitsType::blockSize, "Initialization vectors must fill a block");
+		
+		const bool returnValue = (calculateBlockCount<BlockType>(size) <= NonceAllocator::maxMessageBlocks) && lane.next(initializationVector);
+		
+		if (returnValue)
+		{
+			encrypt(schedule, initializationVector, plaintext, size, ciphertext);
+		}
+		
+		return returnValue;
+	}
+	
+	static bool encrypt(const KeyType &key, NonceAllocator::Lane &lane, CtrMessage *messages, const size_t messageCount,
+			uint8_t *initializationVectors)
+	{
+		const ScheduleType schedule(key);
+		
+		return encrypt(schedule, lane, messages, messageCount, initializationVectors);
+	}
+	
+	///
+	/// \brief	Assigns fresh initialization vectors from \a lane to all \a messageCount \a messages and encrypts them as a batch.
+	/// 
+	///			The initialization vectors are stored consecutively in \a initializationVectors, which must hold one block per message. Returns
+	///			\c false without encrypting anything under the same conditions as the single message overload.
+	/// 
+	/// \since	1.0
+	///
+	static bool encrypt(const ScheduleType &schedule, NonceAllocator::Lane &lane, CtrMessage *messages, const size_t messageCount,
+			uint8_t *initializationVectors)
+	{
+		static_assert(NonceAllocator::initializationVectorSize == BlockType::TraitsType::blockSize, "Initialization vectors must fill a block");
 		
-		// Set lower half of counter with block index, i.e. the actual counter
-		*(reinterpret_cast<uint64_t *>(counter) + 1) = changeEndianness(changeEndianness(*(reinterpret_cast<uint64_t *>(counter) + 1)) + (blockCount - 1));
+		bool returnValue = true;
 		
-		// Encrypt counter
-		block.encrypt(counter, outputBlock);
+		for (size_t message = 0; returnValue && (message < messageCount); message++)
+		{
+			uint8_t *initializationVector = initializationVectors + message * NonceAllocator::initializationVectorSize;
+			
+			returnValue = (calculateBlockCount<BlockType>(messages[message].size) <= NonceAllocator::maxMessageBlocks) && lane.next(initializationVector);
+			messages[message].initializationVector = initializationVector;
+		}
 		
-		// XOR output block with plain block and write to ciphertext
-		uint8_t remainingBytes = uint8_t(size - (sizeof (plainBlock) * (blockCount - 1)));
-		for (uint8_t byte = 0; byte < remainingBytes; byte++)
+		if (returnValue)
 		{
-			ciphertext[byte + sizeof (plainBlock) * (blockCount - 1)] = plainBlock[byte] ^ outputBlock[byte];
+			encrypt(schedule, messages, messageCount);
 		}
+		
+		return returnValue;
+	}
+	
+	template <typename DigestType>
+	static void encryptAndHash(const KeyType &key, const uint8_t *initializationVector, const uint8_t *plaintext, const size_t size,
+			uint8_t *ciphertext, const HashedData hashedData, uint8_t *hash)
+	{
+		const ScheduleType schedule(key);
+		
+		encryptAndHash<DigestType>(schedule, initializationVector, plaintext, size, ciphertext, hashedData, hash);
+	}
+	
+	///
+	/// \brief	Encrypts \a size bytes of \a plaintext into \a ciphertext and hashes the \a hashedData side with \a DigestType into \a hash.
+	/// 
+	///			Both are done in a single pass over tiles of #tileSize bytes, so each tile is hashed while it is still in the cache instead of
+	///			being read from memory a second time. \a ciphertext may be equal to \a plaintext. The call runs on the calling thread; hashing
+	///			is sequential anyway.
+	/// 
+	/// \since	1.0
+	///
+	template <typename DigestType>
+	static void encryptAndHash(const ScheduleType &schedule, const uint8_t *initializationVector, const uint8_t *plaintext, const size_t size,
+			uint8_t *ciphertext, const HashedData hashedData, uint8_t *hash)
+	{
+		_transformAndHash<DigestType>(schedule, initializationVector, plaintext, size, ciphertext, hashedData == HashedData::Plaintext, hash);
 	}
 	
 	static void decrypt(const KeyType &key, const uint8_t *initializationVector, const uint8_t *ciphertext, const size_t size, uint8_t *plaintext)
@@ -96,6 +314,137 @@ public:
 		// CTR mode uses encryption for decryption
 		encrypt(key, initializationVector, ciphertext, size, plaintext);
 	}
+	
+	///
+	/// \brief	Decrypts \a size bytes of \a ciphertext using the shared key \a schedule and stores the result in \a plaintext.
+	/// 
+	/// \since	1.0
+	///
+	static void decrypt(const ScheduleType &schedule, const uint8_t *initializationVector, const uint8_t *ciphertext, const size_t size, uint8_t *plaintext)
+	{
+		encrypt(schedule, initializationVector, ciphertext, size, plaintext);
+	}
+	
+	static void decrypt(const KeyType &key, const uint8_t *initializationVector, const uint64_t streamOffset, const uint8_t *ciphertext, const size_t size,
+			uint8_t *plaintext)
+	{
+		encrypt(key, initializationVector, streamOffset, ciphertext, size, plaintext);
+	}
+	
+	///
+	/// \brief	Decrypts \a size bytes of \a ciphertext located at byte \a streamOffset of the stream started by \a initializationVector.
+	/// 
+	///			This allows reading an arbitrary range of a large encrypted object at a cost proportional to the range.
+	/// 
+	/// \since	1.0
+	///
+	static void decrypt(const ScheduleType &schedule, const uint8_t *initializationVector, const uint64_t streamOffset, const uint8_t *ciphertext,
+			const size_t size, uint8_t *plaintext)
+	{
+		encrypt(schedule, initializationVector, streamOffset, ciphertext, size, plaintext);
+	}
+	
+	static bool decrypt(const KeyType &key, const uint8_t *initializationVector, const iovec *ciphertext, const size_t ciphertextCount,
+			const iovec *plaintext, const size_t plaintextCount)
+	{
+		return encrypt(key, initializationVector, ciphertext, ciphertextCount, plaintext, plaintextCount);
+	}
+	
+	///
+	/// \brief	Decrypts the concatenation of the \a ciphertext fragments into the \a plaintext fragments using the shared key \a schedule.
+	/// 
+	/// \since	1.0
+	///
+	static bool decrypt(const ScheduleType &schedule, const uint8_t *initializationVector, const iovec *ciphertext, const size_t ciphertextCount,
+			const iovec *plaintext, const size_t plaintextCount)
+	{
+		return encrypt(schedule, initializationVector, ciphertext, ciphertextCount, plaintext, plaintextCount);
+	}
+	
+	template <typename DigestType>
+	static void decryptAndHash(const KeyType &key, const uint8_t *initializationVector, const uint8_t *ciphertext, const size_t size,
+			uint8_t *plaintext, const HashedData hashedData, uint8_t *hash)
+	{
+		const ScheduleType schedule(key);
+		
+		decryptAndHash<DigestType>(schedule, initializationVector, ciphertext, size, plaintext, hashedData, hash);
+	}
+	
+	///
+	/// \brief	Decrypts \a size bytes of \a ciphertext into \a plaintext and hashes the \a hashedData side with \a DigestType into \a hash.
+	/// 
+	///			This is the single pass counterpart of encryptAndHash() for verifying stored objects.
+	/// 
+	/// \since	1.0
+	///
+	template <typename DigestType>
+	static void decryptAndHash(const ScheduleType &schedule, const uint8_t *initializationVector, const uint8_t *ciphertext, const size_t size,
+			uint8_t *plaintext, const HashedData hashedData, uint8_t *hash)
+	{
+		_transformAndHash<DigestType>(schedule, initializationVector, ciphertext, size, plaintext, hashedData == HashedData::Ciphertext, hash);
+	}
+	
+	static void decrypt(const KeyType &key, const CtrMessage *messages, const size_t messageCount)
+	{
+		encrypt(key, messages, messageCount);
+	}
+	
+	///
+	/// \brief	Decrypts all \a messageCount \a messages, each with its own initialization vector, using the shared key \a schedule.
+	/// 
+	/// \since	1.0
+	///
+	static void decrypt(const ScheduleType &schedule, const CtrMessage *messages, const size_t messageCount)
+	{
+		encrypt(schedule, messages, messageCount);
+	}
+	
+private:
+	template <typename DigestType>
+	static void _transformAndHash(const ScheduleType &schedule, const uint8_t *initializationVector, const uint8_t *input, const size_t size,
+			uint8_t *output, const bool hashInput, uint8_t *hash)
+	{
+		constexpr size_t hashBlockSize = DigestType::TraitsType::blockSize;
+		
+		static_assert((tileSize % hashBlockSize) == 0, "Tiles must consist of whole hash blocks");
+		
+		DigestType digest;
+		uint8_t counter[BlockType::TraitsType::blockSize];
+		size_t offset = 0;
+		
+		memcpy(counter, initializationVector, BlockType::TraitsType::blockSize);
+		
+		// Input is hashed before it is transformed, which keeps in place operation correct
+		for (; (size - offset) >= tileSize; offset += tileSize)
+		{
+			if (hashInput)
+			{
+				digest.update(input + offset, tileSize / hashBlockSize);
+			}
+			
+			schedule.applyKeystream(counter, input + offset, output + offset, tileSize);
+			
+			if (!hashInput)
+			{
+				digest.update(output + offset, tileSize / hashBlockSize);
+			}
+		}
+		
+		if (hashInput)
+		{
+			digest.hash(input + offset, size - offset);
+		}
+		
+		schedule.applyKeystream(counter, input + offset, output + offset, size - offset);
+		
+		if (!hashInput)
+		{
+			digest.hash(output + offset, size - offset);
+		}
+		
+		digest.extract(hash);
+		safeSetZero(counter, sizeof (counter));
+	}
 };
 
 } // namespace Crypto::Mode
@@ -0,0 +1,208 @@
+#ifndef ENCRYPTEDMAPPING_H
+#define ENCRYPTEDMAPPING_H
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "ctrmode.h"
+
+namespace Crypto::Mode
+{
+
+///
+/// \brief	Maps an encrypted file into memory as plaintext that is decrypted page by page when first touched.
+/// 
+///			The mapping is private anonymous memory registered with userfaultfd. A handler thread resolves the first access to each page by
+///			reading its ciphertext, applying the transform at the page's file offset and installing the result, so only the working set is
+///			decrypted and resident. Writable mappings additionally write protect installed pages to learn which pages are modified. sync()
+///			encrypts those pages and writes them back to the file, which is also done on destruction.
+/// 
+///			A page whose ciphertext cannot be read is installed as zeros and reported by hasFailed(), as is an error while waiting for page
+///			faults, after which faults are still served. The plaintext pages are excluded from core dumps. Mappings are only available on Linux
+///			with userfaultfd; check isValid().
+/// 
+/// \since	1.0
+///
+class EncryptedMapping
+{
+public:
+	///
+	/// \brief	Encrypts or decrypts \a size bytes of \a data in place, which are located at byte \a offset of the file.
+	/// 
+	///			The transform must be its own inverse, like a stream cipher's keystream.
+	/// 
+	/// \since	1.0
+	///
+	using Transform = std::function<void(uint8_t *data, const size_t size, const uint64_t offset)>;
+	
+	///
+	/// \brief	Maps the whole file \a fd, which must stay open for the lifetime of the mapping.
+	/// 
+	///			\a fd must be opened for reading and writing if \a writable is \c true. The file size is fixed at construction.
+	/// 
+	/// \since	1.0
+	///
+	EncryptedMapping(const int fd, const bool writable, Transform transform);
+	
+	EncryptedMapping(const EncryptedMapping &other) = delete;
+	EncryptedMapping &operator=(const EncryptedMapping &other) = delete;
+	
+	///
+	/// \brief	Writes back modified pages of a writable mapping, stops the handler and unmaps the memory.
+	/// 
+	/// \since	1.0
+	///
+	~EncryptedMapping();
+	
+	///
+	/// \brief	Returns \c true if the file could be mapped.
+	/// 
+	/// \since	1.0
+	///
+	bool isValid() const
+	{
+		return (this->_data != nullptr);
+	}
+	
+	///
+	/// \brief	Returns \c true if the ciphertext of a page could not be read.
+	/// 
+	///			Such a page reads as zeros and is never written back, so the file keeps its previous content there.
+	/// 
+	/// \since	1.0
+	///
+	bool hasFailed() const
+	{
+		return this->_failed;
+	}
+	
+	///
+	/// \brief	Returns the plaintext of the file.
+	/// 
+	/// \since	1.0
+	///
+	uint8_t *data()
+	{
+		return this->_data;
+	}
+	
+	///
+	/// \brief	Returns the plaintext of the file.
+	/// 
+	/// \since	1.0
+	///
+	const uint8_t *data() const
+	{
+		return this->_data;
+	}
+	
+	///
+	/// \brief	Returns the size of the file in bytes.
+	/// 
+	/// \since	1.0
+	///
+	size_t size() const
+	{
+		return this->_size;
+	}
+	
+	///
+	/// \brief	Returns the number of pages decrypted so far.
+	/// 
+	/// \since	1.0
+	///
+	size_t loadedPages() const;
+	
+	///
+	/// \brief	Encrypts all pages modified since the last call and writes them back to the file.
+	/// 
+	///			Pages may be modified concurrently; a page written to during the call is written back by the next one. Pages whose ciphertext
+	///			could not be read are skipped. Returns \c false on any I/O error, including earlier failed reads, or if the mapping is not
+	///			writable.
+	/// 
+	/// \since	1.0
+	///
+	bool sync();
+	
+private:
+	enum class _PageState : uint8_t
+	{
+		Missing,
+		Clean,
+		Dirty,
+		Failed
+	};
+	
+	int _fd = -1;
+	bool _writable = false;
+	bool _writeProtect = false;
+	size_t _size = 0;
+	size_t _pageSize = 0;
+	size_t _mappingSize = 0;
+	uint8_t *_data = nullptr;
+	int _faultFd = -1;
+	int _stopFd = -1;
+	std::atomic<bool> _failed;
+	Transform _transform;
+	mutable std::mutex _mutex;
+	std::vector<_PageState> _pageStates;
+	std::thread _handler;
+	
+	void _handleFaults();
+	void _loadPage(const size_t page, uint8_t *buffer);
+	void _markDirty(const size_t page);
+};
+
+///
+/// \brief	Maps a file encrypted in CTR mode with \a BlockType into memory as plaintext.
+/// 
+///			The file holds the CTR ciphertext of a stream started by the initialization vector, so every page is decrypted independently at its
+///			offset.
+/// 
+/// \since	1.0
+///
+template <typename BlockType>
+class CtrMapping : public EncryptedMapping
+{
+public:
+	using KeyType = typename BlockType::KeyType;
+	using ScheduleType = typename BlockType::ScheduleType;
+	
+	///
+	/// \brief	Maps the whole file \a fd encrypted with \a key and \a initializationVector.
+	/// 
+	/// \since	1.0
+	///
+	CtrMapping(const int fd, const KeyType &key, const uint8_t *initializationVector, const bool writable) :
+		EncryptedMapping(fd, writable, _transform(key, initializationVector))
+	{
+	}
+	
+private:
+	static Transform _transform(const KeyType &key, const uint8_t *initializationVector)
+	{
+		constexpr size_t blockSize = BlockType::TraitsType::blockSize;
+		
+		// The handler thread owns the schedule through the transform, which outlives any fault
+		std::shared_ptr<const ScheduleType> schedule = std::make_shared<const ScheduleType>(key);
+		std::array<uint8_t, blockSize> counter;
+		
+		memcpy(counter.data(), initializationVector, blockSize);
+		
+		return [schedule, counter](uint8_t *data, const size_t size, const uint64_t offset){
+			Ctr<BlockType>::encrypt(*schedule, counter.data(), offset, data, size, data);
+		};
+	}
+};
+
+} // namespace Crypto::Mode
+
+#endif // ENCRYPTEDMAPPING_H
@@ -0,0 +1,487 @@
+#ifndef FF1_H
+#define FF1_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "cryptoglobals.h"
+
+namespace Crypto::Mode
+{
+
+///
+/// \brief	Implements the FF1 format-preserving encryption of NIST SP 800-38G for \a BlockType.
+/// 
+///			A token is a string of numerals in a radix between 2 and 65536, and encryption yields a string of the same length and radix. All
+///			tokens of a batch share radix, length and tweak size, which is the case for a column of a table. Their Feistel rounds run in
+///			lockstep in groups of #groupSize tokens, so every CBC-MAC step of the round function encrypts one block per token with a single
+///			multi-block call. Groups are processed in parallel. A single token is a batch of one.
+/// 
+/// \since	1.0
+///
+template <typename BlockType>
+class Ff1
+{
+public:
+	using KeyType = typename BlockType::KeyType;
+	using ScheduleType = typename BlockType::ScheduleType;
+	
+	///
+	/// \brief	The number of tokens whose rounds run in lockstep.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t groupSize = 64;
+	
+	///
+	/// \brief	The largest supported radix.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr uint32_t maxRadix = 65536;
+	
+	///
+	/// \brief	The smallest number of distinct tokens a radix and length must allow, as required by SP 800-38G Rev. 1.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr uint64_t minDomainSize = 1000000;
+	
+	Ff1() = delete;
+	~Ff1() = delete;
+	
+	static bool encrypt(const KeyType &key, const uint32_t radix, const uint8_t *tweak, const size_t tweakSize, const uint16_t *numerals,
+			const size_t length, uint16_t *output)
+	{
+		const ScheduleType schedule(key);
+		
+		return encrypt(schedule, radix, tweak, tweakSize, numerals, length, output);
+	}
+	
+	///
+	/// \brief	Encrypts the token of \a length \a numerals in \a radix with \a tweak of \a tweakSize bytes into \a output.
+	/// 
+	///			Returns \c false without writing anything if \a radix or \a length is out of range or a numeral is not below \a radix. \a output
+	///			may be equal to \a numerals.
+	/// 
+	/// \since	1.0
+	///
+	static bool encrypt(const ScheduleType &schedule, const uint32_t radix, const uint8_t *tweak, const size_t tweakSize, const uint16_t *numerals,
+			const size_t length, uint16_t *output)
+	{
+		return _transform(schedule, true, radix, tweak, tweakSize, numerals, length, 1, output);
+	}
+	
+	static bool encrypt(const KeyType &key, const uint32_t radix, const uint8_t *tweaks, const size_t tweakSize, const uint16_t *numerals,
+			const size_t length, const size_t count, uint16_t *output)
+	{
+		const ScheduleType schedule(key);
+		
+		return encrypt(schedule, radix, tweaks, tweakSize, numerals, length, count, output);
+	}
+	
+	///
+	/// \brief	Encrypts \a count tokens of \a length numerals each, stored consecutively in \a numerals, into \a output.
+	/// 
+	///			\a tweaks holds one tweak of \a tweakSize bytes per token and may be \c nullptr if \a tweakSize is zero. Returns \c false without
+	///			writing anything under the same conditions as the single token overload.
+	/// 
+	/// \since	1.0
+	///
+	static bool encrypt(const ScheduleType &schedule, const uint32_t radix, const uint8_t *tweaks, const size_t tweakSize, const uint16_t *numerals,
+			const size_t length, const size_t count, uint16_t *output)
+	{
+		return _transform(schedule, true, radix, tweaks, tweakSize, numerals, length, count, output);
+	}
+	
+	static bool decrypt(const KeyType &key, const uint32_t radix, const uint8_t *tweak, const size_t tweakSize, const uint16_t *numerals,
+			const size_t length, uint16_t *output)
+	{
+		const ScheduleType schedule(key);
+		
+		return decrypt(schedule, radix, tweak, tweakSize, numerals, length, output);
+	}
+	
+	///
+	/// \brief	Decrypts the token of \a length \a numerals in \a radix with \a tweak of \a tweakSize bytes into \a output.
+	/// 
+	/// \since	1.0
+	///
+	static bool decrypt(const ScheduleType &schedule, const uint32_t radix, const uint8_t *tweak, const size_t tweakSize, const uint16_t *numerals,
+			const size_t length, uint16_t *output)
+	{
+		return _transform(schedule, false, radix, tweak, tweakSize, numerals, length, 1, output);
+	}
+	
+	static bool decrypt(const KeyType &key, const uint32_t radix, const uint8_t *tweaks, const size_t tweakSize, const uint16_t *numerals,
+			const size_t length, const size_t count, uint16_t *output)
+	{
+		const ScheduleType schedule(key);
+		
+		return decrypt(schedule, radix, tweaks, tweakSize, numerals, length, count, output);
+	}
+	
+	///
+	/// \brief	Decrypts \a count tokens of \a length numerals each, stored consecutively in \a numerals, into \a output.
+	/// 
+	/// \since	1.0
+	///
+	static bool decrypt(const ScheduleType &schedule, const uint32_t radix, const uint8_t *tweaks, const size_t tweakSize, const uint16_t *numerals,
+			const size_t length, const size_t count, uint16_t *output)
+	{
+		return _transform(schedule, false, radix, tweaks, tweakSize, numerals, length, count, output);
+	}
+	
+private:
+	static constexpr size_t blockSize = BlockType::TraitsType::blockSize;
+	static constexpr size_t roundCount = 10;
+	
+	static_assert(blockSize == 16, "FF1 requires a 128 bit block cipher");
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Holds the sizes derived from the radix, the token length and the tweak size, which are shared by all tokens of a batch.
+	/// 
+	/// \since	1.0
+	///
+	struct _Format
+	{
+		uint32_t radix = 0;
+		size_t length = 0;
+		size_t leftLength = 0;
+		size_t rightLength = 0;
+		size_t tweakSize = 0;
+		size_t numberSize = 0;
+		size_t roundOutputSize = 0;
+		size_t paddingSize = 0;
+		size_t messageSize = 0;
+	};
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Returns \c true if \a length numerals in \a radix can be encrypted.
+	/// 
+	/// \since	1.0
+	///
+	static bool _isValidFormat(const uint32_t radix, const size_t length)
+	{
+		uint64_t domainSize = 1;
+		
+		for (size_t numeral = 0; (numeral < length) && (domainSize < minDomainSize); numeral++)
+		{
+			domainSize *= radix;
+		}
+		
+		return (radix >= 2) && (radix <= maxRadix) && (length >= 2) && (length <= 0xffffffff) && (domainSize >= minDomainSize);
+	}
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Returns the number of bytes needed to represent radix^length - 1, which is \c b of the standard.
+	/// 
+	///			Computing the power exactly avoids rounding the logarithm of the standard's formula.
+	/// 
+	/// \since	1.0
+	///
+	static size_t _numberSize(const uint32_t radix, const size_t length)
+	{
+		std::vector<uint8_t> power{1};
+		size_t returnValue = 0;
+		
+		// Little endian bytes
+		for (size_t numeral = 0; numeral < length; numeral++)
+		{
+			uint32_t carry = 0;
+			
+			for (uint8_t &byte : power)
+			{
+				carry += uint32_t(byte) * radix;
+				byte = uint8_t(carry);
+				carry >>= 8;
+			}
+			
+			for (; carry != 0; carry >>= 8)
+			{
+				power.push_back(uint8_t(carry));
+			}
+		}
+		
+		// Subtracting one only borrows through trailing zero bytes
+		bool borrow = true;
+		
+		for (size_t byte = 0; borrow && (byte < power.size()); byte++)
+		{
+			borrow = (power[byte] == 0);
+			power[byte]--;
+		}
+		
+		for (size_t byte = power.size(); (byte > 0) && (returnValue == 0); byte--)
+		{
+			returnValue = (power[byte - 1] != 0) ? byte : 0;
+		}
+		
+		return returnValue;
+	}
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Writes the \a format.numberSize big endian bytes of the number of \a count \a numerals to \a number.
+	/// 
+	/// \since	1.0
+	///
+	static void _numberBytes(const _Format &format, const uint16_t *numerals, const size_t count, uint8_t *number)
+	{
+		memset(number, 0, format.numberSize);
+		
+		for (size_t numeral = 0; numeral < count; numeral++)
+		{
+			uint32_t carry = numerals[numeral];
+			
+			for (size_t byte = format.numberSize; byte > 0; byte--)
+			{
+				carry += uint32_t(number[byte - 1]) * format.radix;
+				number[byte - 1] = uint8_t(carry);
+				carry >>= 8;
+			}
+		}
+	}
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Adds or subtracts the big endian number of \a size bytes in \a value to or from \a count \a numerals modulo radix^count.
+	/// 
+	///			\a value is destroyed; it is divided by the radix once per numeral, starting with the least significant one.
+	/// 
+	/// \since	1.0
+	///
+	static void _combine(const _Format &format, const bool add, uint8_t *value, const size_t size, const uint16_t *numerals, const size_t count,
+			uint16_t *result)
+	{
+		uint32_t carry = 0;
+		
+		for (size_t numeral = count; numeral > 0; numeral--)
+		{
+			uint32_t remainder = 0;
+			
+			for (size_t byte = 0; byte < size; byte++)
+			{
+				remainder = (remainder << 8) | value[byte];
+				value[byte] = uint8_t(remainder / format.radix);
+				remainder %= format.radix;
+			}
+			
+			if (add)
+			{
+				const uint32_t sum = uint32_t(numerals[numeral - 1]) + remainder + carry;
+				
+				carry = (sum >= format.radix) ? 1 : 0;
+				result[numeral - 1] = uint16_t(sum - carry * format.radix);
+			}
+			else
+			{
+				const uint32_t subtrahend = remainder + carry;
+				
+				carry = (numerals[numeral - 1] < subtrahend) ? 1 : 0;
+				result[numeral - 1] = uint16_t(uint32_t(numerals[numeral - 1]) + carry * format.radix - subtrahend);
+			}
+		}
+	}
+	
+	static bool _transform(const ScheduleType &schedule, const bool encrypting, const uint32_t radix, const uint8_t *tweaks, const size_t tweakSize,
+			const uint16_t *numerals, const size_t length, const size_t count, uint16_t *output)
+	{
+		bool returnValue = _isValidFormat(radix, length) && ((tweaks != nullptr) || (tweakSize == 0));
+		
+		for (size_t numeral = 0; returnValue && (numeral < length * count); numeral++)
+		{
+			returnValue = (numerals[numeral] < radix);
+		}
+		
+		if (returnValue)
+		{
+			_Format format;
+			uint8_t header[blockSize];
+			
+			format.radix = radix;
+			format.length = length;
+			format.leftLength = length / 2;
+			format.rightLength = length - format.leftLength;
+			format.tweakSize = tweakSize;
+			format.numberSize = _numberSize(radix, format.rightLength);
+			format.roundOutputSize = 4 * ((format.numberSize + 3) / 4) + 4;
+			format.paddingSize = (blockSize - (tweakSize + format.numberSize + 1) % blockSize) % blockSize;
+			format.messageSize = tweakSize + format.paddingSize + 1 + format.numberSize;
+			
+			// The first block of the round function input is the same for every round and token, so its CBC-MAC state is computed once
+			header[0] = 1;
+			header[1] = 2;
+			header[2] = 1;
+			header[3] = uint8_t(radix >> 16);
+			header[4] = uint8_t(radix >> 8);
+			header[5] = uint8_t(radix);
+			header[6] = 10;
+			header[7] = uint8_t(format.leftLength);
+			
+			for (size_t byte = 0; byte < 4; byte++)
+			{
+				header[8 + byte] = uint8_t(uint64_t(length) >> (24 - 8 * byte));
+				header[12 + byte] = uint8_t(uint64_t(tweakSize) >> (24 - 8 * byte));
+			}
+			
+			schedule.encryptBlocks(header, header, 1);
+			
+			const size_t groupCount = (count + groupSize - 1) / groupSize;
+			
+#pragma omp parallel for schedule(static) if (groupCount > 1)
+			for (size_t group = 0; group < groupCount; group++)
+			{
+				const size_t first = group * groupSize;
+				const size_t tokenCount = ((count - first) < groupSize) ? (count - first) : groupSize;
+				const uint8_t *groupTweaks = (tweakSize != 0) ? (tweaks + first * tweakSize) : nullptr;
+				
+				_transformGroup(schedule, encrypting, format, header, groupTweaks, numerals + first * length, tokenCount, output + first * length);
+			}
+		}
+		
+		return returnValue;
+	}
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Runs the ten Feistel rounds of \a tokenCount tokens in lockstep.
+	/// 
+	/// \since	1.0
+	///
+	static void _transformGroup(const ScheduleType &schedule, const bool encrypting, const _Format &format, const uint8_t *header,
+			const uint8_t *tweaks, const uint16_t *numerals, const size_t tokenCount, uint16_t *output)
+	{
+		const size_t messageBlocks = format.messageSize / blockSize;
+		const size_t outputBlocks = (format.roundOutputSize + blockSize - 1) / blockSize;
+		std::vector<uint16_t> halves(tokenCount * format.length);
+		std::vector<uint8_t> messages(tokenCount * format.messageSize);
+		std::vector<uint8_t> states(tokenCount * blockSize);
+		std::vector<uint8_t> roundOutputs(tokenCount * outputBlocks * blockSize);
+		std::vector<uint8_t> extraBlocks(tokenCount * blockSize);
+		std::vector<uint16_t> combined(format.rightLength);
+		
+		// Each token keeps its halves as A followed by B; the longer half may be on either side after a round
+		memcpy(halves.data(), numerals, halves.size() * sizeof (uint16_t));
+		
+		for (size_t token = 0; token < tokenCount; token++)
+		{
+			uint8_t *message = messages.data() + token * format.messageSize;
+			
+			if (format.tweakSize != 0)
+			{
+				memcpy(message, tweaks + token * format.tweakSize, format.tweakSize);
+			}
+			
+			memset(message + format.tweakSize, 0, format.paddingSize);
+		}
+		
+		for (size_t step = 0; step < roundCount; step++)
+		{
+			const size_t round = encrypting ? step : (roundCount - 1 - step);
+			const size_t combinedLength = ((round % 2) == 0) ? format.leftLength : format.rightLength;
+			const size_t otherLength = format.length - combinedLength;
+			
+			// Encryption feeds B to the round function and changes A, decryption feeds A and changes B
+			for (size_t token = 0; token < tokenCount; token++)
+			{
+				uint16_t *tokenHalves = halves.data() + token * format.length;
+				uint8_t *message = messages.data() + token * format.messageSize;
+				const uint16_t *fedHalf = encrypting ? (tokenHalves + combinedLength) : tokenHalves;
+				
+				message[format.tweakSize + format.paddingSize] = uint8_t(round);
+				_numberBytes(format, fedHalf, otherLength, message + format.messageSize - format.numberSize);
+				memcpy(states.data() + token * blockSize, header, blockSize);
+			}
+			
+			// CBC-MAC of all tokens, one block each per kernel call
+			for (size_t block = 0; block < messageBlocks; block++)
+			{
+				for (size_t token = 0; token < tokenCount; token++)
+				{
+					_xorBlock(states.data() + token * blockSize, messages.data() + token * format.messageSize + block * blockSize);
+				}
+				
+				schedule.encryptBlocks(states.data(), states.data(), tokenCount);
+			}
+			
+			// The round output is R followed by the encryptions of R xor [j] as long as needed
+			for (size_t token = 0; token < tokenCount; token++)
+			{
+				memcpy(roundOutputs.data() + token * outputBlocks * blockSize, states.data() + token * blockSize, blockSize);
+			}
+			
+			for (size_t outputBlock = 1; outputBlock < outputBlocks; outputBlock++)
+			{
+				for (size_t token = 0; token < tokenCount; token++)
+				{
+					uint8_t *extraBlock = extraBlocks.data() + token * blockSize;
+					
+					memcpy(extraBlock, states.data() + token * blockSize, blockSize);
+					extraBlock[blockSize - 1] ^= uint8_t(outputBlock);
+					extraBlock[blockSize - 2] ^= uint8_t(outputBlock >> 8);
+				}
+				
+				schedule.encryptBlocks(extraBlocks.data(), extraBlocks.data(), tokenCount);
+				
+				for (size_t token = 0; token < tokenCount; token++)
+				{
+					memcpy(roundOutputs.data() + (token * outputBlocks + outputBlock) * blockSize, extraBlocks.data() + token * blockSize, blockSize);
+				}
+			}
+			
+			for (size_t token = 0; token < tokenCount; token++)
+			{
+				uint16_t *tokenHalves = halves.data() + token * format.length;
+				uint8_t *roundOutput = roundOutputs.data() + token * outputBlocks * blockSize;
+				const uint16_t *changedHalf = encrypting ? tokenHalves : (tokenHalves + otherLength);
+				
+				_combine(format, encrypting, roundOutput, format.roundOutputSize, changedHalf, combinedLength, combined.data());
+				
+				// A becomes B and the combination becomes the new B, or the reverse for decryption
+				if (encrypting)
+				{
+					memmove(tokenHalves, tokenHalves + combinedLength, otherLength * sizeof (uint16_t));
+					memcpy(tokenHalves + otherLength, combined.data(), combinedLength * sizeof (uint16_t));
+				}
+				else
+				{
+					memmove(tokenHalves + combinedLength, tokenHalves, otherLength * sizeof (uint16_t));
+					memcpy(tokenHalves, combined.data(), combinedLength * sizeof (uint16_t));
+				}
+			}
+		}
+		
+		memcpy(output, halves.data(), halves.size() * sizeof (uint16_t));
+		
+		safeSetZero(halves.data(), halves.size() * sizeof (uint16_t));
+		safeSetZero(messages.data(), messages.size());
+		safeSetZero(states.data(), states.size());
+		safeSetZero(roundOutputs.data(), roundOutputs.size());
+		safeSetZero(extraBlocks.data(), extraBlocks.size());
+		safeSetZero(combined.data(), combined.size() * sizeof (uint16_t));
+	}
+	
+	static void _xorBlock(uint8_t *destination, const uint8_t *source)
+	{
+		for (size_t byte = 0; byte < blockSize; byte++)
+		{
+			destination[byte] ^= source[byte];
+		}
+	}
+};
+
+} // namespace Crypto::Mode
+
+#endif // FF1_H
@@ -0,0 +1,50 @@
+#ifndef FILEIO_H
+#define FILEIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace Crypto::Io
+{
+
+///
+/// \internal
+/// 
+/// \brief	Selects the direction of transferFully().
+/// 
+/// \since	1.0
+///
+enum class Direction
+{
+	/// Reads from the file into the buffer.
+	Read,
+	
+	/// Writes the buffer to the file.
+	Write
+};
+
+///
+/// \internal
+/// 
+/// \brief	Passed as offset to transferFully() to transfer at the current file position, for pipes and other descriptors that cannot seek.
+/// 
+/// \since	1.0
+///
+static constexpr uint64_t currentPosition = UINT64_MAX;
+
+///
+/// \internal
+/// 
+/// \brief	Transfers \a size bytes of \a data in \a direction at byte \a offset of \a fd, continuing after short transfers and interrupts.
+/// 
+///			Stops early only at the end of the file or on an error. Returns the number of bytes transferred or -1 with \c errno set if an
+///			error occurred.
+/// 
+/// \since	1.0
+///
+ssize_t transferFully(const Direction direction, const int fd, uint8_t *data, const size_t size, const uint64_t offset = currentPosition);
+
+} // namespace Crypto::Io
+
+#endif // FILEIO_H
@@ -0,0 +1,137 @@
+#ifndef FRAGMENTCURSOR_H
+#define FRAGMENTCURSOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+
+namespace Crypto
+{
+
+///
+/// \brief	Returns the total size in bytes of all \a fragmentCount \a fragments.
+/// 
+/// \since	1.0
+///
+static inline size_t fragmentsSize(const iovec *fragments, const size_t fragmentCount)
+{
+	size_t returnValue = 0;
+	
+	for (size_t fragment = 0; fragment < fragmentCount; fragment++)
+	{
+		returnValue += fragments[fragment].iov_len;
+	}
+	
+	return returnValue;
+}
+
+///
+/// \brief	Walks a scatter/gather list of fragments as one contiguous byte stream.
+/// 
+///			Empty fragments are skipped. Moving past the end of the list stops at its end.
+/// 
+/// \since	1.0
+///
+class FragmentCursor
+{
+public:
+	FragmentCursor(const iovec *fragments, const size_t fragmentCount) :
+		_fragments(fragments),
+		_fragmentCount(fragmentCount)
+	{
+		this->_skipEmpty();
+	}
+	
+	///
+	/// \brief	Returns the current position.
+	/// 
+	/// \since	1.0
+	///
+	uint8_t *data() const
+	{
+		return static_cast<uint8_t *>(this->_fragments[this->_fragment].iov_base) + this->_offset;
+	}
+	
+	///
+	/// \brief	Returns the number of bytes from the current position to the end of its fragment, zero at the end of the list.
+	/// 
+	/// \since	1.0
+	///
+	size_t contiguousSize() const
+	{
+		return (this->_fragment < this->_fragmentCount) ? (this->_fragments[this->_fragment].iov_len - this->_offset) : 0;
+	}
+	
+	///
+	/// \brief	Moves the position \a size bytes forward.
+	/// 
+	/// \since	1.0
+	///
+	void advance(size_t size)
+	{
+		while ((size != 0) && (this->contiguousSize() != 0))
+		{
+			const size_t bytes = (this->contiguousSize() < size) ? this->contiguousSize() : size;
+			
+			this->_offset += bytes;
+			size -= bytes;
+			this->_skipEmpty();
+		}
+	}
+	
+	///
+	/// \brief	Copies the next \a size bytes into \a destination and moves past them.
+	/// 
+	/// \since	1.0
+	///
+	void gather(uint8_t *destination, size_t size)
+	{
+		while ((size != 0) && (this->contiguousSize() != 0))
+		{
+			const size_t bytes = (this->contiguousSize() < size) ? this->contiguousSize() : size;
+			
+			memcpy(destination, this->data(), bytes);
+			destination += bytes;
+			size -= bytes;
+			this->advance(bytes);
+		}
+	}
+	
+	///
+	/// \brief	Copies \a size bytes of \a source to the next bytes and moves past them.
+	/// 
+	/// \since	1.0
+	///
+	void scatter(const uint8_t *source, size_t size)
+	{
+		while ((size != 0) && (this->contiguousSize() != 0))
+		{
+			const size_t bytes = (this->contiguousSize() < size) ? this->contiguousSize() : size;
+			
+			memcpy(this->data(), source, bytes);
+			source += bytes;
+			size -= bytes;
+			this->advance(bytes);
+		}
+	}
+	
+private:
+	const iovec *_fragments = nullptr;
+	size_t _fragmentCount = 0;
+	size_t _fragment = 0;
+	size_t _offset = 0;
+	
+	void _skipEmpty()
+	{
+		while ((this->_fragment < this->_fragmentCount) && (this->_offset == this->_fragments[this->_fragment].iov_len))
+		{
+			this->_fragment++;
+			this->_offset = 0;
+		}
+	}
+};
+
+} // namespace Crypto
+
+#endif // FRAGMENTCURSOR_H
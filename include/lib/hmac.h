@@ -0,0 +1,167 @@
+#ifndef HMAC_H
+#define HMAC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "cryptoglobals.h"
+#include "streamingdigest.h"
+
+namespace Crypto::Hash
+{
+
+///
+/// \brief	Implements HMAC as described in RFC 2104 on top of \a DigestType.
+/// 
+///			The digests after absorbing the inner and outer padded key are kept, so reset() starts a new message without touching the key
+///			again. Messages can be passed in pieces of any size.
+/// 
+/// \since	1.0
+///
+template <typename DigestType>
+class Hmac
+{
+public:
+	///
+	/// \brief	The size of the authentication code in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t macSize = DigestType::TraitsType::digestSize;
+	
+	///
+	/// \brief	Initializes the HMAC with \a key of \a keySize bytes.
+	/// 
+	///			Keys longer than the block size of \a DigestType are hashed first.
+	/// 
+	/// \since	1.0
+	///
+	Hmac(const uint8_t *key, const size_t keySize)
+	{
+		uint8_t paddedKey[blockSize] = {};
+		uint8_t padBlock[blockSize];
+		
+		if (keySize > blockSize)
+		{
+			DigestType keyDigest;
+			keyDigest.hash(key, keySize);
+			keyDigest.extract(paddedKey);
+			safeSetZero(&keyDigest, sizeof (keyDigest));
+		}
+		else if (keySize != 0)
+		{
+			memcpy(paddedKey, key, keySize);
+		}
+		
+		for (size_t byte = 0; byte < blockSize; byte++)
+		{
+			padBlock[byte] = paddedKey[byte] ^ 0x36;
+		}
+		
+		this->_innerStart.update(padBlock);
+		
+		for (size_t byte = 0; byte < blockSize; byte++)
+		{
+			padBlock[byte] = paddedKey[byte] ^ 0x5c;
+		}
+		
+		this->_outerStart.update(padBlock);
+		this->_inner.reset(this->_innerStart);
+		
+		safeSetZero(paddedKey, sizeof (paddedKey));
+		safeSetZero(padBlock, sizeof (padBlock));
+	}
+	
+	///
+	/// \brief	Destructs the HMAC and safely discards all key dependent state.
+	/// 
+	/// \since	1.0
+	///
+	~Hmac()
+	{
+		safeSetZero(&this->_innerStart, sizeof (this->_innerStart));
+		safeSetZero(&this->_outerStart, sizeof (this->_outerStart));
+		safeSetZero(&this->_inner, sizeof (this->_inner));
+	}
+	
+	///
+	/// \brief	Appends \a size bytes of \a data to the message.
+	/// 
+	/// \since	1.0
+	///
+	void update(const uint8_t *data, const size_t size)
+	{
+		this->_inner.update(data, size);
+	}
+	
+	///
+	/// \brief	Appends the concatenation of \a fragmentCount \a fragments to the message.
+	/// 
+	/// \since	1.0
+	///
+	void updateFragments(const iovec *fragments, const size_t fragmentCount)
+	{
+		for (size_t fragment = 0; fragment < fragmentCount; fragment++)
+		{
+			this->update(static_cast<const uint8_t *>(fragments[fragment].iov_base), fragments[fragment].iov_len);
+		}
+	}
+	
+	///
+	/// \brief	Completes the message, writes the authentication code to \a mac and prepares for the next message.
+	/// 
+	///			\a mac must be of macSize bytes.
+	/// 
+	/// \since	1.0
+	///
+	void finalize(uint8_t *mac)
+	{
+		uint8_t innerHash[macSize];
+		
+		this->_inner.finalize(innerHash);
+		
+		DigestType outer = this->_outerStart;
+		outer.hash(innerHash, sizeof (innerHash));
+		outer.extract(mac);
+		
+		safeSetZero(innerHash, sizeof (innerHash));
+		safeSetZero(&outer, sizeof (outer));
+		this->reset();
+	}
+	
+	///
+	/// \brief	Discards the current message.
+	/// 
+	/// \since	1.0
+	///
+	void reset()
+	{
+		this->_inner.reset(this->_innerStart);
+	}
+	
+	///
+	/// \brief	Computes the authentication code of \a data of \a size bytes with \a key of \a keySize bytes and writes it to \a mac.
+	/// 
+	/// \since	1.0
+	///
+	static void compute(const uint8_t *key, const size_t keySize, const uint8_t *data, const size_t size, uint8_t *mac)
+	{
+		Hmac hmac(key, keySize);
+		
+		hmac.update(data, size);
+		hmac.finalize(mac);
+	}
+	
+private:
+	static constexpr size_t blockSize = DigestType::TraitsType::blockSize;
+	
+	DigestType _innerStart;
+	DigestType _outerStart;
+	StreamingDigest<DigestType> _inner;
+};
+
+} // namespace Crypto::Hash
+
+#endif // HMAC_H
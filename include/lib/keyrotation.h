@@ -0,0 +1,215 @@
+#ifndef KEYROTATION_H
+#define KEYROTATION_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "cbcmode.h"
+#include "ctrmode.h"
+
+namespace Crypto::Mode
+{
+
+///
+/// \brief	Re-encrypts data from \a SourceBlockType to counter mode of \a TargetBlockType in a single pass without materializing the plaintext.
+/// 
+///			Counter mode sources are XORed with the combination of the old and the new keystream, so the data is read and written once and
+///			the plaintext never exists in memory. For CBC sources every decrypted block is combined with the new keystream before it is
+///			chained with the preceding ciphertext block. Work is split into chunks that are processed in parallel, and each call takes the
+///			offset of its data in the stream, so a rotation can be resumed wherever it stopped.
+/// 
+/// \since	1.0
+///
+template <typename SourceBlockType, typename TargetBlockType = SourceBlockType>
+class KeyRotation
+{
+public:
+	using SourceKeyType = typename SourceBlockType::KeyType;
+	using SourceScheduleType = typename SourceBlockType::ScheduleType;
+	using TargetKeyType = typename TargetBlockType::KeyType;
+	using TargetScheduleType = typename TargetBlockType::ScheduleType;
+	
+	///
+	/// \brief	The number of bytes processed by one thread at a time.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t chunkSize = 4096 * SourceBlockType::TraitsType::blockSize;
+	
+	///
+	/// \brief	Returned by cbcToCtr() if the ciphertext does not fit the padding or the padding is malformed.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t invalidSize = Cbc<SourceBlockType>::invalidSize;
+	
+	KeyRotation() = delete;
+	~KeyRotation() = delete;
+	
+	static void ctrToCtr(const SourceKeyType &sourceKey, const uint8_t *sourceInitializationVector, const TargetKeyType &targetKey,
+			const uint8_t *targetInitializationVector, const uint64_t streamOffset, const uint8_t *input, const size_t size, uint8_t *output)
+	{
+		const SourceScheduleType sourceSchedule(sourceKey);
+		const TargetScheduleType targetSchedule(targetKey);
+		
+		ctrToCtr(sourceSchedule, sourceInitializationVector, targetSchedule, targetInitializationVector, streamOffset, input, size, output);
+	}
+	
+	///
+	/// \brief	Re-encrypts \a size bytes of counter mode \a input located at byte \a streamOffset of both streams into \a output.
+	/// 
+	///			The result equals decrypting with \a sourceSchedule and \a sourceInitializationVector and encrypting with \a targetSchedule and
+	///			\a targetInitializationVector. \a output may be equal to \a input.
+	/// 
+	/// \since	1.0
+	///
+	static void ctrToCtr(const SourceScheduleType &sourceSchedule, const uint8_t *sourceInitializationVector, const TargetScheduleType &targetSchedule,
+			const uint8_t *targetInitializationVector, const uint64_t streamOffset, const uint8_t *input, const size_t size, uint8_t *output)
+	{
+		const size_t chunkCount = (size + chunkSize - 1) / chunkSize;
+		
+#pragma omp parallel for schedule(static) if (chunkCount > 1)
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			const size_t chunkOffset = chunk * chunkSize;
+			const size_t chunkBytes = ((size - chunkOffset) < chunkSize) ? (size - chunkOffset) : chunkSize;
+			uint8_t keystream[tileSize];
+			
+			for (size_t offset = chunkOffset; offset < (chunkOffset + chunkBytes); offset += tileSize)
+			{
+				const size_t tileBytes = ((chunkOffset + chunkBytes - offset) < tileSize) ? (chunkOffset + chunkBytes - offset) : tileSize;
+				
+				// Both keystreams are combined in the cache before the data is touched
+				memset(keystream, 0, tileBytes);
+				Ctr<SourceBlockType>::encrypt(sourceSchedule, sourceInitializationVector, streamOffset + offset, keystream, tileBytes, keystream);
+				Ctr<TargetBlockType>::encrypt(targetSchedule, targetInitializationVector, streamOffset + offset, keystream, tileBytes, keystream);
+				xorKeystream(input + offset, keystream, output + offset, tileBytes);
+			}
+			
+			safeSetZero(keystream, sizeof (keystream));
+		}
+	}
+	
+	static size_t cbcToCtr(const SourceKeyType &sourceKey, const uint8_t *chainBlock, const TargetKeyType &targetKey,
+			const uint8_t *initializationVector, const uint64_t streamOffset, const uint8_t *ciphertext, const size_t size, uint8_t *output,
+			const PaddingType padding = PaddingType::Nulls)
+	{
+		const SourceScheduleType sourceSchedule(sourceKey);
+		const TargetScheduleType targetSchedule(targetKey);
+		
+		return cbcToCtr(sourceSchedule, chainBlock, targetSchedule, initializationVector, streamOffset, ciphertext, size, output, padding);
+	}
+	
+	///
+	/// \brief	Re-encrypts \a size bytes of CBC \a ciphertext into counter mode \a output at byte \a streamOffset of the target stream.
+	/// 
+	///			\a chainBlock is the CBC initialization vector at the start of a message and the preceding ciphertext block when resuming inside
+	///			one. Parts before the end of a message are passed with PaddingType::Nulls; the part ending the message is passed with the
+	///			padding of the message, which is removed. \a output must hold \a size bytes and may be equal to \a ciphertext. Returns the
+	///			number of bytes written or #invalidSize without writing anything if the ciphertext does not fit the padding.
+	/// 
+	/// \since	1.0
+	///
+	static size_t cbcToCtr(const SourceScheduleType &sourceSchedule, const uint8_t *chainBlock, const TargetScheduleType &targetSchedule,
+			const uint8_t *initializationVector, const uint64_t streamOffset, const uint8_t *ciphertext, const size_t size, uint8_t *output,
+			const PaddingType padding = PaddingType::Nulls)
+	{
+		const size_t tailSize = Cbc<SourceBlockType>::ciphertextTailSize(size, padding);
+		const size_t bodySize = size - tailSize;
+		uint8_t tail[blockSize * 2];
+		size_t returnValue = 0;
+		
+		if ((((size % blockSize) != 0) && (padding != PaddingType::CipherTextStealing)) || ((size == 0) && (padding != PaddingType::Nulls)))
+		{
+			returnValue = invalidSize;
+		}
+		else if (tailSize != 0)
+		{
+			const uint8_t *tailChainBlock = (bodySize != 0) ? (ciphertext + bodySize - blockSize) : chainBlock;
+			
+			// The padded tail is decrypted first, so malformed padding is detected before anything is written
+			returnValue = Cbc<SourceBlockType>::decrypt(sourceSchedule, tailChainBlock, ciphertext + bodySize, tailSize, tail, padding);
+		}
+		
+		if (returnValue != invalidSize)
+		{
+			_cbcBodyToCtr(sourceSchedule, chainBlock, targetSchedule, initializationVector, streamOffset, ciphertext, bodySize, output);
+			Ctr<TargetBlockType>::encrypt(targetSchedule, initializationVector, streamOffset + bodySize, tail, returnValue, output + bodySize);
+			returnValue += bodySize;
+		}
+		
+		safeSetZero(tail, sizeof (tail));
+		
+		return returnValue;
+	}
+	
+private:
+	static constexpr size_t blockSize = SourceBlockType::TraitsType::blockSize;
+	
+	///
+	/// \brief	The number of bytes whose keystream is generated at once, sized to stay in the L1 cache.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t tileSize = 256 * blockSize;
+	
+	static_assert(blockSize == TargetBlockType::TraitsType::blockSize, "Source and target must have the same block size");
+	static_assert((chunkSize % tileSize) == 0, "Chunks must consist of whole tiles");
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Re-encrypts the whole blocks of \a ciphertext, which form a part of a message without padding.
+	/// 
+	/// \since	1.0
+	///
+	static void _cbcBodyToCtr(const SourceScheduleType &sourceSchedule, const uint8_t *chainBlock, const TargetScheduleType &targetSchedule,
+			const uint8_t *initializationVector, const uint64_t streamOffset, const uint8_t *ciphertext, const size_t size, uint8_t *output)
+	{
+		const size_t chunkCount = (size + chunkSize - 1) / chunkSize;
+		std::vector<uint8_t> chainBlocks(chunkCount * blockSize);
+		
+		// Every chunk chains from the ciphertext block before it, which in place operation of another thread may overwrite
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			memcpy(chainBlocks.data() + chunk * blockSize, (chunk == 0) ? chainBlock : (ciphertext + chunk * chunkSize - blockSize), blockSize);
+		}
+		
+#pragma omp parallel for schedule(static) if (chunkCount > 1)
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			const size_t chunkOffset = chunk * chunkSize;
+			const size_t chunkBytes = ((size - chunkOffset) < chunkSize) ? (size - chunkOffset) : chunkSize;
+			uint8_t previousBlock[blockSize];
+			uint8_t decrypted[tileSize];
+			uint8_t keystream[tileSize];
+			
+			memcpy(previousBlock, chainBlocks.data() + chunk * blockSize, blockSize);
+			
+			for (size_t offset = chunkOffset; offset < (chunkOffset + chunkBytes); offset += tileSize)
+			{
+				const size_t tileBytes = ((chunkOffset + chunkBytes - offset) < tileSize) ? (chunkOffset + chunkBytes - offset) : tileSize;
+				const uint8_t *tileCiphertext = ciphertext + offset;
+				
+				memset(keystream, 0, tileBytes);
+				Ctr<TargetBlockType>::encrypt(targetSchedule, initializationVector, streamOffset + offset, keystream, tileBytes, keystream);
+				sourceSchedule.decryptBlocks(tileCiphertext, decrypted, tileBytes / blockSize);
+				xorKeystream(decrypted, keystream, decrypted, tileBytes);
+				
+				// Chaining last yields the new ciphertext directly; the whole tile is read before it is written
+				xorKeystream(decrypted, previousBlock, decrypted, blockSize);
+				xorKeystream(decrypted + blockSize, tileCiphertext, decrypted + blockSize, tileBytes - blockSize);
+				memcpy(previousBlock, tileCiphertext + tileBytes - blockSize, blockSize);
+				memcpy(output + offset, decrypted, tileBytes);
+			}
+			
+			safeSetZero(decrypted, sizeof (decrypted));
+			safeSetZero(keystream, sizeof (keystream));
+		}
+	}
+};
+
+} // namespace Crypto::Mode
+
+#endif // KEYROTATION_H
@@ -0,0 +1,256 @@
+#ifndef NONCEALLOCATOR_H
+#define NONCEALLOCATOR_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cryptoglobals.h"
+
+namespace Crypto::Mode
+{
+
+///
+/// \brief	Allocates unique nonces and counter mode initialization vectors without a lock on the hot path.
+/// 
+///			Nonces follow the deterministic construction of NIST SP 800-38D: a 32 bit big endian fixed field holding the instance ID followed
+///			by a 64 bit big endian invocation field. Every thread allocates from its own Lane, which reserves ranges of reservationSize()
+///			invocation values from a shared atomic counter and hands them out without any synchronization. Two lanes never share a value,
+///			and instances with distinct IDs never share a nonce.
+/// 
+///			Counter mode initialization vectors are a nonce followed by a 32 bit block counter starting at zero, so messages of up to
+///			#maxMessageBlocks blocks never overlap in their counter ranges.
+/// 
+///			Invocation values are not reused as long as the allocator lives. To keep nonces unique across restarts with the same instance
+///			ID, persist reservedInvocations() and pass it as the first invocation value on the next start.
+/// 
+/// \since	1.0
+///
+class NonceAllocator
+{
+public:
+	///
+	/// \brief	The size of a nonce in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t nonceSize = 12;
+	
+	///
+	/// \brief	The size of a counter mode initialization vector in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t initializationVectorSize = 16;
+	
+	///
+	/// \brief	The number of blocks a counter mode message may have without reaching the counter range of the next nonce.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr uint64_t maxMessageBlocks = uint64_t(1) << 32;
+	
+	///
+	/// \brief	Allocates nonces for one thread from ranges reserved in an allocator.
+	/// 
+	///			A lane is movable but not copyable, so a range is never handed out twice. It must not be used by several threads at once and
+	///			must not outlive its allocator. Values left in its range when it is destroyed are skipped.
+	/// 
+	/// \since	1.0
+	///
+	class Lane
+	{
+	public:
+		Lane() = default;
+		
+		///
+		/// \brief	Creates a lane that reserves its ranges in \a allocator.
+		/// 
+		/// \since	1.0
+		///
+		explicit Lane(NonceAllocator &allocator) :
+			_allocator(&allocator)
+		{
+		}
+		
+		Lane(const Lane &other) = delete;
+		Lane &operator=(const Lane &other) = delete;
+		
+		Lane(Lane &&other) :
+			_allocator(other._allocator),
+			_next(other._next),
+			_end(other._end)
+		{
+			other._next = other._end;
+		}
+		
+		Lane &operator=(Lane &&other)
+		{
+			if (this != &other)
+			{
+				this->_allocator = other._allocator;
+				this->_next = other._next;
+				this->_end = other._end;
+				other._next = other._end;
+			}
+			
+			return *this;
+		}
+		
+		///
+		/// \brief	Writes the next nonce of #nonceSize bytes to \a nonce.
+		/// 
+		///			Returns \c false without writing anything if the lane has no allocator or the invocation field is exhausted.
+		/// 
+		/// \since	1.0
+		///
+		bool nextNonce(uint8_t *nonce)
+		{
+			const bool returnValue = (this->_next != this->_end) || this->_reserve();
+			
+			if (returnValue)
+			{
+				const uint32_t fixedField = changeEndianness(this->_allocator->_instanceId);
+				const uint64_t invocationField = changeEndianness(this->_next);
+				
+				memcpy(nonce, &fixedField, sizeof (fixedField));
+				memcpy(nonce + sizeof (fixedField), &invocationField, sizeof (invocationField));
+				this->_next++;
+			}
+			
+			return returnValue;
+		}
+		
+		///
+		/// \brief	Writes the next counter mode initialization vector of #initializationVectorSize bytes to \a initializationVector.
+		/// 
+		/// \since	1.0
+		///
+		bool next(uint8_t *initializationVector)
+		{
+			const bool returnValue = this->nextNonce(initializationVector);
+			
+			if (returnValue)
+			{
+				memset(initializationVector + nonceSize, 0, initializationVectorSize - nonceSize);
+			}
+			
+			return returnValue;
+		}
+		
+		///
+		/// \brief	Writes \a count consecutive initialization vectors to \a initializationVectors and returns \c false if the lane ran out.
+		/// 
+		/// \since	1.0
+		///
+		bool next(uint8_t *initializationVectors, const size_t count)
+		{
+			bool returnValue = true;
+			
+			for (size_t vector = 0; returnValue && (vector < count); vector++)
+			{
+				returnValue = this->next(initializationVectors + vector * initializationVectorSize);
+			}
+			
+			return returnValue;
+		}
+	
+	private:
+		NonceAllocator *_allocator = nullptr;
+		uint64_t _next = 0;
+		uint64_t _end = 0;
+		
+		bool _reserve()
+		{
+			return (this->_allocator != nullptr) && this->_allocator->_reserve(this->_next, this->_end);
+		}
+	};
+	
+	///
+	/// \brief	Creates an allocator for the fixed field \a instanceId that reserves \a reservationSize invocation values per lane refill.
+	/// 
+	///			Allocation starts at \a firstInvocation.
+	/// 
+	/// \since	1.0
+	///
+	NonceAllocator(const uint32_t instanceId, const uint64_t reservationSize = 4096, const uint64_t firstInvocation = 0) :
+		_instanceId(instanceId),
+		_reservationSize((reservationSize != 0) ? reservationSize : 1),
+		_nextInvocation(firstInvocation)
+	{
+	}
+	
+	NonceAllocator(const NonceAllocator &other) = delete;
+	NonceAllocator &operator=(const NonceAllocator &other) = delete;
+	
+	///
+	/// \brief	Returns a new lane of the allocator for the calling thread.
+	/// 
+	/// \since	1.0
+	///
+	Lane lane()
+	{
+		return Lane(*this);
+	}
+	
+	///
+	/// \brief	Returns the instance ID stored in the fixed field.
+	/// 
+	/// \since	1.0
+	///
+	uint32_t instanceId() const
+	{
+		return this->_instanceId;
+	}
+	
+	///
+	/// \brief	Returns the number of invocation values reserved per lane refill.
+	/// 
+	/// \since	1.0
+	///
+	uint64_t reservationSize() const
+	{
+		return this->_reservationSize;
+	}
+	
+	///
+	/// \brief	Returns the first invocation value that has not been reserved by any lane yet.
+	/// 
+	/// \since	1.0
+	///
+	uint64_t reservedInvocations() const
+	{
+		return this->_nextInvocation.load(std::memory_order_relaxed);
+	}
+	
+private:
+	uint32_t _instanceId = 0;
+	uint64_t _reservationSize = 0;
+	std::atomic<uint64_t> _nextInvocation;
+	
+	bool _reserve(uint64_t &first, uint64_t &end)
+	{
+		uint64_t reserved = this->_nextInvocation.load(std::memory_order_relaxed);
+		bool returnValue = false;
+		
+		// A compare and swap instead of an addition keeps the counter from wrapping around into values handed out before
+		do
+		{
+			returnValue = (reserved <= (~uint64_t(0) - this->_reservationSize));
+		}
+		while (returnValue && !this->_nextInvocation.compare_exchange_weak(reserved, reserved + this->_reservationSize, std::memory_order_relaxed));
+		
+		if (returnValue)
+		{
+			first = reserved;
+			end = reserved + this->_reservationSize;
+		}
+		
+		return returnValue;
+	}
+};
+
+} // namespace Crypto::Mode
+
+#endif // NONCEALLOCATOR_H
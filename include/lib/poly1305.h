@@ -0,0 +1,90 @@
+#ifndef POLY1305_H
+#define POLY1305_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Crypto::Hash
+{
+
+///
+/// \brief	Implements the Poly1305 one-time authenticator as described in RFC 8439.
+/// 
+///			The accumulator is kept in five 26 bit limbs, so every block costs 25 multiplications of 32 bit numbers and no big number
+///			arithmetic. Messages can be passed in pieces of any size.
+/// 
+///			A key must never authenticate more than one message. finalize() therefore discards the key instead of preparing for another
+///			message.
+/// 
+/// \since	1.0
+///
+class Poly1305
+{
+public:
+	///
+	/// \brief	The size of the one-time key in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t keySize = 32;
+	
+	///
+	/// \brief	The size of the authentication code in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t macSize = 16;
+	
+	///
+	/// \brief	Initializes the authenticator with the one-time \a key of #keySize bytes.
+	/// 
+	/// \since	1.0
+	///
+	explicit Poly1305(const uint8_t *key);
+	
+	Poly1305(const Poly1305 &other) = delete;
+	Poly1305 &operator=(const Poly1305 &other) = delete;
+	
+	///
+	/// \brief	Destructs the authenticator and safely discards all key dependent state.
+	/// 
+	/// \since	1.0
+	///
+	~Poly1305();
+	
+	///
+	/// \brief	Appends \a size bytes of \a data to the message.
+	/// 
+	/// \since	1.0
+	///
+	void update(const uint8_t *data, size_t size);
+	
+	///
+	/// \brief	Completes the message and writes the authentication code of #macSize bytes to \a mac.
+	/// 
+	/// \since	1.0
+	///
+	void finalize(uint8_t *mac);
+	
+	///
+	/// \brief	Computes the authentication code of \a size bytes of \a data with the one-time \a key and writes it to \a mac.
+	/// 
+	/// \since	1.0
+	///
+	static void compute(const uint8_t *key, const uint8_t *data, const size_t size, uint8_t *mac);
+	
+private:
+	static constexpr size_t blockSize = 16;
+	
+	uint32_t _r[5];
+	uint32_t _h[5] = {};
+	uint32_t _pad[4];
+	uint8_t _buffer[blockSize];
+	size_t _bufferSize = 0;
+	
+	void _blocks(const uint8_t *data, const size_t blockCount, const uint32_t highBit);
+};
+
+} // namespace Crypto::Hash
+
+#endif // POLY1305_H
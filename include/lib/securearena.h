@@ -0,0 +1,108 @@
+#ifndef SECUREARENA_H
+#define SECUREARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Crypto
+{
+
+///
+/// \brief	Implements a fixed size slot allocator for key material.
+/// 
+///			All slots live in one anonymous mapping that is locked into memory, excluded from core dumps and surrounded by inaccessible guard
+///			pages. Released slots are zeroized before they can be handed out again. The arena itself is not thread safe.
+/// 
+/// \since	1.0
+///
+class SecureArena
+{
+public:
+	///
+	/// \brief	Maps an arena of \a slotCount slots of \a slotSize bytes each, aligned to \a alignment.
+	/// 
+	///			Check isValid() to find out whether the mapping succeeded.
+	/// 
+	/// \since	1.0
+	///
+	SecureArena(const size_t slotSize, const size_t slotCount, const size_t alignment = 64);
+	
+	SecureArena(const SecureArena &other) = delete;
+	SecureArena &operator=(const SecureArena &other) = delete;
+	
+	///
+	/// \brief	Zeroizes and unmaps the arena.
+	/// 
+	/// \since	1.0
+	///
+	~SecureArena();
+	
+	///
+	/// \brief	Returns \c true if the arena could be mapped.
+	/// 
+	/// \since	1.0
+	///
+	bool isValid() const
+	{
+		return (this->_slots != nullptr);
+	}
+	
+	///
+	/// \brief	Returns \c true if the arena is locked into memory and cannot be swapped out.
+	/// 
+	/// \since	1.0
+	///
+	bool isLocked() const
+	{
+		return this->_locked;
+	}
+	
+	///
+	/// \brief	Returns a free slot or \c nullptr if all slots are in use.
+	/// 
+	/// \since	1.0
+	///
+	void *allocate();
+	
+	///
+	/// \brief	Zeroizes \a slot and returns it to the arena.
+	/// 
+	/// \since	1.0
+	///
+	void deallocate(void *slot);
+	
+	///
+	/// \brief	Returns the number of bytes per slot including alignment padding.
+	/// 
+	/// \since	1.0
+	///
+	size_t slotSize() const
+	{
+		return this->_slotSize;
+	}
+	
+	///
+	/// \brief	Returns the total number of slots.
+	/// 
+	/// \since	1.0
+	///
+	size_t slotCount() const
+	{
+		return this->_slotCount;
+	}
+	
+private:
+	size_t _slotSize = 0;
+	size_t _slotCount = 0;
+	size_t _mappingSize = 0;
+	size_t _slotRegionSize = 0;
+	uint8_t *_mapping = nullptr;
+	uint8_t *_slots = nullptr;
+	uint32_t *_freeSlots = nullptr;
+	size_t _freeSlotCount = 0;
+	bool _locked = false;
+};
+
+} // namespace Crypto
+
+#endif // SECUREARENA_H
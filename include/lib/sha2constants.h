@@ -3,10 +3,15 @@
 
 #include <stdint.h>
 
-#define SHA224_DIGEST_SIZE 224 / 8
-#define SHA256_DIGEST_SIZE 256 / 8
-#define SHA384_DIGEST_SIZE 384 / 8
-#define SHA512_DIGEST_SIZE 512 / 8
+#define SHA224_DIGEST_SIZE (224 / 8)
+#define SHA256_DIGEST_SIZE (256 / 8)
+#define SHA384_DIGEST_SIZE (384 / 8)
+#define SHA512_DIGEST_SIZE (512 / 8)
+#define SHA512_224_DIGEST_SIZE (224 / 8)
+#define SHA512_256_DIGEST_SIZE (256 / 8)
+
+#define SHA256_BLOCK_SIZE (512 / 8)
+#define SHA512_BLOCK_SIZE (1024 / 8)
 
 namespace Crypto::Hash::Sha2
 {
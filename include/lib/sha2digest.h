@@ -3,20 +3,26 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
 
 #include "cryptoglobals.h"
 #include "cryptoutilities.h"
+#include "sha2kernels.h"
 #include "sha2traits.h"
 
 namespace Crypto::Hash::Sha2
 {
 
 ///
-/// \brief	Implements the SHA2 hash algorithm for the desired \a digestSize.
+/// \brief	Implements the SHA2 hash algorithm for the desired \a digestSize using the compression function of \a blockSize.
+/// 
+///			Digests are plain values. Copying one clones its state, so a digest that has consumed a common prefix can be copied and continued
+///			for each message instead of recompressing the prefix.
 /// 
 /// \since	1.0
 ///
-template <uint32_t digestSize>
+template <uint32_t digestSize, uint32_t blockSize = defaultBlockSize(digestSize)>
 class Digest
 {
 public:
@@ -25,7 +31,14 @@ public:
 	/// 
 	/// \since	1.0
 	///
-	using TraitsType = Sha2::Traits<digestSize>;
+	using TraitsType = Sha2::Traits<digestSize, blockSize>;
+	
+	///
+	/// \brief	The size of a serialized midstate in bytes.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t midstateSize = sizeof (typename TraitsType::WordType) * TraitsType::stateSize + sizeof (uint64_t);
 	
 	///
 	/// \brief	Constructs the digest and initializes the internal state.
@@ -44,7 +57,20 @@ public:
 	/// 
 	/// \since	1.0
 	///
-	void update(const uint8_t *block);
+	void update(const uint8_t *block)
+	{
+		this->_compress(block, 1);
+	}
+	
+	///
+	/// \brief	Updates the internal state using \a blockCount consecutive blocks, which are compressed with a single kernel call.
+	/// 
+	/// \since	1.0
+	///
+	void update(const uint8_t *blocks, const size_t blockCount)
+	{
+		this->_compress(blocks, blockCount);
+	}
 	
 	///
 	/// \brief	Finalizes the hash using \a block of \a size.
@@ -58,12 +84,8 @@ public:
 		uint8_t paddedBlock[TraitsType::blockSize * 2];
 		
 		// Calculations
-//		const size_t paddingBytes = (TraitsType::blockSize - sizeof (WordType) * 2) - size;
-		const size_t paddedBlockSize = (size <= (TraitsType::blockSize - sizeof (WordType) - 1)) ? TraitsType::blockSize : (TraitsType::blockSize * 2);
-		
-		// Word-sized pointers
-		WordType *paddedBlockWords = reinterpret_cast<WordType *>(paddedBlock);
-		const WordType *blockWords = reinterpret_cast<const WordType *>(block);
+		const size_t lengthFieldSize = sizeof (WordType) * 2;
+		const size_t paddedBlockSize = (size < (TraitsType::blockSize - lengthFieldSize)) ? TraitsType::blockSize : (TraitsType::blockSize * 2);
 		
 		// Set padded block zero and copy existing data from partial block
 		memset(paddedBlock, '\0', sizeof (paddedBlock));
@@ -75,12 +97,11 @@ public:
 		// Set first byte after block end
 		paddedBlock[size] = 0x80;
 		
-		// Add size to the end
+		// Add size in bits to the end; the upper half of SHA-384/512's 128 bit length field stays zero
 		this->_messageSize += size * 8;
-		*(reinterpret_cast<size_t *>(paddedBlock + (paddedBlockSize / sizeof (WordType))) - 1) = this->_messageSize;
+		*reinterpret_cast<uint64_t *>(paddedBlock + paddedBlockSize - sizeof (uint64_t)) = changeEndianness(this->_messageSize);
 		
 		DEBUG("size added 0x" << std::hex << this->_messageSize)
-		printBuffer(paddedBlock, paddedBlockSize);
 		
 		// Update digest
 		if (paddedBlockSize == TraitsType::blockSize)
@@ -107,12 +128,55 @@ public:
 		DEBUG("blocks=" << blocks)
 		DEBUG("remainingBytes=" << remainingBytes)
 		
-		for (size_t block = 0; block < blocks; block++)
+		this->_compress(message, blocks);
+		this->finalize(message + blocks * TraitsType::blockSize, remainingBytes);
+	}
+	
+	///
+	/// \brief	Hashes the concatenation of \a fragmentCount \a fragments of arbitrary sizes.
+	/// 
+	///			Whole blocks are compressed directly from the fragments; only blocks spanning a fragment boundary are assembled in a buffer.
+	/// 
+	/// \since	1.0
+	///
+	void hashFragments(const iovec *fragments, const size_t fragmentCount)
+	{
+		uint8_t block[TraitsType::blockSize];
+		size_t blockBytes = 0;
+		
+		for (size_t fragment = 0; fragment < fragmentCount; fragment++)
 		{
-			this->update(message + block * TraitsType::blockSize);
+			const uint8_t *data = static_cast<const uint8_t *>(fragments[fragment].iov_base);
+			size_t size = fragments[fragment].iov_len;
+			
+			// Complete a block carried over from the previous fragments first
+			if ((blockBytes != 0) && (size != 0))
+			{
+				const size_t bytes = ((TraitsType::blockSize - blockBytes) < size) ? (TraitsType::blockSize - blockBytes) : size;
+				
+				memcpy(block + blockBytes, data, bytes);
+				blockBytes += bytes;
+				data += bytes;
+				size -= bytes;
+				
+				if (blockBytes == TraitsType::blockSize)
+				{
+					this->_compress(block, 1);
+					blockBytes = 0;
+				}
+			}
+			
+			this->_compress(data, size / TraitsType::blockSize);
+			
+			if ((size % TraitsType::blockSize) != 0)
+			{
+				memcpy(block, data + size - (size % TraitsType::blockSize), size % TraitsType::blockSize);
+				blockBytes = size % TraitsType::blockSize;
+			}
 		}
 		
-		this->finalize(message + blocks * TraitsType::blockSize, remainingBytes);
+		this->finalize(block, blockBytes);
+		safeSetZero(block, sizeof (block));
 	}
 	
 	///
@@ -123,6 +187,7 @@ public:
 	void reset()
 	{
 		this->_initializeState();
+		this->_messageSize = 0;
 	}
 	
 	///
@@ -132,29 +197,99 @@ public:
 	/// 
 	/// \since	1.0
 	///
-	void extract(uint8_t *digest)
+	void extract(uint8_t *digest) const
 	{
-//		memcpy(digest, reinterpret_cast<uint8_t *>(this->_state), TraitsType::digestSize);
-		WordType *digestWords = reinterpret_cast<WordType *>(digest);
+		WordType stateWords[TraitsType::stateSize];
+		
+		for (size_t word = 0; word < TraitsType::stateSize; word++)
+		{
+			stateWords[word] = changeEndianness(this->_state[word]);
+		}
 		
+		// Truncated variants only output the leading bytes of the state
+		memcpy(digest, stateWords, TraitsType::digestSize);
+	}
+	
+	///
+	/// \brief	Serializes the internal state into \a midstate.
+	/// 
+	///			The midstate covers all blocks passed to update() so far and is stored in big endian byte order. It can be persisted and passed to
+	///			importMidstate() of another digest of the same type, even in another process, to resume hashing without recompressing the prefix.
+	///			\a midstate must be of midstateSize bytes.
+	/// 
+	/// \since	1.0
+	///
+	void exportMidstate(uint8_t *midstate) const
+	{
 		for (size_t word = 0; word < TraitsType::stateSize; word++)
 		{
-			*(reinterpret_cast<WordType *>(digest) + word) = changeEndianness(this->_state[word]);
+			const WordType value = changeEndianness(this->_state[word]);
+			memcpy(midstate + word * sizeof (WordType), &value, sizeof (WordType));
 		}
+		
+		const uint64_t messageSize = changeEndianness(this->_messageSize);
+		memcpy(midstate + TraitsType::stateSize * sizeof (WordType), &messageSize, sizeof (messageSize));
+	}
+	
+	///
+	/// \brief	Restores the internal state from \a midstate previously written by exportMidstate().
+	/// 
+	///			Returns \c false and leaves the digest untouched if \a midstate does not describe a whole number of blocks.
+	/// 
+	/// \since	1.0
+	///
+	bool importMidstate(const uint8_t *midstate)
+	{
+		bool returnValue = false;
+		uint64_t messageSize = 0;
+		
+		memcpy(&messageSize, midstate + TraitsType::stateSize * sizeof (WordType), sizeof (messageSize));
+		messageSize = changeEndianness(messageSize);
+		
+		if ((messageSize % (TraitsType::blockSize * 8)) == 0)
+		{
+			for (size_t word = 0; word < TraitsType::stateSize; word++)
+			{
+				WordType value = 0;
+				memcpy(&value, midstate + word * sizeof (WordType), sizeof (WordType));
+				this->_state[word] = changeEndianness(value);
+			}
+			
+			this->_messageSize = messageSize;
+			returnValue = true;
+		}
+		
+		return returnValue;
 	}
 	
 private:
 	using WordType = typename TraitsType::WordType;
 	WordType _state[TraitsType::stateSize];
-	size_t _messageSize = 0;
+	uint64_t _messageSize = 0;
 	
 	void _initializeState();
+	
+	void _compress(const uint8_t *blocks, const size_t blockCount)
+	{
+		this->_messageSize += uint64_t(blockCount) * TraitsType::blockSize * 8;
+		
+		if constexpr (TraitsType::blockSize == SHA256_BLOCK_SIZE)
+		{
+			kernels().sha256Blocks(this->_state, blocks, blockCount);
+		}
+		else
+		{
+			kernels().sha512Blocks(this->_state, blocks, blockCount);
+		}
+	}
 };
 
 using Digest224 = Digest<SHA224_DIGEST_SIZE>;
 using Digest256 = Digest<SHA256_DIGEST_SIZE>;
 using Digest384 = Digest<SHA384_DIGEST_SIZE>;
 using Digest512 = Digest<SHA512_DIGEST_SIZE>;
+using Digest512_224 = Digest<SHA512_224_DIGEST_SIZE, SHA512_BLOCK_SIZE>;
+using Digest512_256 = Digest<SHA512_256_DIGEST_SIZE, SHA512_BLOCK_SIZE>;
 
 } // namespace Crypto::Hash::Sha2
 
@@ -0,0 +1,76 @@
+#ifndef SHA2KERNELS_H
+#define SHA2KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Crypto::Hash::Sha2
+{
+
+///
+/// \brief	Holds the SHA-2 compression kernels selected for the running CPU.
+/// 
+/// \since	1.0
+///
+struct Kernels
+{
+	///
+	/// \brief	Compresses \a blockCount consecutive 64 byte \a blocks into the SHA-224/256 \a state.
+	/// 
+	/// \since	1.0
+	///
+	void (*sha256Blocks)(uint32_t *state, const uint8_t *blocks, const size_t blockCount);
+	
+	///
+	/// \brief	Compresses \a blockCount consecutive 128 byte \a blocks into the SHA-384/512 \a state.
+	/// 
+	/// \since	1.0
+	///
+	void (*sha512Blocks)(uint64_t *state, const uint8_t *blocks, const size_t blockCount);
+	
+	///
+	/// \brief	Compresses \a blockCount consecutive 64 byte blocks of each of \a laneCount independent messages.
+	/// 
+	///			Lane \a i compresses the blocks at \a blocks[i] into the SHA-224/256 state \a states[i]. Vector kernels compress one block of
+	///			every lane with a single instruction stream, so many short messages are hashed as fast as a long one.
+	/// 
+	/// \since	1.0
+	///
+	void (*sha256BlocksLanes)(uint32_t *const *states, const uint8_t *const *blocks, const size_t laneCount, const size_t blockCount);
+	
+	///
+	/// \brief	The name of the kernel set for diagnostics.
+	/// 
+	/// \since	1.0
+	///
+	const char *name;
+};
+
+///
+/// \brief	Returns the fastest kernels allowed by Crypto::Cpu::features().
+/// 
+///			The kernels are selected on first use and again by selectKernels(), so the features are not checked on every call.
+/// 
+/// \since	1.0
+///
+const Kernels &kernels();
+
+///
+/// \brief	Selects the kernels returned by kernels() again for the current Crypto::Cpu::features().
+/// 
+///			Crypto::Cpu::restrictFeatures() calls it after changing the features.
+/// 
+/// \since	1.0
+///
+void selectKernels();
+
+///
+/// \brief	Returns the portable kernels.
+/// 
+/// \since	1.0
+///
+const Kernels &genericKernels();
+
+} // namespace Crypto::Hash::Sha2
+
+#endif // SHA2KERNELS_H
@@ -0,0 +1,231 @@
+#ifndef SHA2MULTIDIGEST_H
+#define SHA2MULTIDIGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cryptoutilities.h"
+#include "sha2digest.h"
+#include "sha2kernels.h"
+#include "sha2traits.h"
+
+namespace Crypto::Hash::Sha2
+{
+
+///
+/// \brief	Hashes many independent messages with the SHA2 variant of \a digestSize at once.
+/// 
+///			SHA-224/256 messages are assigned to the lanes of Kernels::sha256BlocksLanes(). A lane that has compressed its message including
+///			the padding takes the next message, so many short messages of different sizes keep all lanes busy. SHA-384/512 messages are hashed
+///			one after another.
+/// 
+/// \since	1.0
+///
+template <uint32_t digestSize, uint32_t blockSize = defaultBlockSize(digestSize)>
+class MultiDigest
+{
+public:
+	///
+	/// \brief	The corresponding traits type.
+	/// 
+	/// \since	1.0
+	///
+	using TraitsType = Sha2::Traits<digestSize, blockSize>;
+	
+	///
+	/// \brief	The digest type computing the same hash values for single messages.
+	/// 
+	/// \since	1.0
+	///
+	using DigestType = Digest<digestSize, blockSize>;
+	
+	///
+	/// \brief	The number of messages in flight.
+	/// 
+	/// \since	1.0
+	///
+	static constexpr size_t laneCount = 8;
+	
+	///
+	/// \brief	Hashes the \a messageCount \a messages of \a messageSizes bytes and writes the hash values to \a digests.
+	/// 
+	///			\a digests receives the hash values one after another and must hold \a messageCount times the digest size.
+	/// 
+	/// \since	1.0
+	///
+	static void hash(const uint8_t *const *messages, const size_t *messageSizes, const size_t messageCount, uint8_t *digests)
+	{
+		if constexpr (TraitsType::blockSize == SHA256_BLOCK_SIZE)
+		{
+			_hashLanes(messages, messageSizes, messageCount, digests);
+		}
+		else
+		{
+			for (size_t message = 0; message < messageCount; message++)
+			{
+				DigestType digest;
+				digest.hash(messages[message], messageSizes[message]);
+				digest.extract(digests + message * TraitsType::digestSize);
+			}
+		}
+	}
+	
+private:
+	using WordType = typename TraitsType::WordType;
+	
+	///
+	/// \internal
+	/// 
+	/// \brief	Holds the progress of the message assigned to a lane.
+	/// 
+	/// \since	1.0
+	///
+	struct _Lane
+	{
+		WordType state[TraitsType::stateSize];
+		const uint8_t *blocks;
+		size_t blockCount;
+		size_t message;
+		bool inTail;
+		uint8_t tail[TraitsType::blockSize * 2];
+	};
+	
+	static void _start(_Lane &lane, const size_t message, const uint8_t *data, const size_t size, const WordType *initialState)
+	{
+		const size_t remainingBytes = size % TraitsType::blockSize;
+		const size_t tailSize = (remainingBytes < (TraitsType::blockSize - sizeof (uint64_t))) ? TraitsType::blockSize : (TraitsType::blockSize * 2);
+		const uint64_t messageBits = changeEndianness(uint64_t(size) * 8);
+		
+		memcpy(lane.state, initialState, sizeof (lane.state));
+		lane.blocks = data;
+		lane.blockCount = size / TraitsType::blockSize;
+		lane.message = message;
+		lane.inTail = false;
+		
+		// The padded last blocks are compressed from the lane itself once the whole blocks of the message are done
+		memset(lane.tail, 0, sizeof (lane.tail));
+		
+		if (remainingBytes != 0)
+		{
+			memcpy(lane.tail, data + lane.blockCount * TraitsType::blockSize, remainingBytes);
+		}
+		
+		lane.tail[remainingBytes] = 0x80;
+		memcpy(lane.tail + tailSize - sizeof (messageBits), &messageBits, sizeof (messageBits));
+		
+		if (lane.blockCount == 0)
+		{
+			lane.blocks = lane.tail;
+			lane.blockCount = tailSize / TraitsType::blockSize;
+			lane.inTail = true;
+		}
+	}
+	
+	static void _hashLanes(const uint8_t *const *messages, const size_t *messageSizes, const size_t messageCount, uint8_t *digests)
+	{
+		uint8_t midstate[DigestType::midstateSize];
+		WordType initialState[TraitsType::stateSize];
+		_Lane lanes[laneCount];
+		size_t activeLanes[laneCount];
+		size_t activeLaneCount = 0;
+		size_t nextMessage = 0;
+		
+		// A fresh digest holds the initial hash value of the variant
+		DigestType().exportMidstate(midstate);
+		
+		for (size_t word = 0; word < TraitsType::stateSize; word++)
+		{
+			memcpy(&initialState[word], midstate + word * sizeof (WordType), sizeof (WordType));
+			initialState[word] = changeEndianness(initialState[word]);
+		}
+		
+		for (; (activeLaneCount < laneCount) && (nextMessage < messageCount); activeLaneCount++, nextMessage++)
+		{
+			activeLanes[activeLaneCount] = activeLaneCount;
+			_start(lanes[activeLaneCount], nextMessage, messages[nextMessage], messageSizes[nextMessage], initialState);
+		}
+		
+		while (activeLaneCount != 0)
+		{
+			WordType *states[laneCount];
+			const uint8_t *blocks[laneCount];
+			size_t step = lanes[activeLanes[0]].blockCount;
+			
+			// All lanes advance by the blocks left in the shortest segment
+			for (size_t lane = 0; lane < activeLaneCount; lane++)
+			{
+				_Lane &current = lanes[activeLanes[lane]];
+				
+				states[lane] = current.state;
+				blocks[lane] = current.blocks;
+				step = (current.blockCount < step) ? current.blockCount : step;
+			}
+			
+			kernels().sha256BlocksLanes(states, blocks, activeLaneCount, step);
+			
+			for (size_t lane = 0; lane < activeLaneCount; )
+			{
+				_Lane &current = lanes[activeLanes[lane]];
+				
+				current.blocks += step * TraitsType::blockSize;
+				current.blockCount -= step;
+				
+				if ((current.blockCount == 0) && !current.inTail)
+				{
+					const size_t remainingBytes = messageSizes[current.message] % TraitsType::blockSize;
+					
+					current.blocks = current.tail;
+					current.blockCount = (remainingBytes < (TraitsType::blockSize - sizeof (uint64_t))) ? 1 : 2;
+					current.inTail = true;
+				}
+				
+				if (current.blockCount != 0)
+				{
+					lane++;
+				}
+				else
+				{
+					_extract(current.state, digests + current.message * TraitsType::digestSize);
+					
+					if (nextMessage < messageCount)
+					{
+						_start(current, nextMessage, messages[nextMessage], messageSizes[nextMessage], initialState);
+						nextMessage++;
+						lane++;
+					}
+					else
+					{
+						// The last active lane has not been advanced yet and is handled in this position
+						activeLaneCount--;
+						activeLanes[lane] = activeLanes[activeLaneCount];
+					}
+				}
+			}
+		}
+		
+		safeSetZero(lanes, sizeof (lanes));
+	}
+	
+	static void _extract(const WordType *state, uint8_t *digest)
+	{
+		WordType stateWords[TraitsType::stateSize];
+		
+		for (size_t word = 0; word < TraitsType::stateSize; word++)
+		{
+			stateWords[word] = changeEndianness(state[word]);
+		}
+		
+		// Truncated variants only output the leading bytes of the state
+		memcpy(digest, stateWords, TraitsType::digestSize);
+	}
+};
+
+using MultiDigest224 = MultiDigest<SHA224_DIGEST_SIZE>;
+using MultiDigest256 = MultiDigest<SHA256_DIGEST_SIZE>;
+using MultiDigest384 = MultiDigest<SHA384_DIGEST_SIZE>;
+using MultiDigest512 = MultiDigest<SHA512_DIGEST_SIZE>;
+
+} // namespace Crypto::Hash::Sha2
+
+#endif // SHA2MULTIDIGEST_H
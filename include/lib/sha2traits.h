@@ -8,7 +8,20 @@
 namespace Crypto::Hash::Sha2
 {
 
-template <uint32_t outputSize>
+///
+/// \brief	Returns the block size of the compression function conventionally used for \a outputSize.
+/// 
+///			SHA-224 and SHA-256 use the 32 bit engine, SHA-384 and SHA-512 the 64 bit one. The truncated SHA-512 variants share their output size
+///			with SHA-224 and SHA-256 and must name SHA512_BLOCK_SIZE explicitly.
+/// 
+/// \since	1.0
+///
+constexpr uint32_t defaultBlockSize(const uint32_t outputSize)
+{
+	return (outputSize <= SHA256_DIGEST_SIZE) ? SHA256_BLOCK_SIZE : SHA512_BLOCK_SIZE;
+}
+
+template <uint32_t outputSize, uint32_t blockSize = defaultBlockSize(outputSize)>
 struct Traits;
 
 template <>
@@ -21,7 +34,7 @@ struct Traits<SHA256_DIGEST_SIZE>
 	static constexpr uint32_t digestSize = SHA256_DIGEST_SIZE;
 	
 	// in Bytes
-	static constexpr uint32_t blockSize = 512 / 8;
+	static constexpr uint32_t blockSize = SHA256_BLOCK_SIZE;
 	
 	// in words
 	static constexpr uint32_t stateSize = 8;
@@ -41,7 +54,7 @@ struct Traits<SHA512_DIGEST_SIZE>
 {
 	using WordType = uint64_t;
 	static constexpr uint32_t digestSize = SHA512_DIGEST_SIZE;
-	static constexpr uint32_t blockSize = 1024 / 8;
+	static constexpr uint32_t blockSize = SHA512_BLOCK_SIZE;
 	static constexpr uint32_t stateSize = 8;
 };
 
@@ -54,6 +67,24 @@ struct Traits<SHA384_DIGEST_SIZE>
 	static constexpr uint32_t stateSize = 8;
 };
 
+template <>
+struct Traits<SHA512_224_DIGEST_SIZE, SHA512_BLOCK_SIZE>
+{
+	using WordType = Traits<SHA512_DIGEST_SIZE>::WordType;
+	static constexpr uint32_t digestSize = SHA512_224_DIGEST_SIZE;
+	static constexpr uint32_t blockSize = Traits<SHA512_DIGEST_SIZE>::blockSize;
+	static constexpr uint32_t stateSize = 8;
+};
+
+template <>
+struct Traits<SHA512_256_DIGEST_SIZE, SHA512_BLOCK_SIZE>
+{
+	using WordType = Traits<SHA512_DIGEST_SIZE>::WordType;
+	static constexpr uint32_t digestSize = SHA512_256_DIGEST_SIZE;
+	static constexpr uint32_t blockSize = Traits<SHA512_DIGEST_SIZE>::blockSize;
+	static constexpr uint32_t stateSize = 8;
+};
+
 } // namespace Hash
 
 #endif // SHA2TRAITS_H
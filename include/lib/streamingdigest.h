@@ -0,0 +1,134 @@
+#ifndef STREAMINGDIGEST_H
+#define STREAMINGDIGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cryptoglobals.h"
+
+namespace Crypto::Hash
+{
+
+///
+/// \brief	Feeds arbitrarily sized pieces of a message to \a DigestType, which only accepts whole blocks until finalization.
+/// 
+///			Each run of whole blocks is passed to the digest in a single call, so long pieces reach the multi-block kernels. Only a block
+///			spanning two pieces is assembled in the internal buffer.
+/// 
+/// \since	1.0
+///
+template <typename DigestType>
+class StreamingDigest
+{
+public:
+	///
+	/// \brief	The corresponding traits type.
+	/// 
+	/// \since	1.0
+	///
+	using TraitsType = typename DigestType::TraitsType;
+	
+	///
+	/// \brief	Constructs the streaming digest with a freshly initialized digest.
+	/// 
+	/// \since	1.0
+	///
+	StreamingDigest() = default;
+	
+	///
+	/// \brief	Constructs the streaming digest continuing from \a digest, which may already have consumed whole blocks.
+	/// 
+	/// \since	1.0
+	///
+	explicit StreamingDigest(const DigestType &digest) :
+		_digest(digest)
+	{
+	}
+	
+	///
+	/// \brief	Destructs the streaming digest and safely discards the buffered message bytes.
+	/// 
+	/// \since	1.0
+	///
+	~StreamingDigest()
+	{
+		safeSetZero(this->_buffer, sizeof (this->_buffer));
+	}
+	
+	///
+	/// \brief	Appends \a size bytes of \a data to the message.
+	/// 
+	/// \since	1.0
+	///
+	void update(const uint8_t *data, size_t size)
+	{
+		// Complete a previously buffered partial block first
+		if (this->_bufferSize != 0)
+		{
+			const size_t bytes = ((blockSize - this->_bufferSize) < size) ? (blockSize - this->_bufferSize) : size;
+			
+			memcpy(this->_buffer + this->_bufferSize, data, bytes);
+			this->_bufferSize += bytes;
+			data += bytes;
+			size -= bytes;
+			
+			if (this->_bufferSize == blockSize)
+			{
+				this->_digest.update(this->_buffer);
+				this->_bufferSize = 0;
+			}
+		}
+		
+		const size_t blockCount = size / blockSize;
+		
+		if (blockCount != 0)
+		{
+			this->_digest.update(data, blockCount);
+			data += blockCount * blockSize;
+			size -= blockCount * blockSize;
+		}
+		
+		if (size != 0)
+		{
+			memcpy(this->_buffer, data, size);
+			this->_bufferSize = size;
+		}
+	}
+	
+	///
+	/// \brief	Completes the message and writes the hash to \a digest.
+	/// 
+	///			\a digest must be of the digest size. Afterwards the streaming digest has to be reset before it is used again.
+	/// 
+	/// \since	1.0
+	///
+	void finalize(uint8_t *digest)
+	{
+		this->_digest.finalize(this->_buffer, this->_bufferSize);
+		this->_digest.extract(digest);
+	}
+	
+	///
+	/// \brief	Discards the current message and continues from \a digest.
+	/// 
+	/// \since	1.0
+	///
+	void reset(const DigestType &digest = DigestType())
+	{
+		this->_digest = digest;
+		safeSetZero(this->_buffer, sizeof (this->_buffer));
+		this->_bufferSize = 0;
+	}
+	
+private:
+	static constexpr size_t blockSize = TraitsType::blockSize;
+	
+	DigestType _digest;
+	uint8_t _buffer[blockSize];
+	size_t _bufferSize = 0;
+};
+
+} // namespace Crypto::Hash
+
+#endif // STREAMINGDIGEST_H
@@ -0,0 +1,947 @@
+#include <atomic>
+#include <string.h>
+
+#include "aesconstants.h"
+#include "aeskernels.h"
+#include "ciphermode.h"
+#include "cpufeatures.h"
+#include "cryptoglobals.h"
+
+#ifdef CRYPTO_ARCH_X86
+#include <immintrin.h>
+#endif
+
+namespace Crypto::BlockCipher::Aes
+{
+
+static inline uint32_t _loadWord(const uint8_t *source)
+{
+	uint32_t word = 0;
+	
+	memcpy(&word, source, sizeof (word));
+	
+	return changeEndianness(word);
+}
+
+static inline void _storeWord(uint8_t *destination, const uint32_t word)
+{
+	const uint32_t value = changeEndianness(word);
+	
+	memcpy(destination, &value, sizeof (value));
+}
+
+static inline void _encryptBlockGeneric(const uint8_t *roundKeys, const uint32_t rounds, const uint8_t *plainBlock, uint8_t *cipherBlock)
+{
+	// Column vectors; add round key of the first round
+	uint32_t s0 = _loadWord(plainBlock) ^ _loadWord(roundKeys);
+	uint32_t s1 = _loadWord(plainBlock + sizeof (uint32_t)) ^ _loadWord(roundKeys + sizeof (uint32_t));
+	uint32_t s2 = _loadWord(plainBlock + sizeof (uint32_t) * 2) ^ _loadWord(roundKeys + sizeof (uint32_t) * 2);
+	uint32_t s3 = _loadWord(plainBlock + sizeof (uint32_t) * 3) ^ _loadWord(roundKeys + sizeof (uint32_t) * 3);
+	
+	// Temporaries
+	uint32_t t0 = 0;
+	uint32_t t1 = 0;
+	uint32_t t2 = 0;
+	uint32_t t3 = 0;
+	
+	// Perform transformation on middle rounds
+	for (uint32_t round = 1; round < rounds; round++)
+	{
+		const uint8_t *roundKey = roundKeys + round * AES_BLOCK_SIZE;
+		
+		t0 = t0_enc[uint8_t(s0 >> 24)] ^ t1_enc[uint8_t(s1 >> 16)] ^ t2_enc[uint8_t(s2 >> 8)] ^ t3_enc[uint8_t(s3)] ^ _loadWord(roundKey);
+		t1 = t0_enc[uint8_t(s1 >> 24)] ^ t1_enc[uint8_t(s2 >> 16)] ^ t2_enc[uint8_t(s3 >> 8)] ^ t3_enc[uint8_t(s0)] ^ _loadWord(roundKey + sizeof (uint32_t));
+		t2 = t0_enc[uint8_t(s2 >> 24)] ^ t1_enc[uint8_t(s3 >> 16)] ^ t2_enc[uint8_t(s0 >> 8)] ^ t3_enc[uint8_t(s1)] ^ _loadWord(roundKey + sizeof (uint32_t) * 2);
+		t3 = t0_enc[uint8_t(s3 >> 24)] ^ t1_enc[uint8_t(s0 >> 16)] ^ t2_enc[uint8_t(s1 >> 8)] ^ t3_enc[uint8_t(s2)] ^ _loadWord(roundKey + sizeof (uint32_t) * 3);
+		
+		s0 = t0;
+		s1 = t1;
+		s2 = t2;
+		s3 = t3;
+	}
+	
+	// Final round
+	const uint8_t *roundKey = roundKeys + rounds * AES_BLOCK_SIZE;
+	
+	t0 = (uint32_t(sBox_enc[uint8_t(s0 >> 24)]) << 24) | (uint32_t(sBox_enc[uint8_t(s1 >> 16)]) << 16) | (uint32_t(sBox_enc[uint8_t(s2 >> 8)]) << 8) | (uint32_t(sBox_enc[uint8_t(s3)]));
+	t1 = (uint32_t(sBox_enc[uint8_t(s1 >> 24)]) << 24) | (uint32_t(sBox_enc[uint8_t(s2 >> 16)]) << 16) | (uint32_t(sBox_enc[uint8_t(s3 >> 8)]) << 8) | (uint32_t(sBox_enc[uint8_t(s0)]));
+	t2 = (uint32_t(sBox_enc[uint8_t(s2 >> 24)]) << 24) | (uint32_t(sBox_enc[uint8_t(s3 >> 16)]) << 16) | (uint32_t(sBox_enc[uint8_t(s0 >> 8)]) << 8) | (uint32_t(sBox_enc[uint8_t(s1)]));
+	t3 = (uint32_t(sBox_enc[uint8_t(s3 >> 24)]) << 24) | (uint32_t(sBox_enc[uint8_t(s0 >> 16)]) << 16) | (uint32_t(sBox_enc[uint8_t(s1 >> 8)]) << 8) | (uint32_t(sBox_enc[uint8_t(s2)]));
+	
+	_storeWord(cipherBlock, t0 ^ _loadWord(roundKey));
+	_storeWord(cipherBlock + sizeof (uint32_t), t1 ^ _loadWord(roundKey + sizeof (uint32_t)));
+	_storeWord(cipherBlock + sizeof (uint32_t) * 2, t2 ^ _loadWord(roundKey + sizeof (uint32_t) * 2));
+	_storeWord(cipherBlock + sizeof (uint32_t) * 3, t3 ^ _loadWord(roundKey + sizeof (uint32_t) * 3));
+}
+
+static void _encryptBlocksGeneric(const uint8_t *roundKeys, const uint32_t rounds, const uint8_t *input, uint8_t *output, const size_t blockCount)
+{
+	for (size_t block = 0; block < blockCount; block++)
+	{
+		_encryptBlockGeneric(roundKeys, rounds, input + block * AES_BLOCK_SIZE, output + block * AES_BLOCK_SIZE);
+	}
+}
+
+static inline void _decryptBlockGeneric(const uint8_t *roundKeys, const uint32_t rounds, const uint8_t *cipherBlock, uint8_t *plainBlock)
+{
+	// Column vectors; add round key of the first round
+	uint32_t s0 = _loadWord(cipherBlock) ^ _loadWord(roundKeys);
+	uint32_t s1 = _loadWord(cipherBlock + sizeof (uint32_t)) ^ _loadWord(roundKeys + sizeof (uint32_t));
+	uint32_t s2 = _loadWord(cipherBlock + sizeof (uint32_t) * 2) ^ _loadWord(roundKeys + sizeof (uint32_t) * 2);
+	uint32_t s3 = _loadWord(cipherBlock + sizeof (uint32_t) * 3) ^ _loadWord(roundKeys + sizeof (uint32_t) * 3);
+	
+	// Temporaries
+	uint32_t t0 = 0;
+	uint32_t t1 = 0;
+	uint32_t t2 = 0;
+	uint32_t t3 = 0;
+	
+	// Perform inverse transformation on middle rounds
+	for (uint32_t round = 1; round < rounds; round++)
+	{
+		const uint8_t *roundKey = roundKeys + round * AES_BLOCK_SIZE;
+		
+		t0 = t0_dec[uint8_t(s0 >> 24)] ^ t1_dec[uint8_t(s3 >> 16)] ^ t2_dec[uint8_t(s2 >> 8)] ^ t3_dec[uint8_t(s1)] ^ _loadWord(roundKey);
+		t1 = t0_dec[uint8_t(s1 >> 24)] ^ t1_dec[uint8_t(s0 >> 16)] ^ t2_dec[uint8_t(s3 >> 8)] ^ t3_dec[uint8_t(s2)] ^ _loadWord(roundKey + sizeof (uint32_t));
+		t2 = t0_dec[uint8_t(s2 >> 24)] ^ t1_dec[uint8_t(s1 >> 16)] ^ t2_dec[uint8_t(s0 >> 8)] ^ t3_dec[uint8_t(s3)] ^ _loadWord(roundKey + sizeof (uint32_t) * 2);
+		t3 = t0_dec[uint8_t(s3 >> 24)] ^ t1_dec[uint8_t(s2 >> 16)] ^ t2_dec[uint8_t(s1 >> 8)] ^ t3_dec[uint8_t(s0)] ^ _loadWord(roundKey + sizeof (uint32_t) * 3);
+		
+		s0 = t0;
+		s1 = t1;
+		s2 = t2;
+		s3 = t3;
+	}
+	
+	// Final round
+	const uint8_t *roundKey = roundKeys + rounds * AES_BLOCK_SIZE;
+	
+	t0 = (uint32_t(sBox_dec[uint8_t(s0 >> 24)]) << 24) | (uint32_t(sBox_dec[uint8_t(s3 >> 16)]) << 16) | (uint32_t(sBox_dec[uint8_t(s2 >> 8)]) << 8) | (uint32_t(sBox_dec[uint8_t(s1)]));
+	t1 = (uint32_t(sBox_dec[uint8_t(s1 >> 24)]) << 24) | (uint32_t(sBox_dec[uint8_t(s0 >> 16)]) << 16) | (uint32_t(sBox_dec[uint8_t(s3 >> 8)]) << 8) | (uint32_t(sBox_dec[uint8_t(s2)]));
+	t2 = (uint32_t(sBox_dec[uint8_t(s2 >> 24)]) << 24) | (uint32_t(sBox_dec[uint8_t(s1 >> 16)]) << 16) | (uint32_t(sBox_dec[uint8_t(s0 >> 8)]) << 8) | (uint32_t(sBox_dec[uint8_t(s3)]));
+	t3 = (uint32_t(sBox_dec[uint8_t(s3 >> 24)]) << 24) | (uint32_t(sBox_dec[uint8_t(s2 >> 16)]) << 16) | (uint32_t(sBox_dec[uint8_t(s1 >> 8)]) << 8) | (uint32_t(sBox_dec[uint8_t(s0)]));
+	
+	_storeWord(plainBlock, t0 ^ _loadWord(roundKey));
+	_storeWord(plainBlock + sizeof (uint32_t), t1 ^ _loadWord(roundKey + sizeof (uint32_t)));
+	_storeWord(plainBlock + sizeof (uint32_t) * 2, t2 ^ _loadWord(roundKey + sizeof (uint32_t) * 2));
+	_storeWord(plainBlock + sizeof (uint32_t) * 3, t3 ^ _loadWord(roundKey + sizeof (uint32_t) * 3));
+}
+
+static void _decryptBlocksGeneric(const uint8_t *roundKeys, const uint32_t rounds, const uint8_t *input, uint8_t *output, const size_t blockCount)
+{
+	for (size_t block = 0; block < blockCount; block++)
+	{
+		_decryptBlockGeneric(roundKeys, rounds, input + block * AES_BLOCK_SIZE, output + block * AES_BLOCK_SIZE);
+	}
+}
+
+///
+/// \internal
+/// 
+/// \brief	The number of keystream blocks the portable counter mode kernel generates before applying them, one cache line.
+/// 
+/// \since	1.0
+///
+static constexpr size_t _genericKeystreamBlocks = 4;
+
+static void _ctrGeneric(const uint8_t *roundKeys, const uint32_t rounds, uint8_t *counter, const uint8_t *input, uint8_t *output, const size_t size)
+{
+	uint8_t keystream[_genericKeystreamBlocks * AES_BLOCK_SIZE];
+	
+	// The keystream of a whole cache line is applied at once, so every line of the data is read and written once
+	for (size_t offset = 0; offset < size; offset += sizeof (keystream))
+	{
+		const size_t bytes = ((size - offset) < sizeof (keystream)) ? (size - offset) : sizeof (keystream);
+		
+		for (size_t block = 0; (block * AES_BLOCK_SIZE) < bytes; block++)
+		{
+			_encryptBlockGeneric(roundKeys, rounds, counter, keystream + block * AES_BLOCK_SIZE);
+			Mode::addToCounter(counter, 1);
+		}
+		
+		Mode::xorKeystream(input + offset, keystream, output + offset, bytes);
+	}
+	
+	safeSetZero(keystream, sizeof (keystream));
+}
+
+static void _ctrBatchGeneric(const uint8_t *roundKeys, const uint32_t rounds, const Mode::CtrMessage *messages, const size_t messageCount)
+{
+	uint8_t counter[AES_BLOCK_SIZE];
+	
+	for (size_t message = 0; message < messageCount; message++)
+	{
+		memcpy(counter, messages[message].initializationVector, AES_BLOCK_SIZE);
+		_ctrGeneric(roundKeys, rounds, counter, messages[message].input, messages[message].output, messages[message].size);
+	}
+	
+	safeSetZero(counter, sizeof (counter));
+}
+
+static inline uint32_t _subWord(const uint32_t word)
+{
+	return (uint32_t(sBox_enc[uint8_t(word >> 24)]) << 24) | (uint32_t(sBox_enc[uint8_t(word >> 16)]) << 16) |
+			(uint32_t(sBox_enc[uint8_t(word >> 8)]) << 8) | uint32_t(sBox_enc[uint8_t(word)]);
+}
+
+static inline uint32_t _rotWord(const uint32_t word)
+{
+	return rotateLeft(word, 8);
+}
+
+static void _expandKeysGeneric(const uint8_t *keys, const uint32_t keySize, const size_t keyCount, uint8_t *roundKeys)
+{
+	const uint32_t keySizeWords = keySize / sizeof (uint32_t);
+	const uint32_t blockSizeWords = AES_BLOCK_SIZE / sizeof (uint32_t);
+	const uint32_t roundKeyWords = blockSizeWords * (keySizeWords + 7);
+	uint32_t expandedKey[(AES_BLOCK_SIZE / sizeof (uint32_t)) * (AES_256_ROUND_COUNT + 1)];
+	
+	for (size_t key = 0; key < keyCount; key++)
+	{
+		for (uint32_t column = 0; column < keySizeWords; column++)
+		{
+			expandedKey[column] = _loadWord(keys + key * keySize + column * sizeof (uint32_t));
+		}
+		
+		for (uint32_t column = keySizeWords; column < roundKeyWords; column++)
+		{
+			uint32_t tmp = expandedKey[column - 1];
+			
+			if ((column % keySizeWords) == 0)
+			{
+				tmp = _subWord(_rotWord(tmp)) ^ (uint32_t(rCon[column / keySizeWords]) << 24);
+			}
+			else if ((keySizeWords > 6) && ((column % keySizeWords) == 4))
+			{
+				tmp = _subWord(tmp);
+			}
+			
+			expandedKey[column] = expandedKey[column - keySizeWords] ^ tmp;
+		}
+		
+		for (uint32_t column = 0; column < roundKeyWords; column++)
+		{
+			const size_t round = column / blockSizeWords;
+			
+			_storeWord(roundKeys + (round * keyCount + key) * AES_BLOCK_SIZE + (column % blockSizeWords) * sizeof (uint32_t), expandedKey[column]);
+		}
+	}
+	
+	safeSetZero(expandedKey, sizeof (expandedKey));
+}
+
+///
+/// \internal
+/// 
+/// \brief	Copies the round keys of key \a key out of the round major \a roundKeys into the consecutive layout of the single key kernels.
+/// 
+/// \since	1.0
+///
+static inline void _gatherRoundKeys(const uint8_t *roundKeys, const uint32_t rounds, const size_t keyCount, const size_t key, uint8_t *keys)
+{
+	for (uint32_t round = 0; round <= rounds; round++)
+	{
+		memcpy(keys + round * AES_BLOCK_SIZE, roundKeys + (round * keyCount + key) * AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+	}
+}
+
+static void _encryptBlocksMultiKeyGeneric(const uint8_t *roundKeys, const uint32_t rounds, const size_t keyCount, const uint8_t *input, uint8_t *output)
+{
+	uint8_t keys[AES_BLOCK_SIZE * (AES_256_ROUND_COUNT + 1)];
+	
+	// Gather the round keys of each key so the T-table round function can be reused
+	for (size_t key = 0; key < keyCount; key++)
+	{
+		_gatherRoundKeys(roundKeys, rounds, keyCount, key, keys);
+		_encryptBlockGeneric(keys, rounds, input + key * AES_BLOCK_SIZE, output + key * AES_BLOCK_SIZE);
+	}
+	
+	safeSetZero(keys, sizeof (keys));
+}
+
+static void _ctrMultiKeyGeneric(const uint8_t *roundKeys, const uint32_t rounds, const size_t keyCount, const Mode::CtrMessage *messages)
+{
+	uint8_t keys[AES_BLOCK_SIZE * (AES_256_ROUND_COUNT + 1)];
+	uint8_t counter[AES_BLOCK_SIZE];
+	
+	for (size_t key = 0; key < keyCount; key++)
+	{
+		_gatherRoundKeys(roundKeys, rounds, keyCount, key, keys);
+		memcpy(counter, messages[key].initializationVector, AES_BLOCK_SIZE);
+		_ctrGeneric(keys, rounds, counter, messages[key].input, messages[key].output, messages[key].size);
+	}
+	
+	safeSetZero(keys, sizeof (keys));
+	safeSetZero(counter, sizeof (counter));
+}
+
+#ifdef CRYPTO_ARCH_X86
+///
+/// \internal
+/// 
+/// \brief	The number of blocks AES-NI kernels keep in flight to hide the latency of AESENC.
+/// 
+/// \since	1.0
+///
+static constexpr size_t _aesNiLanes = 8;
+
+__attribute__((target("aes,sse2")))
+static inline __m128i _encryptBlockAesNi(const __m128i *keys, const uint32_t rounds, __m128i block)
+{
+	block = _mm_xor_si128(block, keys[0]);
+	
+	for (uint32_t round = 1; round < rounds; round++)
+	{
+		block = _mm_aesenc_si128(block, keys[round]);
+	}
+	
+	return _mm_aesenclast_si128(block, keys[rounds]);
+}
+
+__attribute__((target("aes,sse2")))
+static inline void _encryptLanesAesNi(const __m128i *keys, const uint32_t rounds, __m128i *blocks)
+{
+	for (size_t lane = 0; lane < _aesNiLanes; lane++)
+	{
+		blocks[lane] = _mm_xor_si128(blocks[lane], keys[0]);
+	}
+	
+	for (uint32_t round = 1; round < rounds; round++)
+	{
+		for (size_t lane = 0; lane < _aesNiLanes; lane++)
+		{
+			blocks[lane] = _mm_aesenc_si128(blocks[lane], keys[round]);
+		}
+	}
+	
+	for (size_t lane = 0; lane < _aesNiLanes; lane++)
+	{
+		blocks[lane] = _mm_aesenclast_si128(blocks[lane], keys[rounds]);
+	}
+}
+
+__attribute__((target("sse2")))
+static inline __m128i _nextCounterBlock(uint64_t &counterHigh, uint64_t &counterLow)
+{
+	const __m128i counterBlock = _mm_set_epi64x(int64_t(changeEndianness(counterLow)), int64_t(changeEndianness(counterHigh)));
+	
+	counterLow++;
+	counterHigh += (counterLow == 0);
+	
+	return counterBlock;
+}
+
+__attribute__((target("aes,sse2")))
+static void _encryptBlocksAesNi(const uint8_t *roundKeys, const uint32_t rounds, const uint8_t *input, uint8_t *output, const size_t blockCount)
+{
+	__m128i keys[AES_256_ROUND_COUNT + 1];
+	size_t block = 0;
+	
+	for (uint32_t round = 0; round <= rounds; round++)
+	{
+		keys[round] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(roundKeys) + round);
+	}
+	
+	for (; (block + _aesNiLanes) <= blockCount; block += _aesNiLanes)
+	{
+		__m128i blocks[_aesNiLanes];
+		
+		for (size_t lane = 0; lane < _aesNiLanes; lane++)
+		{
+			blocks[lane] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input) + block + lane);
+		}
+		
+		_encryptLanesAesNi(keys, rounds, blocks);
+		
+		for (size_t lane = 0; lane < _aesNiLanes; lane++)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(output) + block + lane, blocks[lane]);
+		}
+	}
+	
+	for (; block < blockCount; block++)
+	{
+		const __m128i plainBlock = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input) + block);
+		
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(output) + block, _encryptBlockAesNi(keys, rounds, plainBlock));
+	}
+	
+	safeSetZero(keys, sizeof (keys));
+}
+
+__attribute__((target("aes,sse2")))
+static void _decryptBlocksAesNi(const uint8_t *roundKeys, const uint32_t rounds, const uint8_t *input, uint8_t *output, const size_t blockCount)
+{
+	__m128i keys[AES_256_ROUND_COUNT + 1];
+	size_t block = 0;
+	
+	for (uint32_t round = 0; round <= rounds; round++)
+	{
+		keys[round] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(roundKeys) + round);
+	}
+	
+	for (; (block + _aesNiLanes) <= blockCount; block += _aesNiLanes)
+	{
+		__m128i blocks[_aesNiLanes];
+		
+		for (size_t lane = 0; lane < _aesNiLanes; lane++)
+		{
+			blocks[lane] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(input) + block + lane), keys[0]);
+		}
+		
+		for (uint32_t round = 1; round < rounds; round++)
+		{
+			for (size_t lane = 0; lane < _aesNiLanes; lane++)
+			{
+				blocks[lane] = _mm_aesdec_si128(blocks[lane], keys[round]);
+			}
+		}
+		
+		for (size_t lane = 0; lane < _aesNiLanes; lane++)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(output) + block + lane, _mm_aesdeclast_si128(blocks[lane], keys[rounds]));
+		}
+	}
+	
+	for (; block < blockCount; block++)
+	{
+		__m128i cipherBlock = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(input) + block), keys[0]);
+		
+		for (uint32_t round = 1; round < rounds; round++)
+		{
+			cipherBlock = _mm_aesdec_si128(cipherBlock, keys[round]);
+		}
+		
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(output) + block, _mm_aesdeclast_si128(cipherBlock, keys[rounds]));
+	}
+	
+	safeSetZero(keys, sizeof (keys));
+}
+
+///
+/// \internal
+/// 
+/// \brief	The distance in bytes at which streaming kernels prefetch their input.
+/// 
+/// \since	1.0
+///
+static constexpr size_t _prefetchDistance = 4096;
+
+template <bool streaming>
+__attribute__((target("sse2")))
+static inline void _storeBlock(uint8_t *output, const size_t block, const __m128i value, const bool aligned)
+{
+	// Non-temporal stores bypass the caches but require aligned addresses
+	if (streaming && aligned)
+	{
+		_mm_stream_si128(reinterpret_cast<__m128i *>(output) + block, value);
+	}
+	else
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(output) + block, value);
+	}
+}
+
+template <bool streaming>
+__attribute__((target("aes,sse2")))
+static void _ctrAesNi(const uint8_t *roundKeys, const uint32_t rounds, uint8_t *counter, const uint8_t *input, uint8_t *output, const size_t size)
+{
+	__m128i keys[AES_256_ROUND_COUNT + 1];
+	const size_t blockCount = size / AES_BLOCK_SIZE;
+	const bool aligned = ((reinterpret_cast<uintptr_t>(output) % AES_BLOCK_SIZE) == 0);
+	size_t block = 0;
+	
+	for (uint32_t round = 0; round <= rounds; round++)
+	{
+		keys[round] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(roundKeys) + round);
+	}
+	
+	// Keep the counter as two native words and only convert when building counter blocks
+	uint64_t counterHigh = 0;
+	uint64_t counterLow = 0;
+	memcpy(&counterHigh, counter, sizeof (counterHigh));
+	memcpy(&counterLow, counter + sizeof (counterHigh), sizeof (counterLow));
+	counterHigh = changeEndianness(counterHigh);
+	counterLow = changeEndianness(counterLow);
+	
+	for (; (block + _aesNiLanes) <= blockCount; block += _aesNiLanes)
+	{
+		__m128i blocks[_aesNiLanes];
+		
+		for (size_t lane = 0; lane < _aesNiLanes; lane++)
+		{
+			blocks[lane] = _nextCounterBlock(counterHigh, counterLow);
+		}
+		
+		// Each iteration consumes two cache lines of input
+		if constexpr (streaming)
+		{
+			_mm_prefetch(reinterpret_cast<const char *>(input + block * AES_BLOCK_SIZE + _prefetchDistance), _MM_HINT_NTA);
+			_mm_prefetch(reinterpret_cast<const char *>(input + block * AES_BLOCK_SIZE + _prefetchDistance + 64), _MM_HINT_NTA);
+		}
+		
+		_encryptLanesAesNi(keys, rounds, blocks);
+		
+		for (size_t lane = 0; lane < _aesNiLanes; lane++)
+		{
+			const __m128i plainBlock = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input) + block + lane);
+			
+			_storeBlock<streaming>(output, block + lane, _mm_xor_si128(plainBlock, blocks[lane]), aligned);
+		}
+	}
+	
+	for (; block < blockCount; block++)
+	{
+		const __m128i keystream = _encryptBlockAesNi(keys, rounds, _nextCounterBlock(counterHigh, counterLow));
+		const __m128i plainBlock = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input) + block);
+		
+		_storeBlock<streaming>(output, block, _mm_xor_si128(plainBlock, keystream), aligned);
+	}
+	
+	// Order the non-temporal stores before anything the caller does with the output
+	if constexpr (streaming)
+	{
+		_mm_sfence();
+	}
+	
+	// Last incomplete block
+	const size_t remainingBytes = size % AES_BLOCK_SIZE;
+	
+	if (remainingBytes != 0)
+	{
+		alignas(16) uint8_t keystream[AES_BLOCK_SIZE];
+		
+		_mm_store_si128(reinterpret_cast<__m128i *>(keystream), _encryptBlockAesNi(keys, rounds, _nextCounterBlock(counterHigh, counterLow)));
+		
+		for (size_t byte = 0; byte < remainingBytes; byte++)
+		{
+			output[blockCount * AES_BLOCK_SIZE + byte] = input[blockCount * AES_BLOCK_SIZE + byte] ^ keystream[byte];
+		}
+		
+		safeSetZero(keystream, sizeof (keystream));
+	}
+	
+	counterHigh = changeEndianness(counterHigh);
+	counterLow = changeEndianness(counterLow);
+	memcpy(counter, &counterHigh, sizeof (counterHigh));
+	memcpy(counter + sizeof (counterHigh), &counterLow, sizeof (counterLow));
+	
+	safeSetZero(keys, sizeof (keys));
+}
+
+///
+/// \internal
+/// 
+/// \brief	The number of keys expanded together, one per 32 bit lane of a vector register.
+/// 
+/// \since	1.0
+///
+static constexpr size_t _expansionLanes = 4;
+
+__attribute__((target("aes,ssse3,sse2")))
+static void _expandKeysAesNi(const uint8_t *keys, const uint32_t keySize, const size_t keyCount, uint8_t *roundKeys)
+{
+	const uint32_t keySizeWords = keySize / sizeof (uint32_t);
+	const uint32_t blockSizeWords = AES_BLOCK_SIZE / sizeof (uint32_t);
+	const uint32_t rounds = keySizeWords + 6;
+	const uint32_t roundKeyWords = blockSizeWords * (rounds + 1);
+	
+	// AESENCLAST applies ShiftRows after SubBytes, which mixes the lanes. Shuffling with the inverse permutation first leaves SubWord() of
+	// every lane in place; the first mask additionally performs RotWord().
+	const __m128i rotSubMask = _mm_setr_epi8(1, 14, 11, 4, 5, 2, 15, 8, 9, 6, 3, 12, 13, 10, 7, 0);
+	const __m128i subMask = _mm_setr_epi8(0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3);
+	
+	// Word w of all keys in the group, lane l belonging to key l
+	__m128i words[(AES_BLOCK_SIZE / sizeof (uint32_t)) * (AES_256_ROUND_COUNT + 1)];
+	
+	for (size_t key = 0; key < keyCount; key += _expansionLanes)
+	{
+		const size_t lanes = ((keyCount - key) < _expansionLanes) ? (keyCount - key) : _expansionLanes;
+		
+		for (uint32_t column = 0; column < keySizeWords; column++)
+		{
+			uint32_t laneWords[_expansionLanes] = {};
+			
+			for (size_t lane = 0; lane < lanes; lane++)
+			{
+				memcpy(laneWords + lane, keys + (key + lane) * keySize + column * sizeof (uint32_t), sizeof (uint32_t));
+			}
+			
+			words[column] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(laneWords));
+			safeSetZero(laneWords, sizeof (laneWords));
+		}
+		
+		for (uint32_t column = keySizeWords; column < roundKeyWords; column++)
+		{
+			__m128i tmp = words[column - 1];
+			
+			if ((column % keySizeWords) == 0)
+			{
+				tmp = _mm_aesenclast_si128(_mm_shuffle_epi8(tmp, rotSubMask), _mm_set1_epi32(rCon[column / keySizeWords]));
+			}
+			else if ((keySizeWords > 6) && ((column % keySizeWords) == 4))
+			{
+				tmp = _mm_aesenclast_si128(_mm_shuffle_epi8(tmp, subMask), _mm_setzero_si128());
+			}
+			
+			words[column] = _mm_xor_si128(words[column - keySizeWords], tmp);
+		}
+		
+		// Transpose the four words of every round back into one round key per lane
+		for (uint32_t round = 0; round <= rounds; round++)
+		{
+			const __m128i *roundWords = words + round * blockSizeWords;
+			const __m128i low01 = _mm_unpacklo_epi32(roundWords[0], roundWords[1]);
+			const __m128i low23 = _mm_unpacklo_epi32(roundWords[2], roundWords[3]);
+			const __m128i high01 = _mm_unpackhi_epi32(roundWords[0], roundWords[1]);
+			const __m128i high23 = _mm_unpackhi_epi32(roundWords[2], roundWords[3]);
+			const __m128i laneKeys[_expansionLanes] = {
+				_mm_unpacklo_epi64(low01, low23),
+				_mm_unpackhi_epi64(low01, low23),
+				_mm_unpacklo_epi64(high01, high23),
+				_mm_unpackhi_epi64(high01, high23)
+			};
+			
+			for (size_t lane = 0; lane < lanes; lane++)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(roundKeys) + round * keyCount + key + lane, laneKeys[lane]);
+			}
+		}
+	}
+	
+	safeSetZero(words, sizeof (words));
+}
+
+__attribute__((target("aes,sse2")))
+static void _encryptBlocksMultiKeyAesNi(const uint8_t *roundKeys, const uint32_t rounds, const size_t keyCount, const uint8_t *input, uint8_t *output)
+{
+	const __m128i *keys = reinterpret_cast<const __m128i *>(roundKeys);
+	size_t block = 0;
+	
+	// Round major storage makes the keys of all lanes for one round a single contiguous load
+	for (; (block + _aesNiLanes) <= keyCount; block += _aesNiLanes)
+	{
+		__m128i blocks[_aesNiLanes];
+		
+		for (size_t lane = 0; lane < _aesNiLanes; lane++)
+		{
+			blocks[lane] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(input) + block + lane), _mm_loadu_si128(keys + block + lane));
+		}
+		
+		for (uint32_t round = 1; round < rounds; round++)
+		{
+			for (size_t lane = 0; lane < _aesNiLanes; lane++)
+			{
+				blocks[lane] = _mm_aesenc_si128(blocks[lane], _mm_loadu_si128(keys + round * keyCount + block + lane));
+			}
+		}
+		
+		for (size_t lane = 0; lane < _aesNiLanes; lane++)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(output) + block + lane,
+					_mm_aesenclast_si128(blocks[lane], _mm_loadu_si128(keys + rounds * keyCount + block + lane)));
+		}
+	}
+	
+	for (; block < keyCount; block++)
+	{
+		__m128i cipherBlock = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(input) + block), _mm_loadu_si128(keys + block));
+		
+		for (uint32_t round = 1; round < rounds; round++)
+		{
+			cipherBlock = _mm_aesenc_si128(cipherBlock, _mm_loadu_si128(keys + round * keyCount + block));
+		}
+		
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(output) + block, _mm_aesenclast_si128(cipherBlock, _mm_loadu_si128(keys + rounds * keyCount + block)));
+	}
+}
+
+///
+/// \internal
+/// 
+/// \brief	Tells where the keystream block in one lane of the batched counter mode pipeline is applied.
+/// 
+/// \since	1.0
+///
+struct _CtrLane
+{
+	const uint8_t *input;
+	uint8_t *output;
+	size_t size;
+};
+
+__attribute__((target("sse2")))
+static inline void _applyLanesAesNi(const __m128i *keystream, const _CtrLane *lanes, const size_t laneCount)
+{
+	for (size_t lane = 0; lane < laneCount; lane++)
+	{
+		if (lanes[lane].size == AES_BLOCK_SIZE)
+		{
+			const __m128i inputBlock = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes[lane].input));
+			
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes[lane].output), _mm_xor_si128(inputBlock, keystream[lane]));
+		}
+		else
+		{
+			alignas(16) uint8_t keystreamBytes[AES_BLOCK_SIZE];
+			
+			_mm_store_si128(reinterpret_cast<__m128i *>(keystreamBytes), keystream[lane]);
+			
+			for (size_t byte = 0; byte < lanes[lane].size; byte++)
+			{
+				lanes[lane].output[byte] = lanes[lane].input[byte] ^ keystreamBytes[byte];
+			}
+			
+			safeSetZero(keystreamBytes, sizeof (keystreamBytes));
+		}
+	}
+}
+
+__attribute__((target("aes,sse2")))
+static void _ctrBatchAesNi(const uint8_t *roundKeys, const uint32_t rounds, const Mode::CtrMessage *messages, const size_t messageCount)
+{
+	__m128i keys[AES_256_ROUND_COUNT + 1];
+	__m128i blocks[_aesNiLanes];
+	_CtrLane lanes[_aesNiLanes];
+	size_t laneCount = 0;
+	
+	for (uint32_t round = 0; round <= rounds; round++)
+	{
+		keys[round] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(roundKeys) + round);
+	}
+	
+	// Fill the lanes with counter blocks regardless of which message they belong to and flush them whenever all are in use
+	for (size_t message = 0; message < messageCount; message++)
+	{
+		const Mode::CtrMessage &current = messages[message];
+		uint64_t counterHigh = 0;
+		uint64_t counterLow = 0;
+		
+		memcpy(&counterHigh, current.initializationVector, sizeof (counterHigh));
+		memcpy(&counterLow, current.initializationVector + sizeof (counterHigh), sizeof (counterLow));
+		counterHigh = changeEndianness(counterHigh);
+		counterLow = changeEndianness(counterLow);
+		
+		for (size_t offset = 0; offset < current.size; offset += AES_BLOCK_SIZE)
+		{
+			blocks[laneCount] = _nextCounterBlock(counterHigh, counterLow);
+			lanes[laneCount].input = current.input + offset;
+			lanes[laneCount].output = current.output + offset;
+			lanes[laneCount].size = ((current.size - offset) < AES_BLOCK_SIZE) ? (current.size - offset) : AES_BLOCK_SIZE;
+			laneCount++;
+			
+			if (laneCount == _aesNiLanes)
+			{
+				_encryptLanesAesNi(keys, rounds, blocks);
+				_applyLanesAesNi(blocks, lanes, laneCount);
+				laneCount = 0;
+			}
+		}
+	}
+	
+	if (laneCount != 0)
+	{
+		for (size_t lane = laneCount; lane < _aesNiLanes; lane++)
+		{
+			blocks[lane] = _mm_setzero_si128();
+		}
+		
+		_encryptLanesAesNi(keys, rounds, blocks);
+		_applyLanesAesNi(blocks, lanes, laneCount);
+	}
+	
+	safeSetZero(blocks, sizeof (blocks));
+	safeSetZero(keys, sizeof (keys));
+}
+
+///
+/// \internal
+/// 
+/// \brief	The size from which a message of the multi key counter mode fills all lanes on its own and runs through the single key kernel.
+/// 
+/// \since	1.0
+///
+static constexpr size_t _multiKeyDirectSize = 4 * _aesNiLanes * AES_BLOCK_SIZE;
+
+///
+/// \internal
+/// 
+/// \brief	Tracks the message a lane of the multi key counter mode pipeline is working on.
+/// 
+/// \since	1.0
+///
+struct _MultiKeyLane
+{
+	size_t message;
+	size_t offset;
+	uint64_t counterHigh;
+	uint64_t counterLow;
+};
+
+__attribute__((target("aes,sse2")))
+static void _ctrMultiKeyAesNi(const uint8_t *roundKeys, const uint32_t rounds, const size_t keyCount, const Mode::CtrMessage *messages)
+{
+	const __m128i *keys = reinterpret_cast<const __m128i *>(roundKeys);
+	uint8_t messageKeys[AES_BLOCK_SIZE * (AES_256_ROUND_COUNT + 1)];
+	uint8_t counter[AES_BLOCK_SIZE];
+	__m128i blocks[_aesNiLanes];
+	_CtrLane lanes[_aesNiLanes];
+	_MultiKeyLane states[_aesNiLanes];
+	size_t laneKeys[_aesNiLanes];
+	size_t nextMessage = 0;
+	size_t busyLanes = _aesNiLanes;
+	
+	// Long messages keep all lanes busy with one key, which saves every lane from loading its own round keys
+	for (size_t message = 0; message < keyCount; message++)
+	{
+		if (messages[message].size >= _multiKeyDirectSize)
+		{
+			_gatherRoundKeys(roundKeys, rounds, keyCount, message, messageKeys);
+			memcpy(counter, messages[message].initializationVector, AES_BLOCK_SIZE);
+			_ctrAesNi<false>(messageKeys, rounds, counter, messages[message].input, messages[message].output, messages[message].size);
+		}
+	}
+	
+	for (size_t lane = 0; lane < _aesNiLanes; lane++)
+	{
+		states[lane] = {keyCount, 0, 0, 0};
+	}
+	
+	while (busyLanes != 0)
+	{
+		busyLanes = 0;
+		
+		for (size_t lane = 0; lane < _aesNiLanes; lane++)
+		{
+			_MultiKeyLane &state = states[lane];
+			
+			// A lane that finished its message takes over the next short one that is not empty
+			while (((state.message == keyCount) || (state.offset >= messages[state.message].size)
+					|| (messages[state.message].size >= _multiKeyDirectSize)) && (nextMessage < keyCount))
+			{
+				state.message = nextMessage++;
+				state.offset = 0;
+				memcpy(&state.counterHigh, messages[state.message].initializationVector, sizeof (state.counterHigh));
+				memcpy(&state.counterLow, messages[state.message].initializationVector + sizeof (state.counterHigh), sizeof (state.counterLow));
+				state.counterHigh = changeEndianness(state.counterHigh);
+				state.counterLow = changeEndianness(state.counterLow);
+			}
+			
+			if ((state.message != keyCount) && (state.offset < messages[state.message].size) && (messages[state.message].size < _multiKeyDirectSize))
+			{
+				const Mode::CtrMessage &current = messages[state.message];
+				
+				blocks[lane] = _nextCounterBlock(state.counterHigh, state.counterLow);
+				lanes[lane].input = current.input + state.offset;
+				lanes[lane].output = current.output + state.offset;
+				lanes[lane].size = ((current.size - state.offset) < AES_BLOCK_SIZE) ? (current.size - state.offset) : AES_BLOCK_SIZE;
+				laneKeys[lane] = state.message;
+				state.offset += AES_BLOCK_SIZE;
+				busyLanes++;
+			}
+			else
+			{
+				// Idle lanes encrypt a dummy block whose keystream is not applied anywhere
+				blocks[lane] = _mm_setzero_si128();
+				lanes[lane].size = 0;
+				laneKeys[lane] = 0;
+			}
+		}
+		
+		if (busyLanes != 0)
+		{
+			// Round major storage keeps the round keys of all lanes in a few neighbouring cache lines
+			for (size_t lane = 0; lane < _aesNiLanes; lane++)
+			{
+				blocks[lane] = _mm_xor_si128(blocks[lane], _mm_loadu_si128(keys + laneKeys[lane]));
+			}
+			
+			for (uint32_t round = 1; round < rounds; round++)
+			{
+				for (size_t lane = 0; lane < _aesNiLanes; lane++)
+				{
+					blocks[lane] = _mm_aesenc_si128(blocks[lane], _mm_loadu_si128(keys + round * keyCount + laneKeys[lane]));
+				}
+			}
+			
+			for (size_t lane = 0; lane < _aesNiLanes; lane++)
+			{
+				blocks[lane] = _mm_aesenclast_si128(blocks[lane], _mm_loadu_si128(keys + rounds * keyCount + laneKeys[lane]));
+			}
+			
+			_applyLanesAesNi(blocks, lanes, _aesNiLanes);
+		}
+	}
+	
+	safeSetZero(messageKeys, sizeof (messageKeys));
+	safeSetZero(counter, sizeof (counter));
+	safeSetZero(blocks, sizeof (blocks));
+	safeSetZero(states, sizeof (states));
+}
+
+static const Kernels _aesNiKernels = {
+	_encryptBlocksAesNi,
+	_decryptBlocksAesNi,
+	_ctrAesNi<false>,
+	_ctrAesNi<true>,
+	_ctrBatchAesNi,
+	_expandKeysAesNi,
+	_encryptBlocksMultiKeyAesNi,
+	_ctrMultiKeyAesNi,
+	"aesni"
+};
+#endif
+
+static const Kernels _genericKernels = {
+	_encryptBlocksGeneric,
+	_decryptBlocksGeneric,
+	_ctrGeneric,
+	_ctrGeneric,
+	_ctrBatchGeneric,
+	_expandKeysGeneric,
+	_encryptBlocksMultiKeyGeneric,
+	_ctrMultiKeyGeneric,
+	"generic"
+};
+
+static const Kernels &_fastestKernels()
+{
+#ifdef CRYPTO_ARCH_X86
+	if (Cpu::hasFeatures(Cpu::AesNi | Cpu::Ssse3 | Cpu::Sse2))
+	{
+		return _aesNiKernels;
+	}
+#endif
+	
+	return _genericKernels;
+}
+
+///
+/// \internal
+/// 
+/// \brief	Holds the kernels selected on first use, which only restrictFeatures() changes through selectKernels().
+/// 
+/// \since	1.0
+///
+static std::atomic<const Kernels *> &_selectedKernels()
+{
+	static std::atomic<const Kernels *> selectedKernels{&_fastestKernels()};
+	
+	return selectedKernels;
+}
+
+const Kernels &kernels()
+{
+	return *_selectedKernels().load(std::memory_order_relaxed);
+}
+
+void selectKernels()
+{
+	_selectedKernels().store(&_fastestKernels(), std::memory_order_relaxed);
+}
+
+const Kernels &genericKernels()
+{
+	return _genericKernels;
+}
+
+} // namespace Crypto::BlockCipher::Aes
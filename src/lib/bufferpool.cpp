@@ -0,0 +1,216 @@
+#include <fstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "bufferpool.h"
+#include "cryptoglobals.h"
+
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << 26)
+#endif
+
+namespace Crypto
+{
+
+static size_t _roundUp(const size_t value, const size_t multiple)
+{
+	return ((value + multiple - 1) / multiple) * multiple;
+}
+
+///
+/// \internal
+/// 
+/// \brief	Returns the number of possible NUMA nodes, which is one on systems without NUMA.
+/// 
+/// \since	1.0
+///
+static size_t _nodeCount()
+{
+	std::ifstream possible("/sys/devices/system/node/possible");
+	std::string nodes;
+	size_t returnValue = 1;
+	
+	// The list looks like "0" or "0-3"; the last number is the highest node
+	if (std::getline(possible, nodes) && !nodes.empty())
+	{
+		const size_t lastNumber = nodes.find_last_not_of("0123456789");
+		const std::string highestNode = (lastNumber == std::string::npos) ? nodes : nodes.substr(lastNumber + 1);
+		
+		returnValue = highestNode.empty() ? 1 : size_t(std::stoul(highestNode)) + 1;
+	}
+	
+	return returnValue;
+}
+
+static size_t _currentNode(const size_t nodeCount)
+{
+	unsigned cpu = 0;
+	unsigned node = 0;
+	
+	if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+	{
+		node = 0;
+	}
+	
+	return (size_t(node) < nodeCount) ? size_t(node) : 0;
+}
+
+///
+/// \internal
+/// 
+/// \brief	Maps \a size bytes aligned to BufferPool::hugePageSize from reserved huge pages or else with transparent huge pages.
+/// 
+/// \since	1.0
+///
+static uint8_t *_mapHugePages(const size_t size, bool &hugePages)
+{
+	const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+	void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB | MAP_POPULATE, -1, 0);
+	uint8_t *returnValue = nullptr;
+	
+	hugePages = (mapping != MAP_FAILED);
+	
+	if (hugePages)
+	{
+		returnValue = static_cast<uint8_t *>(mapping);
+	}
+	else
+	{
+		// Over-allocate to cut out a region aligned to the huge page size, which transparent huge pages require
+		mapping = mmap(nullptr, size + BufferPool::hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		
+		if (mapping != MAP_FAILED)
+		{
+			uint8_t *start = static_cast<uint8_t *>(mapping);
+			uint8_t *aligned = reinterpret_cast<uint8_t *>(_roundUp(reinterpret_cast<uintptr_t>(start), BufferPool::hugePageSize));
+			const size_t tail = size_t((start + size + BufferPool::hugePageSize) - (aligned + size));
+			
+			if (aligned != start)
+			{
+				munmap(start, size_t(aligned - start));
+			}
+			
+			if (tail != 0)
+			{
+				munmap(aligned + size, tail);
+			}
+			
+			madvise(aligned, size, MADV_HUGEPAGE);
+			
+			// Fault in every page from this thread, which places the memory on its NUMA node
+			for (size_t offset = 0; offset < size; offset += pageSize)
+			{
+				*reinterpret_cast<volatile uint8_t *>(aligned + offset) = 0;
+			}
+			
+			returnValue = aligned;
+		}
+	}
+	
+	return returnValue;
+}
+
+BufferPool::BufferPool(const size_t bufferSize, const bool zeroize, const size_t alignment) :
+	_bufferSize(bufferSize),
+	_slotSize(_roundUp(bufferSize, alignment)),
+	_slabSize(_roundUp(_roundUp(bufferSize, alignment), hugePageSize)),
+	_zeroize(zeroize)
+{
+	const size_t nodeCount = _nodeCount();
+	
+	for (size_t node = 0; node < nodeCount; node++)
+	{
+		this->_nodes.push_back(std::make_unique<_Node>());
+	}
+}
+
+BufferPool::~BufferPool()
+{
+	for (const _Slab &slab : this->_slabs)
+	{
+		munmap(slab.data, slab.size);
+	}
+}
+
+BufferPool::Lease BufferPool::lease()
+{
+	const size_t node = _currentNode(this->_nodes.size());
+	_Node &freeList = *this->_nodes[node];
+	std::lock_guard<std::mutex> lock(freeList.mutex);
+	Lease returnValue;
+	
+	if (!freeList.freeBuffers.empty() || this->_mapSlab(freeList))
+	{
+		returnValue = Lease(this, freeList.freeBuffers.back(), node);
+		freeList.freeBuffers.pop_back();
+	}
+	
+	return returnValue;
+}
+
+size_t BufferPool::bufferCount() const
+{
+	std::lock_guard<std::mutex> lock(this->_slabMutex);
+	
+	return this->_slabs.size() * (this->_slabSize / this->_slotSize);
+}
+
+size_t BufferPool::hugePageSlabCount() const
+{
+	std::lock_guard<std::mutex> lock(this->_slabMutex);
+	size_t returnValue = 0;
+	
+	for (const _Slab &slab : this->_slabs)
+	{
+		returnValue += slab.hugePages ? 1 : 0;
+	}
+	
+	return returnValue;
+}
+
+bool BufferPool::_mapSlab(_Node &node)
+{
+	_Slab slab;
+	
+	slab.size = this->_slabSize;
+	slab.data = _mapHugePages(slab.size, slab.hugePages);
+	
+	if (slab.data == nullptr)
+	{
+		ERROR("Failed to map buffer pool slab of " << slab.size << " bytes")
+	}
+	else
+	{
+		const size_t slotCount = this->_slabSize / this->_slotSize;
+		
+		{
+			std::lock_guard<std::mutex> lock(this->_slabMutex);
+			this->_slabs.push_back(slab);
+		}
+		
+		// Hand out low addresses first
+		for (size_t slot = slotCount; slot > 0; slot--)
+		{
+			node.freeBuffers.push_back(slab.data + (slot - 1) * this->_slotSize);
+		}
+	}
+	
+	return (slab.data != nullptr);
+}
+
+void BufferPool::_release(uint8_t *data, const size_t node)
+{
+	_Node &freeList = *this->_nodes[node];
+	
+	if (this->_zeroize)
+	{
+		safeSetZero(data, this->_bufferSize);
+	}
+	
+	std::lock_guard<std::mutex> lock(freeList.mutex);
+	freeList.freeBuffers.push_back(data);
+}
+
+} // namespace Crypto
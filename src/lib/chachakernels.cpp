@@ -0,0 +1,509 @@
+#include <atomic>
+#include <string.h>
+
+#include "chachakernels.h"
+#include "cpufeatures.h"
+#include "cryptoglobals.h"
+
+#ifdef CRYPTO_ARCH_X86
+#include <immintrin.h>
+#endif
+
+namespace Crypto::StreamCipher::ChaCha
+{
+
+static constexpr size_t _stateWords = 16;
+static constexpr size_t _doubleRounds = 10;
+
+static inline void _quarterRound(uint32_t &a, uint32_t &b, uint32_t &c, uint32_t &d)
+{
+	a += b;
+	d = rotateLeft(d ^ a, 16);
+	c += d;
+	b = rotateLeft(b ^ c, 12);
+	a += b;
+	d = rotateLeft(d ^ a, 8);
+	c += d;
+	b = rotateLeft(b ^ c, 7);
+}
+
+static void _xorBlocksGeneric(const uint32_t *state, const uint8_t *input, uint8_t *output, const size_t blockCount)
+{
+	uint32_t counter = state[12];
+	
+	for (size_t block = 0; block < blockCount; block++)
+	{
+		uint32_t x[_stateWords];
+		
+		memcpy(x, state, sizeof (x));
+		x[12] = counter;
+		
+		for (size_t round = 0; round < _doubleRounds; round++)
+		{
+			_quarterRound(x[0], x[4], x[8], x[12]);
+			_quarterRound(x[1], x[5], x[9], x[13]);
+			_quarterRound(x[2], x[6], x[10], x[14]);
+			_quarterRound(x[3], x[7], x[11], x[15]);
+			_quarterRound(x[0], x[5], x[10], x[15]);
+			_quarterRound(x[1], x[6], x[11], x[12]);
+			_quarterRound(x[2], x[7], x[8], x[13]);
+			_quarterRound(x[3], x[4], x[9], x[14]);
+		}
+		
+		// The keystream is serialized little endian independently of the host
+		for (size_t word = 0; word < _stateWords; word++)
+		{
+			const uint32_t value = x[word] + ((word == 12) ? counter : state[word]);
+			
+			for (size_t byte = 0; byte < sizeof (value); byte++)
+			{
+				output[word * 4 + byte] = input[word * 4 + byte] ^ uint8_t(value >> (8 * byte));
+			}
+		}
+		
+		safeSetZero(x, sizeof (x));
+		
+		counter++;
+		input += blockSize;
+		output += blockSize;
+	}
+}
+
+#ifdef CRYPTO_ARCH_X86
+///
+/// \internal
+/// 
+/// \brief	Continues the keystream of \a state \a blockOffset blocks later with the generic kernel.
+/// 
+/// \since	1.0
+///
+static void _xorRemainingBlocks(const uint32_t *state, const size_t blockOffset, const uint8_t *input, uint8_t *output, const size_t blockCount)
+{
+	uint32_t remainingState[_stateWords];
+	
+	memcpy(remainingState, state, sizeof (remainingState));
+	remainingState[12] += uint32_t(blockOffset);
+	_xorBlocksGeneric(remainingState, input + blockOffset * blockSize, output + blockOffset * blockSize, blockCount - blockOffset);
+	
+	safeSetZero(remainingState, sizeof (remainingState));
+}
+
+template <int bits>
+__attribute__((target("sse2")))
+static inline __m128i _rotateLeftSse2(const __m128i x)
+{
+	return _mm_or_si128(_mm_slli_epi32(x, bits), _mm_srli_epi32(x, 32 - bits));
+}
+
+__attribute__((target("sse2")))
+static inline void _quarterRoundSse2(__m128i &a, __m128i &b, __m128i &c, __m128i &d)
+{
+	a = _mm_add_epi32(a, b);
+	d = _rotateLeftSse2<16>(_mm_xor_si128(d, a));
+	c = _mm_add_epi32(c, d);
+	b = _rotateLeftSse2<12>(_mm_xor_si128(b, c));
+	a = _mm_add_epi32(a, b);
+	d = _rotateLeftSse2<8>(_mm_xor_si128(d, a));
+	c = _mm_add_epi32(c, d);
+	b = _rotateLeftSse2<7>(_mm_xor_si128(b, c));
+}
+
+///
+/// \internal
+/// 
+/// \brief	Transposes the words \a x of four blocks, one block per element, and XORs the blocks into \a input.
+/// 
+/// \since	1.0
+///
+__attribute__((target("sse2")))
+static inline void _storeBlocksSse2(const __m128i *x, const uint8_t *input, uint8_t *output)
+{
+	for (size_t group = 0; group < 4; group++)
+	{
+		const __m128i *words = x + group * 4;
+		const __m128i low01 = _mm_unpacklo_epi32(words[0], words[1]);
+		const __m128i low23 = _mm_unpacklo_epi32(words[2], words[3]);
+		const __m128i high01 = _mm_unpackhi_epi32(words[0], words[1]);
+		const __m128i high23 = _mm_unpackhi_epi32(words[2], words[3]);
+		const __m128i blocks[4] = {
+			_mm_unpacklo_epi64(low01, low23),
+			_mm_unpackhi_epi64(low01, low23),
+			_mm_unpacklo_epi64(high01, high23),
+			_mm_unpackhi_epi64(high01, high23)
+		};
+		
+		for (size_t block = 0; block < 4; block++)
+		{
+			const size_t offset = block * blockSize + group * 16;
+			const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + offset));
+			
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(output + offset), _mm_xor_si128(data, blocks[block]));
+		}
+	}
+}
+
+__attribute__((target("sse2")))
+static void _xorBlocksSse2(const uint32_t *state, const uint8_t *input, uint8_t *output, const size_t blockCount)
+{
+	constexpr size_t parallelBlocks = 4;
+	size_t block = 0;
+	
+	// Each 32 bit element of a vector belongs to another block
+	for (; (blockCount - block) >= parallelBlocks; block += parallelBlocks)
+	{
+		__m128i initial[_stateWords];
+		__m128i x[_stateWords];
+		
+		for (size_t word = 0; word < _stateWords; word++)
+		{
+			initial[word] = _mm_set1_epi32(int(state[word]));
+		}
+		
+		initial[12] = _mm_add_epi32(_mm_set1_epi32(int(state[12] + uint32_t(block))), _mm_setr_epi32(0, 1, 2, 3));
+		memcpy(x, initial, sizeof (x));
+		
+		for (size_t round = 0; round < _doubleRounds; round++)
+		{
+			_quarterRoundSse2(x[0], x[4], x[8], x[12]);
+			_quarterRoundSse2(x[1], x[5], x[9], x[13]);
+			_quarterRoundSse2(x[2], x[6], x[10], x[14]);
+			_quarterRoundSse2(x[3], x[7], x[11], x[15]);
+			_quarterRoundSse2(x[0], x[5], x[10], x[15]);
+			_quarterRoundSse2(x[1], x[6], x[11], x[12]);
+			_quarterRoundSse2(x[2], x[7], x[8], x[13]);
+			_quarterRoundSse2(x[3], x[4], x[9], x[14]);
+		}
+		
+		for (size_t word = 0; word < _stateWords; word++)
+		{
+			x[word] = _mm_add_epi32(x[word], initial[word]);
+		}
+		
+		_storeBlocksSse2(x, input + block * blockSize, output + block * blockSize);
+	}
+	
+	_xorRemainingBlocks(state, block, input, output, blockCount);
+}
+
+template <int bits>
+__attribute__((target("avx2")))
+static inline __m256i _rotateLeftAvx2(const __m256i x)
+{
+	return _mm256_or_si256(_mm256_slli_epi32(x, bits), _mm256_srli_epi32(x, 32 - bits));
+}
+
+__attribute__((target("avx2")))
+static inline void _quarterRoundAvx2(__m256i &a, __m256i &b, __m256i &c, __m256i &d, const __m256i rotate16, const __m256i rotate8)
+{
+	// Rotations by whole bytes are a single byte shuffle
+	a = _mm256_add_epi32(a, b);
+	d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rotate16);
+	c = _mm256_add_epi32(c, d);
+	b = _rotateLeftAvx2<12>(_mm256_xor_si256(b, c));
+	a = _mm256_add_epi32(a, b);
+	d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rotate8);
+	c = _mm256_add_epi32(c, d);
+	b = _rotateLeftAvx2<7>(_mm256_xor_si256(b, c));
+}
+
+///
+/// \internal
+/// 
+/// \brief	Transposes the words \a x of eight blocks, one block per element, and XORs the blocks into \a input.
+/// 
+/// \since	1.0
+///
+__attribute__((target("avx2")))
+static inline void _storeBlocksAvx2(const __m256i *x, const uint8_t *input, uint8_t *output)
+{
+	__m256i groups[4][4];
+	
+	// The unpack instructions transpose the four blocks of each 128 bit lane
+	for (size_t group = 0; group < 4; group++)
+	{
+		const __m256i *words = x + group * 4;
+		const __m256i low01 = _mm256_unpacklo_epi32(words[0], words[1]);
+		const __m256i low23 = _mm256_unpacklo_epi32(words[2], words[3]);
+		const __m256i high01 = _mm256_unpackhi_epi32(words[0], words[1]);
+		const __m256i high23 = _mm256_unpackhi_epi32(words[2], words[3]);
+		
+		groups[0][group] = _mm256_unpacklo_epi64(low01, low23);
+		groups[1][group] = _mm256_unpackhi_epi64(low01, low23);
+		groups[2][group] = _mm256_unpacklo_epi64(high01, high23);
+		groups[3][group] = _mm256_unpackhi_epi64(high01, high23);
+	}
+	
+	for (size_t block = 0; block < 4; block++)
+	{
+		const __m256i *words = groups[block];
+		const __m256i blocks[4] = {
+			_mm256_permute2x128_si256(words[0], words[1], 0x20),
+			_mm256_permute2x128_si256(words[2], words[3], 0x20),
+			_mm256_permute2x128_si256(words[0], words[1], 0x31),
+			_mm256_permute2x128_si256(words[2], words[3], 0x31)
+		};
+		
+		// The upper lanes hold the block four positions further
+		for (size_t half = 0; half < 4; half++)
+		{
+			const size_t offset = (block + (half / 2) * 4) * blockSize + (half % 2) * 32;
+			const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + offset));
+			
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(output + offset), _mm256_xor_si256(data, blocks[half]));
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+static void _xorBlocksAvx2(const uint32_t *state, const uint8_t *input, uint8_t *output, const size_t blockCount)
+{
+	constexpr size_t parallelBlocks = 8;
+	const __m256i rotate16 = _mm256_set_epi64x(0x0d0c0f0e09080b0all, 0x0504070601000302ll, 0x0d0c0f0e09080b0all, 0x0504070601000302ll);
+	const __m256i rotate8 = _mm256_set_epi64x(0x0e0d0c0f0a09080bll, 0x0605040702010003ll, 0x0e0d0c0f0a09080bll, 0x0605040702010003ll);
+	size_t block = 0;
+	
+	for (; (blockCount - block) >= parallelBlocks; block += parallelBlocks)
+	{
+		__m256i initial[_stateWords];
+		__m256i x[_stateWords];
+		
+		for (size_t word = 0; word < _stateWords; word++)
+		{
+			initial[word] = _mm256_set1_epi32(int(state[word]));
+		}
+		
+		initial[12] = _mm256_add_epi32(_mm256_set1_epi32(int(state[12] + uint32_t(block))), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		memcpy(x, initial, sizeof (x));
+		
+		for (size_t round = 0; round < _doubleRounds; round++)
+		{
+			_quarterRoundAvx2(x[0], x[4], x[8], x[12], rotate16, rotate8);
+			_quarterRoundAvx2(x[1], x[5], x[9], x[13], rotate16, rotate8);
+			_quarterRoundAvx2(x[2], x[6], x[10], x[14], rotate16, rotate8);
+			_quarterRoundAvx2(x[3], x[7], x[11], x[15], rotate16, rotate8);
+			_quarterRoundAvx2(x[0], x[5], x[10], x[15], rotate16, rotate8);
+			_quarterRoundAvx2(x[1], x[6], x[11], x[12], rotate16, rotate8);
+			_quarterRoundAvx2(x[2], x[7], x[8], x[13], rotate16, rotate8);
+			_quarterRoundAvx2(x[3], x[4], x[9], x[14], rotate16, rotate8);
+		}
+		
+		for (size_t word = 0; word < _stateWords; word++)
+		{
+			x[word] = _mm256_add_epi32(x[word], initial[word]);
+		}
+		
+		_storeBlocksAvx2(x, input + block * blockSize, output + block * blockSize);
+	}
+	
+	// Four remaining blocks still fill the narrower vectors
+	if ((blockCount - block) >= 4)
+	{
+		uint32_t remainingState[_stateWords];
+		
+		memcpy(remainingState, state, sizeof (remainingState));
+		remainingState[12] += uint32_t(block);
+		_xorBlocksSse2(remainingState, input + block * blockSize, output + block * blockSize, blockCount - block);
+		
+		safeSetZero(remainingState, sizeof (remainingState));
+	}
+	else
+	{
+		_xorRemainingBlocks(state, block, input, output, blockCount);
+	}
+}
+
+// GCC 12 warns about the deliberately undefined pass through operand inside its own AVX-512 intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+__attribute__((target("avx512f")))
+static inline void _quarterRoundAvx512(__m512i &a, __m512i &b, __m512i &c, __m512i &d)
+{
+	a = _mm512_add_epi32(a, b);
+	d = _mm512_rol_epi32(_mm512_xor_si512(d, a), 16);
+	c = _mm512_add_epi32(c, d);
+	b = _mm512_rol_epi32(_mm512_xor_si512(b, c), 12);
+	a = _mm512_add_epi32(a, b);
+	d = _mm512_rol_epi32(_mm512_xor_si512(d, a), 8);
+	c = _mm512_add_epi32(c, d);
+	b = _mm512_rol_epi32(_mm512_xor_si512(b, c), 7);
+}
+
+///
+/// \internal
+/// 
+/// \brief	Transposes the words \a x of sixteen blocks, one block per element, and XORs the blocks into \a input.
+/// 
+/// \since	1.0
+///
+__attribute__((target("avx512f")))
+static inline void _storeBlocksAvx512(const __m512i *x, const uint8_t *input, uint8_t *output)
+{
+	__m512i groups[4][4];
+	
+	for (size_t group = 0; group < 4; group++)
+	{
+		const __m512i *words = x + group * 4;
+		const __m512i low01 = _mm512_unpacklo_epi32(words[0], words[1]);
+		const __m512i low23 = _mm512_unpacklo_epi32(words[2], words[3]);
+		const __m512i high01 = _mm512_unpackhi_epi32(words[0], words[1]);
+		const __m512i high23 = _mm512_unpackhi_epi32(words[2], words[3]);
+		
+		groups[0][group] = _mm512_unpacklo_epi64(low01, low23);
+		groups[1][group] = _mm512_unpackhi_epi64(low01, low23);
+		groups[2][group] = _mm512_unpacklo_epi64(high01, high23);
+		groups[3][group] = _mm512_unpackhi_epi64(high01, high23);
+	}
+	
+	// Transposing the 128 bit lanes gathers the four word groups of each block
+	for (size_t block = 0; block < 4; block++)
+	{
+		const __m512i *words = groups[block];
+		const __m512i low01 = _mm512_shuffle_i32x4(words[0], words[1], 0x44);
+		const __m512i low23 = _mm512_shuffle_i32x4(words[2], words[3], 0x44);
+		const __m512i high01 = _mm512_shuffle_i32x4(words[0], words[1], 0xee);
+		const __m512i high23 = _mm512_shuffle_i32x4(words[2], words[3], 0xee);
+		const __m512i blocks[4] = {
+			_mm512_shuffle_i32x4(low01, low23, 0x88),
+			_mm512_shuffle_i32x4(low01, low23, 0xdd),
+			_mm512_shuffle_i32x4(high01, high23, 0x88),
+			_mm512_shuffle_i32x4(high01, high23, 0xdd)
+		};
+		
+		for (size_t lane = 0; lane < 4; lane++)
+		{
+			const size_t offset = (block + lane * 4) * blockSize;
+			const __m512i data = _mm512_loadu_si512(input + offset);
+			
+			_mm512_storeu_si512(output + offset, _mm512_xor_si512(data, blocks[lane]));
+		}
+	}
+}
+
+__attribute__((target("avx512f,avx2")))
+static void _xorBlocksAvx512(const uint32_t *state, const uint8_t *input, uint8_t *output, const size_t blockCount)
+{
+	constexpr size_t parallelBlocks = 16;
+	size_t block = 0;
+	
+	for (; (blockCount - block) >= parallelBlocks; block += parallelBlocks)
+	{
+		__m512i initial[_stateWords];
+		__m512i x[_stateWords];
+		
+		for (size_t word = 0; word < _stateWords; word++)
+		{
+			initial[word] = _mm512_set1_epi32(int(state[word]));
+		}
+		
+		initial[12] = _mm512_add_epi32(_mm512_set1_epi32(int(state[12] + uint32_t(block))), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+		memcpy(x, initial, sizeof (x));
+		
+		for (size_t round = 0; round < _doubleRounds; round++)
+		{
+			_quarterRoundAvx512(x[0], x[4], x[8], x[12]);
+			_quarterRoundAvx512(x[1], x[5], x[9], x[13]);
+			_quarterRoundAvx512(x[2], x[6], x[10], x[14]);
+			_quarterRoundAvx512(x[3], x[7], x[11], x[15]);
+			_quarterRoundAvx512(x[0], x[5], x[10], x[15]);
+			_quarterRoundAvx512(x[1], x[6], x[11], x[12]);
+			_quarterRoundAvx512(x[2], x[7], x[8], x[13]);
+			_quarterRoundAvx512(x[3], x[4], x[9], x[14]);
+		}
+		
+		for (size_t word = 0; word < _stateWords; word++)
+		{
+			x[word] = _mm512_add_epi32(x[word], initial[word]);
+		}
+		
+		_storeBlocksAvx512(x, input + block * blockSize, output + block * blockSize);
+	}
+	
+	uint32_t remainingState[_stateWords];
+	
+	memcpy(remainingState, state, sizeof (remainingState));
+	remainingState[12] += uint32_t(block);
+	_xorBlocksAvx2(remainingState, input + block * blockSize, output + block * blockSize, blockCount - block);
+	
+	safeSetZero(remainingState, sizeof (remainingState));
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+static const Kernels _avx512Kernels = {
+	_xorBlocksAvx512,
+	"avx512f"
+};
+
+static const Kernels _avx2Kernels = {
+	_xorBlocksAvx2,
+	"avx2"
+};
+
+static const Kernels _sse2Kernels = {
+	_xorBlocksSse2,
+	"sse2"
+};
+#endif
+
+static const Kernels _genericKernels = {
+	_xorBlocksGeneric,
+	"generic"
+};
+
+static const Kernels &_fastestKernels()
+{
+#ifdef CRYPTO_ARCH_X86
+	if (Cpu::hasFeatures(Cpu::Avx512f | Cpu::Avx2))
+	{
+		return _avx512Kernels;
+	}
+	
+	if (Cpu::hasFeatures(Cpu::Avx2))
+	{
+		return _avx2Kernels;
+	}
+	
+	if (Cpu::hasFeatures(Cpu::Sse2))
+	{
+		return _sse2Kernels;
+	}
+#endif
+	
+	return _genericKernels;
+}
+
+///
+/// \internal
+/// 
+/// \brief	Holds the kernels selected on first use, which only restrictFeatures() changes through selectKernels().
+/// 
+/// \since	1.0
+///
+static std::atomic<const Kernels *> &_selectedKernels()
+{
+	static std::atomic<const Kernels *> selectedKernels{&_fastestKernels()};
+	
+	return selectedKernels;
+}
+
+const Kernels &kernels()
+{
+	return *_selectedKernels().load(std::memory_order_relaxed);
+}
+
+void selectKernels()
+{
+	_selectedKernels().store(&_fastestKernels(), std::memory_order_relaxed);
+}
+
+const Kernels &genericKernels()
+{
+	return _genericKernels;
+}
+
+} // namespace Crypto::StreamCipher::ChaCha
@@ -0,0 +1,372 @@
+#include <string.h>
+
+#include "chunkedcontainer.h"
+#include "cryptoglobals.h"
+#include "ctrmode.h"
+#include "hmac.h"
+#include "sha2digest.h"
+
+namespace Crypto::Container
+{
+
+using Hmac = Hash::Hmac<Hash::Sha2::Digest256>;
+using Ctr = Mode::Ctr<BlockCipher::Aes::Block256>;
+
+static const uint8_t _magic[8] = {'C', 'R', 'Y', 'P', 'T', 'O', 'C', '1'};
+static constexpr uint32_t _version = 1;
+
+static inline void _storeBigEndian(uint8_t *destination, const uint64_t value)
+{
+	const uint64_t bigEndianValue = changeEndianness(value);
+	
+	memcpy(destination, &bigEndianValue, sizeof (bigEndianValue));
+}
+
+static inline void _storeBigEndian(uint8_t *destination, const uint32_t value)
+{
+	const uint32_t bigEndianValue = changeEndianness(value);
+	
+	memcpy(destination, &bigEndianValue, sizeof (bigEndianValue));
+}
+
+template <typename IntegerType>
+static inline IntegerType _loadBigEndian(const uint8_t *source)
+{
+	IntegerType value = 0;
+	
+	memcpy(&value, source, sizeof (value));
+	
+	return changeEndianness(value);
+}
+
+static bool _equalTags(const uint8_t *tag, const uint8_t *otherTag)
+{
+	// Constant time comparison
+	uint8_t difference = 0;
+	
+	for (size_t byte = 0; byte < tagSize; byte++)
+	{
+		difference |= tag[byte] ^ otherTag[byte];
+	}
+	
+	return (difference == 0);
+}
+
+static void _deriveKeys(const BlockCipher::Aes256Key &masterKey, const uint8_t *objectNonce, uint8_t *encryptionKey, uint8_t *macKey)
+{
+	uint8_t label[nonceSize + 1];
+	
+	memcpy(label, objectNonce, nonceSize);
+	
+	label[nonceSize] = 0x01;
+	Hmac::compute(masterKey.key, AES_256_KEY_SIZE, label, sizeof (label), encryptionKey);
+	
+	label[nonceSize] = 0x02;
+	Hmac::compute(masterKey.key, AES_256_KEY_SIZE, label, sizeof (label), macKey);
+}
+
+static void _chunkTag(const uint8_t *macKey, const uint64_t chunk, const uint8_t *ciphertext, const size_t size, uint8_t *tag)
+{
+	uint8_t chunkIndex[sizeof (uint64_t)];
+	Hmac hmac(macKey, tagSize);
+	
+	_storeBigEndian(chunkIndex, chunk);
+	hmac.update(chunkIndex, sizeof (chunkIndex));
+	hmac.update(ciphertext, size);
+	hmac.finalize(tag);
+}
+
+static void _rootTag(const uint8_t *macKey, const uint8_t *header, const std::vector<uint8_t> &tags, const uint8_t *trailer, uint8_t *tag)
+{
+	Hmac hmac(macKey, tagSize);
+	
+	hmac.update(header, headerSize);
+	hmac.update(tags.data(), tags.size());
+	hmac.update(trailer, trailerSize - tagSize);
+	hmac.finalize(tag);
+}
+
+static void _chunkCounter(const uint64_t chunk, uint8_t *counter)
+{
+	_storeBigEndian(counter, chunk);
+	memset(counter + sizeof (uint64_t), 0, AES_BLOCK_SIZE - sizeof (uint64_t));
+}
+
+Writer::Writer(std::ostream &stream, const BlockCipher::Aes256Key &masterKey, const uint8_t *objectNonce, const uint32_t chunkSize,
+		const size_t batchChunks) :
+	_stream(stream),
+	_chunkSize(chunkSize),
+	_batchChunks((batchChunks != 0) ? batchChunks : 1)
+{
+	uint8_t encryptionKey[AES_256_KEY_SIZE];
+	
+	_deriveKeys(masterKey, objectNonce, encryptionKey, this->_macKey);
+	this->_schedule = std::make_unique<BlockCipher::Aes::KeySchedule256>(encryptionKey);
+	safeSetZero(encryptionKey, sizeof (encryptionKey));
+	
+	memset(this->_header, 0, headerSize);
+	memcpy(this->_header, _magic, sizeof (_magic));
+	_storeBigEndian(this->_header + 8, _version);
+	_storeBigEndian(this->_header + 12, chunkSize);
+	memcpy(this->_header + 16, objectNonce, nonceSize);
+	
+	if (chunkSize == 0)
+	{
+		ERROR("Container chunk size must not be zero")
+		this->_finished = true;
+	}
+	else
+	{
+		this->_buffer.resize(size_t(chunkSize) * this->_batchChunks);
+		this->_ciphertext.resize(this->_buffer.size());
+		this->_stream.write(reinterpret_cast<const char *>(this->_header), headerSize);
+	}
+}
+
+Writer::~Writer()
+{
+	safeSetZero(this->_macKey, sizeof (this->_macKey));
+	safeSetZero(this->_buffer.data(), this->_buffer.size());
+}
+
+bool Writer::write(const uint8_t *data, size_t size)
+{
+	bool returnValue = !this->_finished;
+	
+	while (returnValue && (size != 0))
+	{
+		const size_t bytes = ((this->_buffer.size() - this->_bufferSize) < size) ? (this->_buffer.size() - this->_bufferSize) : size;
+		
+		memcpy(this->_buffer.data() + this->_bufferSize, data, bytes);
+		this->_bufferSize += bytes;
+		data += bytes;
+		size -= bytes;
+		
+		if (this->_bufferSize == this->_buffer.size())
+		{
+			returnValue = this->_flush(this->_bufferSize);
+		}
+	}
+	
+	return returnValue;
+}
+
+bool Writer::finish()
+{
+	bool returnValue = !this->_finished;
+	
+	if (returnValue && (this->_bufferSize != 0))
+	{
+		returnValue = this->_flush(this->_bufferSize);
+	}
+	
+	if (returnValue)
+	{
+		uint8_t trailer[trailerSize];
+		
+		_storeBigEndian(trailer, uint64_t(this->_tags.size() / tagSize));
+		_storeBigEndian(trailer + sizeof (uint64_t), this->_size);
+		_rootTag(this->_macKey, this->_header, this->_tags, trailer, trailer + trailerSize - tagSize);
+		
+		this->_stream.write(reinterpret_cast<const char *>(this->_tags.data()), std::streamsize(this->_tags.size()));
+		this->_stream.write(reinterpret_cast<const char *>(trailer), trailerSize);
+		this->_stream.flush();
+		
+		returnValue = this->_stream.good();
+	}
+	
+	this->_finished = true;
+	
+	return returnValue;
+}
+
+bool Writer::_flush(const size_t size)
+{
+	const size_t chunkCount = (size + this->_chunkSize - 1) / this->_chunkSize;
+	const uint64_t firstChunk = this->_tags.size() / tagSize;
+	
+	this->_tags.resize(this->_tags.size() + chunkCount * tagSize);
+	
+	uint8_t *tags = this->_tags.data() + firstChunk * tagSize;
+	
+	// Chunks only depend on their index, so they are encrypted and authenticated independently
+#pragma omp parallel for schedule(static) if (chunkCount > 1)
+	for (size_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		const size_t offset = chunk * this->_chunkSize;
+		const size_t bytes = ((size - offset) < this->_chunkSize) ? (size - offset) : this->_chunkSize;
+		uint8_t counter[AES_BLOCK_SIZE];
+		
+		_chunkCounter(firstChunk + chunk, counter);
+		Ctr::encrypt(*this->_schedule, counter, this->_buffer.data() + offset, bytes, this->_ciphertext.data() + offset);
+		_chunkTag(this->_macKey, firstChunk + chunk, this->_ciphertext.data() + offset, bytes, tags + chunk * tagSize);
+	}
+	
+	this->_stream.write(reinterpret_cast<const char *>(this->_ciphertext.data()), std::streamsize(size));
+	this->_size += size;
+	this->_bufferSize = 0;
+	
+	return this->_stream.good();
+}
+
+Reader::Reader(std::istream &stream, const BlockCipher::Aes256Key &masterKey) :
+	_stream(stream)
+{
+	uint8_t header[headerSize] = {};
+	uint8_t trailer[trailerSize] = {};
+	
+	this->_stream.seekg(0, std::ios::end);
+	const std::streamoff streamSize = this->_stream.tellg();
+	
+	if (streamSize >= std::streamoff(headerSize + trailerSize))
+	{
+		this->_stream.seekg(0);
+		this->_stream.read(reinterpret_cast<char *>(header), headerSize);
+		this->_stream.seekg(streamSize - std::streamoff(trailerSize));
+		this->_stream.read(reinterpret_cast<char *>(trailer), trailerSize);
+	}
+	
+	const uint32_t chunkSize = _loadBigEndian<uint32_t>(header + 12);
+	const uint64_t chunkCount = _loadBigEndian<uint64_t>(trailer);
+	const uint64_t size = _loadBigEndian<uint64_t>(trailer + sizeof (uint64_t));
+	
+	// Reject anything whose layout does not add up before trusting any field
+	if (!this->_stream.good() || (streamSize < std::streamoff(headerSize + trailerSize)) || (memcmp(header, _magic, sizeof (_magic)) != 0) ||
+			(_loadBigEndian<uint32_t>(header + 8) != _version) || (chunkSize == 0) || (size > uint64_t(streamSize)) ||
+			(chunkCount != ((size + chunkSize - 1) / chunkSize)) ||
+			(uint64_t(streamSize) != (headerSize + size + chunkCount * tagSize + trailerSize)))
+	{
+		ERROR("Malformed container")
+		this->_stream.clear();
+	}
+	else
+	{
+		uint8_t rootTag[tagSize];
+		uint8_t encryptionKey[AES_256_KEY_SIZE];
+		
+		this->_tags.resize(chunkCount * tagSize);
+		this->_stream.seekg(std::streamoff(headerSize + size));
+		this->_stream.read(reinterpret_cast<char *>(this->_tags.data()), std::streamsize(this->_tags.size()));
+		
+		_deriveKeys(masterKey, header + 16, encryptionKey, this->_macKey);
+		_rootTag(this->_macKey, header, this->_tags, trailer, rootTag);
+		
+		if (this->_stream.good() && _equalTags(rootTag, trailer + trailerSize - tagSize))
+		{
+			this->_schedule = std::make_unique<BlockCipher::Aes::KeySchedule256>(encryptionKey);
+			this->_chunkSize = chunkSize;
+			this->_chunkCount = chunkCount;
+			this->_size = size;
+		}
+		else
+		{
+			ERROR("Container is not authentic")
+			safeSetZero(this->_macKey, sizeof (this->_macKey));
+			this->_tags.clear();
+			this->_stream.clear();
+		}
+		
+		safeSetZero(encryptionKey, sizeof (encryptionKey));
+	}
+}
+
+Reader::~Reader()
+{
+	safeSetZero(this->_macKey, sizeof (this->_macKey));
+}
+
+bool Reader::readChunks(const uint64_t firstChunk, const uint64_t count, uint8_t *plaintext)
+{
+	bool returnValue = this->isValid() && (firstChunk <= this->_chunkCount) && (count <= (this->_chunkCount - firstChunk));
+	
+	if (returnValue && (count != 0))
+	{
+		const uint64_t offset = firstChunk * this->_chunkSize;
+		const uint64_t remainingBytes = this->_size - offset;
+		const size_t size = size_t((remainingBytes < (count * this->_chunkSize)) ? remainingBytes : (count * this->_chunkSize));
+		
+		this->_ciphertext.resize(size);
+		this->_stream.seekg(std::streamoff(headerSize + offset));
+		this->_stream.read(reinterpret_cast<char *>(this->_ciphertext.data()), std::streamsize(size));
+		returnValue = this->_stream.good();
+		
+		if (returnValue)
+		{
+			bool authentic = true;
+
+#pragma omp parallel for schedule(static) reduction(&&: authentic) if (count > 1)
+			for (uint64_t chunk = 0; chunk < count; chunk++)
+			{
+				const size_t chunkOffset = size_t(chunk) * this->_chunkSize;
+				const size_t bytes = ((size - chunkOffset) < this->_chunkSize) ? (size - chunkOffset) : this->_chunkSize;
+				uint8_t tag[tagSize];
+				
+				_chunkTag(this->_macKey, firstChunk + chunk, this->_ciphertext.data() + chunkOffset, bytes, tag);
+				
+				if (_equalTags(tag, this->_tags.data() + (firstChunk + chunk) * tagSize))
+				{
+					uint8_t counter[AES_BLOCK_SIZE];
+					
+					_chunkCounter(firstChunk + chunk, counter);
+					Ctr::decrypt(*this->_schedule, counter, this->_ciphertext.data() + chunkOffset, bytes, plaintext + chunkOffset);
+				}
+				else
+				{
+					authentic = false;
+				}
+			}
+			
+			if (!authentic)
+			{
+				ERROR("Container chunk is not authentic")
+				safeSetZero(plaintext, size);
+				returnValue = false;
+			}
+		}
+		else
+		{
+			this->_stream.clear();
+		}
+	}
+	
+	return returnValue;
+}
+
+bool Reader::read(const uint64_t offset, const size_t size, uint8_t *plaintext)
+{
+	bool returnValue = this->isValid() && (offset <= this->_size) && (size <= (this->_size - offset));
+	
+	if (returnValue && (size != 0))
+	{
+		const uint64_t firstChunk = offset / this->_chunkSize;
+		const uint64_t lastChunk = (offset + size - 1) / this->_chunkSize;
+		const size_t skippedBytes = size_t(offset - firstChunk * this->_chunkSize);
+		
+		if ((skippedBytes == 0) && (((offset + size) % this->_chunkSize == 0) || ((offset + size) == this->_size)))
+		{
+			// Whole chunks are decrypted directly into the destination
+			returnValue = this->readChunks(firstChunk, lastChunk - firstChunk + 1, plaintext);
+		}
+		else
+		{
+			std::vector<uint8_t> chunks(size_t(lastChunk - firstChunk + 1) * this->_chunkSize);
+			
+			returnValue = this->readChunks(firstChunk, lastChunk - firstChunk + 1, chunks.data());
+			
+			if (returnValue)
+			{
+				memcpy(plaintext, chunks.data() + skippedBytes, size);
+			}
+			else
+			{
+				safeSetZero(plaintext, size);
+			}
+			
+			safeSetZero(chunks.data(), chunks.size());
+		}
+	}
+	
+	return returnValue;
+}
+
+} // namespace Crypto::Container
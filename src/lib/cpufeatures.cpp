@@ -0,0 +1,179 @@
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aeskernels.h"
+#include "chachakernels.h"
+#include "cpufeatures.h"
+#include "cryptoglobals.h"
+#include "sha2kernels.h"
+
+#ifdef CRYPTO_ARCH_X86
+#include <cpuid.h>
+#endif
+
+namespace Crypto::Cpu
+{
+
+static constexpr Feature _allFeatures[] = {Sse2, Ssse3, Sse41, AesNi, Pclmul, Avx, Avx2, Avx512f, Sha};
+
+static uint32_t _detectFeatures()
+{
+	uint32_t returnValue = 0;
+	
+#ifdef CRYPTO_ARCH_X86
+	uint32_t eax = 0;
+	uint32_t ebx = 0;
+	uint32_t ecx = 0;
+	uint32_t edx = 0;
+	
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+	{
+		returnValue |= (edx & bit_SSE2) ? uint32_t(Sse2) : 0u;
+		returnValue |= (ecx & bit_SSSE3) ? uint32_t(Ssse3) : 0u;
+		returnValue |= (ecx & bit_SSE4_1) ? uint32_t(Sse41) : 0u;
+		returnValue |= (ecx & bit_AES) ? uint32_t(AesNi) : 0u;
+		returnValue |= (ecx & bit_PCLMUL) ? uint32_t(Pclmul) : 0u;
+		
+		// AVX state must be enabled by the operating system
+		const bool osxsave = (ecx & bit_OSXSAVE);
+		uint64_t xcr0 = 0;
+		
+		if (osxsave)
+		{
+			uint32_t xcr0Low = 0;
+			uint32_t xcr0High = 0;
+			
+			__asm__ ("xgetbv" : "=a" (xcr0Low), "=d" (xcr0High) : "c" (0));
+			xcr0 = (uint64_t(xcr0High) << 32) | xcr0Low;
+		}
+		
+		const bool avxState = ((xcr0 & 0x06) == 0x06);
+		const bool avx512State = ((xcr0 & 0xe6) == 0xe6);
+		
+		returnValue |= ((ecx & bit_AVX) && avxState) ? uint32_t(Avx) : 0u;
+		
+		if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		{
+			returnValue |= ((ebx & bit_AVX2) && avxState) ? uint32_t(Avx2) : 0u;
+			returnValue |= ((ebx & bit_AVX512F) && avx512State) ? uint32_t(Avx512f) : 0u;
+			returnValue |= (ebx & bit_SHA) ? uint32_t(Sha) : 0u;
+		}
+	}
+#endif
+	
+	return returnValue;
+}
+
+static uint32_t _parseFeatures(const char *list)
+{
+	uint32_t returnValue = 0;
+	
+	while (*list != '\0')
+	{
+		const char *end = strchr(list, ',');
+		const size_t length = (end == nullptr) ? strlen(list) : size_t(end - list);
+		
+		for (const Feature feature : _allFeatures)
+		{
+			if ((strlen(featureName(feature)) == length) && (strncmp(featureName(feature), list, length) == 0))
+			{
+				returnValue |= feature;
+			}
+		}
+		
+		list += length;
+		
+		if (*list == ',')
+		{
+			list++;
+		}
+	}
+	
+	return returnValue;
+}
+
+static uint32_t _initialFeatures()
+{
+	uint32_t returnValue = detectedFeatures();
+	const char *restriction = getenv("CRYPTO_CPU_FEATURES");
+	
+	if (restriction != nullptr)
+	{
+		returnValue &= _parseFeatures(restriction);
+		INFO("CPU features restricted to 0x" << std::hex << returnValue)
+	}
+	
+	return returnValue;
+}
+
+static std::atomic<uint32_t> &_features()
+{
+	static std::atomic<uint32_t> features{_initialFeatures()};
+	
+	return features;
+}
+
+uint32_t detectedFeatures()
+{
+	static const uint32_t features = _detectFeatures();
+	
+	return features;
+}
+
+uint32_t features()
+{
+	return _features().load(std::memory_order_relaxed);
+}
+
+void restrictFeatures(const uint32_t featureMask)
+{
+	_features().store(detectedFeatures() & featureMask, std::memory_order_relaxed);
+	
+	// The kernel tables are only resolved again here, not on every use
+	BlockCipher::Aes::selectKernels();
+	Hash::Sha2::selectKernels();
+	StreamCipher::ChaCha::selectKernels();
+}
+
+const char *featureName(const Feature feature)
+{
+	const char *returnValue = "";
+	
+	switch (feature)
+	{
+		case Sse2:
+			returnValue = "sse2";
+			break;
+		case Ssse3:
+			returnValue = "ssse3";
+			break;
+		case Sse41:
+			returnValue = "sse4.1";
+			break;
+		case AesNi:
+			returnValue = "aesni";
+			break;
+		case Pclmul:
+			returnValue = "pclmul";
+			break;
+		case Avx:
+			returnValue = "avx";
+			break;
+		case Avx2:
+			returnValue = "avx2";
+			break;
+		case Avx512f:
+			returnValue = "avx512f";
+			break;
+		case Sha:
+			returnValue = "sha";
+			break;
+		case AllFeatures:
+			break;
+	}
+	
+	return returnValue;
+}
+
+} // namespace Crypto::Cpu
@@ -0,0 +1,49 @@
+#include <atomic>
+#include <iostream>
+
+#include "cryptolog.h"
+
+namespace Crypto::Log
+{
+
+static std::atomic<Sink> _sink{defaultSink};
+
+void defaultSink(const Level level, const std::string &message)
+{
+	const char *prefix = "";
+	
+	switch (level)
+	{
+		case Level::Error:
+			prefix = "[\x1B[31mERROR\x1B[0m]	";
+			break;
+		case Level::Warn:
+			prefix = "[\x1B[33mWARN\x1B[0m]	";
+			break;
+		case Level::Info:
+			prefix = "[\x1B[34mINFO\x1B[0m]	";
+			break;
+		case Level::Debug:
+			prefix = "[\x1B[36mDEBUG\x1B[0m]	";
+			break;
+	}
+	
+	std::cout << prefix << message << std::endl;
+}
+
+void setSink(Sink sink)
+{
+	_sink.store(sink, std::memory_order_release);
+}
+
+void write(const Level level, const std::string &message)
+{
+	Sink sink = _sink.load(std::memory_order_acquire);
+	
+	if (sink != nullptr)
+	{
+		sink(level, message);
+	}
+}
+
+} // namespace Crypto::Log
@@ -0,0 +1,50 @@
+#include <atomic>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/random.h>
+
+#include "ctrdrbg.h"
+
+namespace Crypto::Random
+{
+
+static std::atomic<uint64_t> _forkGeneration(0);
+
+static void _childAfterFork()
+{
+	_forkGeneration.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool readSystemEntropy(uint8_t *buffer, const size_t size)
+{
+	size_t read = 0;
+	bool failed = false;
+	
+	// Requests above 256 bytes may be interrupted after a partial read
+	while ((read < size) && !failed)
+	{
+		const ssize_t result = getrandom(buffer + read, size - read, 0);
+		
+		if (result > 0)
+		{
+			read += size_t(result);
+		}
+		else
+		{
+			failed = (result == 0) || (errno != EINTR);
+		}
+	}
+	
+	return !failed;
+}
+
+uint64_t forkGeneration()
+{
+	static const bool registered = (pthread_atfork(nullptr, nullptr, _childAfterFork) == 0);
+	
+	CRYPTO_UNUSED(registered)
+	
+	return _forkGeneration.load(std::memory_order_relaxed);
+}
+
+} // namespace Crypto::Random
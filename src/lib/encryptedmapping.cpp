@@ -0,0 +1,348 @@
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/userfaultfd.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cryptoglobals.h"
+#include "encryptedmapping.h"
+#include "fileio.h"
+
+namespace Crypto::Mode
+{
+
+static size_t _roundUp(const size_t value, const size_t multiple)
+{
+	return ((value + multiple - 1) / multiple) * multiple;
+}
+
+static int _openFaultFd(const uint64_t features)
+{
+	uffdio_api api;
+	int fd = int(syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK));
+	
+	memset(&api, 0, sizeof (api));
+	api.api = UFFD_API;
+	api.features = features;
+	
+	// The handshake fails if a requested feature is not supported
+	if ((fd >= 0) && (ioctl(fd, UFFDIO_API, &api) != 0))
+	{
+		close(fd);
+		fd = -1;
+	}
+	
+	return fd;
+}
+
+static bool _register(const int faultFd, uint8_t *data, const size_t size, const bool writeProtect)
+{
+	uffdio_register registration;
+	
+	memset(&registration, 0, sizeof (registration));
+	registration.range.start = uint64_t(reinterpret_cast<uintptr_t>(data));
+	registration.range.len = size;
+	registration.mode = UFFDIO_REGISTER_MODE_MISSING | (writeProtect ? UFFDIO_REGISTER_MODE_WP : 0);
+	
+	return (ioctl(faultFd, UFFDIO_REGISTER, &registration) == 0) && ((registration.ioctls & (uint64_t(1) << _UFFDIO_COPY)) != 0);
+}
+
+static void _setWriteProtection(const int faultFd, uint8_t *page, const size_t pageSize, const bool protect)
+{
+	uffdio_writeprotect protection;
+	
+	memset(&protection, 0, sizeof (protection));
+	protection.range.start = uint64_t(reinterpret_cast<uintptr_t>(page));
+	protection.range.len = pageSize;
+	protection.mode = protect ? UFFDIO_WRITEPROTECT_MODE_WP : 0;
+	
+	// Removing the protection also wakes the faulting thread
+	ioctl(faultFd, UFFDIO_WRITEPROTECT, &protection);
+}
+
+EncryptedMapping::EncryptedMapping(const int fd, const bool writable, Transform transform) :
+	_fd(fd),
+	_writable(writable),
+	_failed(false),
+	_transform(std::move(transform))
+{
+	struct stat status;
+	
+	this->_pageSize = size_t(sysconf(_SC_PAGESIZE));
+	
+	if ((fstat(fd, &status) != 0) || !S_ISREG(status.st_mode) || (status.st_size == 0))
+	{
+		ERROR("Encrypted mapping requires a regular file that is not empty")
+	}
+	else
+	{
+		this->_size = size_t(status.st_size);
+		this->_mappingSize = _roundUp(this->_size, this->_pageSize);
+		
+		// Writable mappings track modified pages by write protection where the kernel supports it
+		this->_writeProtect = writable;
+		this->_faultFd = writable ? _openFaultFd(UFFD_FEATURE_PAGEFAULT_FLAG_WP) : -1;
+		
+		if (this->_faultFd < 0)
+		{
+			this->_writeProtect = false;
+			this->_faultFd = _openFaultFd(0);
+		}
+		
+		this->_stopFd = eventfd(0, EFD_CLOEXEC);
+		
+		void *mapping = ((this->_faultFd >= 0) && (this->_stopFd >= 0)) ? mmap(nullptr, this->_mappingSize,
+				writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0) : MAP_FAILED;
+		
+		if ((this->_faultFd < 0) || (this->_stopFd < 0))
+		{
+			ERROR("userfaultfd is not available")
+		}
+		else if (mapping == MAP_FAILED)
+		{
+			ERROR("Failed to map " << this->_mappingSize << " bytes")
+		}
+		else
+		{
+			uint8_t *data = static_cast<uint8_t *>(mapping);
+			
+			// Pages are installed one at a time, and like the secure arena the plaintext is kept out of core dumps
+			madvise(mapping, this->_mappingSize, MADV_NOHUGEPAGE);
+			madvise(mapping, this->_mappingSize, MADV_DONTDUMP);
+			
+			bool registered = _register(this->_faultFd, data, this->_mappingSize, this->_writeProtect);
+			
+			if (!registered && this->_writeProtect)
+			{
+				this->_writeProtect = false;
+				registered = _register(this->_faultFd, data, this->_mappingSize, false);
+			}
+			
+			if (!registered)
+			{
+				ERROR("Failed to register the mapping with userfaultfd")
+				munmap(mapping, this->_mappingSize);
+			}
+			else
+			{
+				if (writable && !this->_writeProtect)
+				{
+					WARN("Write protection is not supported; sync() writes back all loaded pages")
+				}
+				
+				this->_data = data;
+				this->_pageStates.assign(this->_mappingSize / this->_pageSize, _PageState::Missing);
+				this->_handler = std::thread(&EncryptedMapping::_handleFaults, this);
+			}
+		}
+	}
+}
+
+EncryptedMapping::~EncryptedMapping()
+{
+	if (this->_data != nullptr)
+	{
+		const uint64_t stop = 1;
+		
+		if (this->_writable)
+		{
+			this->sync();
+		}
+		
+		if (write(this->_stopFd, &stop, sizeof (stop)) == sizeof (stop))
+		{
+			this->_handler.join();
+		}
+		else
+		{
+			this->_handler.detach();
+		}
+		
+		munmap(this->_data, this->_mappingSize);
+	}
+	
+	if (this->_stopFd >= 0)
+	{
+		close(this->_stopFd);
+	}
+	
+	if (this->_faultFd >= 0)
+	{
+		close(this->_faultFd);
+	}
+}
+
+size_t EncryptedMapping::loadedPages() const
+{
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	size_t returnValue = 0;
+	
+	for (const _PageState state : this->_pageStates)
+	{
+		returnValue += ((state == _PageState::Clean) || (state == _PageState::Dirty)) ? 1 : 0;
+	}
+	
+	return returnValue;
+}
+
+bool EncryptedMapping::sync()
+{
+	std::vector<uint8_t> buffer(this->_pageSize);
+	bool returnValue = this->isValid() && this->_writable;
+	
+	for (size_t page = 0; returnValue && (page < this->_pageStates.size()); page++)
+	{
+		const uint64_t offset = uint64_t(page) * this->_pageSize;
+		const size_t size = ((this->_size - offset) < this->_pageSize) ? size_t(this->_size - offset) : this->_pageSize;
+		bool modified = false;
+		
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			// Without write protection every loaded page may have been modified; a page that failed to load is never written back, since
+			// its zeros would replace the real content of the file
+			modified = (this->_pageStates[page] == _PageState::Dirty) || (!this->_writeProtect && (this->_pageStates[page] == _PageState::Clean));
+			
+			// Protect before copying, so every later write faults and marks the page again
+			if (modified && this->_writeProtect)
+			{
+				this->_pageStates[page] = _PageState::Clean;
+				_setWriteProtection(this->_faultFd, this->_data + offset, this->_pageSize, true);
+			}
+		}
+		
+		if (modified)
+		{
+			memcpy(buffer.data(), this->_data + offset, size);
+			this->_transform(buffer.data(), size, offset);
+			returnValue = (Io::transferFully(Io::Direction::Write, this->_fd, buffer.data(), size, offset) == ssize_t(size));
+		}
+	}
+	
+	safeSetZero(buffer.data(), buffer.size());
+	
+	return returnValue && (fdatasync(this->_fd) == 0) && !this->_failed;
+}
+
+void EncryptedMapping::_handleFaults()
+{
+	std::vector<uint8_t> buffer(this->_pageSize);
+	pollfd descriptors[2];
+	bool running = true;
+	bool pollFailed = false;
+	
+	descriptors[0].fd = this->_faultFd;
+	descriptors[0].events = POLLIN;
+	descriptors[1].fd = this->_stopFd;
+	descriptors[1].events = POLLIN;
+	
+	while (running)
+	{
+		uffd_msg message;
+		
+		if (poll(descriptors, 2, -1) < 0)
+		{
+			// Faulting threads wait for this thread, so it keeps serving them after an error such as ENOMEM instead of leaving them hanging
+			if (errno != EINTR)
+			{
+				if (!pollFailed)
+				{
+					ERROR("Failed to wait for page faults: " << strerror(errno))
+				}
+				
+				pollFailed = true;
+				this->_failed = true;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+		else if (descriptors[1].revents != 0)
+		{
+			running = false;
+		}
+		else if ((read(this->_faultFd, &message, sizeof (message)) == sizeof (message)) && (message.event == UFFD_EVENT_PAGEFAULT))
+		{
+			const size_t page = size_t(message.arg.pagefault.address - uint64_t(reinterpret_cast<uintptr_t>(this->_data))) / this->_pageSize;
+			
+			if ((message.arg.pagefault.flags & UFFD_PAGEFAULT_FLAG_WP) != 0)
+			{
+				this->_markDirty(page);
+			}
+			else
+			{
+				this->_loadPage(page, buffer.data());
+			}
+		}
+	}
+}
+
+void EncryptedMapping::_loadPage(const size_t page, uint8_t *buffer)
+{
+	const uint64_t offset = uint64_t(page) * this->_pageSize;
+	const size_t size = ((this->_size - offset) < this->_pageSize) ? size_t(this->_size - offset) : this->_pageSize;
+	uffdio_copy copy;
+	
+	// The part of the last page beyond the end of the file stays zero
+	memset(buffer, 0, this->_pageSize);
+	
+	const bool loaded = (Io::transferFully(Io::Direction::Read, this->_fd, buffer, size, offset) == ssize_t(size));
+	
+	if (loaded)
+	{
+		this->_transform(buffer, size, offset);
+	}
+	else
+	{
+		ERROR("Failed to read encrypted page at offset " << offset)
+		memset(buffer, 0, this->_pageSize);
+		this->_failed = true;
+	}
+	
+	memset(&copy, 0, sizeof (copy));
+	copy.dst = uint64_t(reinterpret_cast<uintptr_t>(this->_data + offset));
+	copy.src = uint64_t(reinterpret_cast<uintptr_t>(buffer));
+	copy.len = this->_pageSize;
+	copy.mode = this->_writeProtect ? UFFDIO_COPY_MODE_WP : 0;
+	
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		
+		// Several threads may have faulted on the same page, which is only installed for the first fault
+		if (this->_pageStates[page] == _PageState::Missing)
+		{
+			this->_pageStates[page] = loaded ? _PageState::Clean : _PageState::Failed;
+		}
+		
+		if ((ioctl(this->_faultFd, UFFDIO_COPY, &copy) != 0) && (errno == EEXIST))
+		{
+			uffdio_range range;
+			
+			range.start = copy.dst;
+			range.len = this->_pageSize;
+			ioctl(this->_faultFd, UFFDIO_WAKE, &range);
+		}
+	}
+	
+	safeSetZero(buffer, this->_pageSize);
+}
+
+void EncryptedMapping::_markDirty(const size_t page)
+{
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	
+	// Marking and unprotecting happen atomically with respect to sync(); writes to a page that failed to load are accepted but never
+	// written back
+	if (this->_pageStates[page] != _PageState::Failed)
+	{
+		this->_pageStates[page] = _PageState::Dirty;
+	}
+	
+	_setWriteProtection(this->_faultFd, this->_data + page * this->_pageSize, this->_pageSize, false);
+}
+
+} // namespace Crypto::Mode
@@ -0,0 +1,47 @@
+#include <errno.h>
+#include <unistd.h>
+
+#include "fileio.h"
+
+namespace Crypto::Io
+{
+
+ssize_t transferFully(const Direction direction, const int fd, uint8_t *data, const size_t size, const uint64_t offset)
+{
+	const bool positioned = (offset != currentPosition);
+	size_t transferred = 0;
+	ssize_t result = 1;
+	
+	while ((transferred < size) && (result > 0))
+	{
+		if ((direction == Direction::Read) && positioned)
+		{
+			result = pread(fd, data + transferred, size - transferred, off_t(offset + transferred));
+		}
+		else if (direction == Direction::Read)
+		{
+			result = read(fd, data + transferred, size - transferred);
+		}
+		else if (positioned)
+		{
+			result = pwrite(fd, data + transferred, size - transferred, off_t(offset + transferred));
+		}
+		else
+		{
+			result = write(fd, data + transferred, size - transferred);
+		}
+		
+		if (result > 0)
+		{
+			transferred += size_t(result);
+		}
+		else if ((result < 0) && (errno == EINTR))
+		{
+			result = 1;
+		}
+	}
+	
+	return (result < 0) ? result : ssize_t(transferred);
+}
+
+} // namespace Crypto::Io
@@ -0,0 +1,196 @@
+#include <string.h>
+
+#include "cryptoglobals.h"
+#include "poly1305.h"
+
+namespace Crypto::Hash
+{
+
+static constexpr uint32_t _limbMask = 0x3ffffff;
+
+static inline uint32_t _load32(const uint8_t *bytes)
+{
+	return uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+}
+
+static inline void _store32(uint8_t *bytes, const uint32_t value)
+{
+	for (size_t byte = 0; byte < sizeof (value); byte++)
+	{
+		bytes[byte] = uint8_t(value >> (8 * byte));
+	}
+}
+
+Poly1305::Poly1305(const uint8_t *key)
+{
+	// Clamp r as required by the specification while splitting it into limbs
+	this->_r[0] = _load32(key) & 0x3ffffff;
+	this->_r[1] = (_load32(key + 3) >> 2) & 0x3ffff03;
+	this->_r[2] = (_load32(key + 6) >> 4) & 0x3ffc0ff;
+	this->_r[3] = (_load32(key + 9) >> 6) & 0x3f03fff;
+	this->_r[4] = (_load32(key + 12) >> 8) & 0x00fffff;
+	
+	for (size_t word = 0; word < 4; word++)
+	{
+		this->_pad[word] = _load32(key + 16 + word * 4);
+	}
+}
+
+Poly1305::~Poly1305()
+{
+	safeSetZero(this->_r, sizeof (this->_r));
+	safeSetZero(this->_h, sizeof (this->_h));
+	safeSetZero(this->_pad, sizeof (this->_pad));
+	safeSetZero(this->_buffer, sizeof (this->_buffer));
+}
+
+void Poly1305::update(const uint8_t *data, size_t size)
+{
+	// Complete a previously buffered partial block first
+	if (this->_bufferSize != 0)
+	{
+		const size_t bytes = ((blockSize - this->_bufferSize) < size) ? (blockSize - this->_bufferSize) : size;
+		
+		memcpy(this->_buffer + this->_bufferSize, data, bytes);
+		this->_bufferSize += bytes;
+		data += bytes;
+		size -= bytes;
+		
+		if (this->_bufferSize == blockSize)
+		{
+			this->_blocks(this->_buffer, 1, 1u << 24);
+			this->_bufferSize = 0;
+		}
+	}
+	
+	if (size >= blockSize)
+	{
+		this->_blocks(data, size / blockSize, 1u << 24);
+		data += size - (size % blockSize);
+		size %= blockSize;
+	}
+	
+	if (size != 0)
+	{
+		memcpy(this->_buffer, data, size);
+		this->_bufferSize = size;
+	}
+}
+
+void Poly1305::finalize(uint8_t *mac)
+{
+	uint32_t *h = this->_h;
+	uint32_t g[5];
+	
+	// A partial last block is padded with a one byte instead of the implicit 2^128
+	if (this->_bufferSize != 0)
+	{
+		this->_buffer[this->_bufferSize] = 1;
+		memset(this->_buffer + this->_bufferSize + 1, 0, blockSize - this->_bufferSize - 1);
+		this->_blocks(this->_buffer, 1, 0);
+	}
+	
+	uint32_t carry = h[1] >> 26;
+	
+	h[1] &= _limbMask;
+	
+	for (size_t limb = 2; limb < 5; limb++)
+	{
+		h[limb] += carry;
+		carry = h[limb] >> 26;
+		h[limb] &= _limbMask;
+	}
+	
+	h[0] += carry * 5;
+	carry = h[0] >> 26;
+	h[0] &= _limbMask;
+	h[1] += carry;
+	
+	// Compute h + -p and select it in constant time if h is not smaller than p = 2^130 - 5
+	g[0] = h[0] + 5;
+	carry = g[0] >> 26;
+	g[0] &= _limbMask;
+	
+	for (size_t limb = 1; limb < 5; limb++)
+	{
+		g[limb] = h[limb] + carry;
+		carry = g[limb] >> 26;
+		g[limb] &= _limbMask;
+	}
+	
+	g[4] = h[4] + carry - (1u << 26);
+	
+	const uint32_t selectG = (g[4] >> 31) - 1;
+	
+	for (size_t limb = 0; limb < 5; limb++)
+	{
+		h[limb] = (h[limb] & ~selectG) | (g[limb] & selectG);
+	}
+	
+	const uint32_t words[4] = {
+		h[0] | (h[1] << 26),
+		(h[1] >> 6) | (h[2] << 20),
+		(h[2] >> 12) | (h[3] << 14),
+		(h[3] >> 18) | (h[4] << 8)
+	};
+	uint64_t sum = 0;
+	
+	for (size_t word = 0; word < 4; word++)
+	{
+		sum = uint64_t(words[word]) + this->_pad[word] + (sum >> 32);
+		_store32(mac + word * 4, uint32_t(sum));
+	}
+	
+	// The key must not be used for another message
+	safeSetZero(this->_r, sizeof (this->_r));
+	safeSetZero(this->_h, sizeof (this->_h));
+	safeSetZero(this->_pad, sizeof (this->_pad));
+	safeSetZero(g, sizeof (g));
+	this->_bufferSize = 0;
+}
+
+void Poly1305::compute(const uint8_t *key, const uint8_t *data, const size_t size, uint8_t *mac)
+{
+	Poly1305 authenticator(key);
+	
+	authenticator.update(data, size);
+	authenticator.finalize(mac);
+}
+
+void Poly1305::_blocks(const uint8_t *data, const size_t blockCount, const uint32_t highBit)
+{
+	const uint32_t *r = this->_r;
+	const uint32_t s[5] = {0, r[1] * 5, r[2] * 5, r[3] * 5, r[4] * 5};
+	uint32_t *h = this->_h;
+	
+	for (size_t block = 0; block < blockCount; block++, data += blockSize)
+	{
+		h[0] += _load32(data) & _limbMask;
+		h[1] += (_load32(data + 3) >> 2) & _limbMask;
+		h[2] += (_load32(data + 6) >> 4) & _limbMask;
+		h[3] += (_load32(data + 9) >> 6) & _limbMask;
+		h[4] += (_load32(data + 12) >> 8) | highBit;
+		
+		// Multiply by r modulo 2^130 - 5; limbs above 2^130 wrap around multiplied by 5
+		uint64_t d[5] = {
+			uint64_t(h[0]) * r[0] + uint64_t(h[1]) * s[4] + uint64_t(h[2]) * s[3] + uint64_t(h[3]) * s[2] + uint64_t(h[4]) * s[1],
+			uint64_t(h[0]) * r[1] + uint64_t(h[1]) * r[0] + uint64_t(h[2]) * s[4] + uint64_t(h[3]) * s[3] + uint64_t(h[4]) * s[2],
+			uint64_t(h[0]) * r[2] + uint64_t(h[1]) * r[1] + uint64_t(h[2]) * r[0] + uint64_t(h[3]) * s[4] + uint64_t(h[4]) * s[3],
+			uint64_t(h[0]) * r[3] + uint64_t(h[1]) * r[2] + uint64_t(h[2]) * r[1] + uint64_t(h[3]) * r[0] + uint64_t(h[4]) * s[4],
+			uint64_t(h[0]) * r[4] + uint64_t(h[1]) * r[3] + uint64_t(h[2]) * r[2] + uint64_t(h[3]) * r[1] + uint64_t(h[4]) * r[0]
+		};
+		
+		for (size_t limb = 0; limb < 4; limb++)
+		{
+			d[limb + 1] += d[limb] >> 26;
+			h[limb] = uint32_t(d[limb]) & _limbMask;
+		}
+		
+		h[4] = uint32_t(d[4]) & _limbMask;
+		h[0] += uint32_t(d[4] >> 26) * 5;
+		h[1] += h[0] >> 26;
+		h[0] &= _limbMask;
+	}
+}
+
+} // namespace Crypto::Hash
@@ -0,0 +1,98 @@
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "cryptoglobals.h"
+#include "securearena.h"
+
+namespace Crypto
+{
+
+static size_t _roundUp(const size_t value, const size_t multiple)
+{
+	return ((value + multiple - 1) / multiple) * multiple;
+}
+
+SecureArena::SecureArena(const size_t slotSize, const size_t slotCount, const size_t alignment) :
+	_slotSize(_roundUp(slotSize, alignment)),
+	_slotCount(slotCount)
+{
+	const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+	
+	// The free list is kept inside the locked region as well, so slot indices never leak into swap
+	this->_slotRegionSize = _roundUp(this->_slotSize * slotCount + sizeof (uint32_t) * slotCount, pageSize);
+	this->_mappingSize = this->_slotRegionSize + 2 * pageSize;
+	
+	void *mapping = mmap(nullptr, this->_mappingSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	
+	if (mapping == MAP_FAILED)
+	{
+		ERROR("Failed to map secure arena of " << this->_mappingSize << " bytes")
+	}
+	else if (mprotect(static_cast<uint8_t *>(mapping) + pageSize, this->_slotRegionSize, PROT_READ | PROT_WRITE) != 0)
+	{
+		ERROR("Failed to unprotect secure arena")
+		munmap(mapping, this->_mappingSize);
+	}
+	else
+	{
+		this->_mapping = static_cast<uint8_t *>(mapping);
+		this->_slots = this->_mapping + pageSize;
+		this->_freeSlots = reinterpret_cast<uint32_t *>(this->_slots + this->_slotSize * slotCount);
+		
+		this->_locked = (mlock(this->_slots, this->_slotRegionSize) == 0);
+		madvise(this->_slots, this->_slotRegionSize, MADV_DONTDUMP);
+		
+		if (!this->_locked)
+		{
+			WARN("Secure arena could not be locked into memory; check RLIMIT_MEMLOCK")
+		}
+		
+		// Hand out low slots first
+		for (size_t slot = 0; slot < slotCount; slot++)
+		{
+			this->_freeSlots[slot] = uint32_t(slotCount - slot - 1);
+		}
+		
+		this->_freeSlotCount = slotCount;
+	}
+}
+
+SecureArena::~SecureArena()
+{
+	if (this->_mapping != nullptr)
+	{
+		safeSetZero(this->_slots, this->_slotRegionSize);
+		
+		if (this->_locked)
+		{
+			munlock(this->_slots, this->_slotRegionSize);
+		}
+		
+		munmap(this->_mapping, this->_mappingSize);
+	}
+}
+
+void *SecureArena::allocate()
+{
+	void *returnValue = nullptr;
+	
+	if (this->_freeSlotCount > 0)
+	{
+		this->_freeSlotCount--;
+		returnValue = this->_slots + size_t(this->_freeSlots[this->_freeSlotCount]) * this->_slotSize;
+	}
+	
+	return returnValue;
+}
+
+void SecureArena::deallocate(void *slot)
+{
+	uint8_t *slotBytes = static_cast<uint8_t *>(slot);
+	
+	safeSetZero(slotBytes, this->_slotSize);
+	
+	this->_freeSlots[this->_freeSlotCount] = uint32_t((slotBytes - this->_slots) / this->_slotSize);
+	this->_freeSlotCount++;
+}
+
+} // namespace Crypto
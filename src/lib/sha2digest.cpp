@@ -1,6 +1,3 @@
-#include <cassert>
-#include <string.h>
-
 #include "sha2digest.h"
 #include "sha2constants.h"
 
@@ -59,188 +56,30 @@ void Digest<SHA512_DIGEST_SIZE>::_initializeState()
 	this->_state[7] = 0x5be0cd19137e2179;
 }
 
-template <typename WordType>
-inline static constexpr WordType _ch(const WordType x, const WordType y, const WordType z)
-{
-	return ((x ^ y) ^ (~x ^ z));
-}
-
-template <typename WordType>
-inline static constexpr WordType _maj(const WordType x, const WordType y, const WordType z)
-{
-	return ((x ^ y) ^ (x ^ z) ^ (y ^ z));
-}
-
-template <typename WordType>
-inline static constexpr WordType _sigma0(const WordType x)
-{
-	return (rotateRight(x, 2) ^ rotateRight(x, 13) ^ rotateRight(x, 22));
-}
-
-template <typename WordType>
-inline static constexpr WordType _sigma1(const WordType x)
-{
-	return (rotateRight(x, 6) ^ rotateRight(x, 11) ^ rotateRight(x, 25));
-}
-
-template <typename WordType>
-inline static constexpr WordType _phi0(const WordType x)
-{
-	return (rotateRight(x, 7) ^ rotateRight(x, 18) ^ shiftRight(x, 3));
-}
-
-template <typename WordType>
-inline static constexpr WordType _phi1(const WordType x)
-{
-	return (rotateRight(x, 17) ^ rotateRight(x, 19) ^ shiftRight(x, 10));
-}
-
-inline void _sha256Update(Sha2::Traits<SHA256_DIGEST_SIZE>::WordType *state, const uint8_t *block)
-{
-	using WordType = Sha2::Traits<SHA256_DIGEST_SIZE>::WordType;
-//	DEBUG("STATE")
-//	printBuffer(state, 8);
-	// Prepare message schedule
-	WordType w[64];
-	
-	for (uint32_t t = 0; t < 16; t++)
-	{
-		w[t] = changeEndianness(reinterpret_cast<const WordType *>(block)[t]);
-	}
-	
-	for (uint32_t t = 16; t < 64; t++)
-	{
-		w[t] = _phi1(w[t - 2]) + w[t - 7] + _phi0(w[t - 15]) + w[t - 16];
-	}
-	
-//	DEBUG("W")
-//	printBuffer(w, 64);
-	
-	// Working variables
-	WordType a, b, c, d, e, f, g, h;
-	
-	a = state[0];
-	b = state[1];
-	c = state[2];
-	d = state[3];
-	e = state[4];
-	f = state[5];
-	g = state[6];
-	h = state[7];
-	
-	for (uint32_t t = 0; t < 64; t++)
-	{
-		WordType T1, T2;
-		
-		T1 = h + _sigma1(e) + _ch(e, f, g) + Sha2::sha256Constants[t] + w[t];
-		T2 = _sigma0(a) + _maj(a, b, c);
-		
-		h = g;
-		g = f;
-		f = e;
-		e = d + T1;
-		d = c;
-		c = b;
-		b = a;
-		a = T1 + T2;
-	}
-	
-	// Compute intermediate hash value
-	state[0] += a;
-	state[1] += b;
-	state[2] += c;
-	state[3] += d;
-	state[4] += e;
-	state[5] += f;
-	state[6] += g;
-	state[7] += h;
-	
-	printBuffer(state, 8);
-}
-
-inline void _sha512Update(Sha2::Traits<SHA512_DIGEST_SIZE>::WordType *state, const uint8_t *block)
-{
-	using WordType = Sha2::Traits<SHA512_DIGEST_SIZE>::WordType;
-	
-	// Prepare message schedule
-	WordType w[80];
-	
-	for (uint32_t t = 0; t < 16; t++)
-	{
-		w[t] = changeEndianness(reinterpret_cast<const WordType *>(block)[t]);
-	}
-	
-	for (uint32_t t = 16; t < 80; t++)
-	{
-		w[t] = _phi1(w[t - 2]) + w[t - 7] + _phi0(w[t - 15]) + w[t - 16];
-	}
-	
-	// Working variables
-	WordType a, b, c, d, e, f, g, h;
-	
-	a = state[0];
-	b = state[1];
-	c = state[2];
-	d = state[3];
-	e = state[4];
-	f = state[5];
-	g = state[6];
-	h = state[7];
-	
-	for (uint32_t t = 0; t < 80; t++)
-	{
-		WordType T1, T2;
-		
-		T1 = h + _sigma1(e) + _ch(e, f, g) + Sha2::sha512Constants[t] + w[t];
-		T2 = _sigma0(a) + _maj(a, b, c);
-		
-		h = g;
-		g = f;
-		f = e;
-		e = d + T1;
-		d = c;
-		c = b;
-		b = a;
-		a = T1 + T2;
-	}
-	
-	// Compute intermediate hash value
-	state[0] += a;
-	state[1] += b;
-	state[2] += c;
-	state[3] += d;
-	state[4] += e;
-	state[5] += f;
-	state[6] += g;
-	state[7] += h;
-}
-
 template <>
-void Digest<SHA224_DIGEST_SIZE>::update(const uint8_t *block)
+void Digest<SHA512_224_DIGEST_SIZE, SHA512_BLOCK_SIZE>::_initializeState()
 {
-	this->_messageSize += TraitsType::blockSize * 8;
-	_sha256Update(this->_state, block);
+	this->_state[0] = 0x8c3d37c819544da2;
+	this->_state[1] = 0x73e1996689dcd4d6;
+	this->_state[2] = 0x1dfab7ae32ff9c82;
+	this->_state[3] = 0x679dd514582f9fcf;
+	this->_state[4] = 0x0f6d2b697bd44da8;
+	this->_state[5] = 0x77e36f7304c48942;
+	this->_state[6] = 0x3f9d85a86a1d36c8;
+	this->_state[7] = 0x1112e6ad91d692a1;
 }
 
 template <>
-void Digest<SHA256_DIGEST_SIZE>::update(const uint8_t *block)
-{
-	this->_messageSize += TraitsType::blockSize * 8;
-	_sha256Update(this->_state, block);
-}
-
-template <>
-void Digest<SHA384_DIGEST_SIZE>::update(const uint8_t *block)
-{
-	this->_messageSize += TraitsType::blockSize * 8;
-	_sha512Update(this->_state, block);
-}
-
-template <>
-void Digest<SHA512_DIGEST_SIZE>::update(const uint8_t *block)
-{
-	this->_messageSize += TraitsType::blockSize * 8;
-	_sha512Update(this->_state, block);
+void Digest<SHA512_256_DIGEST_SIZE, SHA512_BLOCK_SIZE>::_initializeState()
+{
+	this->_state[0] = 0x22312194fc2bf72c;
+	this->_state[1] = 0x9f555fa3c84c64c2;
+	this->_state[2] = 0x2393b86b6f53b151;
+	this->_state[3] = 0x963877195940eabd;
+	this->_state[4] = 0x96283ee2a88effe3;
+	this->_state[5] = 0xbe5e1e2553863992;
+	this->_state[6] = 0x2b0199fc2c85b8aa;
+	this->_state[7] = 0x0eb72ddc81c52ca2;
 }
 
 }
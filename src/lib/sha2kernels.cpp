@@ -0,0 +1,474 @@
+#include <atomic>
+#include <string.h>
+
+#include "cpufeatures.h"
+#include "cryptoglobals.h"
+#include "sha2constants.h"
+#include "sha2kernels.h"
+
+#ifdef CRYPTO_ARCH_X86
+#include <immintrin.h>
+#endif
+
+namespace Crypto::Hash::Sha2
+{
+
+template <typename WordType>
+inline static constexpr WordType _ch(const WordType x, const WordType y, const WordType z)
+{
+	return ((x & y) ^ (~x & z));
+}
+
+template <typename WordType>
+inline static constexpr WordType _maj(const WordType x, const WordType y, const WordType z)
+{
+	return ((x & y) ^ (x & z) ^ (y & z));
+}
+
+inline static constexpr uint32_t _sigma0(const uint32_t x)
+{
+	return (rotateRight(x, 2) ^ rotateRight(x, 13) ^ rotateRight(x, 22));
+}
+
+inline static constexpr uint32_t _sigma1(const uint32_t x)
+{
+	return (rotateRight(x, 6) ^ rotateRight(x, 11) ^ rotateRight(x, 25));
+}
+
+inline static constexpr uint32_t _phi0(const uint32_t x)
+{
+	return (rotateRight(x, 7) ^ rotateRight(x, 18) ^ shiftRight(x, 3));
+}
+
+inline static constexpr uint32_t _phi1(const uint32_t x)
+{
+	return (rotateRight(x, 17) ^ rotateRight(x, 19) ^ shiftRight(x, 10));
+}
+
+inline static constexpr uint64_t _sigma0(const uint64_t x)
+{
+	return (rotateRight(x, 28) ^ rotateRight(x, 34) ^ rotateRight(x, 39));
+}
+
+inline static constexpr uint64_t _sigma1(const uint64_t x)
+{
+	return (rotateRight(x, 14) ^ rotateRight(x, 18) ^ rotateRight(x, 41));
+}
+
+inline static constexpr uint64_t _phi0(const uint64_t x)
+{
+	return (rotateRight(x, 1) ^ rotateRight(x, 8) ^ shiftRight(x, 7));
+}
+
+inline static constexpr uint64_t _phi1(const uint64_t x)
+{
+	return (rotateRight(x, 19) ^ rotateRight(x, 61) ^ shiftRight(x, 6));
+}
+
+static inline void _sha256Block(uint32_t *state, const uint8_t *block)
+{
+	using WordType = uint32_t;
+	
+	// Prepare message schedule
+	WordType w[64];
+	
+	for (uint32_t t = 0; t < 16; t++)
+	{
+		WordType word = 0;
+		memcpy(&word, block + t * sizeof (WordType), sizeof (WordType));
+		w[t] = changeEndianness(word);
+	}
+	
+	for (uint32_t t = 16; t < 64; t++)
+	{
+		w[t] = _phi1(w[t - 2]) + w[t - 7] + _phi0(w[t - 15]) + w[t - 16];
+	}
+	
+	// Working variables
+	WordType a, b, c, d, e, f, g, h;
+	
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	f = state[5];
+	g = state[6];
+	h = state[7];
+	
+	for (uint32_t t = 0; t < 64; t++)
+	{
+		WordType T1, T2;
+		
+		T1 = h + _sigma1(e) + _ch(e, f, g) + sha256Constants[t] + w[t];
+		T2 = _sigma0(a) + _maj(a, b, c);
+		
+		h = g;
+		g = f;
+		f = e;
+		e = d + T1;
+		d = c;
+		c = b;
+		b = a;
+		a = T1 + T2;
+	}
+	
+	// Compute intermediate hash value
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+static inline void _sha512Block(uint64_t *state, const uint8_t *block)
+{
+	using WordType = uint64_t;
+	
+	// Prepare message schedule
+	WordType w[80];
+	
+	for (uint32_t t = 0; t < 16; t++)
+	{
+		WordType word = 0;
+		memcpy(&word, block + t * sizeof (WordType), sizeof (WordType));
+		w[t] = changeEndianness(word);
+	}
+	
+	for (uint32_t t = 16; t < 80; t++)
+	{
+		w[t] = _phi1(w[t - 2]) + w[t - 7] + _phi0(w[t - 15]) + w[t - 16];
+	}
+	
+	// Working variables
+	WordType a, b, c, d, e, f, g, h;
+	
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	f = state[5];
+	g = state[6];
+	h = state[7];
+	
+	for (uint32_t t = 0; t < 80; t++)
+	{
+		WordType T1, T2;
+		
+		T1 = h + _sigma1(e) + _ch(e, f, g) + sha512Constants[t] + w[t];
+		T2 = _sigma0(a) + _maj(a, b, c);
+		
+		h = g;
+		g = f;
+		f = e;
+		e = d + T1;
+		d = c;
+		c = b;
+		b = a;
+		a = T1 + T2;
+	}
+	
+	// Compute intermediate hash value
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+static void _sha256BlocksGeneric(uint32_t *state, const uint8_t *blocks, const size_t blockCount)
+{
+	for (size_t block = 0; block < blockCount; block++)
+	{
+		_sha256Block(state, blocks + block * SHA256_BLOCK_SIZE);
+	}
+}
+
+static void _sha512BlocksGeneric(uint64_t *state, const uint8_t *blocks, const size_t blockCount)
+{
+	for (size_t block = 0; block < blockCount; block++)
+	{
+		_sha512Block(state, blocks + block * SHA512_BLOCK_SIZE);
+	}
+}
+
+static void _sha256BlocksLanesGeneric(uint32_t *const *states, const uint8_t *const *blocks, const size_t laneCount, const size_t blockCount)
+{
+	for (size_t lane = 0; lane < laneCount; lane++)
+	{
+		_sha256BlocksGeneric(states[lane], blocks[lane], blockCount);
+	}
+}
+
+#ifdef CRYPTO_ARCH_X86
+__attribute__((target("sha,sse4.1")))
+static void _sha256BlocksShaNi(uint32_t *state, const uint8_t *blocks, const size_t blockCount)
+{
+	const __m128i byteSwapMask = _mm_set_epi64x(0x0c0d0e0f08090a0bll, 0x0405060700010203ll);
+	
+	// The SHA instructions expect the state as ABEF and CDGH
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0xb1);
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4)), 0x1b);
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+	
+	for (size_t block = 0; block < blockCount; block++)
+	{
+		const __m128i savedState0 = state0;
+		const __m128i savedState1 = state1;
+		
+		// Message schedule in groups of four words, only the last four groups are kept
+		__m128i w[4];
+		
+		for (uint32_t group = 0; group < 16; group++)
+		{
+			if (group < 4)
+			{
+				w[group] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks + block * SHA256_BLOCK_SIZE) + group), byteSwapMask);
+			}
+			else
+			{
+				tmp = _mm_sha256msg1_epu32(w[group % 4], w[(group + 1) % 4]);
+				tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(w[(group + 3) % 4], w[(group + 2) % 4], 4));
+				w[group % 4] = _mm_sha256msg2_epu32(tmp, w[(group + 3) % 4]);
+			}
+			
+			// Four rounds
+			tmp = _mm_add_epi32(w[group % 4], _mm_loadu_si128(reinterpret_cast<const __m128i *>(sha256Constants) + group));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, tmp);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(tmp, 0x0e));
+		}
+		
+		state0 = _mm_add_epi32(state0, savedState0);
+		state1 = _mm_add_epi32(state1, savedState1);
+	}
+	
+	// Back to ABCD and EFGH
+	tmp = _mm_shuffle_epi32(state0, 0x1b);
+	state1 = _mm_shuffle_epi32(state1, 0xb1);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_blend_epi16(tmp, state1, 0xf0));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), _mm_alignr_epi8(state1, tmp, 8));
+}
+
+static void _sha256BlocksLanesShaNi(uint32_t *const *states, const uint8_t *const *blocks, const size_t laneCount, const size_t blockCount)
+{
+	// The round instructions are limited by throughput rather than latency, so interleaving lanes gains nothing
+	for (size_t lane = 0; lane < laneCount; lane++)
+	{
+		_sha256BlocksShaNi(states[lane], blocks[lane], blockCount);
+	}
+}
+
+static constexpr size_t _avx2Lanes = 8;
+
+template <int bits>
+__attribute__((target("avx2")))
+static inline __m256i _rotateRightAvx2(const __m256i x)
+{
+	return _mm256_or_si256(_mm256_srli_epi32(x, bits), _mm256_slli_epi32(x, 32 - bits));
+}
+
+__attribute__((target("avx2")))
+static inline void _transposeAvx2(__m256i *rows)
+{
+	__m256i pairs[8];
+	__m256i quads[8];
+	
+	for (uint32_t row = 0; row < 8; row += 2)
+	{
+		pairs[row] = _mm256_unpacklo_epi32(rows[row], rows[row + 1]);
+		pairs[row + 1] = _mm256_unpackhi_epi32(rows[row], rows[row + 1]);
+	}
+	
+	for (uint32_t row = 0; row < 8; row += 4)
+	{
+		quads[row] = _mm256_unpacklo_epi64(pairs[row], pairs[row + 2]);
+		quads[row + 1] = _mm256_unpackhi_epi64(pairs[row], pairs[row + 2]);
+		quads[row + 2] = _mm256_unpacklo_epi64(pairs[row + 1], pairs[row + 3]);
+		quads[row + 3] = _mm256_unpackhi_epi64(pairs[row + 1], pairs[row + 3]);
+	}
+	
+	for (uint32_t row = 0; row < 4; row++)
+	{
+		rows[row] = _mm256_permute2x128_si256(quads[row], quads[row + 4], 0x20);
+		rows[row + 4] = _mm256_permute2x128_si256(quads[row], quads[row + 4], 0x31);
+	}
+}
+
+__attribute__((target("avx2")))
+static void _sha256BlocksLanesAvx2(uint32_t *const *states, const uint8_t *const *blocks, const size_t laneCount, const size_t blockCount)
+{
+	const __m256i byteSwapMask = _mm256_set_epi64x(0x0c0d0e0f08090a0bll, 0x0405060700010203ll, 0x0c0d0e0f08090a0bll, 0x0405060700010203ll);
+	size_t firstLane = 0;
+	
+	// Each 32 bit element of a vector belongs to another message
+	while ((laneCount - firstLane) >= (_avx2Lanes / 2))
+	{
+		const size_t activeLanes = ((laneCount - firstLane) < _avx2Lanes) ? (laneCount - firstLane) : _avx2Lanes;
+		const uint8_t *laneBlocks[_avx2Lanes];
+		__m256i state[8];
+		
+		// Idle lanes compress the blocks of the first lane and discard the result
+		for (size_t lane = 0; lane < _avx2Lanes; lane++)
+		{
+			const size_t source = (lane < activeLanes) ? (firstLane + lane) : firstLane;
+			
+			laneBlocks[lane] = blocks[source];
+			state[lane] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(states[source]));
+		}
+		
+		_transposeAvx2(state);
+		
+		for (size_t block = 0; block < blockCount; block++)
+		{
+			__m256i w[16];
+			
+			for (size_t lane = 0; lane < _avx2Lanes; lane++)
+			{
+				const uint8_t *laneBlock = laneBlocks[lane] + block * SHA256_BLOCK_SIZE;
+				
+				w[lane] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(laneBlock));
+				w[lane + 8] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(laneBlock + 32));
+			}
+			
+			_transposeAvx2(w);
+			_transposeAvx2(w + 8);
+			
+			for (uint32_t t = 0; t < 16; t++)
+			{
+				w[t] = _mm256_shuffle_epi8(w[t], byteSwapMask);
+			}
+			
+			__m256i a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+			
+			for (uint32_t t = 0; t < 64; t++)
+			{
+				// Only the last 16 words of the message schedule are kept
+				if (t >= 16)
+				{
+					const __m256i w2 = w[(t - 2) % 16];
+					const __m256i w15 = w[(t - 15) % 16];
+					const __m256i phi1 = _mm256_xor_si256(_mm256_xor_si256(_rotateRightAvx2<17>(w2), _rotateRightAvx2<19>(w2)), _mm256_srli_epi32(w2, 10));
+					const __m256i phi0 = _mm256_xor_si256(_mm256_xor_si256(_rotateRightAvx2<7>(w15), _rotateRightAvx2<18>(w15)), _mm256_srli_epi32(w15, 3));
+					
+					w[t % 16] = _mm256_add_epi32(_mm256_add_epi32(phi1, w[(t - 7) % 16]), _mm256_add_epi32(phi0, w[t % 16]));
+				}
+				
+				const __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(_rotateRightAvx2<6>(e), _rotateRightAvx2<11>(e)), _rotateRightAvx2<25>(e));
+				const __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+				const __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(_rotateRightAvx2<2>(a), _rotateRightAvx2<13>(a)), _rotateRightAvx2<22>(a));
+				const __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+				const __m256i T1 = _mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(h, sigma1), _mm256_add_epi32(ch, w[t % 16])),
+						_mm256_set1_epi32(int32_t(sha256Constants[t])));
+				const __m256i T2 = _mm256_add_epi32(sigma0, maj);
+				
+				h = g;
+				g = f;
+				f = e;
+				e = _mm256_add_epi32(d, T1);
+				d = c;
+				c = b;
+				b = a;
+				a = _mm256_add_epi32(T1, T2);
+			}
+			
+			state[0] = _mm256_add_epi32(state[0], a);
+			state[1] = _mm256_add_epi32(state[1], b);
+			state[2] = _mm256_add_epi32(state[2], c);
+			state[3] = _mm256_add_epi32(state[3], d);
+			state[4] = _mm256_add_epi32(state[4], e);
+			state[5] = _mm256_add_epi32(state[5], f);
+			state[6] = _mm256_add_epi32(state[6], g);
+			state[7] = _mm256_add_epi32(state[7], h);
+		}
+		
+		_transposeAvx2(state);
+		
+		for (size_t lane = 0; lane < activeLanes; lane++)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(states[firstLane + lane]), state[lane]);
+		}
+		
+		firstLane += activeLanes;
+	}
+	
+	// A few remaining lanes are faster one after another
+	_sha256BlocksLanesGeneric(states + firstLane, blocks + firstLane, laneCount - firstLane, blockCount);
+}
+
+static const Kernels _shaNiKernels = {
+	_sha256BlocksShaNi,
+	_sha512BlocksGeneric,
+	_sha256BlocksLanesShaNi,
+	"sha"
+};
+
+static const Kernels _avx2Kernels = {
+	_sha256BlocksGeneric,
+	_sha512BlocksGeneric,
+	_sha256BlocksLanesAvx2,
+	"avx2"
+};
+#endif
+
+static const Kernels _genericKernels = {
+	_sha256BlocksGeneric,
+	_sha512BlocksGeneric,
+	_sha256BlocksLanesGeneric,
+	"generic"
+};
+
+static const Kernels &_fastestKernels()
+{
+#ifdef CRYPTO_ARCH_X86
+	if (Cpu::hasFeatures(Cpu::Sha | Cpu::Sse41))
+	{
+		return _shaNiKernels;
+	}
+	
+	if (Cpu::hasFeatures(Cpu::Avx2))
+	{
+		return _avx2Kernels;
+	}
+#endif
+	
+	return _genericKernels;
+}
+
+///
+/// \internal
+/// 
+/// \brief	Holds the kernels selected on first use, which only restrictFeatures() changes through selectKernels().
+/// 
+/// \since	1.0
+///
+static std::atomic<const Kernels *> &_selectedKernels()
+{
+	static std::atomic<const Kernels *> selectedKernels{&_fastestKernels()};
+	
+	return selectedKernels;
+}
+
+const Kernels &kernels()
+{
+	return *_selectedKernels().load(std::memory_order_relaxed);
+}
+
+void selectKernels()
+{
+	_selectedKernels().store(&_fastestKernels(), std::memory_order_relaxed);
+}
+
+const Kernels &genericKernels()
+{
+	return _genericKernels;
+}
+
+} // namespace Crypto::Hash::Sha2
@@ -1,13 +1,37 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cxxutility/test.h>
+#include <fstream>
 #include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 
 #include "aesblock.h"
+#include "aeskeyschedulebatch.h"
+#include "aeskeyschedulecache.h"
+#include "bufferpool.h"
+#include "cbcmode.h"
+#include "chacha20poly1305.h"
+#include "chunkedcontainer.h"
+#include "convergentencryption.h"
+#include "cpufeatures.h"
+#include "ctrdrbg.h"
+#include "ctrkeystream.h"
 #include "ctrmode.h"
 #include "cryptoutilities.h"
+#include "encryptedmapping.h"
+#include "ff1.h"
+#include "keyrotation.h"
+#include "nonceallocator.h"
+#include "sha2digest.h"
 
 TEST_SUITE(AesTest)
 {
@@ -133,6 +157,1684 @@ TEST_SUITE(AesTest)
 		CXX_COMPARE(decryptedPlaintext, plaintext, "AES-128 CTR");
 	}
 	
+	TEST(encrypt/decrypt)
+	{
+		std::vector<uint8_t> plaintext{
+			0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+			0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+			0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+			0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+		};
+		
+		std::vector<uint8_t> key{
+			0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+		};
+		
+		std::vector<uint8_t> initializationVector{
+			0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+		};
+		
+		std::vector<uint8_t> expectedCiphertext{
+			0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46, 0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+			0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee, 0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+			0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b, 0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+			0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09, 0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7
+		};
+		
+		using Cbc = Crypto::Mode::Cbc<Crypto::BlockCipher::Aes::Block128>;
+		
+		std::vector<uint8_t> ciphertext(plaintext.size());
+		std::vector<uint8_t> decryptedPlaintext(plaintext.size());
+		
+		Crypto::BlockCipher::Aes128Key keyObj(key.data());
+		const Crypto::BlockCipher::Aes::KeySchedule128 schedule(keyObj);
+		
+		Cbc::encrypt(schedule, initializationVector.data(), plaintext.data(), plaintext.size(), ciphertext.data());
+		Cbc::decrypt(schedule, initializationVector.data(), ciphertext.data(), ciphertext.size(), decryptedPlaintext.data());
+		
+		CXX_COMPARE(ciphertext, expectedCiphertext, "AES-128 CBC");
+		CXX_COMPARE(decryptedPlaintext, plaintext, "AES-128 CBC");
+		
+		// Padding round trips, in place for ciphertext stealing
+		for (size_t size : {size_t(0), size_t(15), size_t(16), size_t(17), size_t(32), size_t(47), size_t(64)})
+		{
+			std::vector<uint8_t> message(plaintext.begin(), plaintext.begin() + size);
+			std::vector<uint8_t> buffer(Cbc::ciphertextSize(size, Crypto::Mode::PaddingType::NBytes));
+			
+			size_t ciphertextSize = Cbc::encrypt(schedule, initializationVector.data(), message.data(), size, buffer.data(),
+												 Crypto::Mode::PaddingType::NBytes);
+			size_t plaintextSize = Cbc::decrypt(schedule, initializationVector.data(), buffer.data(), ciphertextSize, buffer.data(),
+												Crypto::Mode::PaddingType::NBytes);
+			buffer.resize(plaintextSize);
+			
+			CXX_COMPARE(buffer, message, "AES-128 CBC PKCS#7");
+			
+			if (size >= AES_BLOCK_SIZE)
+			{
+				buffer = message;
+				
+				Cbc::encrypt(schedule, initializationVector.data(), buffer.data(), size, buffer.data(), Crypto::Mode::PaddingType::CipherTextStealing);
+				Cbc::decrypt(schedule, initializationVector.data(), buffer.data(), size, buffer.data(), Crypto::Mode::PaddingType::CipherTextStealing);
+				
+				CXX_COMPARE(buffer, message, "AES-128 CBC-CS3");
+			}
+		}
+		
+		// Known answers of RFC 3962, whose CBC-CS3 swaps the last two blocks even when the message is block aligned
+		const std::string kerberosKeyText = "chicken teriyaki";
+		std::vector<uint8_t> kerberosKeyBytes(kerberosKeyText.begin(), kerberosKeyText.end());
+		Crypto::BlockCipher::Aes128Key kerberosKey(kerberosKeyBytes.data());
+		const Crypto::BlockCipher::Aes::KeySchedule128 kerberosSchedule(kerberosKey);
+		const std::string kerberosPlaintext = "I would like the General Gau's Chicken, please, and wonton soup.";
+		const std::vector<size_t> kerberosSizes{17, 31, 32, 47, 48, 64};
+		const std::vector<uint8_t> zeroVector(AES_BLOCK_SIZE);
+		const std::vector<std::vector<uint8_t>> expectedKerberosCiphertexts{
+			{
+				0xc6, 0x35, 0x35, 0x68, 0xf2, 0xbf, 0x8c, 0xb4, 0xd8, 0xa5, 0x80, 0x36, 0x2d, 0xa7, 0xff, 0x7f,
+				0x97
+			},
+			{
+				0xfc, 0x00, 0x78, 0x3e, 0x0e, 0xfd, 0xb2, 0xc1, 0xd4, 0x45, 0xd4, 0xc8, 0xef, 0xf7, 0xed, 0x22,
+				0x97, 0x68, 0x72, 0x68, 0xd6, 0xec, 0xcc, 0xc0, 0xc0, 0x7b, 0x25, 0xe2, 0x5e, 0xcf, 0xe5
+			},
+			{
+				0x39, 0x31, 0x25, 0x23, 0xa7, 0x86, 0x62, 0xd5, 0xbe, 0x7f, 0xcb, 0xcc, 0x98, 0xeb, 0xf5, 0xa8,
+				0x97, 0x68, 0x72, 0x68, 0xd6, 0xec, 0xcc, 0xc0, 0xc0, 0x7b, 0x25, 0xe2, 0x5e, 0xcf, 0xe5, 0x84
+			},
+			{
+				0x97, 0x68, 0x72, 0x68, 0xd6, 0xec, 0xcc, 0xc0, 0xc0, 0x7b, 0x25, 0xe2, 0x5e, 0xcf, 0xe5, 0x84,
+				0xb3, 0xff, 0xfd, 0x94, 0x0c, 0x16, 0xa1, 0x8c, 0x1b, 0x55, 0x49, 0xd2, 0xf8, 0x38, 0x02, 0x9e,
+				0x39, 0x31, 0x25, 0x23, 0xa7, 0x86, 0x62, 0xd5, 0xbe, 0x7f, 0xcb, 0xcc, 0x98, 0xeb, 0xf5
+			},
+			{
+				0x97, 0x68, 0x72, 0x68, 0xd6, 0xec, 0xcc, 0xc0, 0xc0, 0x7b, 0x25, 0xe2, 0x5e, 0xcf, 0xe5, 0x84,
+				0x9d, 0xad, 0x8b, 0xbb, 0x96, 0xc4, 0xcd, 0xc0, 0x3b, 0xc1, 0x03, 0xe1, 0xa1, 0x94, 0xbb, 0xd8,
+				0x39, 0x31, 0x25, 0x23, 0xa7, 0x86, 0x62, 0xd5, 0xbe, 0x7f, 0xcb, 0xcc, 0x98, 0xeb, 0xf5, 0xa8
+			},
+			{
+				0x97, 0x68, 0x72, 0x68, 0xd6, 0xec, 0xcc, 0xc0, 0xc0, 0x7b, 0x25, 0xe2, 0x5e, 0xcf, 0xe5, 0x84,
+				0x39, 0x31, 0x25, 0x23, 0xa7, 0x86, 0x62, 0xd5, 0xbe, 0x7f, 0xcb, 0xcc, 0x98, 0xeb, 0xf5, 0xa8,
+				0x48, 0x07, 0xef, 0xe8, 0x36, 0xee, 0x89, 0xa5, 0x26, 0x73, 0x0d, 0xbc, 0x2f, 0x7b, 0xc8, 0x40,
+				0x9d, 0xad, 0x8b, 0xbb, 0x96, 0xc4, 0xcd, 0xc0, 0x3b, 0xc1, 0x03, 0xe1, 0xa1, 0x94, 0xbb, 0xd8
+			}
+		};
+		
+		for (size_t vector = 0; vector < kerberosSizes.size(); vector++)
+		{
+			const std::vector<uint8_t> message(kerberosPlaintext.begin(), kerberosPlaintext.begin() + kerberosSizes[vector]);
+			std::vector<uint8_t> buffer(message.size());
+			std::vector<uint8_t> decryptedMessage(message.size());
+			
+			Cbc::encrypt(kerberosSchedule, zeroVector.data(), message.data(), message.size(), buffer.data(),
+					Crypto::Mode::PaddingType::CipherTextStealing);
+			Cbc::decrypt(kerberosSchedule, zeroVector.data(), expectedKerberosCiphertexts[vector].data(), message.size(), decryptedMessage.data(),
+					Crypto::Mode::PaddingType::CipherTextStealing);
+			
+			CXX_COMPARE(buffer, expectedKerberosCiphertexts[vector], "AES-128 CBC-CS3 RFC 3962");
+			CXX_COMPARE(decryptedMessage, message, "AES-128 CBC-CS3 RFC 3962 decryption");
+		}
+	}
+	
+	TEST(ctrSeek)
+	{
+		std::vector<uint8_t> plaintext(5000);
+		
+		for (size_t byte = 0; byte < plaintext.size(); byte++)
+		{
+			plaintext[byte] = uint8_t(byte * 5 + 1);
+		}
+		
+		std::vector<uint8_t> key{
+			0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+		};
+		
+		std::vector<uint8_t> initializationVector{
+			0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00
+		};
+		
+		std::vector<uint8_t> ciphertext(plaintext.size());
+		
+		using Ctr = Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block128>;
+		Crypto::BlockCipher::Aes::KeySchedule128 schedule(key.data());
+		Ctr::encrypt(schedule, initializationVector.data(), plaintext.data(), plaintext.size(), ciphertext.data());
+		
+		// Ranges starting inside a block, ending inside a block and contained in a single block
+		const size_t ranges[][2] = {{37, 4096}, {0, 5000}, {4999, 1}, {17, 5}, {4080, 920}};
+		
+		for (const auto &range : ranges)
+		{
+			std::vector<uint8_t> decryptedRange(range[1]);
+			std::vector<uint8_t> expectedRange(plaintext.begin() + range[0], plaintext.begin() + range[0] + range[1]);
+			
+			Ctr::decrypt(schedule, initializationVector.data(), range[0], ciphertext.data() + range[0], range[1], decryptedRange.data());
+			
+			CXX_COMPARE(decryptedRange, expectedRange, "AES-128 CTR seek");
+		}
+		
+		// 37 GiB into the stream the lower 64 bits of the counter wrap around
+		std::vector<uint8_t> counter{
+			0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x08, 0x00, 0x00, 0x00, 0x00, 0x93, 0xff, 0xff, 0x00
+		};
+		
+		std::vector<uint8_t> keystream(AES_BLOCK_SIZE);
+		std::vector<uint8_t> zeros(AES_BLOCK_SIZE - 5);
+		Crypto::BlockCipher::Aes128Key keyObj(key.data());
+		Crypto::BlockCipher::Aes::Block128 block(keyObj);
+		block.encrypt(counter.data(), keystream.data());
+		
+		std::vector<uint8_t> expectedKeystream(keystream.begin() + 5, keystream.end());
+		std::vector<uint8_t> seekedKeystream(zeros.size());
+		Ctr::encrypt(schedule, initializationVector.data(), 37ull * 1024 * 1024 * 1024 + 5, zeros.data(), zeros.size(), seekedKeystream.data());
+		
+		CXX_COMPARE(seekedKeystream, expectedKeystream, "AES-128 CTR seek carry");
+	}
+	
+	TEST(ctrDrbg)
+	{
+		using Drbg = Crypto::Random::CtrDrbg<Crypto::BlockCipher::Aes::Block256>;
+		
+		std::vector<uint8_t> entropy(Drbg::seedSize);
+		std::vector<uint8_t> personalization(Drbg::seedSize);
+		
+		for (size_t byte = 0; byte < entropy.size(); byte++)
+		{
+			entropy[byte] = uint8_t(byte);
+			personalization[byte] = uint8_t(byte * 7 + 3);
+		}
+		
+		// Every refill of the buffer is one generate request
+		Drbg generator(entropy.data(), personalization.data());
+		std::vector<uint8_t> output(Drbg::bufferSize);
+		
+		generator.fill(output.data(), output.size());
+		output.resize(32);
+		
+		std::vector<uint8_t> expectedFirst{
+			0xb3, 0xe6, 0x2e, 0x71, 0x4e, 0x8a, 0xd4, 0x94, 0xef, 0x9a, 0x85, 0x79, 0xbe, 0x62, 0x6a, 0xb3,
+			0xf5, 0x98, 0xa7, 0xb9, 0x99, 0xd3, 0x80, 0x38, 0x39, 0x85, 0xe0, 0x06, 0x32, 0x08, 0xca, 0x1c
+		};
+		
+		CXX_COMPARE(output, expectedFirst, "AES-256 CTR_DRBG");
+		
+		output.resize(Drbg::bufferSize);
+		generator.fill(output.data(), output.size());
+		output.resize(32);
+		
+		std::vector<uint8_t> expectedSecond{
+			0x6e, 0x61, 0xb9, 0x76, 0x72, 0xe4, 0xe7, 0xb3, 0xd4, 0x10, 0xbf, 0xc7, 0xd1, 0x7d, 0x7f, 0x0a,
+			0xba, 0xea, 0x17, 0x3b, 0x7c, 0xc0, 0xf4, 0xde, 0x4f, 0xe6, 0xd8, 0x1c, 0x76, 0x50, 0x76, 0x65
+		};
+		
+		CXX_COMPARE(output, expectedSecond, "AES-256 CTR_DRBG second request");
+		
+		// A small request leaves the rest of a buffer, a large one is generated in place and ends in a new buffer
+		Drbg otherGenerator(entropy.data(), personalization.data());
+		std::vector<uint8_t> small(5);
+		std::vector<uint8_t> large(70000);
+		
+		otherGenerator.fill(small.data(), small.size());
+		otherGenerator.fill(large.data(), large.size());
+		
+		std::vector<uint8_t> tail(large.end() - 16, large.end());
+		std::vector<uint8_t> expectedTail{
+			0x89, 0x59, 0xe6, 0xf0, 0x75, 0x5d, 0x9f, 0xfc, 0x0b, 0x4f, 0xed, 0x76, 0x40, 0xfd, 0x82, 0x88
+		};
+		
+		CXX_COMPARE(tail, expectedTail, "AES-256 CTR_DRBG large request");
+		
+		// Reseeding discards the buffered output
+		for (size_t byte = 0; byte < entropy.size(); byte++)
+		{
+			entropy[byte] = uint8_t(0xff - byte);
+			personalization[byte] = uint8_t(byte * 3);
+		}
+		
+		otherGenerator.reseed(entropy.data(), personalization.data());
+		output.resize(32);
+		otherGenerator.fill(output.data(), output.size());
+		
+		std::vector<uint8_t> expectedReseeded{
+			0x03, 0x75, 0x71, 0x8d, 0x3f, 0x45, 0x32, 0x2d, 0x34, 0xef, 0x57, 0x4e, 0x08, 0x01, 0xa1, 0xfc,
+			0xa9, 0xea, 0x4c, 0x6f, 0x6e, 0x67, 0xa4, 0x0b, 0xd8, 0x31, 0x99, 0x82, 0x16, 0x3a, 0xad, 0xce
+		};
+		
+		CXX_COMPARE(output, expectedReseeded, "AES-256 CTR_DRBG reseed");
+		
+		// Threads and forked children have their own generators
+		Drbg &threadGenerator = Drbg::threadLocal();
+		uint64_t otherThreadValue = 0;
+		uint64_t childValue = 0;
+		int descriptors[2] = {-1, -1};
+		
+		std::thread([&otherThreadValue](){
+			otherThreadValue = Drbg::threadLocal()();
+		}).join();
+		
+		threadGenerator();
+		
+		if (pipe(descriptors) == 0)
+		{
+			const pid_t child = fork();
+			
+			if (child == 0)
+			{
+				const uint64_t value = threadGenerator();
+				
+				_exit((write(descriptors[1], &value, sizeof (value)) == sizeof (value)) ? 0 : 1);
+			}
+			
+			if ((child < 0) || (read(descriptors[0], &childValue, sizeof (childValue)) != sizeof (childValue)))
+			{
+				childValue = 0;
+			}
+			
+			waitpid(child, nullptr, 0);
+			close(descriptors[0]);
+			close(descriptors[1]);
+		}
+		
+		// Without reseeding, the child's first value would equal the parent's next one
+		const uint64_t parentValue = threadGenerator();
+		std::uniform_int_distribution<uint32_t> distribution(1, 6);
+		const uint32_t roll = distribution(threadGenerator);
+		std::vector<bool> independent{
+			threadGenerator.isValid(), otherThreadValue != parentValue, (childValue != 0) && (childValue != parentValue), (roll >= 1) && (roll <= 6)
+		};
+		std::vector<bool> expectedIndependent{true, true, true, true};
+		
+		CXX_COMPARE(independent, expectedIndependent, "AES-256 CTR_DRBG thread local");
+	}
+	
+	TEST(nonceAllocator)
+	{
+		using Ctr = Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block128>;
+		using NonceAllocator = Crypto::Mode::NonceAllocator;
+		
+		const size_t threadCount = 8;
+		const size_t vectorsPerThread = 1000;
+		NonceAllocator allocator(0x01020304, 8);
+		std::vector<std::vector<uint8_t>> initializationVectors(threadCount * vectorsPerThread);
+		std::vector<std::thread> threads;
+		
+		// Lanes allocate concurrently without sharing a value
+		for (size_t thread = 0; thread < threadCount; thread++)
+		{
+			threads.emplace_back([&allocator, &initializationVectors, thread, vectorsPerThread](){
+				NonceAllocator::Lane lane = allocator.lane();
+				
+				for (size_t vector = 0; vector < vectorsPerThread; vector++)
+				{
+					std::vector<uint8_t> &initializationVector = initializationVectors[thread * vectorsPerThread + vector];
+					
+					initializationVector.resize(NonceAllocator::initializationVectorSize);
+					lane.next(initializationVector.data());
+				}
+			});
+		}
+		
+		for (std::thread &thread : threads)
+		{
+			thread.join();
+		}
+		
+		std::sort(initializationVectors.begin(), initializationVectors.end());
+		
+		const std::vector<uint8_t> expectedFirst{0x01, 0x02, 0x03, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+		const std::vector<uint8_t> expectedLast{0x01, 0x02, 0x03, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x3f, 0x00, 0x00, 0x00, 0x00};
+		std::vector<size_t> counts{
+			size_t(std::unique(initializationVectors.begin(), initializationVectors.end()) - initializationVectors.begin()),
+			size_t(allocator.reservedInvocations())
+		};
+		std::vector<size_t> expectedCounts{threadCount * vectorsPerThread, threadCount * vectorsPerThread};
+		
+		CXX_COMPARE(counts, expectedCounts, "Nonce allocator uniqueness");
+		CXX_COMPARE(initializationVectors.front(), expectedFirst, "Nonce allocator first value");
+		CXX_COMPARE(initializationVectors.back(), expectedLast, "Nonce allocator last value");
+		
+		// Counter mode takes its initialization vectors directly from a lane
+		std::vector<uint8_t> key{
+			0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+		};
+		
+		Crypto::BlockCipher::Aes::KeySchedule128 schedule(key.data());
+		NonceAllocator::Lane lane = allocator.lane();
+		std::vector<uint8_t> plaintext(300);
+		std::vector<uint8_t> ciphertext(plaintext.size());
+		std::vector<uint8_t> decrypted(plaintext.size());
+		std::vector<uint8_t> usedVectors(4 * NonceAllocator::initializationVectorSize);
+		
+		for (size_t byte = 0; byte < plaintext.size(); byte++)
+		{
+			plaintext[byte] = uint8_t(byte * 3 + 1);
+		}
+		
+		std::vector<Crypto::Mode::CtrMessage> messages{
+			{nullptr, plaintext.data(), 100, ciphertext.data()},
+			{nullptr, plaintext.data() + 100, 50, ciphertext.data() + 100},
+			{nullptr, plaintext.data() + 150, 150, ciphertext.data() + 150}
+		};
+		
+		std::vector<bool> results{
+			Ctr::encrypt(schedule, lane, messages.data(), messages.size(), usedVectors.data()),
+			Ctr::encrypt(schedule, lane, plaintext.data(), plaintext.size(), decrypted.data(), usedVectors.data() + 3 * NonceAllocator::initializationVectorSize)
+		};
+		
+		Ctr::decrypt(schedule, usedVectors.data() + 3 * NonceAllocator::initializationVectorSize, decrypted.data(), decrypted.size(), decrypted.data());
+		
+		CXX_COMPARE(decrypted, plaintext, "CTR with allocated initialization vector");
+		
+		for (const Crypto::Mode::CtrMessage &message : messages)
+		{
+			Ctr::decrypt(schedule, message.initializationVector, message.output, message.size, decrypted.data() + (message.input - plaintext.data()));
+		}
+		
+		CXX_COMPARE(decrypted, plaintext, "CTR batch with allocated initialization vectors");
+		
+		// The invocation field does not wrap around
+		NonceAllocator exhaustedAllocator(7, 4, ~uint64_t(0) - 6);
+		NonceAllocator::Lane exhaustedLane(exhaustedAllocator);
+		NonceAllocator::Lane emptyLane;
+		std::vector<uint8_t> nonce(NonceAllocator::nonceSize);
+		
+		for (size_t vector = 0; vector < 5; vector++)
+		{
+			results.push_back(exhaustedLane.nextNonce(nonce.data()));
+		}
+		
+		results.push_back(exhaustedLane.nextNonce(nonce.data()));
+		results.push_back(emptyLane.nextNonce(nonce.data()));
+		
+		std::vector<bool> expectedResults{true, true, true, true, true, true, false, false, false};
+		
+		CXX_COMPARE(results, expectedResults, "Nonce allocator exhaustion");
+	}
+	
+	TEST(ff1)
+	{
+		using Ff1 = Crypto::Mode::Ff1<Crypto::BlockCipher::Aes::Block128>;
+		
+		std::vector<uint8_t> key{
+			0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+		};
+		
+		Crypto::BlockCipher::Aes::KeySchedule128 schedule(key.data());
+		
+		// NIST SP 800-38G samples 1 to 3
+		std::vector<uint16_t> digits{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+		std::vector<uint8_t> tweak{0x39, 0x38, 0x37, 0x36, 0x35, 0x34, 0x33, 0x32, 0x31, 0x30};
+		std::vector<uint16_t> ciphertext(digits.size());
+		std::vector<uint16_t> expectedCiphertext{2, 4, 3, 3, 4, 7, 7, 4, 8, 4};
+		
+		Ff1::encrypt(schedule, 10, nullptr, 0, digits.data(), digits.size(), ciphertext.data());
+		
+		CXX_COMPARE(ciphertext, expectedCiphertext, "FF1-AES128 sample 1");
+		
+		expectedCiphertext = {6, 1, 2, 4, 2, 0, 0, 7, 7, 3};
+		Ff1::encrypt(schedule, 10, tweak.data(), tweak.size(), digits.data(), digits.size(), ciphertext.data());
+		
+		CXX_COMPARE(ciphertext, expectedCiphertext, "FF1-AES128 sample 2");
+		
+		std::vector<uint16_t> alphanumerics(19);
+		std::vector<uint8_t> otherTweak{0x37, 0x37, 0x37, 0x37, 0x70, 0x71, 0x72, 0x73, 0x37, 0x37, 0x37};
+		
+		for (size_t numeral = 0; numeral < alphanumerics.size(); numeral++)
+		{
+			alphanumerics[numeral] = uint16_t(numeral);
+		}
+		
+		ciphertext.resize(alphanumerics.size());
+		expectedCiphertext = {10, 9, 29, 31, 4, 0, 22, 21, 21, 9, 20, 13, 30, 5, 0, 9, 14, 30, 22};
+		Ff1::encrypt(schedule, 36, otherTweak.data(), otherTweak.size(), alphanumerics.data(), alphanumerics.size(), ciphertext.data());
+		
+		CXX_COMPARE(ciphertext, expectedCiphertext, "FF1-AES128 sample 3");
+		
+		// A long token needs a round output of more than one block, a wide radix the largest numerals
+		std::vector<uint16_t> longToken(61);
+		std::vector<uint16_t> wideToken(9);
+		std::vector<uint8_t> longTweak{'t', 'w', 'e', 'a', 'k'};
+		std::vector<uint8_t> wideTweak(20);
+		
+		for (size_t numeral = 0; numeral < longToken.size(); numeral++)
+		{
+			longToken[numeral] = uint16_t((numeral * 7 + 3) % 10);
+		}
+		
+		for (size_t numeral = 0; numeral < wideToken.size(); numeral++)
+		{
+			wideToken[numeral] = uint16_t((numeral * 977 + 5) % 65536);
+		}
+		
+		for (size_t byte = 0; byte < wideTweak.size(); byte++)
+		{
+			wideTweak[byte] = uint8_t(byte);
+		}
+		
+		ciphertext.resize(longToken.size());
+		expectedCiphertext = {
+			2, 0, 9, 2, 1, 7, 8, 5, 2, 8, 1, 1, 2, 2, 2, 2, 8, 9, 1, 9, 5, 4, 3, 9, 8, 2, 6, 6, 2, 6, 1, 3, 5, 6, 8, 4, 2, 0, 7, 7, 9, 2, 0, 7,
+			0, 3, 0, 1, 4, 9, 4, 2, 5, 5, 8, 8, 8, 9, 2, 4, 2
+		};
+		
+		Ff1::encrypt(schedule, 10, longTweak.data(), longTweak.size(), longToken.data(), longToken.size(), ciphertext.data());
+		
+		CXX_COMPARE(ciphertext, expectedCiphertext, "FF1-AES128 long token");
+		
+		Ff1::decrypt(schedule, 10, longTweak.data(), longTweak.size(), ciphertext.data(), ciphertext.size(), ciphertext.data());
+		
+		CXX_COMPARE(ciphertext, longToken, "FF1-AES128 long token decryption");
+		
+		ciphertext.resize(wideToken.size());
+		expectedCiphertext = {52329, 18487, 33300, 51798, 64304, 12104, 15738, 47196, 62240};
+		Ff1::encrypt(schedule, 65536, wideTweak.data(), wideTweak.size(), wideToken.data(), wideToken.size(), ciphertext.data());
+		
+		CXX_COMPARE(ciphertext, expectedCiphertext, "FF1-AES128 radix 65536");
+		
+		// A batch of card numbers, each with its own tweak, equals encrypting the tokens one by one
+		const size_t tokenCount = 150;
+		const size_t tokenLength = 16;
+		std::vector<uint16_t> tokens(tokenCount * tokenLength);
+		std::vector<uint8_t> tweaks(tokenCount * 4);
+		std::vector<uint16_t> batchCiphertext(tokens.size());
+		std::vector<uint16_t> singleCiphertext(tokens.size());
+		
+		for (size_t numeral = 0; numeral < tokens.size(); numeral++)
+		{
+			tokens[numeral] = uint16_t((numeral * 13 + numeral / 7) % 10);
+		}
+		
+		for (size_t byte = 0; byte < tweaks.size(); byte++)
+		{
+			tweaks[byte] = uint8_t(byte * 29);
+		}
+		
+		Ff1::encrypt(schedule, 10, tweaks.data(), 4, tokens.data(), tokenLength, tokenCount, batchCiphertext.data());
+		
+		for (size_t token = 0; token < tokenCount; token++)
+		{
+			Ff1::encrypt(schedule, 10, tweaks.data() + token * 4, 4, tokens.data() + token * tokenLength, tokenLength,
+					singleCiphertext.data() + token * tokenLength);
+		}
+		
+		CXX_COMPARE(batchCiphertext, singleCiphertext, "FF1-AES128 batch");
+		
+		Ff1::decrypt(schedule, 10, tweaks.data(), 4, batchCiphertext.data(), tokenLength, tokenCount, batchCiphertext.data());
+		
+		CXX_COMPARE(batchCiphertext, tokens, "FF1-AES128 batch decryption");
+		
+		// Domains below a million tokens and numerals outside the radix are rejected
+		std::vector<uint16_t> invalidDigits{1, 2, 3, 4, 10, 6, 7};
+		std::vector<bool> results{
+			Ff1::encrypt(schedule, 10, nullptr, 0, digits.data(), 5, ciphertext.data()),
+			Ff1::encrypt(schedule, 10, nullptr, 0, invalidDigits.data(), invalidDigits.size(), ciphertext.data()),
+			Ff1::encrypt(schedule, 1, nullptr, 0, digits.data(), digits.size(), ciphertext.data()),
+			Ff1::encrypt(schedule, 10, nullptr, 0, digits.data(), 6, ciphertext.data())
+		};
+		std::vector<bool> expectedResults{false, false, false, true};
+		
+		CXX_COMPARE(results, expectedResults, "FF1-AES128 invalid input");
+	}
+	
+	TEST(chaCha20Poly1305)
+	{
+		using ChaCha20 = Crypto::StreamCipher::ChaCha20;
+		using ChaCha20Poly1305 = Crypto::StreamCipher::ChaCha20Poly1305;
+		
+		const std::string message = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+		std::vector<uint8_t> plaintext(message.begin(), message.end());
+		std::vector<uint8_t> key(ChaCha20::keySize);
+		std::vector<uint8_t> nonce{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x00, 0x00};
+		
+		for (size_t byte = 0; byte < key.size(); byte++)
+		{
+			key[byte] = uint8_t(byte);
+		}
+		
+		// RFC 8439 section 2.4.2, which starts at block counter 1
+		std::vector<uint8_t> expectedCiphertext{
+			0x6e, 0x2e, 0x35, 0x9a, 0x25, 0x68, 0xf9, 0x80, 0x41, 0xba, 0x07, 0x28, 0xdd, 0x0d, 0x69, 0x81,
+			0xe9, 0x7e, 0x7a, 0xec, 0x1d, 0x43, 0x60, 0xc2, 0x0a, 0x27, 0xaf, 0xcc, 0xfd, 0x9f, 0xae, 0x0b,
+			0xf9, 0x1b, 0x65, 0xc5, 0x52, 0x47, 0x33, 0xab, 0x8f, 0x59, 0x3d, 0xab, 0xcd, 0x62, 0xb3, 0x57,
+			0x16, 0x39, 0xd6, 0x24, 0xe6, 0x51, 0x52, 0xab, 0x8f, 0x53, 0x0c, 0x35, 0x9f, 0x08, 0x61, 0xd8,
+			0x07, 0xca, 0x0d, 0xbf, 0x50, 0x0d, 0x6a, 0x61, 0x56, 0xa3, 0x8e, 0x08, 0x8a, 0x22, 0xb6, 0x5e,
+			0x52, 0xbc, 0x51, 0x4d, 0x16, 0xcc, 0xf8, 0x06, 0x81, 0x8c, 0xe9, 0x1a, 0xb7, 0x79, 0x37, 0x36,
+			0x5a, 0xf9, 0x0b, 0xbf, 0x74, 0xa3, 0x5b, 0xe6, 0xb4, 0x0b, 0x8e, 0xed, 0xf2, 0x78, 0x5e, 0x42,
+			0x87, 0x4d
+		};
+		std::vector<uint8_t> ciphertext(plaintext.size());
+		
+		ChaCha20::encrypt(ChaCha20::KeyType(key.data()), nonce.data(), ChaCha20::blockSize, plaintext.data(), plaintext.size(), ciphertext.data());
+		
+		CXX_COMPARE(ciphertext, expectedCiphertext, "ChaCha20 RFC 8439");
+		
+		// RFC 8439 section 2.5.2, passed in one piece and in pieces crossing block boundaries
+		std::vector<uint8_t> macKey{
+			0x85, 0xd6, 0xbe, 0x78, 0x57, 0x55, 0x6d, 0x33, 0x7f, 0x44, 0x52, 0xfe, 0x42, 0xd5, 0x06, 0xa8,
+			0x01, 0x03, 0x80, 0x8a, 0xfb, 0x0d, 0xb2, 0xfd, 0x4a, 0xbf, 0xf6, 0xaf, 0x41, 0x49, 0xf5, 0x1b
+		};
+		
+		const std::string macMessage = "Cryptographic Forum Research Group";
+		std::vector<uint8_t> macData(macMessage.begin(), macMessage.end());
+		std::vector<uint8_t> expectedMac{
+			0xa8, 0x06, 0x1d, 0xc1, 0x30, 0x51, 0x36, 0xc6, 0xc2, 0x2b, 0x8b, 0xaf, 0x0c, 0x01, 0x27, 0xa9
+		};
+		std::vector<uint8_t> mac(Crypto::Hash::Poly1305::macSize);
+		
+		Crypto::Hash::Poly1305::compute(macKey.data(), macData.data(), macData.size(), mac.data());
+		
+		CXX_COMPARE(mac, expectedMac, "Poly1305 RFC 8439");
+		
+		Crypto::Hash::Poly1305 authenticator(macKey.data());
+		
+		authenticator.update(macData.data(), 1);
+		authenticator.update(macData.data() + 1, 20);
+		authenticator.update(macData.data() + 21, macData.size() - 21);
+		authenticator.finalize(mac.data());
+		
+		CXX_COMPARE(mac, expectedMac, "Poly1305 in pieces");
+		
+		// RFC 8439 section 2.8.2
+		std::vector<uint8_t> aeadKey(ChaCha20::keySize);
+		std::vector<uint8_t> aeadNonce{0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47};
+		std::vector<uint8_t> additionalData{0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7};
+		
+		for (size_t byte = 0; byte < aeadKey.size(); byte++)
+		{
+			aeadKey[byte] = uint8_t(0x80 + byte);
+		}
+		
+		std::vector<uint8_t> aeadCiphertext{
+			0xd3, 0x1a, 0x8d, 0x34, 0x64, 0x8e, 0x60, 0xdb, 0x7b, 0x86, 0xaf, 0xbc, 0x53, 0xef, 0x7e, 0xc2,
+			0xa4, 0xad, 0xed, 0x51, 0x29, 0x6e, 0x08, 0xfe, 0xa9, 0xe2, 0xb5, 0xa7, 0x36, 0xee, 0x62, 0xd6,
+			0x3d, 0xbe, 0xa4, 0x5e, 0x8c, 0xa9, 0x67, 0x12, 0x82, 0xfa, 0xfb, 0x69, 0xda, 0x92, 0x72, 0x8b,
+			0x1a, 0x71, 0xde, 0x0a, 0x9e, 0x06, 0x0b, 0x29, 0x05, 0xd6, 0xa5, 0xb6, 0x7e, 0xcd, 0x3b, 0x36,
+			0x92, 0xdd, 0xbd, 0x7f, 0x2d, 0x77, 0x8b, 0x8c, 0x98, 0x03, 0xae, 0xe3, 0x28, 0x09, 0x1b, 0x58,
+			0xfa, 0xb3, 0x24, 0xe4, 0xfa, 0xd6, 0x75, 0x94, 0x55, 0x85, 0x80, 0x8b, 0x48, 0x31, 0xd7, 0xbc,
+			0x3f, 0xf4, 0xde, 0xf0, 0x8e, 0x4b, 0x7a, 0x9d, 0xe5, 0x76, 0xd2, 0x65, 0x86, 0xce, 0xc6, 0x4b,
+			0x61, 0x16
+		};
+		std::vector<uint8_t> expectedTag{
+			0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09, 0xe2, 0x6a, 0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60, 0x06, 0x91
+		};
+		
+		const ChaCha20Poly1305::KeyType aeadKeyObj(aeadKey.data());
+		std::vector<uint8_t> tag(ChaCha20Poly1305::tagSize);
+		
+		ChaCha20Poly1305::encrypt(aeadKeyObj, aeadNonce.data(), additionalData.data(), additionalData.size(), plaintext.data(), plaintext.size(),
+				ciphertext.data(), tag.data());
+		
+		CXX_COMPARE(ciphertext, aeadCiphertext, "ChaCha20-Poly1305 RFC 8439 ciphertext");
+		CXX_COMPARE(tag, expectedTag, "ChaCha20-Poly1305 RFC 8439 tag");
+		
+		std::vector<uint8_t> decrypted(plaintext.size());
+		
+		CXX_COMPARE(ChaCha20Poly1305::decrypt(aeadKeyObj, aeadNonce.data(), additionalData.data(), additionalData.size(), ciphertext.data(),
+				ciphertext.size(), tag.data(), decrypted.data()), true, "ChaCha20-Poly1305 tag accepted");
+		CXX_COMPARE(decrypted, plaintext, "ChaCha20-Poly1305 decrypt");
+		
+		// A forged tag or additional data must not release any plaintext
+		std::vector<uint8_t> untouched(plaintext.size(), 0xaa);
+		
+		tag[15] ^= 0x01;
+		decrypted = untouched;
+		
+		CXX_COMPARE(ChaCha20Poly1305::decrypt(aeadKeyObj, aeadNonce.data(), additionalData.data(), additionalData.size(), ciphertext.data(),
+				ciphertext.size(), tag.data(), decrypted.data()), false, "ChaCha20-Poly1305 forged tag rejected");
+		CXX_COMPARE(decrypted, untouched, "ChaCha20-Poly1305 output untouched");
+		
+		tag[15] ^= 0x01;
+		
+		CXX_COMPARE(ChaCha20Poly1305::decrypt(aeadKeyObj, aeadNonce.data(), additionalData.data(), additionalData.size() - 1, ciphertext.data(),
+				ciphertext.size(), tag.data(), decrypted.data()), false, "ChaCha20-Poly1305 truncated additional data rejected");
+		
+		// Messages beyond the 32 bit block counter are rejected before any buffer is touched
+		const size_t oversize = size_t(ChaCha20Poly1305::maxMessageSize + 1);
+		std::vector<bool> limits{
+			ChaCha20Poly1305::encrypt(aeadKeyObj, aeadNonce.data(), nullptr, 0, nullptr, oversize, nullptr, nullptr),
+			ChaCha20Poly1305::decrypt(aeadKeyObj, aeadNonce.data(), nullptr, 0, nullptr, oversize, nullptr, nullptr),
+			ChaCha20::encrypt(ChaCha20::KeyType(key.data()), nonce.data(), ChaCha20::maxStreamSize, nullptr, 1, nullptr),
+			ChaCha20::encrypt(ChaCha20::KeyType(key.data()), nonce.data(), ChaCha20::blockSize, nullptr, oversize, nullptr),
+			ChaCha20::isWithinStream(ChaCha20::maxStreamSize - ChaCha20::blockSize, ChaCha20::blockSize)
+		};
+		std::vector<bool> expectedLimits{false, false, false, false, true};
+		
+		CXX_COMPARE(limits, expectedLimits, "ChaCha20 stream limit");
+		
+		// Every kernel set against the generic one, with partial blocks at both ends and in place
+		std::vector<uint8_t> longPlaintext(100 * ChaCha20::blockSize + 29);
+		std::vector<uint8_t> expectedLong(longPlaintext.size());
+		
+		for (size_t byte = 0; byte < longPlaintext.size(); byte++)
+		{
+			longPlaintext[byte] = uint8_t(byte * 7 + 1);
+		}
+		
+		Crypto::Cpu::restrictFeatures(0);
+		ChaCha20::encrypt(ChaCha20::KeyType(key.data()), nonce.data(), 37, longPlaintext.data(), longPlaintext.size(), expectedLong.data());
+		
+		const uint32_t featureMasks[] = {
+			Crypto::Cpu::AllFeatures,
+			Crypto::Cpu::Avx2 | Crypto::Cpu::Sse2,
+			Crypto::Cpu::Sse2
+		};
+		
+		for (const uint32_t featureMask : featureMasks)
+		{
+			Crypto::Cpu::restrictFeatures(featureMask);
+			
+			std::vector<uint8_t> longCiphertext(longPlaintext);
+			
+			ChaCha20::encrypt(ChaCha20::KeyType(key.data()), nonce.data(), 37, longCiphertext.data(), longCiphertext.size(), longCiphertext.data());
+			
+			CXX_COMPARE(longCiphertext, expectedLong, "ChaCha20 kernels");
+			
+			// Decrypt a range starting in the middle of a block
+			std::vector<uint8_t> range(longCiphertext.begin() + 1000, longCiphertext.end());
+			std::vector<uint8_t> expectedRange(longPlaintext.begin() + 1000, longPlaintext.end());
+			
+			ChaCha20::decrypt(ChaCha20::KeyType(key.data()), nonce.data(), 1037, range.data(), range.size(), range.data());
+			
+			CXX_COMPARE(range, expectedRange, "ChaCha20 seek");
+		}
+		
+		Crypto::Cpu::restrictFeatures(Crypto::Cpu::AllFeatures);
+	}
+	
+	TEST(convergentEncryption)
+	{
+		using ConvergentEncryption = Crypto::Mode::ConvergentEncryption<Crypto::BlockCipher::Aes::Block256>;
+		
+		// Key, chunk ID and ciphertext of a known chunk, computed with independent SHA-256 and AES-256-CTR implementations
+		const std::string message = "convergent";
+		std::vector<uint8_t> plaintext(message.begin(), message.end());
+		std::vector<uint8_t> expectedKey{
+			0x53, 0x0c, 0x63, 0xcd, 0x3f, 0x2c, 0x01, 0x76, 0x3b, 0xe7, 0x80, 0x05, 0x31, 0x93, 0x45, 0x26,
+			0x2e, 0x46, 0x3e, 0x57, 0xde, 0x08, 0x58, 0x41, 0x4d, 0xd9, 0x89, 0x9c, 0x41, 0x9a, 0x48, 0xa6
+		};
+		std::vector<uint8_t> expectedChunkId{
+			0x30, 0x2b, 0x5b, 0x89, 0x26, 0x53, 0x6e, 0x88, 0xf3, 0xe1, 0x46, 0x95, 0x05, 0x7d, 0x8d, 0x8c,
+			0x3c, 0x39, 0x0b, 0x04, 0xcf, 0xc1, 0x49, 0xa1, 0xe8, 0xb6, 0x27, 0xa6, 0xca, 0x5a, 0x9f, 0x63
+		};
+		std::vector<uint8_t> expectedCiphertext{0x18, 0xfd, 0xe9, 0x6a, 0xd4, 0x0f, 0x3c, 0xa8, 0xd6, 0x03};
+		std::vector<uint8_t> ciphertext(plaintext.size());
+		std::vector<uint8_t> chunkId(ConvergentEncryption::chunkIdSize);
+		std::vector<uint8_t> key(ConvergentEncryption::keySize);
+		
+		ConvergentEncryption::encrypt(plaintext.data(), plaintext.size(), ciphertext.data(), chunkId.data(), key.data());
+		
+		CXX_COMPARE(key, expectedKey, "Convergent key");
+		CXX_COMPARE(chunkId, expectedChunkId, "Convergent chunk ID");
+		CXX_COMPARE(ciphertext, expectedCiphertext, "Convergent ciphertext");
+		
+		// A batch spanning several groups, with sizes around the hash padding boundaries and repeated contents, some in place
+		const std::vector<size_t> sizes{0, 1, 55, 56, 63, 64, 65, 1000, 4096, 70001, 55, 3, 129, 4096, 17, 8192, 0, 100, 31, 64, 1};
+		std::vector<std::vector<uint8_t>> plaintexts(sizes.size());
+		std::vector<std::vector<uint8_t>> ciphertexts(sizes.size());
+		std::vector<uint8_t> chunkIds(sizes.size() * ConvergentEncryption::chunkIdSize);
+		std::vector<uint8_t> keys(sizes.size() * ConvergentEncryption::keySize);
+		std::vector<Crypto::Mode::ConvergentChunk> chunks(sizes.size());
+		
+		for (size_t chunk = 0; chunk < sizes.size(); chunk++)
+		{
+			plaintexts[chunk].resize(sizes[chunk]);
+			
+			// Equal sizes get equal contents
+			for (size_t byte = 0; byte < sizes[chunk]; byte++)
+			{
+				plaintexts[chunk][byte] = uint8_t(byte * 13 + sizes[chunk]);
+			}
+			
+			ciphertexts[chunk] = ((chunk % 3) == 0) ? plaintexts[chunk] : std::vector<uint8_t>(sizes[chunk]);
+			chunks[chunk] = {
+				((chunk % 3) == 0) ? ciphertexts[chunk].data() : plaintexts[chunk].data(),
+				sizes[chunk],
+				ciphertexts[chunk].data(),
+				chunkIds.data() + chunk * ConvergentEncryption::chunkIdSize,
+				keys.data() + chunk * ConvergentEncryption::keySize
+			};
+		}
+		
+		ConvergentEncryption::encrypt(chunks.data(), chunks.size());
+		
+		for (size_t chunk = 0; chunk < sizes.size(); chunk++)
+		{
+			// The serial steps the batch replaces: hash, hash the hash, encrypt from a zero counter
+			Crypto::Hash::Sha2::Digest256 digest;
+			std::vector<uint8_t> chunkKey(ConvergentEncryption::keySize);
+			std::vector<uint8_t> keyHash(ConvergentEncryption::chunkIdSize);
+			std::vector<uint8_t> referenceCiphertext(sizes[chunk]);
+			const uint8_t initializationVector[16] = {};
+			
+			digest.hash(plaintexts[chunk].data(), sizes[chunk]);
+			digest.extract(chunkKey.data());
+			
+			Crypto::Hash::Sha2::Digest256 idDigest;
+			
+			idDigest.hash(chunkKey.data(), chunkKey.size());
+			idDigest.extract(keyHash.data());
+			Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block256>::encrypt(Crypto::BlockCipher::Aes::KeySchedule256(chunkKey.data()),
+					initializationVector, plaintexts[chunk].data(), sizes[chunk], referenceCiphertext.data());
+			
+			std::vector<uint8_t> batchKey(keys.begin() + chunk * ConvergentEncryption::keySize,
+					keys.begin() + (chunk + 1) * ConvergentEncryption::keySize);
+			std::vector<uint8_t> batchChunkId(chunkIds.begin() + chunk * ConvergentEncryption::chunkIdSize,
+					chunkIds.begin() + (chunk + 1) * ConvergentEncryption::chunkIdSize);
+			
+			CXX_COMPARE(batchKey, chunkKey, "Convergent batch key");
+			CXX_COMPARE(batchChunkId, keyHash, "Convergent batch chunk ID");
+			CXX_COMPARE(ciphertexts[chunk], referenceCiphertext, "Convergent batch ciphertext");
+		}
+		
+		CXX_COMPARE(ciphertexts[13], ciphertexts[8], "Convergent deduplication");
+		
+		// Decryption checks the plaintext against the key
+		std::vector<uint8_t> decrypted(sizes[9]);
+		
+		CXX_COMPARE(ConvergentEncryption::decrypt(keys.data() + 9 * ConvergentEncryption::keySize, ciphertexts[9].data(), sizes[9], decrypted.data()),
+				true, "Convergent decrypt verified");
+		CXX_COMPARE(decrypted, plaintexts[9], "Convergent decrypt");
+		
+		ciphertexts[9][40000] ^= 0x01;
+		
+		CXX_COMPARE(ConvergentEncryption::decrypt(keys.data() + 9 * ConvergentEncryption::keySize, ciphertexts[9].data(), sizes[9], decrypted.data()),
+				false, "Convergent corruption detected");
+	}
+	
+	TEST(keyRotation)
+	{
+		using Ctr128 = Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block128>;
+		using Ctr256 = Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block256>;
+		using Cbc128 = Crypto::Mode::Cbc<Crypto::BlockCipher::Aes::Block128>;
+		using KeyRotation = Crypto::Mode::KeyRotation<Crypto::BlockCipher::Aes::Block128, Crypto::BlockCipher::Aes::Block256>;
+		
+		std::vector<uint8_t> plaintext(200003);
+		
+		for (size_t byte = 0; byte < plaintext.size(); byte++)
+		{
+			plaintext[byte] = uint8_t(byte * 13 + 7);
+		}
+		
+		std::vector<uint8_t> oldKey{
+			0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+		};
+		
+		std::vector<uint8_t> newKey{
+			0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+			0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4
+		};
+		
+		std::vector<uint8_t> oldInitializationVector{
+			0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+		};
+		
+		std::vector<uint8_t> newInitializationVector{
+			0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+		};
+		
+		Crypto::BlockCipher::Aes::KeySchedule128 oldSchedule(oldKey.data());
+		Crypto::BlockCipher::Aes::KeySchedule256 newSchedule(newKey.data());
+		std::vector<uint8_t> oldCiphertext(plaintext.size());
+		std::vector<uint8_t> expectedCiphertext(plaintext.size());
+		
+		Ctr128::encrypt(oldSchedule, oldInitializationVector.data(), plaintext.data(), plaintext.size(), oldCiphertext.data());
+		Ctr256::encrypt(newSchedule, newInitializationVector.data(), plaintext.data(), plaintext.size(), expectedCiphertext.data());
+		
+		// CTR to CTR in one call and resumed in place at an offset inside a block
+		std::vector<uint8_t> ciphertext(plaintext.size());
+		
+		KeyRotation::ctrToCtr(oldSchedule, oldInitializationVector.data(), newSchedule, newInitializationVector.data(), 0, oldCiphertext.data(),
+				oldCiphertext.size(), ciphertext.data());
+		
+		CXX_COMPARE(ciphertext, expectedCiphertext, "AES-128 CTR to AES-256 CTR");
+		
+		ciphertext = oldCiphertext;
+		KeyRotation::ctrToCtr(oldSchedule, oldInitializationVector.data(), newSchedule, newInitializationVector.data(), 0, ciphertext.data(), 70001,
+				ciphertext.data());
+		KeyRotation::ctrToCtr(oldSchedule, oldInitializationVector.data(), newSchedule, newInitializationVector.data(), 70001, ciphertext.data() + 70001,
+				ciphertext.size() - 70001, ciphertext.data() + 70001);
+		
+		CXX_COMPARE(ciphertext, expectedCiphertext, "AES-128 CTR to AES-256 CTR resumed");
+		
+		// CBC to CTR with padding, resumed in place after a part of whole blocks
+		std::vector<uint8_t> cbcCiphertext(Cbc128::ciphertextSize(plaintext.size(), Crypto::Mode::PaddingType::NBytes));
+		const size_t firstPart = 65536 + 32;
+		
+		Cbc128::encrypt(oldSchedule, oldInitializationVector.data(), plaintext.data(), plaintext.size(), cbcCiphertext.data(),
+				Crypto::Mode::PaddingType::NBytes);
+		
+		std::vector<uint8_t> chainBlock(cbcCiphertext.begin() + firstPart - AES_BLOCK_SIZE, cbcCiphertext.begin() + firstPart);
+		std::vector<size_t> sizes;
+		
+		sizes.push_back(KeyRotation::cbcToCtr(oldSchedule, oldInitializationVector.data(), newSchedule, newInitializationVector.data(), 0,
+				cbcCiphertext.data(), firstPart, cbcCiphertext.data()));
+		sizes.push_back(KeyRotation::cbcToCtr(oldSchedule, chainBlock.data(), newSchedule, newInitializationVector.data(), firstPart,
+				cbcCiphertext.data() + firstPart, cbcCiphertext.size() - firstPart, cbcCiphertext.data() + firstPart, Crypto::Mode::PaddingType::NBytes));
+		cbcCiphertext.resize(plaintext.size());
+		
+		std::vector<size_t> expectedSizes{firstPart, plaintext.size() - firstPart};
+		
+		CXX_COMPARE(sizes, expectedSizes, "AES-128 CBC to AES-256 CTR sizes");
+		CXX_COMPARE(cbcCiphertext, expectedCiphertext, "AES-128 CBC to AES-256 CTR");
+		
+		// Ciphertext stealing keeps the size, malformed padding is rejected
+		std::vector<uint8_t> stolenCiphertext(1000);
+		std::vector<uint8_t> rotatedCiphertext(stolenCiphertext.size());
+		std::vector<uint8_t> expectedRotatedCiphertext(expectedCiphertext.begin(), expectedCiphertext.begin() + 1000);
+		
+		Cbc128::encrypt(oldSchedule, oldInitializationVector.data(), plaintext.data(), 1000, stolenCiphertext.data(), Crypto::Mode::PaddingType::CipherTextStealing);
+		
+		sizes = {
+			KeyRotation::cbcToCtr(oldSchedule, oldInitializationVector.data(), newSchedule, newInitializationVector.data(), 0, stolenCiphertext.data(),
+					stolenCiphertext.size(), rotatedCiphertext.data(), Crypto::Mode::PaddingType::CipherTextStealing),
+			KeyRotation::cbcToCtr(oldSchedule, oldInitializationVector.data(), newSchedule, newInitializationVector.data(), 0, stolenCiphertext.data(),
+					992, rotatedCiphertext.data(), Crypto::Mode::PaddingType::NBytes)
+		};
+		
+		expectedSizes = {1000, KeyRotation::invalidSize};
+		
+		CXX_COMPARE(sizes, expectedSizes, "AES-128 CBC-CS3 to AES-256 CTR sizes");
+		CXX_COMPARE(rotatedCiphertext, expectedRotatedCiphertext, "AES-128 CBC-CS3 to AES-256 CTR");
+	}
+	
+	TEST(ctrBatch)
+	{
+		const size_t messageCount = 300;
+		std::vector<uint8_t> key{
+			0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+		};
+		
+		// Message sizes between 0 and 499 bytes, most of them without whole blocks
+		std::vector<size_t> offsets(messageCount + 1);
+		
+		for (size_t message = 0; message < messageCount; message++)
+		{
+			offsets[message + 1] = offsets[message] + (message * 37) % 500;
+		}
+		
+		std::vector<uint8_t> plaintext(offsets[messageCount]);
+		std::vector<uint8_t> initializationVectors(messageCount * AES_BLOCK_SIZE);
+		
+		for (size_t byte = 0; byte < plaintext.size(); byte++)
+		{
+			plaintext[byte] = uint8_t(byte * 11);
+		}
+		
+		for (size_t byte = 0; byte < initializationVectors.size(); byte++)
+		{
+			initializationVectors[byte] = uint8_t(0xff - byte);
+		}
+		
+		std::vector<uint8_t> ciphertext(plaintext.size());
+		std::vector<uint8_t> expectedCiphertext(plaintext.size());
+		std::vector<Crypto::Mode::CtrMessage> messages(messageCount);
+		
+		using Ctr = Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block128>;
+		Crypto::BlockCipher::Aes::KeySchedule128 schedule(key.data());
+		
+		for (size_t message = 0; message < messageCount; message++)
+		{
+			messages[message] = {
+				initializationVectors.data() + message * AES_BLOCK_SIZE,
+				plaintext.data() + offsets[message],
+				offsets[message + 1] - offsets[message],
+				ciphertext.data() + offsets[message]
+			};
+			
+			Ctr::encrypt(schedule, messages[message].initializationVector, messages[message].input, messages[message].size,
+					expectedCiphertext.data() + offsets[message]);
+		}
+		
+		Ctr::encrypt(schedule, messages.data(), messages.size());
+		
+		CXX_COMPARE(ciphertext, expectedCiphertext, "AES-128 CTR batch");
+		
+		// Decrypt in place
+		for (Crypto::Mode::CtrMessage &message : messages)
+		{
+			message.input = message.output;
+		}
+		
+		Ctr::decrypt(schedule, messages.data(), messages.size());
+		
+		CXX_COMPARE(ciphertext, plaintext, "AES-128 CTR batch in place");
+	}
+	
+	TEST(scatterGather)
+	{
+		using Ctr = Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block128>;
+		using Cbc = Crypto::Mode::Cbc<Crypto::BlockCipher::Aes::Block128>;
+		using Crypto::Mode::PaddingType;
+		
+		std::vector<uint8_t> plaintext(1000);
+		
+		// Generate plaintext
+		for (size_t byte = 0; byte < plaintext.size(); byte++)
+		{
+			plaintext[byte] = uint8_t(byte * 5 + 1);
+		}
+		
+		std::vector<uint8_t> key{
+			0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+		};
+		
+		std::vector<uint8_t> initializationVector{
+			0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+		};
+		
+		// Splits a buffer into fragments of the repeated sizes of a pattern, including empty ones
+		auto fragment = [](std::vector<uint8_t> &buffer, const std::vector<size_t> &pattern){
+			std::vector<iovec> fragments;
+			
+			for (size_t offset = 0, index = 0; offset < buffer.size(); index++)
+			{
+				const size_t size = ((buffer.size() - offset) < pattern[index % pattern.size()]) ? (buffer.size() - offset) : pattern[index % pattern.size()];
+				
+				fragments.push_back(iovec{buffer.data() + offset, size});
+				offset += size;
+			}
+			
+			return fragments;
+		};
+		
+		const std::vector<size_t> inputPattern{1, 0, 15, 33, 16, 7, 100, 2};
+		const std::vector<size_t> outputPattern{40, 3, 0, 17, 64, 9};
+		
+		Crypto::BlockCipher::Aes128Key keyObj(key.data());
+		const Crypto::BlockCipher::Aes::KeySchedule128 schedule(keyObj);
+		
+		std::vector<uint8_t> input(plaintext);
+		std::vector<uint8_t> ciphertext(plaintext.size());
+		std::vector<uint8_t> expectedCiphertext(plaintext.size());
+		std::vector<iovec> inputFragments = fragment(input, inputPattern);
+		std::vector<iovec> outputFragments = fragment(ciphertext, outputPattern);
+		
+		Ctr::encrypt(schedule, initializationVector.data(), plaintext.data(), plaintext.size(), expectedCiphertext.data());
+		Ctr::encrypt(schedule, initializationVector.data(), inputFragments.data(), inputFragments.size(), outputFragments.data(), outputFragments.size());
+		
+		CXX_COMPARE(ciphertext, expectedCiphertext, "AES-128 CTR scatter/gather");
+		
+		Ctr::decrypt(schedule, initializationVector.data(), outputFragments.data(), outputFragments.size(), outputFragments.data(), outputFragments.size());
+		
+		CXX_COMPARE(ciphertext, plaintext, "AES-128 CTR scatter/gather in place");
+		
+		for (const PaddingType padding : {PaddingType::Nulls, PaddingType::NBytes, PaddingType::CipherTextStealing})
+		{
+			for (const size_t size : {size_t(0), size_t(15), size_t(16), size_t(17), size_t(32), size_t(47), size_t(64), size_t(1000)})
+			{
+				std::vector<uint8_t> message(plaintext.begin(), plaintext.begin() + size);
+				std::vector<uint8_t> expectedBuffer(Cbc::ciphertextSize(size, padding));
+				std::vector<uint8_t> buffer(expectedBuffer.size());
+				std::vector<uint8_t> decryptedMessage(buffer.size());
+				std::vector<iovec> messageFragments = fragment(message, inputPattern);
+				std::vector<iovec> bufferFragments = fragment(buffer, outputPattern);
+				std::vector<iovec> decryptedFragments = fragment(decryptedMessage, inputPattern);
+				
+				const size_t expectedSize = Cbc::encrypt(schedule, initializationVector.data(), message.data(), size, expectedBuffer.data(), padding);
+				const size_t ciphertextSize = Cbc::encrypt(schedule, initializationVector.data(), messageFragments.data(), messageFragments.size(),
+														   bufferFragments.data(), bufferFragments.size(), padding);
+				const size_t plaintextSize = Cbc::decrypt(schedule, initializationVector.data(), bufferFragments.data(), bufferFragments.size(),
+														  decryptedFragments.data(), decryptedFragments.size(), padding);
+				
+				// Null padding is kept on decryption
+				decryptedMessage.resize((plaintextSize == Cbc::invalidSize) ? 0 : ((padding == PaddingType::Nulls) ? size : plaintextSize));
+				message.resize((expectedSize == Cbc::invalidSize) ? 0 : size);
+				
+				std::vector<size_t> sizes{ciphertextSize};
+				std::vector<size_t> expectedSizes{expectedSize};
+				
+				CXX_COMPARE(sizes, expectedSizes, "AES-128 CBC scatter/gather size");
+				CXX_COMPARE(buffer, expectedBuffer, "AES-128 CBC scatter/gather");
+				CXX_COMPARE(decryptedMessage, message, "AES-128 CBC scatter/gather round trip");
+			}
+		}
+	}
+	
+	TEST(container)
+	{
+		std::vector<uint8_t> plaintext(100000);
+		
+		for (size_t byte = 0; byte < plaintext.size(); byte++)
+		{
+			plaintext[byte] = uint8_t(byte * 7 + 3);
+		}
+		
+		std::vector<uint8_t> key(AES_256_KEY_SIZE, 0x42);
+		std::vector<uint8_t> objectNonce(Crypto::Container::nonceSize, 0x24);
+		Crypto::BlockCipher::Aes256Key keyObj(key.data());
+		std::stringstream stream;
+		
+		// Several batches of chunks and a short last chunk
+		Crypto::Container::Writer writer(stream, keyObj, objectNonce.data(), 4096, 4);
+		CXX_COMPARE(writer.write(plaintext.data(), 30000), true, "container write");
+		CXX_COMPARE(writer.write(plaintext.data() + 30000, plaintext.size() - 30000), true, "container write");
+		CXX_COMPARE(writer.finish(), true, "container finish");
+		
+		Crypto::Container::Reader reader(stream, keyObj);
+		CXX_COMPARE(reader.isValid(), true, "container index");
+		CXX_COMPARE(reader.chunkCount(), uint64_t(25), "container chunk count");
+		
+		std::vector<uint8_t> decryptedPlaintext(plaintext.size());
+		CXX_COMPARE(reader.read(0, plaintext.size(), decryptedPlaintext.data()), true, "container read");
+		CXX_COMPARE(decryptedPlaintext, plaintext, "container read");
+		
+		std::vector<uint8_t> range(5000);
+		std::vector<uint8_t> expectedRange(plaintext.begin() + 8190, plaintext.begin() + 13190);
+		CXX_COMPARE(reader.read(8190, range.size(), range.data()), true, "container range");
+		CXX_COMPARE(range, expectedRange, "container range");
+		
+		// Tamper with the third chunk
+		std::string container = stream.str();
+		container[Crypto::Container::headerSize + 2 * 4096 + 1] ^= 1;
+		std::stringstream tamperedStream(container);
+		Crypto::Container::Reader tamperedReader(tamperedStream, keyObj);
+		
+		CXX_COMPARE(tamperedReader.isValid(), true, "tampered container index");
+		CXX_COMPARE(tamperedReader.readChunks(0, 2, decryptedPlaintext.data()), true, "untouched chunks");
+		CXX_COMPARE(tamperedReader.readChunks(1, 2, decryptedPlaintext.data()), false, "tampered chunk");
+		
+		// Truncated container and wrong key
+		std::stringstream truncatedStream(container.substr(0, container.size() - 1));
+		std::vector<uint8_t> otherKey(AES_256_KEY_SIZE, 0x43);
+		Crypto::BlockCipher::Aes256Key otherKeyObj(otherKey.data());
+		
+		CXX_COMPARE(Crypto::Container::Reader(truncatedStream, keyObj).isValid(), false, "truncated container");
+		CXX_COMPARE(Crypto::Container::Reader(stream, otherKeyObj).isValid(), false, "wrong container key");
+	}
+	
+	TEST(mapping)
+	{
+		std::vector<uint8_t> plaintext(5 * 4096 + 100);
+		
+		for (size_t byte = 0; byte < plaintext.size(); byte++)
+		{
+			plaintext[byte] = uint8_t(byte * 11 + 5);
+		}
+		
+		std::vector<uint8_t> key(AES_128_KEY_SIZE, 0x17);
+		std::vector<uint8_t> initializationVector(AES_BLOCK_SIZE, 0xfe);
+		std::vector<uint8_t> ciphertext(plaintext.size());
+		Crypto::BlockCipher::Aes128Key keyObj(key.data());
+		
+		using Ctr = Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block128>;
+		Ctr::encrypt(keyObj, initializationVector.data(), plaintext.data(), plaintext.size(), ciphertext.data());
+		
+		char path[] = "/tmp/aestestXXXXXX";
+		const int fd = mkstemp(path);
+		unlink(path);
+		CXX_COMPARE(pwrite(fd, ciphertext.data(), ciphertext.size(), 0), ssize_t(ciphertext.size()), "mapping file");
+		
+		{
+			Crypto::Mode::CtrMapping<Crypto::BlockCipher::Aes::Block128> mapping(fd, keyObj, initializationVector.data(), true);
+			
+			// userfaultfd may be disabled for unprivileged processes
+			if (mapping.isValid())
+			{
+				CXX_COMPARE(mapping.loadedPages(), size_t(0), "mapping untouched");
+				CXX_COMPARE(mapping.data()[3 * 4096 + 5], plaintext[3 * 4096 + 5], "mapping page");
+				CXX_COMPARE(mapping.loadedPages(), size_t(1), "mapping single page");
+				
+				std::vector<uint8_t> mapped(mapping.data(), mapping.data() + mapping.size());
+				CXX_COMPARE(mapped, plaintext, "mapping contents");
+				
+				// The plaintext must not end up in core dumps
+				std::ifstream memoryMaps("/proc/self/smaps");
+				std::ostringstream mappingStart;
+				std::string line;
+				bool inMapping = false;
+				bool excludedFromDumps = false;
+				
+				mappingStart << std::hex << reinterpret_cast<uintptr_t>(mapping.data()) << "-";
+				
+				while (std::getline(memoryMaps, line))
+				{
+					if ((line.find('-') != std::string::npos) && (line.find(':') > line.find(' ')))
+					{
+						inMapping = (line.compare(0, mappingStart.str().size(), mappingStart.str()) == 0);
+					}
+					else if (inMapping && (line.compare(0, 8, "VmFlags:") == 0))
+					{
+						excludedFromDumps = (line.find(" dd") != std::string::npos);
+					}
+				}
+				
+				CXX_COMPARE(excludedFromDumps, true, "mapping excluded from core dumps");
+				
+				// Modify the first and the partial last page
+				mapping.data()[10] = 0x55;
+				mapping.data()[5 * 4096 + 99] ^= 0xff;
+				plaintext[10] = 0x55;
+				plaintext[5 * 4096 + 99] ^= 0xff;
+				CXX_COMPARE(mapping.sync(), true, "mapping sync");
+			}
+		}
+		
+		std::vector<uint8_t> decryptedPlaintext(plaintext.size());
+		CXX_COMPARE(pread(fd, ciphertext.data(), ciphertext.size(), 0), ssize_t(ciphertext.size()), "mapping file");
+		Ctr::decrypt(keyObj, initializationVector.data(), ciphertext.data(), ciphertext.size(), decryptedPlaintext.data());
+		CXX_COMPARE(decryptedPlaintext, plaintext, "mapping written back");
+		
+		// A page whose ciphertext cannot be read must not overwrite the file with encrypted zeros, even if it is modified
+		bool truncated = false;
+		
+		{
+			Crypto::Mode::CtrMapping<Crypto::BlockCipher::Aes::Block128> mapping(fd, keyObj, initializationVector.data(), true);
+			
+			if (mapping.isValid())
+			{
+				truncated = (ftruncate(fd, 4096) == 0);
+				CXX_COMPARE(mapping.data()[2 * 4096 + 7], uint8_t(0), "mapping failed page");
+				mapping.data()[2 * 4096 + 7] = 0x55;
+				CXX_COMPARE(mapping.hasFailed(), true, "mapping failure reported");
+				CXX_COMPARE(mapping.loadedPages(), size_t(0), "mapping failed page not loaded");
+				CXX_COMPARE(mapping.sync(), false, "mapping sync after failed read");
+			}
+		}
+		
+		if (truncated)
+		{
+			CXX_COMPARE(lseek(fd, 0, SEEK_END), off_t(4096), "mapping failed page not written back");
+		}
+		
+		close(fd);
+	}
+	
+	TEST(bufferPool)
+	{
+		Crypto::BufferPool pool(100000);
+		std::vector<uint8_t> contents(pool.bufferSize());
+		std::vector<uint8_t> expectedContents(pool.bufferSize(), 0);
+		uint8_t *first = nullptr;
+		
+		{
+			Crypto::BufferPool::Lease lease = pool.lease();
+			
+			first = lease.data();
+			memset(lease.data(), 0xa5, lease.size());
+		}
+		
+		// The returned buffer is zeroized and leased again without mapping a new slab
+		const size_t slabBuffers = pool.bufferCount();
+		std::vector<Crypto::BufferPool::Lease> leases;
+		
+		leases.push_back(pool.lease());
+		memcpy(contents.data(), leases[0].data(), contents.size());
+		
+		// Leasing more buffers than one slab holds maps further slabs
+		for (size_t lease = 1; lease < 50; lease++)
+		{
+			leases.push_back(pool.lease());
+		}
+		
+		size_t alignedLeases = 0;
+		
+		for (const Crypto::BufferPool::Lease &lease : leases)
+		{
+			alignedLeases += (lease.isValid() && ((reinterpret_cast<uintptr_t>(lease.data()) % 64) == 0)) ? 1 : 0;
+		}
+		
+		std::vector<size_t> counts{size_t(leases[0].data() == first), slabBuffers, alignedLeases, size_t(pool.bufferCount() >= leases.size())};
+		std::vector<size_t> expectedCounts{1, Crypto::BufferPool::hugePageSize / 100032, leases.size(), 1};
+		
+		CXX_COMPARE(contents, expectedContents, "buffer pool zeroization");
+		CXX_COMPARE(counts, expectedCounts, "buffer pool reuse and growth");
+	}
+	
+	TEST(cache)
+	{
+		std::vector<uint8_t> plaintext{
+			0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d, 0x31, 0x31, 0x98, 0xa2, 0xe0, 0x37, 0x07, 0x34
+		};
+		
+		std::vector<uint8_t> key{
+			0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+		};
+		
+		std::vector<uint8_t> expectedCiphertext{
+			0x39, 0x25, 0x84, 0x1d, 0x02, 0xdc, 0x09, 0xfb, 0xdc, 0x11, 0x85, 0x97, 0x19, 0x6a, 0x0b, 0x32
+		};
+		
+		std::vector<uint8_t> ciphertext(plaintext.size());
+		
+		Crypto::BlockCipher::Aes128Key keyObj(key.data());
+		Crypto::BlockCipher::Aes::KeyScheduleCache<AES_128_KEY_SIZE> cache(2);
+		
+		{
+			auto lease = cache.acquire(1, keyObj);
+			lease.schedule().encryptBlocks(plaintext.data(), ciphertext.data(), 1);
+			
+			// Key 1 stays pinned while keys 2 and 3 compete for the other entry
+			cache.acquire(2, keyObj);
+			cache.acquire(3, keyObj);
+			
+			CXX_COMPARE(bool(cache.acquire(1, keyObj)), true, "cache hit");
+			CXX_COMPARE(cache.evict(1), false, "pinned schedule is not evicted");
+		}
+		
+		cache.acquire(3, keyObj);
+		
+		CXX_COMPARE(ciphertext, expectedCiphertext, "cached AES-128");
+		CXX_COMPARE(cache.hits(), uint64_t(2), "cache hits");
+		CXX_COMPARE(cache.misses(), uint64_t(3), "cache misses");
+		CXX_COMPARE(cache.evict(1), true, "unpinned schedule is evicted");
+		
+		// A loader that throws gives its entry back
+		Crypto::BlockCipher::Aes::KeyScheduleCache<AES_128_KEY_SIZE> singleCache(1);
+		bool thrown = false;
+		
+		try
+		{
+			singleCache.acquire(4, []() -> const Crypto::BlockCipher::Aes128Key & { throw std::runtime_error("key store unavailable"); });
+		}
+		catch (const std::runtime_error &)
+		{
+			thrown = true;
+		}
+		
+		CXX_COMPARE(thrown, true, "cache loader exception");
+		CXX_COMPARE(bool(singleCache.acquire(5, keyObj)), true, "cache entry given back after a loader exception");
+		
+		// Hits are served while another thread is still fetching a key
+		std::atomic<bool> loaderStarted(false);
+		std::atomic<bool> hitServed(false);
+		
+		std::thread loaderThread([&](){
+			cache.acquire(6, [&]() -> const Crypto::BlockCipher::Aes128Key & {
+				loaderStarted = true;
+				
+				while (!hitServed)
+				{
+					std::this_thread::yield();
+				}
+				
+				return keyObj;
+			});
+		});
+		
+		while (!loaderStarted)
+		{
+			std::this_thread::yield();
+		}
+		
+		hitServed = bool(cache.acquire(3, keyObj));
+		loaderThread.join();
+		
+		CXX_COMPARE(bool(hitServed), true, "cache hit during a slow key fetch");
+		CXX_COMPARE(bool(cache.acquire(6, keyObj)), true, "cache insert after a slow key fetch");
+	}
+	
+	TEST(batch)
+	{
+		// Not a multiple of the expansion or encryption lanes
+		const size_t keyCount = 37;
+		std::vector<uint8_t> keys(keyCount * AES_256_KEY_SIZE);
+		std::vector<uint8_t> plaintext(keyCount * AES_BLOCK_SIZE);
+		
+		for (size_t byte = 0; byte < keys.size(); byte++)
+		{
+			keys[byte] = uint8_t(byte * 13 + 5);
+		}
+		
+		for (size_t byte = 0; byte < plaintext.size(); byte++)
+		{
+			plaintext[byte] = uint8_t(byte * 3);
+		}
+		
+		std::vector<uint8_t> ciphertext(plaintext.size());
+		std::vector<uint8_t> expectedCiphertext(plaintext.size());
+		std::vector<uint8_t> lastRoundKeys(plaintext.size());
+		std::vector<uint8_t> expectedLastRoundKeys(plaintext.size());
+		
+		// One counter mode message per key, mostly between 0 and 299 bytes so the lanes finish at different times, and every fifth one long
+		// enough to run on its own
+		std::vector<size_t> offsets(keyCount + 1);
+		
+		for (size_t key = 0; key < keyCount; key++)
+		{
+			offsets[key + 1] = offsets[key] + (key * 89) % 300 + (((key % 5) == 4) ? 1000 : 0);
+		}
+		
+		std::vector<uint8_t> messagePlaintext(offsets[keyCount]);
+		std::vector<uint8_t> initializationVectors(keyCount * AES_BLOCK_SIZE);
+		
+		for (size_t byte = 0; byte < messagePlaintext.size(); byte++)
+		{
+			messagePlaintext[byte] = uint8_t(byte * 7);
+		}
+		
+		for (size_t byte = 0; byte < initializationVectors.size(); byte++)
+		{
+			initializationVectors[byte] = uint8_t(0xf0 + byte);
+		}
+		
+		std::vector<uint8_t> messageCiphertext(messagePlaintext.size());
+		std::vector<uint8_t> expectedMessageCiphertext(messagePlaintext.size());
+		std::vector<Crypto::Mode::CtrMessage> messages(keyCount);
+		
+		for (size_t key = 0; key < keyCount; key++)
+		{
+			messages[key] = {
+				initializationVectors.data() + key * AES_BLOCK_SIZE,
+				messagePlaintext.data() + offsets[key],
+				offsets[key + 1] - offsets[key],
+				messageCiphertext.data() + offsets[key]
+			};
+		}
+		
+		Crypto::BlockCipher::Aes::KeyScheduleBatch256 batch(keys.data(), keyCount);
+		batch.encryptBlocks(plaintext.data(), ciphertext.data());
+		batch.applyKeystream(messages.data());
+		
+		// Reference using one key schedule per key with the portable kernels
+		Crypto::Cpu::restrictFeatures(0);
+		
+		for (size_t key = 0; key < keyCount; key++)
+		{
+			Crypto::BlockCipher::Aes::KeySchedule256 schedule(keys.data() + key * AES_256_KEY_SIZE);
+			
+			schedule.encryptBlocks(plaintext.data() + key * AES_BLOCK_SIZE, expectedCiphertext.data() + key * AES_BLOCK_SIZE, 1);
+			Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block256>::encrypt(schedule, messages[key].initializationVector, messages[key].input,
+					messages[key].size, expectedMessageCiphertext.data() + offsets[key]);
+			memcpy(lastRoundKeys.data() + key * AES_BLOCK_SIZE, batch.roundKey(key, AES_256_ROUND_COUNT), AES_BLOCK_SIZE);
+			memcpy(expectedLastRoundKeys.data() + key * AES_BLOCK_SIZE, schedule.encryptionKeys() + AES_256_ROUND_COUNT * AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+		}
+		
+		Crypto::Cpu::restrictFeatures(Crypto::Cpu::AllFeatures);
+		
+		CXX_COMPARE(lastRoundKeys, expectedLastRoundKeys, "AES-256 batch key expansion");
+		CXX_COMPARE(ciphertext, expectedCiphertext, "AES-256 batch");
+		CXX_COMPARE(messageCiphertext, expectedMessageCiphertext, "AES-256 batch CTR");
+		
+		// Decrypt in place
+		for (Crypto::Mode::CtrMessage &message : messages)
+		{
+			message.input = message.output;
+		}
+		
+		batch.applyKeystream(messages.data());
+		
+		CXX_COMPARE(messageCiphertext, messagePlaintext, "AES-256 batch CTR in place");
+	}
+	
+	TEST(kernels)
+	{
+		std::vector<uint8_t> plaintext(1037);
+		
+		// Generate plaintext
+		for (size_t byte = 0; byte < plaintext.size(); byte++)
+		{
+			plaintext[byte] = uint8_t(byte * 7);
+		}
+		
+		std::vector<uint8_t> key{
+			0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+			0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f
+		};
+		
+		// Counter wraps around its lower 64 bits after two blocks
+		std::vector<uint8_t> initializationVector{
+			0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe
+		};
+		
+		std::vector<uint8_t> ciphertext(plaintext.size());
+		std::vector<uint8_t> expectedCiphertext(plaintext.size());
+		
+		Crypto::BlockCipher::Aes256Key keyObj(key.data());
+		Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block256>::encrypt(
+				keyObj, initializationVector.data(), plaintext.data(), plaintext.size(), ciphertext.data());
+		
+		// Reference using single block encryption with the portable kernels
+		Crypto::Cpu::restrictFeatures(0);
+		Crypto::BlockCipher::Aes::Block256 block(keyObj);
+		std::vector<uint8_t> counter(initializationVector);
+		
+		for (size_t offset = 0; offset < plaintext.size(); offset += AES_BLOCK_SIZE)
+		{
+			uint8_t keystream[AES_BLOCK_SIZE];
+			
+			block.encrypt(counter.data(), keystream);
+			Crypto::Mode::addToCounter(counter.data(), 1);
+			
+			for (size_t byte = offset; (byte < offset + AES_BLOCK_SIZE) && (byte < plaintext.size()); byte++)
+			{
+				expectedCiphertext[byte] = plaintext[byte] ^ keystream[byte - offset];
+			}
+		}
+		
+		Crypto::Cpu::restrictFeatures(Crypto::Cpu::AllFeatures);
+		
+		CXX_COMPARE(ciphertext, expectedCiphertext, "AES-256 CTR kernels");
+	}
+	
+	TEST(inPlace)
+	{
+		using Ctr = Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block128>;
+		
+		std::vector<uint8_t> plaintext(1037);
+		
+		// Generate plaintext
+		for (size_t byte = 0; byte < plaintext.size(); byte++)
+		{
+			plaintext[byte] = uint8_t(byte * 3 + 11);
+		}
+		
+		std::vector<uint8_t> key{
+			0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+		};
+		
+		std::vector<uint8_t> initializationVector{
+			0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+		};
+		
+		Crypto::BlockCipher::Aes128Key keyObj(key.data());
+		
+		// Both kernel sets, with the data at an aligned and a misaligned address
+		for (const uint32_t featureMask : {uint32_t(Crypto::Cpu::AllFeatures), uint32_t(0)})
+		{
+			Crypto::Cpu::restrictFeatures(featureMask);
+			
+			const Crypto::BlockCipher::Aes::KeySchedule128 schedule(keyObj);
+			std::vector<uint8_t> expectedCiphertext(plaintext.size());
+			
+			Ctr::encrypt(schedule, initializationVector.data(), plaintext.data(), plaintext.size(), expectedCiphertext.data());
+			
+			for (const size_t misalignment : {size_t(0), size_t(5)})
+			{
+				std::vector<uint8_t> buffer(plaintext.size() + misalignment);
+				
+				memcpy(buffer.data() + misalignment, plaintext.data(), plaintext.size());
+				Ctr::encrypt(schedule, initializationVector.data(), buffer.data() + misalignment, plaintext.size(), buffer.data() + misalignment);
+				
+				std::vector<uint8_t> ciphertext(buffer.begin() + misalignment, buffer.end());
+				
+				CXX_COMPARE(ciphertext, expectedCiphertext, "AES-128 CTR in place");
+				
+				// Decrypt the second half in place starting in the middle of a block
+				Ctr::decrypt(schedule, initializationVector.data(), 517, buffer.data() + misalignment + 517, plaintext.size() - 517,
+						buffer.data() + misalignment + 517);
+				
+				std::vector<uint8_t> secondHalf(buffer.begin() + misalignment + 517, buffer.end());
+				std::vector<uint8_t> expectedSecondHalf(plaintext.begin() + 517, plaintext.end());
+				
+				CXX_COMPARE(secondHalf, expectedSecondHalf, "AES-128 CTR seek in place");
+			}
+		}
+		
+		Crypto::Cpu::restrictFeatures(Crypto::Cpu::AllFeatures);
+	}
+	
+	TEST(encryptAndHash)
+	{
+		using Ctr = Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block128>;
+		using Crypto::Mode::HashedData;
+		
+		std::vector<uint8_t> key{
+			0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+		};
+		
+		std::vector<uint8_t> initializationVector{
+			0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+		};
+		
+		Crypto::BlockCipher::Aes128Key keyObj(key.data());
+		const Crypto::BlockCipher::Aes::KeySchedule128 schedule(keyObj);
+		
+		// Empty, shorter than a tile, exactly one tile and several tiles with a partial one
+		for (const size_t size : {size_t(0), size_t(100), Ctr::tileSize, Ctr::tileSize * 3 + 1013})
+		{
+			std::vector<uint8_t> plaintext(size);
+			
+			for (size_t byte = 0; byte < plaintext.size(); byte++)
+			{
+				plaintext[byte] = uint8_t(byte * 7 + 1);
+			}
+			
+			std::vector<uint8_t> expectedCiphertext(size);
+			std::vector<uint8_t> expectedHashes(SHA256_DIGEST_SIZE * 2);
+			Crypto::Hash::Sha2::Digest256 plaintextDigest;
+			Crypto::Hash::Sha2::Digest256 ciphertextDigest;
+			
+			// Two separate passes as reference
+			Ctr::encrypt(schedule, initializationVector.data(), plaintext.data(), size, expectedCiphertext.data());
+			plaintextDigest.hash(plaintext.data(), size);
+			plaintextDigest.extract(expectedHashes.data());
+			ciphertextDigest.hash(expectedCiphertext.data(), size);
+			ciphertextDigest.extract(expectedHashes.data() + SHA256_DIGEST_SIZE);
+			
+			std::vector<uint8_t> ciphertext(size);
+			std::vector<uint8_t> buffer(plaintext);
+			std::vector<uint8_t> hashes(SHA256_DIGEST_SIZE * 2);
+			std::vector<uint8_t> decryptionHashes(SHA256_DIGEST_SIZE * 2);
+			
+			Ctr::encryptAndHash<Crypto::Hash::Sha2::Digest256>(schedule, initializationVector.data(), plaintext.data(), size, ciphertext.data(),
+					HashedData::Plaintext, hashes.data());
+			Ctr::encryptAndHash<Crypto::Hash::Sha2::Digest256>(schedule, initializationVector.data(), buffer.data(), size, buffer.data(),
+					HashedData::Ciphertext, hashes.data() + SHA256_DIGEST_SIZE);
+			
+			CXX_COMPARE(ciphertext, expectedCiphertext, "AES-128 CTR encrypt and hash");
+			CXX_COMPARE(buffer, expectedCiphertext, "AES-128 CTR encrypt and hash in place");
+			CXX_COMPARE(hashes, expectedHashes, "AES-128 CTR encrypt and hash digests");
+			
+			// Decrypt in place, hashing the ciphertext before it is overwritten
+			Ctr::decryptAndHash<Crypto::Hash::Sha2::Digest256>(schedule, initializationVector.data(), buffer.data(), size, buffer.data(),
+					HashedData::Ciphertext, decryptionHashes.data() + SHA256_DIGEST_SIZE);
+			Ctr::decryptAndHash<Crypto::Hash::Sha2::Digest256>(schedule, initializationVector.data(), ciphertext.data(), size, ciphertext.data(),
+					HashedData::Plaintext, decryptionHashes.data());
+			
+			CXX_COMPARE(buffer, plaintext, "AES-128 CTR decrypt and hash in place");
+			CXX_COMPARE(decryptionHashes, expectedHashes, "AES-128 CTR decrypt and hash digests");
+		}
+	}
+	
+	TEST(keystream)
+	{
+		using Ctr = Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block128>;
+		
+		std::vector<uint8_t> plaintext(20000);
+		
+		// Generate plaintext
+		for (size_t byte = 0; byte < plaintext.size(); byte++)
+		{
+			plaintext[byte] = uint8_t(byte * 9 + 2);
+		}
+		
+		std::vector<uint8_t> key{
+			0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+		};
+		
+		std::vector<uint8_t> initializationVector{
+			0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+		};
+		
+		Crypto::BlockCipher::Aes128Key keyObj(key.data());
+		const Crypto::BlockCipher::Aes::KeySchedule128 schedule(keyObj);
+		std::vector<uint8_t> expectedCiphertext(plaintext.size());
+		
+		Ctr::encrypt(schedule, initializationVector.data(), plaintext.data(), plaintext.size(), expectedCiphertext.data());
+		
+		// Part of the message is precomputed, part is computed on arrival and the end lies beyond the capacity
+		Crypto::Mode::CtrKeystream<Crypto::BlockCipher::Aes::Block128> keystream(schedule, initializationVector.data(), 15001);
+		std::vector<uint8_t> ciphertext(plaintext.size());
+		
+		const size_t generated = keystream.generate(300);
+		
+		keystream.apply(plaintext.data(), 100, ciphertext.data());
+		
+		const size_t available = keystream.available();
+		
+		keystream.apply(plaintext.data() + 100, 250, ciphertext.data() + 100);
+		keystream.generateInBackground();
+		keystream.apply(plaintext.data() + 350, 7000, ciphertext.data() + 350);
+		keystream.apply(plaintext.data() + 7350, plaintext.size() - 7350, ciphertext.data() + 7350);
+		
+		std::vector<size_t> sizes{generated, available};
+		std::vector<size_t> expectedSizes{304, 204};
+		
+		CXX_COMPARE(sizes, expectedSizes, "AES-128 CTR keystream reservoir sizes");
+		CXX_COMPARE(ciphertext, expectedCiphertext, "AES-128 CTR keystream reservoir");
+		
+		// A fully precomputed message of another initialization vector, decrypted in place
+		initializationVector[15] ^= 0x01;
+		keystream.reset(initializationVector.data());
+		
+		// Stopping the background thread must not keep later calls from generating
+		const size_t regenerated = keystream.generate(keystream.capacity());
+		
+		CXX_COMPARE(regenerated, size_t(15001), "AES-128 CTR keystream reservoir regenerated after reset");
+		
+		std::vector<uint8_t> buffer(plaintext.begin(), plaintext.begin() + 15001);
+		std::vector<uint8_t> expectedBuffer(buffer.size());
+		
+		Ctr::encrypt(schedule, initializationVector.data(), buffer.data(), buffer.size(), expectedBuffer.data());
+		keystream.apply(buffer.data(), buffer.size(), buffer.data());
+		
+		CXX_COMPARE(buffer, expectedBuffer, "AES-128 CTR keystream reservoir in place");
+	}
+	
+	TEST(streaming)
+	{
+		std::vector<uint8_t> plaintext(300017);
+		
+		// Generate plaintext
+		for (size_t byte = 0; byte < plaintext.size(); byte++)
+		{
+			plaintext[byte] = uint8_t(byte * 11 + 3);
+		}
+		
+		std::vector<uint8_t> key{
+			0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+		};
+		
+		std::vector<uint8_t> initializationVector{
+			0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+		};
+		
+		Crypto::BlockCipher::Aes128Key keyObj(key.data());
+		std::vector<uint8_t> expectedCiphertext(plaintext.size());
+		
+		Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block128>::encrypt(
+				keyObj, initializationVector.data(), plaintext.data(), plaintext.size(), expectedCiphertext.data());
+		
+		// Force non-temporal stores for an aligned and a misaligned output, which falls back to regular stores
+		const size_t threshold = Crypto::Mode::streamingThreshold();
+		Crypto::Mode::setStreamingThreshold(0);
+		
+		std::vector<uint8_t> ciphertext(plaintext.size() + 1);
+		std::vector<uint8_t> alignedCiphertext(plaintext.size());
+		std::vector<uint8_t> misalignedCiphertext(plaintext.size());
+		
+		Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block128>::encrypt(
+				keyObj, initializationVector.data(), plaintext.data(), plaintext.size(), ciphertext.data());
+		memcpy(alignedCiphertext.data(), ciphertext.data(), plaintext.size());
+		
+		Crypto::Mode::Ctr<Crypto::BlockCipher::Aes::Block128>::encrypt(
+				keyObj, initializationVector.data(), plaintext.data(), plaintext.size(), ciphertext.data() + 1);
+		memcpy(misalignedCiphertext.data(), ciphertext.data() + 1, plaintext.size());
+		
+		Crypto::Mode::setStreamingThreshold(threshold);
+		
+		CXX_COMPARE(alignedCiphertext, expectedCiphertext, "AES-128 CTR streaming aligned");
+		CXX_COMPARE(misalignedCiphertext, expectedCiphertext, "AES-128 CTR streaming misaligned");
+	}
+	
 	TEST(encrypt)
 	{
 		std::vector<uint8_t> plaintext(22000);
@@ -2,8 +2,13 @@
 #include <iostream>
 #include <stdint.h>
 #include <stdlib.h>
+#include <vector>
 
+#include "cpufeatures.h"
+#include "hmac.h"
 #include "sha2digest.h"
+#include "sha2multidigest.h"
+#include "streamingdigest.h"
 #include "cryptoutilities.h"
 
 #define SUCCESS(text) \
@@ -132,10 +137,356 @@ int main()
 		}
 	};
 	
+	auto sha256TestMidstate = []()
+	{
+		uint8_t message[200];
+		
+		// Generate message with a prefix of three complete blocks
+		for (size_t byte = 0; byte < sizeof (message); byte++)
+		{
+			message[byte] = uint8_t(byte % 251);
+		}
+		
+		uint8_t expectedHash[] = {
+			0x19, 0x01, 0xda, 0x1c, 0x9f, 0x69, 0x9b, 0x48, 0xf6, 0xb2, 0x63, 0x6e, 0x65, 0xcb, 0xf7, 0x3a,
+			0xbf, 0x99, 0xd0, 0x44, 0x1e, 0xf6, 0x7f, 0x5c, 0x54, 0x0a, 0x42, 0xf7, 0x05, 0x1d, 0xec, 0x6f
+		};
+		
+		uint8_t hash[sizeof (expectedHash)];
+		uint8_t clonedHash[sizeof (expectedHash)];
+		uint8_t midstate[Crypto::Hash::Sha2::Digest256::midstateSize];
+		
+		Crypto::Hash::Sha2::Digest256 prefixDigest;
+		
+		for (size_t block = 0; block < 3; block++)
+		{
+			prefixDigest.update(message + block * Crypto::Hash::Sha2::Digest256::TraitsType::blockSize);
+		}
+		
+		prefixDigest.exportMidstate(midstate);
+		
+		// Resume from the serialized midstate
+		Crypto::Hash::Sha2::Digest256 digest;
+		bool imported = digest.importMidstate(midstate);
+		digest.finalize(message + 192, sizeof (message) - 192);
+		digest.extract(hash);
+		
+		// Resume from a clone
+		Crypto::Hash::Sha2::Digest256 clonedDigest = prefixDigest;
+		clonedDigest.finalize(message + 192, sizeof (message) - 192);
+		clonedDigest.extract(clonedHash);
+		
+		if (imported && (memcmp(expectedHash, hash, sizeof (expectedHash)) == 0) && (memcmp(expectedHash, clonedHash, sizeof (expectedHash)) == 0))
+		{
+			SUCCESS("SHA-256 midstate")
+		}
+		else
+		{
+			FAIL("SHA-256 midstate")
+			INFO("RESULT")
+			printBuffer(hash, sizeof (expectedHash));
+			INFO("EXPECTED")
+			printBuffer(expectedHash, sizeof (expectedHash));
+			abort();
+		}
+	};
+	
+	auto sha512_224TestShortMsg = []()
+	{
+		uint8_t message[] = {
+			0x61, 0x62, 0x63
+		};
+		
+		uint8_t expectedHash[] = {
+			0x46, 0x34, 0x27, 0x0f, 0x70, 0x7b, 0x6a, 0x54, 0xda, 0xae, 0x75, 0x30, 0x46, 0x08, 0x42, 0xe2,
+			0x0e, 0x37, 0xed, 0x26, 0x5c, 0xee, 0xe9, 0xa4, 0x3e, 0x89, 0x24, 0xaa
+		};
+		
+		uint8_t hash[sizeof (expectedHash)];
+		
+		Crypto::Hash::Sha2::Digest512_224 digest;
+		digest.hash(message, sizeof (message));
+		digest.extract(hash);
+		
+		if (memcmp(expectedHash, hash, sizeof (expectedHash)) == 0)
+		{
+			SUCCESS("SHA-512/224")
+		}
+		else
+		{
+			FAIL("SHA-512/224")
+			INFO("RESULT")
+			printBuffer(hash, sizeof (expectedHash));
+			INFO("EXPECTED")
+			printBuffer(expectedHash, sizeof (expectedHash));
+			abort();
+		}
+	};
+	
+	auto sha512_256TestShortMsg = []()
+	{
+		uint8_t message[] = {
+			0x61, 0x62, 0x63
+		};
+		
+		uint8_t expectedHash[] = {
+			0x53, 0x04, 0x8e, 0x26, 0x81, 0x94, 0x1e, 0xf9, 0x9b, 0x2e, 0x29, 0xb7, 0x6b, 0x4c, 0x7d, 0xab,
+			0xe4, 0xc2, 0xd0, 0xc6, 0x34, 0xfc, 0x6d, 0x46, 0xe0, 0xe2, 0xf1, 0x31, 0x07, 0xe7, 0xaf, 0x23
+		};
+		
+		uint8_t hash[sizeof (expectedHash)];
+		
+		Crypto::Hash::Sha2::Digest512_256 digest;
+		digest.hash(message, sizeof (message));
+		digest.extract(hash);
+		
+		if (memcmp(expectedHash, hash, sizeof (expectedHash)) == 0)
+		{
+			SUCCESS("SHA-512/256")
+		}
+		else
+		{
+			FAIL("SHA-512/256")
+			INFO("RESULT")
+			printBuffer(hash, sizeof (expectedHash));
+			INFO("EXPECTED")
+			printBuffer(expectedHash, sizeof (expectedHash));
+			abort();
+		}
+	};
+	
+	auto sha256TestKernels = []()
+	{
+		uint8_t message[1000];
+		
+		for (size_t byte = 0; byte < sizeof (message); byte++)
+		{
+			message[byte] = uint8_t(byte * 13);
+		}
+		
+		uint8_t hash[SHA256_DIGEST_SIZE];
+		uint8_t expectedHash[SHA256_DIGEST_SIZE];
+		
+		Crypto::Hash::Sha2::Digest256 digest;
+		digest.hash(message, sizeof (message));
+		digest.extract(hash);
+		
+		// Reference using the portable kernels, which restricting the features selects
+		Crypto::Cpu::restrictFeatures(0);
+		const bool reselected = (strcmp(Crypto::Hash::Sha2::kernels().name, "generic") == 0);
+		Crypto::Hash::Sha2::Digest256 referenceDigest;
+		referenceDigest.hash(message, sizeof (message));
+		referenceDigest.extract(expectedHash);
+		Crypto::Cpu::restrictFeatures(Crypto::Cpu::AllFeatures);
+		
+		if (reselected && (memcmp(expectedHash, hash, sizeof (expectedHash)) == 0))
+		{
+			SUCCESS("SHA-256 " << Crypto::Hash::Sha2::kernels().name)
+		}
+		else
+		{
+			FAIL("SHA-256 " << Crypto::Hash::Sha2::kernels().name)
+			INFO("RESULT")
+			printBuffer(hash, sizeof (expectedHash));
+			INFO("EXPECTED")
+			printBuffer(expectedHash, sizeof (expectedHash));
+			abort();
+		}
+	};
+	
+	auto sha256TestLanes = []()
+	{
+		// Sizes around the block and padding boundaries, followed by one long message that outlasts the others
+		std::vector<std::vector<uint8_t>> messages;
+		
+		for (size_t size = 0; size < 200; size++)
+		{
+			messages.emplace_back(size * 7 % 193);
+		}
+		
+		messages.emplace_back(10000);
+		
+		std::vector<const uint8_t *> messagePointers;
+		std::vector<size_t> messageSizes;
+		std::vector<uint8_t> expectedHashes(messages.size() * SHA256_DIGEST_SIZE);
+		
+		for (size_t message = 0; message < messages.size(); message++)
+		{
+			for (size_t byte = 0; byte < messages[message].size(); byte++)
+			{
+				messages[message][byte] = uint8_t(byte * 31 + message);
+			}
+			
+			messagePointers.push_back(messages[message].data());
+			messageSizes.push_back(messages[message].size());
+			
+			Crypto::Hash::Sha2::Digest256 digest;
+			digest.hash(messages[message].data(), messages[message].size());
+			digest.extract(expectedHashes.data() + message * SHA256_DIGEST_SIZE);
+		}
+		
+		// Every kernel set the CPU supports, down to the portable one
+		const uint32_t featureMasks[] = {Crypto::Cpu::AllFeatures, Crypto::Cpu::AllFeatures & ~uint32_t(Crypto::Cpu::Sha), 0};
+		
+		for (const uint32_t featureMask : featureMasks)
+		{
+			std::vector<uint8_t> hashes(expectedHashes.size());
+			
+			Crypto::Cpu::restrictFeatures(featureMask);
+			Crypto::Hash::Sha2::MultiDigest256::hash(messagePointers.data(), messageSizes.data(), messages.size(), hashes.data());
+			
+			if (hashes == expectedHashes)
+			{
+				SUCCESS("SHA-256 lanes " << Crypto::Hash::Sha2::kernels().name)
+			}
+			else
+			{
+				FAIL("SHA-256 lanes " << Crypto::Hash::Sha2::kernels().name)
+				abort();
+			}
+		}
+		
+		Crypto::Cpu::restrictFeatures(Crypto::Cpu::AllFeatures);
+	};
+	
+	auto sha256TestFragments = []()
+	{
+		std::vector<uint8_t> message(1000);
+		
+		for (size_t byte = 0; byte < message.size(); byte++)
+		{
+			message[byte] = uint8_t(byte * 13 + 7);
+		}
+		
+		// Fragments around the block size, including empty ones
+		const size_t fragmentSizes[] = {1, 0, 63, 64, 65, 7, 128, 0, 200};
+		std::vector<iovec> fragments;
+		
+		for (size_t offset = 0, index = 0; offset < message.size(); index++)
+		{
+			const size_t fragmentSize = fragmentSizes[index % (sizeof (fragmentSizes) / sizeof (size_t))];
+			const size_t size = ((message.size() - offset) < fragmentSize) ? (message.size() - offset) : fragmentSize;
+			
+			fragments.push_back(iovec{message.data() + offset, size});
+			offset += size;
+		}
+		
+		uint8_t expectedHash[SHA256_DIGEST_SIZE];
+		uint8_t hash[SHA256_DIGEST_SIZE];
+		Crypto::Hash::Sha2::Digest256 expectedDigest;
+		Crypto::Hash::Sha2::Digest256 digest;
+		
+		expectedDigest.hash(message.data(), message.size());
+		expectedDigest.extract(expectedHash);
+		digest.hashFragments(fragments.data(), fragments.size());
+		digest.extract(hash);
+		
+		if (memcmp(expectedHash, hash, sizeof (expectedHash)) == 0)
+		{
+			SUCCESS("SHA-256 fragments")
+		}
+		else
+		{
+			FAIL("SHA-256 fragments")
+			INFO("RESULT")
+			printBuffer(hash, sizeof (hash));
+			INFO("EXPECTED")
+			printBuffer(expectedHash, sizeof (expectedHash));
+			abort();
+		}
+	};
+	
+	auto sha256TestStreaming = []()
+	{
+		std::vector<uint8_t> message(1000);
+		
+		for (size_t byte = 0; byte < message.size(); byte++)
+		{
+			message[byte] = uint8_t(byte * 29 + 3);
+		}
+		
+		// Pieces straddling block boundaries as well as runs of several whole blocks
+		const size_t pieceSizes[] = {1, 0, 63, 64, 65, 7, 300, 0, 200};
+		uint8_t expectedHash[SHA256_DIGEST_SIZE];
+		uint8_t hash[SHA256_DIGEST_SIZE];
+		Crypto::Hash::Sha2::Digest256 expectedDigest;
+		Crypto::Hash::StreamingDigest<Crypto::Hash::Sha2::Digest256> digest;
+		
+		expectedDigest.hash(message.data(), message.size());
+		expectedDigest.extract(expectedHash);
+		
+		for (size_t offset = 0, index = 0; offset < message.size(); index++)
+		{
+			const size_t pieceSize = pieceSizes[index % (sizeof (pieceSizes) / sizeof (size_t))];
+			const size_t size = ((message.size() - offset) < pieceSize) ? (message.size() - offset) : pieceSize;
+			
+			digest.update(message.data() + offset, size);
+			offset += size;
+		}
+		
+		digest.finalize(hash);
+		
+		if (memcmp(expectedHash, hash, sizeof (expectedHash)) == 0)
+		{
+			SUCCESS("SHA-256 streaming")
+		}
+		else
+		{
+			FAIL("SHA-256 streaming")
+			INFO("RESULT")
+			printBuffer(hash, sizeof (hash));
+			INFO("EXPECTED")
+			printBuffer(expectedHash, sizeof (expectedHash));
+			abort();
+		}
+	};
+	
+	auto hmacSha256Test = []()
+	{
+		// RFC 4231 test case 2
+		const uint8_t key[] = {'J', 'e', 'f', 'e'};
+		const char message[] = "what do ya want for nothing?";
+		
+		uint8_t expectedMac[] = {
+			0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+			0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43
+		};
+		
+		uint8_t mac[sizeof (expectedMac)];
+		
+		// Pass the message in two pieces to exercise buffering
+		Crypto::Hash::Hmac<Crypto::Hash::Sha2::Digest256> hmac(key, sizeof (key));
+		hmac.update(reinterpret_cast<const uint8_t *>(message), 5);
+		hmac.update(reinterpret_cast<const uint8_t *>(message) + 5, sizeof (message) - 6);
+		hmac.finalize(mac);
+		
+		if (memcmp(expectedMac, mac, sizeof (expectedMac)) == 0)
+		{
+			SUCCESS("HMAC-SHA-256")
+		}
+		else
+		{
+			FAIL("HMAC-SHA-256")
+			INFO("RESULT")
+			printBuffer(mac, sizeof (expectedMac));
+			INFO("EXPECTED")
+			printBuffer(expectedMac, sizeof (expectedMac));
+			abort();
+		}
+	};
+	
 	// Run tests
 	sha256TestEmptyMsg();
 	sha256TestShortMsg();
 //	sha256TestMediumMsg();
+	sha256TestMidstate();
+	sha512_224TestShortMsg();
+	sha512_256TestShortMsg();
+	sha256TestKernels();
+	sha256TestLanes();
+	sha256TestFragments();
+	sha256TestStreaming();
+	hmacSha256Test();
 	
 	return 0;
 }
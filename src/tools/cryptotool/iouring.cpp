@@ -0,0 +1,173 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "iouring.h"
+
+namespace CryptoTool
+{
+
+IoUring::IoUring(const unsigned entries)
+{
+	io_uring_params parameters;
+	memset(&parameters, 0, sizeof (parameters));
+	
+	this->_fd = int(syscall(__NR_io_uring_setup, entries, &parameters));
+	
+	if (this->_fd >= 0)
+	{
+		this->_submissionRingSize = parameters.sq_off.array + parameters.sq_entries * sizeof (unsigned);
+		this->_completionRingSize = parameters.cq_off.cqes + parameters.cq_entries * sizeof (io_uring_cqe);
+		this->_submissionEntriesSize = parameters.sq_entries * sizeof (io_uring_sqe);
+		
+		// Newer kernels map both rings with a single mapping
+		if ((parameters.features & IORING_FEAT_SINGLE_MMAP) != 0)
+		{
+			if (this->_completionRingSize > this->_submissionRingSize)
+			{
+				this->_submissionRingSize = this->_completionRingSize;
+			}
+			
+			this->_completionRingSize = 0;
+		}
+		
+		void *submissionRing = mmap(nullptr, this->_submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->_fd,
+				IORING_OFF_SQ_RING);
+		void *completionRing = submissionRing;
+		
+		if ((submissionRing != MAP_FAILED) && (this->_completionRingSize != 0))
+		{
+			completionRing = mmap(nullptr, this->_completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->_fd,
+					IORING_OFF_CQ_RING);
+		}
+		
+		void *submissionEntries = mmap(nullptr, this->_submissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->_fd,
+				IORING_OFF_SQES);
+		
+		this->_submissionRing = (submissionRing != MAP_FAILED) ? submissionRing : nullptr;
+		this->_completionRing = ((completionRing != MAP_FAILED) && (this->_completionRingSize != 0)) ? completionRing : nullptr;
+		this->_submissionEntries = (submissionEntries != MAP_FAILED) ? static_cast<io_uring_sqe *>(submissionEntries) : nullptr;
+		
+		if ((submissionRing == MAP_FAILED) || (completionRing == MAP_FAILED) || (submissionEntries == MAP_FAILED))
+		{
+			close(this->_fd);
+			this->_fd = -1;
+		}
+		else
+		{
+			uint8_t *submission = static_cast<uint8_t *>(submissionRing);
+			uint8_t *completion = static_cast<uint8_t *>(completionRing);
+			
+			this->_submissionHead = reinterpret_cast<unsigned *>(submission + parameters.sq_off.head);
+			this->_submissionTail = reinterpret_cast<unsigned *>(submission + parameters.sq_off.tail);
+			this->_submissionMask = *reinterpret_cast<unsigned *>(submission + parameters.sq_off.ring_mask);
+			this->_submissionEntryCount = parameters.sq_entries;
+			this->_submissionArray = reinterpret_cast<unsigned *>(submission + parameters.sq_off.array);
+			this->_completionHead = reinterpret_cast<unsigned *>(completion + parameters.cq_off.head);
+			this->_completionTail = reinterpret_cast<unsigned *>(completion + parameters.cq_off.tail);
+			this->_completionMask = *reinterpret_cast<unsigned *>(completion + parameters.cq_off.ring_mask);
+			this->_completionEntries = reinterpret_cast<io_uring_cqe *>(completion + parameters.cq_off.cqes);
+		}
+	}
+}
+
+IoUring::~IoUring()
+{
+	if (this->_submissionEntries != nullptr)
+	{
+		munmap(this->_submissionEntries, this->_submissionEntriesSize);
+	}
+	
+	if (this->_completionRing != nullptr)
+	{
+		munmap(this->_completionRing, this->_completionRingSize);
+	}
+	
+	if (this->_submissionRing != nullptr)
+	{
+		munmap(this->_submissionRing, this->_submissionRingSize);
+	}
+	
+	if (this->_fd >= 0)
+	{
+		close(this->_fd);
+	}
+}
+
+bool IoUring::prepareRead(const int fd, uint8_t *buffer, const uint32_t size, const uint64_t offset, const uint64_t userData)
+{
+	return this->_prepare(IORING_OP_READ, fd, buffer, size, offset, userData);
+}
+
+bool IoUring::prepareWrite(const int fd, const uint8_t *buffer, const uint32_t size, const uint64_t offset, const uint64_t userData)
+{
+	return this->_prepare(IORING_OP_WRITE, fd, buffer, size, offset, userData);
+}
+
+bool IoUring::submit(const unsigned minCompletions)
+{
+	long result = 0;
+	
+	do
+	{
+		result = syscall(__NR_io_uring_enter, this->_fd, this->_pendingSubmissions, minCompletions, IORING_ENTER_GETEVENTS, nullptr, 0);
+	}
+	while ((result < 0) && (errno == EINTR));
+	
+	if (result >= 0)
+	{
+		this->_pendingSubmissions -= unsigned(result);
+	}
+	
+	return (result >= 0);
+}
+
+bool IoUring::nextCompletion(uint64_t &userData, int32_t &result)
+{
+	bool returnValue = false;
+	const unsigned head = *this->_completionHead;
+	
+	// The kernel publishes completions by advancing the tail
+	if (head != __atomic_load_n(this->_completionTail, __ATOMIC_ACQUIRE))
+	{
+		const io_uring_cqe &completion = this->_completionEntries[head & this->_completionMask];
+		
+		userData = completion.user_data;
+		result = completion.res;
+		__atomic_store_n(this->_completionHead, head + 1, __ATOMIC_RELEASE);
+		returnValue = true;
+	}
+	
+	return returnValue;
+}
+
+bool IoUring::_prepare(const uint8_t opcode, const int fd, const uint8_t *buffer, const uint32_t size, const uint64_t offset, const uint64_t userData)
+{
+	bool returnValue = false;
+	const unsigned tail = *this->_submissionTail;
+	
+	if ((tail - __atomic_load_n(this->_submissionHead, __ATOMIC_ACQUIRE)) < this->_submissionEntryCount)
+	{
+		const unsigned index = tail & this->_submissionMask;
+		io_uring_sqe &entry = this->_submissionEntries[index];
+		
+		memset(&entry, 0, sizeof (entry));
+		entry.opcode = opcode;
+		entry.fd = fd;
+		entry.addr = uint64_t(reinterpret_cast<uintptr_t>(buffer));
+		entry.len = size;
+		entry.off = offset;
+		entry.user_data = userData;
+		
+		this->_submissionArray[index] = index;
+		__atomic_store_n(this->_submissionTail, tail + 1, __ATOMIC_RELEASE);
+		this->_pendingSubmissions++;
+		returnValue = true;
+	}
+	
+	return returnValue;
+}
+
+} // namespace CryptoTool
@@ -0,0 +1,112 @@
+#ifndef IOURING_H
+#define IOURING_H
+
+#include <linux/io_uring.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace CryptoTool
+{
+
+///
+/// \brief	Implements a minimal io_uring instance on top of the raw system calls.
+/// 
+///			Only plain reads and writes at explicit offsets are supported. The instance is not thread safe.
+/// 
+/// \since	1.0
+///
+class IoUring
+{
+public:
+	///
+	/// \brief	Sets up a ring with room for at least \a entries submissions.
+	/// 
+	///			Check isValid() to find out whether the kernel supports io_uring.
+	/// 
+	/// \since	1.0
+	///
+	explicit IoUring(const unsigned entries);
+	
+	IoUring(const IoUring &other) = delete;
+	IoUring &operator=(const IoUring &other) = delete;
+	
+	///
+	/// \brief	Unmaps the rings and closes the instance.
+	/// 
+	/// \since	1.0
+	///
+	~IoUring();
+	
+	///
+	/// \brief	Returns \c true if the ring could be set up.
+	/// 
+	/// \since	1.0
+	///
+	bool isValid() const
+	{
+		return (this->_fd >= 0);
+	}
+	
+	///
+	/// \brief	Queues a read of \a size bytes at \a offset of \a fd into \a buffer.
+	/// 
+	///			Returns \c false if the submission queue is full.
+	/// 
+	/// \since	1.0
+	///
+	bool prepareRead(const int fd, uint8_t *buffer, const uint32_t size, const uint64_t offset, const uint64_t userData);
+	
+	///
+	/// \brief	Queues a write of \a size bytes of \a buffer at \a offset of \a fd.
+	/// 
+	///			Returns \c false if the submission queue is full.
+	/// 
+	/// \since	1.0
+	///
+	bool prepareWrite(const int fd, const uint8_t *buffer, const uint32_t size, const uint64_t offset, const uint64_t userData);
+	
+	///
+	/// \brief	Submits all queued requests and waits until at least \a minCompletions have completed.
+	/// 
+	///			Returns \c false if the kernel rejected the submission.
+	/// 
+	/// \since	1.0
+	///
+	bool submit(const unsigned minCompletions);
+	
+	///
+	/// \brief	Takes the next completion off the completion queue without blocking.
+	/// 
+	///			Returns \c false if there is none. \a result receives the number of transferred bytes or a negative error number.
+	/// 
+	/// \since	1.0
+	///
+	bool nextCompletion(uint64_t &userData, int32_t &result);
+	
+private:
+	int _fd = -1;
+	unsigned _pendingSubmissions = 0;
+	
+	void *_submissionRing = nullptr;
+	size_t _submissionRingSize = 0;
+	void *_completionRing = nullptr;
+	size_t _completionRingSize = 0;
+	io_uring_sqe *_submissionEntries = nullptr;
+	size_t _submissionEntriesSize = 0;
+	
+	unsigned *_submissionHead = nullptr;
+	unsigned *_submissionTail = nullptr;
+	unsigned _submissionMask = 0;
+	unsigned _submissionEntryCount = 0;
+	unsigned *_submissionArray = nullptr;
+	unsigned *_completionHead = nullptr;
+	unsigned *_completionTail = nullptr;
+	unsigned _completionMask = 0;
+	io_uring_cqe *_completionEntries = nullptr;
+	
+	bool _prepare(const uint8_t opcode, const int fd, const uint8_t *buffer, const uint32_t size, const uint64_t offset, const uint64_t userData);
+};
+
+} // namespace CryptoTool
+
+#endif // IOURING_H
@@ -0,0 +1,233 @@
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "aesblock.h"
+#include "aeskeyschedule.h"
+#include "cryptolog.h"
+#include "ctrmode.h"
+#include "pipeline.h"
+#include "sha2digest.h"
+#include "streamingdigest.h"
+
+using namespace CryptoTool;
+
+static void printUsage(const char *program)
+{
+	std::cerr << "Usage: " << program << " encrypt|decrypt|sha256|sha512 [options] [input [output]]" << std::endl
+			<< std::endl
+			<< "Encrypts or decrypts with AES-CTR or hashes input, which defaults to stdin. Output defaults to stdout." << std::endl
+			<< std::endl
+			<< "  -k HEX    key of 16, 24 or 32 bytes" << std::endl
+			<< "  -i HEX    initialization vector of 16 bytes" << std::endl
+			<< "  -b KIB    buffer size in KiB, a multiple of 4 (default 1024)" << std::endl
+			<< "  -n COUNT  number of buffers in flight (default 8)" << std::endl
+			<< "  -D        open files with O_DIRECT" << std::endl
+			<< "  -T        use reader and writer threads instead of io_uring" << std::endl
+			<< "  -q        do not report throughput" << std::endl;
+}
+
+///
+/// \brief	Writes library log messages to stderr, since stdout may carry ciphertext or checksums.
+/// 
+/// \since	1.0
+///
+static void logToStderr(const Crypto::Log::Level, const std::string &message)
+{
+	std::cerr << message << std::endl;
+}
+
+static bool parseHex(const char *text, std::vector<uint8_t> &bytes)
+{
+	const size_t length = strlen(text);
+	bool returnValue = ((length % 2) == 0);
+	
+	bytes.clear();
+	
+	for (size_t character = 0; returnValue && (character < length); character += 2)
+	{
+		const std::string byteText(text + character, 2);
+		char *end = nullptr;
+		const unsigned long value = strtoul(byteText.c_str(), &end, 16);
+		
+		returnValue = (*end == '\0');
+		bytes.push_back(uint8_t(value));
+	}
+	
+	return returnValue;
+}
+
+template <typename BlockType>
+static bool runCtr(const std::vector<uint8_t> &key, const uint8_t *initializationVector, const int input, const int output,
+		const PipelineOptions &options, const char *&backend, uint64_t &bytes)
+{
+	const typename BlockType::ScheduleType schedule(key.data());
+	
+	// Every buffer knows its offset, so the keystream is computed independently of other buffers
+	return runPipeline(input, output, options, [&](uint8_t *data, const size_t size, const uint64_t offset){
+		Crypto::Mode::Ctr<BlockType>::encrypt(schedule, initializationVector, offset, data, size, data);
+	}, backend, bytes);
+}
+
+template <typename DigestType>
+static bool runHash(const int input, const PipelineOptions &options, const char *inputName, const char *&backend, uint64_t &bytes)
+{
+	Crypto::Hash::StreamingDigest<DigestType> digest;
+	
+	const bool returnValue = runPipeline(input, -1, options, [&](uint8_t *data, const size_t size, const uint64_t){
+		digest.update(data, size);
+	}, backend, bytes);
+	
+	if (returnValue)
+	{
+		uint8_t hash[DigestType::TraitsType::digestSize];
+		std::ostringstream stream;
+		
+		digest.finalize(hash);
+		
+		for (const uint8_t byte : hash)
+		{
+			stream << std::hex << std::setw(2) << std::setfill('0') << unsigned(byte);
+		}
+		
+		std::cout << stream.str() << "  " << inputName << std::endl;
+	}
+	
+	return returnValue;
+}
+
+int main(int argc, char **argv)
+{
+	PipelineOptions options;
+	std::vector<uint8_t> key;
+	std::vector<uint8_t> initializationVector;
+	bool direct = false;
+	bool quiet = false;
+	bool valid = (argc >= 2);
+	int option = 0;
+	
+	Crypto::Log::setSink(logToStderr);
+	optind = 2;
+	
+	while (valid && ((option = getopt(argc, argv, "k:i:b:n:DTq")) != -1))
+	{
+		switch (option)
+		{
+			case 'k':
+				valid = parseHex(optarg, key) && ((key.size() == AES_128_KEY_SIZE) || (key.size() == AES_192_KEY_SIZE) || (key.size() == AES_256_KEY_SIZE));
+				break;
+			case 'i':
+				valid = parseHex(optarg, initializationVector) && (initializationVector.size() == AES_BLOCK_SIZE);
+				break;
+			case 'b':
+				options.bufferSize = size_t(strtoul(optarg, nullptr, 10)) * 1024;
+				valid = (options.bufferSize != 0) && ((options.bufferSize % 4096) == 0) && (options.bufferSize <= (1u << 30));
+				break;
+			case 'n':
+				options.bufferCount = size_t(strtoul(optarg, nullptr, 10));
+				valid = (options.bufferCount != 0) && (options.bufferCount <= 4096);
+				break;
+			case 'D':
+				direct = true;
+				break;
+			case 'T':
+				options.allowIoUring = false;
+				break;
+			case 'q':
+				quiet = true;
+				break;
+			default:
+				valid = false;
+				break;
+		}
+	}
+	
+	const std::string command = (argc >= 2) ? argv[1] : "";
+	const bool isCipher = (command == "encrypt") || (command == "decrypt");
+	const bool isHash = (command == "sha256") || (command == "sha512");
+	const char *inputName = (optind < argc) ? argv[optind] : "-";
+	const char *outputName = ((optind + 1) < argc) ? argv[optind + 1] : "-";
+	
+	valid = valid && (isCipher || isHash) && ((argc - optind) <= (isCipher ? 2 : 1));
+	valid = valid && (!isCipher || (!key.empty() && !initializationVector.empty()));
+	
+	if (!valid)
+	{
+		printUsage(argv[0]);
+		
+		return 2;
+	}
+	
+	const int directFlag = direct ? O_DIRECT : 0;
+	const int input = (strcmp(inputName, "-") == 0) ? STDIN_FILENO : open(inputName, O_RDONLY | directFlag);
+	const int output = !isCipher ? -1 : (strcmp(outputName, "-") == 0) ? STDOUT_FILENO : open(outputName, O_WRONLY | O_CREAT | O_TRUNC | directFlag, 0644);
+	
+	if ((input < 0) || (isCipher && (output < 0)))
+	{
+		std::cerr << "Cannot open " << ((input < 0) ? inputName : outputName) << ": " << strerror(errno) << std::endl;
+		
+		return 1;
+	}
+	
+	options.directOutput = direct && (output != STDOUT_FILENO);
+	
+	const char *backend = "";
+	uint64_t bytes = 0;
+	bool success = false;
+	const auto start = std::chrono::steady_clock::now();
+	
+	if (isCipher)
+	{
+		// CTR mode uses encryption for decryption
+		if (key.size() == AES_128_KEY_SIZE)
+		{
+			success = runCtr<Crypto::BlockCipher::Aes::Block128>(key, initializationVector.data(), input, output, options, backend, bytes);
+		}
+		else if (key.size() == AES_192_KEY_SIZE)
+		{
+			success = runCtr<Crypto::BlockCipher::Aes::Block192>(key, initializationVector.data(), input, output, options, backend, bytes);
+		}
+		else
+		{
+			success = runCtr<Crypto::BlockCipher::Aes::Block256>(key, initializationVector.data(), input, output, options, backend, bytes);
+		}
+	}
+	else if (command == "sha256")
+	{
+		success = runHash<Crypto::Hash::Sha2::Digest256>(input, options, inputName, backend, bytes);
+	}
+	else
+	{
+		success = runHash<Crypto::Hash::Sha2::Digest512>(input, options, inputName, backend, bytes);
+	}
+	
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	
+	safeSetZero(key.data(), key.size());
+	
+	if ((output >= 0) && (output != STDOUT_FILENO))
+	{
+		success = (close(output) == 0) && success;
+	}
+	
+	if (!success)
+	{
+		std::cerr << command << ": I/O error: " << strerror(errno) << std::endl;
+	}
+	else if (!quiet)
+	{
+		std::cerr << command << ": " << bytes << " bytes in " << seconds << " s, " << (double(bytes) / 1000000.0 / seconds) << " MB/s (" << backend
+				<< ")" << std::endl;
+	}
+	
+	return success ? 0 : 1;
+}
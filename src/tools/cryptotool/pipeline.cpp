@@ -0,0 +1,467 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <errno.h>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "bufferpool.h"
+#include "fileio.h"
+#include "iouring.h"
+#include "pipeline.h"
+
+namespace CryptoTool
+{
+
+static constexpr size_t _alignment = 4096;
+
+///
+/// \internal
+/// 
+/// \brief	Describes one buffer of the ring.
+/// 
+/// \since	1.0
+///
+struct _Buffer
+{
+	enum class State
+	{
+		Free,
+		Reading,
+		Ready,
+		Writing
+	};
+	
+	uint8_t *data = nullptr;
+	uint64_t offset = 0;
+	size_t size = 0;
+	size_t transferred = 0;
+	State state = State::Free;
+};
+
+///
+/// \internal
+/// 
+/// \brief	Leases the page aligned memory of all buffers from a huge page backed pool.
+/// 
+/// \since	1.0
+///
+class _BufferRing
+{
+public:
+	_BufferRing(const size_t bufferSize, const size_t bufferCount) :
+		buffers(bufferCount),
+		_pool(bufferSize, true, _alignment)
+	{
+		for (size_t buffer = 0; buffer < bufferCount; buffer++)
+		{
+			this->_leases.push_back(this->_pool.lease());
+			this->buffers[buffer].data = this->_leases.back().data();
+		}
+	}
+	
+	_BufferRing(const _BufferRing &other) = delete;
+	_BufferRing &operator=(const _BufferRing &other) = delete;
+	
+	bool isValid() const
+	{
+		bool returnValue = true;
+		
+		for (const Crypto::BufferPool::Lease &lease : this->_leases)
+		{
+			returnValue = returnValue && lease.isValid();
+		}
+		
+		return returnValue;
+	}
+	
+	std::vector<_Buffer> buffers;
+	
+private:
+	Crypto::BufferPool _pool;
+	std::vector<Crypto::BufferPool::Lease> _leases;
+};
+
+///
+/// \internal
+/// 
+/// \brief	Passes buffers between the threads of the fallback backend.
+/// 
+/// \since	1.0
+///
+class _BufferQueue
+{
+public:
+	void push(_Buffer *buffer)
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->_mutex);
+			this->_buffers.push_back(buffer);
+		}
+		
+		this->_condition.notify_one();
+	}
+	
+	_Buffer *pop()
+	{
+		std::unique_lock<std::mutex> lock(this->_mutex);
+		this->_condition.wait(lock, [this](){ return !this->_buffers.empty(); });
+		
+		_Buffer *buffer = this->_buffers.front();
+		this->_buffers.pop_front();
+		
+		return buffer;
+	}
+	
+private:
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::deque<_Buffer *> _buffers;
+};
+
+///
+/// \internal
+/// 
+/// \brief	Describes one side of the pipeline.
+/// 
+///			Descriptors inherited from the shell may already be positioned, e.g. a stdout that received a header before, so positioned transfers
+///			happen at \c base plus the offset within the stream. The offsets passed to the processor always start at zero. The size of the input
+///			is never taken from \c st_size, which is zero for files in /proc and outdated for files that grow while they are read; reading
+///			stops at the first read that returns no data.
+/// 
+/// \since	1.0
+///
+struct _Endpoint
+{
+	int fd = -1;
+	bool seekable = false;
+	bool direct = false;
+	uint64_t base = 0;
+};
+
+static _Endpoint _endpoint(const int fd)
+{
+	_Endpoint endpoint;
+	struct stat status;
+	
+	endpoint.fd = fd;
+	
+	// Appending descriptors ignore the offset of pwrite(), so they are written like streams
+	if ((fd >= 0) && (fstat(fd, &status) == 0) && ((fcntl(fd, F_GETFL) & O_APPEND) == 0) && (S_ISREG(status.st_mode) || S_ISBLK(status.st_mode)))
+	{
+		const off_t position = lseek(fd, 0, SEEK_CUR);
+		
+		endpoint.seekable = (position >= 0);
+		endpoint.direct = ((fcntl(fd, F_GETFL) & O_DIRECT) != 0);
+		endpoint.base = endpoint.seekable ? uint64_t(position) : 0;
+	}
+	
+	return endpoint;
+}
+
+///
+/// \internal
+/// 
+/// \brief	Returns where a transfer that stopped after \a transferred bytes continues, rounded down to the block size for \c O_DIRECT.
+/// 
+/// \since	1.0
+///
+static size_t _resumeOffset(const _Endpoint &endpoint, const size_t transferred)
+{
+	return endpoint.direct ? (transferred - (transferred % _alignment)) : transferred;
+}
+
+static void _prepareLastWrite(const int fd, const PipelineOptions &options, const size_t size)
+{
+	// O_DIRECT requires aligned lengths; only the very last write of the output can be shorter
+	if (options.directOutput && ((size % _alignment) != 0))
+	{
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+	}
+}
+
+static bool _runIoUring(IoUring &ring, const _Endpoint &input, const _Endpoint &output, const PipelineOptions &options, const Processor &processor,
+		uint64_t &bytes)
+{
+	_BufferRing bufferRing(options.bufferSize, options.bufferCount);
+	std::vector<_Buffer> &buffers = bufferRing.buffers;
+	uint64_t inputEnd = UINT64_MAX;
+	uint64_t nextRead = 0;
+	uint64_t nextProcess = 0;
+	size_t inFlight = 0;
+	bool returnValue = bufferRing.isValid();
+	
+	// Buffer i of the input always lives in slot i % bufferCount, so slots are read, processed and written in ring order. Reads run ahead
+	// until one of them finds the end of the input, which may leave reads beyond the end in flight; their data is not used.
+	while (returnValue && (((nextProcess * options.bufferSize) < inputEnd) || (inFlight != 0)))
+	{
+		for (; returnValue && ((nextRead * options.bufferSize) < inputEnd) && (buffers[nextRead % buffers.size()].state == _Buffer::State::Free);
+				nextRead++)
+		{
+			_Buffer &buffer = buffers[nextRead % buffers.size()];
+			
+			buffer.offset = nextRead * options.bufferSize;
+			buffer.size = options.bufferSize;
+			buffer.transferred = 0;
+			buffer.state = _Buffer::State::Reading;
+			returnValue = ring.prepareRead(input.fd, buffer.data, uint32_t(options.bufferSize), input.base + buffer.offset, nextRead % buffers.size());
+			inFlight += returnValue ? 1 : 0;
+		}
+		
+		for (; returnValue && ((nextProcess * options.bufferSize) < inputEnd) && (buffers[nextProcess % buffers.size()].state == _Buffer::State::Ready);
+				nextProcess++)
+		{
+			_Buffer &buffer = buffers[nextProcess % buffers.size()];
+			
+			// Only the buffer holding the end of the input is short
+			buffer.size = ((inputEnd - buffer.offset) < buffer.transferred) ? size_t(inputEnd - buffer.offset) : buffer.transferred;
+			processor(buffer.data, buffer.size, buffer.offset);
+			
+			if ((output.fd >= 0) && (buffer.size != 0))
+			{
+				if (buffer.size < options.bufferSize)
+				{
+					_prepareLastWrite(output.fd, options, buffer.size);
+				}
+				
+				buffer.transferred = 0;
+				buffer.state = _Buffer::State::Writing;
+				returnValue = ring.prepareWrite(output.fd, buffer.data, uint32_t(buffer.size), output.base + buffer.offset, nextProcess % buffers.size());
+				inFlight += returnValue ? 1 : 0;
+			}
+			else
+			{
+				buffer.state = _Buffer::State::Free;
+			}
+			
+			bytes += buffer.size;
+		}
+		
+		if (returnValue && (inFlight != 0))
+		{
+			returnValue = ring.submit(1);
+		}
+		
+		uint64_t slot = 0;
+		int32_t result = 0;
+		
+		while (returnValue && ring.nextCompletion(slot, result))
+		{
+			_Buffer &buffer = buffers[slot];
+			
+			inFlight--;
+			
+			if ((result < 0) || ((result == 0) && (buffer.state == _Buffer::State::Writing)))
+			{
+				returnValue = false;
+			}
+			else if (buffer.state == _Buffer::State::Reading)
+			{
+				buffer.transferred += size_t(result);
+				
+				// A read without data marks the end of the input, and so does an unaligned short read with O_DIRECT, which only stops early there;
+				// reads beyond a known end are not continued
+				if ((result == 0) || (input.direct && ((buffer.transferred % _alignment) != 0)) || (buffer.offset >= inputEnd))
+				{
+					inputEnd = ((buffer.offset + buffer.transferred) < inputEnd) ? (buffer.offset + buffer.transferred) : inputEnd;
+					buffer.state = _Buffer::State::Ready;
+				}
+				else if (buffer.transferred < buffer.size)
+				{
+					buffer.transferred = _resumeOffset(input, buffer.transferred);
+					returnValue = ring.prepareRead(input.fd, buffer.data + buffer.transferred, uint32_t(buffer.size - buffer.transferred),
+							input.base + buffer.offset + buffer.transferred, slot);
+					inFlight += returnValue ? 1 : 0;
+				}
+				else
+				{
+					buffer.state = _Buffer::State::Ready;
+				}
+			}
+			else
+			{
+				buffer.transferred += size_t(result);
+				
+				if (buffer.transferred < buffer.size)
+				{
+					buffer.transferred = _resumeOffset(output, buffer.transferred);
+					returnValue = ring.prepareWrite(output.fd, buffer.data + buffer.transferred, uint32_t(buffer.size - buffer.transferred),
+							output.base + buffer.offset + buffer.transferred, slot);
+					inFlight += returnValue ? 1 : 0;
+				}
+				else
+				{
+					buffer.state = _Buffer::State::Free;
+				}
+			}
+		}
+	}
+	
+	// Never unmap buffers the kernel may still write to
+	while ((inFlight != 0) && ring.submit(1))
+	{
+		uint64_t slot = 0;
+		int32_t result = 0;
+		
+		while (ring.nextCompletion(slot, result))
+		{
+			inFlight--;
+		}
+	}
+	
+	return returnValue;
+}
+
+static bool _runThreads(const _Endpoint &input, const _Endpoint &output, const PipelineOptions &options, const Processor &processor, uint64_t &bytes)
+{
+	_BufferRing bufferRing(options.bufferSize, options.bufferCount);
+	_BufferQueue freeBuffers;
+	_BufferQueue readBuffers;
+	_BufferQueue writeBuffers;
+	std::atomic<bool> failed(!bufferRing.isValid());
+	
+	if (!failed)
+	{
+		for (_Buffer &buffer : bufferRing.buffers)
+		{
+			freeBuffers.push(&buffer);
+		}
+		
+		// The reader hands out full buffers until it reaches the end, which it signals with an empty one
+		std::thread reader([&](){
+			uint64_t offset = 0;
+			size_t size = 0;
+			
+			do
+			{
+				_Buffer *buffer = freeBuffers.pop();
+				const uint64_t position = input.seekable ? (input.base + offset) : Crypto::Io::currentPosition;
+				const ssize_t result = Crypto::Io::transferFully(Crypto::Io::Direction::Read, input.fd, buffer->data, options.bufferSize, position);
+				
+				if (result < 0)
+				{
+					failed = true;
+				}
+				
+				size = (result > 0) ? size_t(result) : 0;
+				buffer->offset = offset;
+				buffer->size = size;
+				offset += size;
+				readBuffers.push(buffer);
+			}
+			while (size != 0);
+		});
+		
+		std::thread writer;
+		
+		if (output.fd >= 0)
+		{
+			writer = std::thread([&](){
+				for (_Buffer *buffer = writeBuffers.pop(); buffer->size != 0; buffer = writeBuffers.pop())
+				{
+					if (!failed)
+					{
+						if (buffer->size < options.bufferSize)
+						{
+							_prepareLastWrite(output.fd, options, buffer->size);
+						}
+						
+						const uint64_t position = output.seekable ? (output.base + buffer->offset) : Crypto::Io::currentPosition;
+						const ssize_t result = Crypto::Io::transferFully(Crypto::Io::Direction::Write, output.fd, buffer->data, buffer->size,
+								position);
+						
+						failed = failed || (result < 0);
+					}
+					
+					freeBuffers.push(buffer);
+				}
+			});
+		}
+		
+		for (_Buffer *buffer = readBuffers.pop(); ; buffer = readBuffers.pop())
+		{
+			if (buffer->size == 0)
+			{
+				if (output.fd >= 0)
+				{
+					writeBuffers.push(buffer);
+				}
+				
+				break;
+			}
+			
+			if (!failed)
+			{
+				processor(buffer->data, buffer->size, buffer->offset);
+				bytes += buffer->size;
+			}
+			
+			if (output.fd >= 0)
+			{
+				writeBuffers.push(buffer);
+			}
+			else
+			{
+				freeBuffers.push(buffer);
+			}
+		}
+		
+		reader.join();
+		
+		if (writer.joinable())
+		{
+			writer.join();
+		}
+	}
+	
+	return !failed;
+}
+
+bool runPipeline(const int input, const int output, const PipelineOptions &options, const Processor &processor, const char *&backend, uint64_t &bytes)
+{
+	const _Endpoint inputEndpoint = _endpoint(input);
+	const _Endpoint outputEndpoint = _endpoint(output);
+	bool returnValue = false;
+	bool useIoUring = false;
+	std::unique_ptr<IoUring> ring;
+	
+	bytes = 0;
+	
+	// Without offsets io_uring cannot keep several transfers of one descriptor in flight
+	if (options.allowIoUring && inputEndpoint.seekable && ((output < 0) || outputEndpoint.seekable))
+	{
+		ring = std::make_unique<IoUring>(unsigned(options.bufferCount * 2));
+		useIoUring = ring->isValid();
+	}
+	
+	if (useIoUring)
+	{
+		backend = "io_uring";
+		returnValue = _runIoUring(*ring, inputEndpoint, outputEndpoint, options, processor, bytes);
+	}
+	else
+	{
+		backend = "threads";
+		returnValue = _runThreads(inputEndpoint, outputEndpoint, options, processor, bytes);
+	}
+	
+	// Positioned transfers leave the file positions alone; move them past the data like read() and write() would for the next user
+	if (returnValue && inputEndpoint.seekable)
+	{
+		lseek(input, off_t(inputEndpoint.base + bytes), SEEK_SET);
+	}
+	
+	if (returnValue && outputEndpoint.seekable)
+	{
+		lseek(output, off_t(outputEndpoint.base + bytes), SEEK_SET);
+	}
+	
+	return returnValue;
+}
+
+} // namespace CryptoTool
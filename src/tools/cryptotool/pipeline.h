@@ -0,0 +1,71 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace CryptoTool
+{
+
+///
+/// \brief	Processes \a size bytes of \a data in place that were read at byte \a offset of the input.
+/// 
+///			The processor is called for consecutive ranges of the input in order.
+/// 
+/// \since	1.0
+///
+using Processor = std::function<void(uint8_t *data, const size_t size, const uint64_t offset)>;
+
+///
+/// \brief	Holds the settings of a pipeline run.
+/// 
+/// \since	1.0
+///
+struct PipelineOptions
+{
+	///
+	/// \brief	The size of each buffer in bytes, a multiple of the page size.
+	/// 
+	/// \since	1.0
+	///
+	size_t bufferSize = 1024 * 1024;
+	
+	///
+	/// \brief	The number of buffers in the ring.
+	/// 
+	/// \since	1.0
+	///
+	size_t bufferCount = 8;
+	
+	///
+	/// \brief	Whether io_uring may be used.
+	/// 
+	/// \since	1.0
+	///
+	bool allowIoUring = true;
+	
+	///
+	/// \brief	Whether the output was opened with \c O_DIRECT and needs the flag cleared for an unaligned last write.
+	/// 
+	/// \since	1.0
+	///
+	bool directOutput = false;
+};
+
+///
+/// \brief	Reads \a input, passes it through \a processor and writes the result to \a output if it is not negative.
+/// 
+///			Reads, processing and writes of different buffers overlap. If both descriptors refer to regular files or block devices and io_uring is
+///			available, all transfers are issued through one ring. Otherwise a reader and a writer thread transfer the buffers with pread()/pwrite()
+///			or read()/write(). The input is read until a read returns no data, whatever size it reports. Positioned transfers start at the current
+///			position of each descriptor, which is moved past the data afterwards; outputs opened with \c O_APPEND are written like pipes. \a backend receives the name of the backend used and \a bytes the number of
+///			bytes processed. Returns \c false on any I/O error.
+/// 
+/// \since	1.0
+///
+bool runPipeline(const int input, const int output, const PipelineOptions &options, const Processor &processor, const char *&backend, uint64_t &bytes);
+
+} // namespace CryptoTool
+
+#endif // PIPELINE_H
@@ -0,0 +1,346 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "filehasher.h"
+#include "fileio.h"
+#include "sha2digest.h"
+#include "sha2multidigest.h"
+
+namespace Sha2Sum
+{
+
+static constexpr size_t _groupSize = 64;
+static constexpr size_t _smallFileLimit = 256 * 1024;
+
+///
+/// \internal
+/// 
+/// \brief	Describes an opened file.
+/// 
+/// \since	1.0
+///
+struct _OpenFile
+{
+	int fd = -1;
+	bool regular = false;
+	uint64_t size = 0;
+};
+
+static int _open(const std::string &name, _OpenFile &file)
+{
+	struct stat status;
+	int error = 0;
+	
+	file.fd = (name == "-") ? STDIN_FILENO : open(name.c_str(), O_RDONLY);
+	
+	if (file.fd < 0)
+	{
+		error = errno;
+	}
+	else if (fstat(file.fd, &status) != 0)
+	{
+		error = errno;
+	}
+	else
+	{
+		file.regular = S_ISREG(status.st_mode);
+		file.size = uint64_t(status.st_size);
+	}
+	
+	return error;
+}
+
+static void _close(const std::string &name, _OpenFile &file)
+{
+	if ((file.fd >= 0) && (name != "-"))
+	{
+		close(file.fd);
+	}
+	
+	file.fd = -1;
+}
+
+template <typename MultiDigestType>
+static void _hashRoot(const uint8_t *leaves, const size_t leafCount, uint8_t *digest)
+{
+	typename MultiDigestType::DigestType root;
+	
+	root.hash(leaves, leafCount * MultiDigestType::TraitsType::digestSize);
+	root.extract(digest);
+}
+
+template <typename MultiDigestType>
+static void _hashLeaves(const uint8_t *data, const uint64_t size, uint8_t *leaves)
+{
+	const size_t leafCount = size_t((size + treeLeafSize - 1) / treeLeafSize);
+	const size_t batchCount = (leafCount + MultiDigestType::laneCount - 1) / MultiDigestType::laneCount;
+	
+	// Leaves of one batch are equally long, so they occupy all lanes until the last batch
+#pragma omp parallel for schedule(dynamic)
+	for (size_t batch = 0; batch < batchCount; batch++)
+	{
+		const uint8_t *messages[MultiDigestType::laneCount];
+		size_t messageSizes[MultiDigestType::laneCount];
+		const size_t firstLeaf = batch * MultiDigestType::laneCount;
+		size_t messageCount = 0;
+		
+		for (size_t leaf = firstLeaf; (leaf < leafCount) && (messageCount < MultiDigestType::laneCount); leaf++, messageCount++)
+		{
+			const uint64_t offset = uint64_t(leaf) * treeLeafSize;
+			
+			messages[messageCount] = data + offset;
+			messageSizes[messageCount] = ((size - offset) < treeLeafSize) ? size_t(size - offset) : treeLeafSize;
+		}
+		
+		MultiDigestType::hash(messages, messageSizes, messageCount, leaves + firstLeaf * MultiDigestType::TraitsType::digestSize);
+	}
+}
+
+template <typename MultiDigestType>
+static int _hashMapped(const _OpenFile &file, const bool tree, uint8_t *digest)
+{
+	int error = 0;
+	void *mapping = mmap(nullptr, size_t(file.size), PROT_READ, MAP_PRIVATE, file.fd, 0);
+	
+	if (mapping == MAP_FAILED)
+	{
+		error = errno;
+	}
+	else
+	{
+		const uint8_t *data = static_cast<const uint8_t *>(mapping);
+		
+		if (tree)
+		{
+			std::vector<uint8_t> leaves(size_t((file.size + treeLeafSize - 1) / treeLeafSize) * MultiDigestType::TraitsType::digestSize);
+			
+			// All threads fault in different parts of the file at once
+			madvise(mapping, size_t(file.size), MADV_WILLNEED);
+			_hashLeaves<MultiDigestType>(data, file.size, leaves.data());
+			_hashRoot<MultiDigestType>(leaves.data(), leaves.size() / MultiDigestType::TraitsType::digestSize, digest);
+		}
+		else
+		{
+			typename MultiDigestType::DigestType fileDigest;
+			
+			madvise(mapping, size_t(file.size), MADV_SEQUENTIAL);
+			fileDigest.hash(data, size_t(file.size));
+			fileDigest.extract(digest);
+		}
+		
+		munmap(mapping, size_t(file.size));
+	}
+	
+	return error;
+}
+
+template <typename MultiDigestType>
+static int _hashStream(const _OpenFile &file, const bool tree, uint8_t *digest)
+{
+	using DigestType = typename MultiDigestType::DigestType;
+	constexpr size_t blockSize = MultiDigestType::TraitsType::blockSize;
+	constexpr size_t digestSize = MultiDigestType::TraitsType::digestSize;
+	
+	std::vector<uint8_t> buffer(treeLeafSize);
+	std::vector<uint8_t> leaves;
+	DigestType streamDigest;
+	ssize_t result = 0;
+	
+	posix_fadvise(file.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	
+	// Every full buffer is one leaf in tree mode or a whole number of blocks otherwise
+	while ((result = Crypto::Io::transferFully(Crypto::Io::Direction::Read, file.fd, buffer.data(), buffer.size())) == ssize_t(buffer.size()))
+	{
+		if (tree)
+		{
+			leaves.resize(leaves.size() + digestSize);
+			streamDigest.hash(buffer.data(), buffer.size());
+			streamDigest.extract(leaves.data() + leaves.size() - digestSize);
+			streamDigest.reset();
+		}
+		else
+		{
+			for (size_t block = 0; block < buffer.size(); block += blockSize)
+			{
+				streamDigest.update(buffer.data() + block);
+			}
+		}
+	}
+	
+	if ((result >= 0) && tree)
+	{
+		if (result != 0)
+		{
+			leaves.resize(leaves.size() + digestSize);
+			streamDigest.hash(buffer.data(), size_t(result));
+			streamDigest.extract(leaves.data() + leaves.size() - digestSize);
+		}
+		
+		_hashRoot<MultiDigestType>(leaves.data(), leaves.size() / digestSize, digest);
+	}
+	else if (result >= 0)
+	{
+		const size_t blocks = size_t(result) / blockSize;
+		
+		for (size_t block = 0; block < blocks; block++)
+		{
+			streamDigest.update(buffer.data() + block * blockSize);
+		}
+		
+		streamDigest.finalize(buffer.data() + blocks * blockSize, size_t(result) % blockSize);
+		streamDigest.extract(digest);
+	}
+	
+	return (result < 0) ? errno : 0;
+}
+
+template <typename MultiDigestType>
+static void _hashGroup(FileResult *files, _OpenFile *openFiles, const size_t fileCount, const bool tree)
+{
+	constexpr size_t digestSize = MultiDigestType::TraitsType::digestSize;
+	
+	std::vector<std::vector<uint8_t>> contents(fileCount);
+	std::vector<const uint8_t *> messages;
+	std::vector<size_t> messageSizes;
+	std::vector<size_t> messageFiles;
+	
+	for (size_t file = 0; file < fileCount; file++)
+	{
+		files[file].error = _open(files[file].name, openFiles[file]);
+		
+		// Start reading ahead all small files before the first one is consumed
+		if ((files[file].error == 0) && openFiles[file].regular && (openFiles[file].size != 0) && (openFiles[file].size <= _smallFileLimit))
+		{
+			posix_fadvise(openFiles[file].fd, 0, 0, POSIX_FADV_WILLNEED);
+		}
+	}
+	
+	for (size_t file = 0; file < fileCount; file++)
+	{
+		_OpenFile &openFile = openFiles[file];
+		
+		if (files[file].error != 0)
+		{
+			_close(files[file].name, openFile);
+		}
+		else if (openFile.regular && (openFile.size != 0) && (openFile.size <= _smallFileLimit))
+		{
+			size_t used = 0;
+			ssize_t result = 0;
+			bool busy = true;
+			
+			// The spare byte reveals a file that grew since fstat(), whose buffer then grows until the end of the file is reached
+			contents[file].resize(size_t(openFile.size) + 1);
+			
+			while (busy)
+			{
+				result = Crypto::Io::transferFully(Crypto::Io::Direction::Read, openFile.fd, contents[file].data() + used,
+						contents[file].size() - used);
+				used += (result > 0) ? size_t(result) : 0;
+				busy = (result > 0) && (used == contents[file].size());
+				
+				if (busy)
+				{
+					contents[file].resize(contents[file].size() * 2);
+				}
+			}
+			
+			if (result < 0)
+			{
+				files[file].error = errno;
+			}
+			else
+			{
+				contents[file].resize(used);
+				messages.push_back(contents[file].data());
+				messageSizes.push_back(contents[file].size());
+				messageFiles.push_back(file);
+			}
+			
+			_close(files[file].name, openFile);
+		}
+		else if (!openFile.regular || (openFile.size == 0))
+		{
+			// Files in /proc and similar report a size of zero whatever they contain
+			files[file].error = _hashStream<MultiDigestType>(openFile, tree, files[file].digest);
+			_close(files[file].name, openFile);
+		}
+		else if (!tree)
+		{
+			files[file].error = _hashMapped<MultiDigestType>(openFile, false, files[file].digest);
+			_close(files[file].name, openFile);
+		}
+		
+		// Large files in tree mode stay open for hashFiles() to spread them over all threads
+	}
+	
+	std::vector<uint8_t> digests(messages.size() * digestSize);
+	
+	MultiDigestType::hash(messages.data(), messageSizes.data(), messages.size(), digests.data());
+	
+	for (size_t message = 0; message < messages.size(); message++)
+	{
+		uint8_t *digest = files[messageFiles[message]].digest;
+		
+		// A small file is a single leaf, unless it is empty
+		if (tree && (messageSizes[message] != 0))
+		{
+			_hashRoot<MultiDigestType>(digests.data() + message * digestSize, 1, digest);
+		}
+		else
+		{
+			memcpy(digest, digests.data() + message * digestSize, digestSize);
+		}
+	}
+}
+
+template <typename MultiDigestType>
+static void _hashFiles(std::vector<FileResult> &files, const bool tree)
+{
+	std::vector<_OpenFile> openFiles(files.size());
+	const size_t groupCount = (files.size() + _groupSize - 1) / _groupSize;
+
+#pragma omp parallel for schedule(dynamic)
+	for (size_t group = 0; group < groupCount; group++)
+	{
+		const size_t firstFile = group * _groupSize;
+		const size_t fileCount = ((files.size() - firstFile) < _groupSize) ? (files.size() - firstFile) : _groupSize;
+		
+		_hashGroup<MultiDigestType>(files.data() + firstFile, openFiles.data() + firstFile, fileCount, tree);
+	}
+	
+	// Only large files in tree mode are left open
+	for (size_t file = 0; file < files.size(); file++)
+	{
+		if (openFiles[file].fd >= 0)
+		{
+			files[file].error = _hashMapped<MultiDigestType>(openFiles[file], true, files[file].digest);
+			_close(files[file].name, openFiles[file]);
+		}
+	}
+}
+
+void hashFiles(std::vector<FileResult> &files, const HashOptions &options)
+{
+	switch (options.digestSize)
+	{
+		case SHA224_DIGEST_SIZE:
+			_hashFiles<Crypto::Hash::Sha2::MultiDigest224>(files, options.tree);
+			break;
+		case SHA384_DIGEST_SIZE:
+			_hashFiles<Crypto::Hash::Sha2::MultiDigest384>(files, options.tree);
+			break;
+		case SHA512_DIGEST_SIZE:
+			_hashFiles<Crypto::Hash::Sha2::MultiDigest512>(files, options.tree);
+			break;
+		default:
+			_hashFiles<Crypto::Hash::Sha2::MultiDigest256>(files, options.tree);
+			break;
+	}
+}
+
+} // namespace Sha2Sum
@@ -0,0 +1,89 @@
+#ifndef FILEHASHER_H
+#define FILEHASHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "sha2traits.h"
+
+namespace Sha2Sum
+{
+
+///
+/// \brief	Holds the hash value of a file or the reason it could not be computed.
+/// 
+/// \since	1.0
+///
+struct FileResult
+{
+	///
+	/// \brief	The path of the file, \c - for standard input.
+	/// 
+	/// \since	1.0
+	///
+	std::string name;
+	
+	///
+	/// \brief	The error number of the failed operation or zero on success.
+	/// 
+	/// \since	1.0
+	///
+	int error = 0;
+	
+	///
+	/// \brief	The hash value of the file, of which the digest size of the selected algorithm is used.
+	/// 
+	/// \since	1.0
+	///
+	uint8_t digest[SHA512_DIGEST_SIZE];
+};
+
+///
+/// \brief	Holds the settings of a hashing run.
+/// 
+/// \since	1.0
+///
+struct HashOptions
+{
+	///
+	/// \brief	The digest size of the SHA2 variant in bytes.
+	/// 
+	/// \since	1.0
+	///
+	uint32_t digestSize = SHA256_DIGEST_SIZE;
+	
+	///
+	/// \brief	Whether files are hashed as a tree of leaves, which spreads a single large file over all threads.
+	/// 
+	///			The tree hash of a file is the hash of the concatenated hash values of its consecutive pieces of treeLeafSize bytes. It differs
+	///			from the plain hash value and can only be checked in tree mode.
+	/// 
+	/// \since	1.0
+	///
+	bool tree = false;
+};
+
+///
+/// \brief	The size of the pieces hashed independently in tree mode.
+/// 
+/// \since	1.0
+///
+static constexpr size_t treeLeafSize = 1024 * 1024;
+
+///
+/// \brief	Hashes all \a files in parallel and fills in their results.
+/// 
+///			Small files are read with readahead hints and hashed together in the lanes of Crypto::Hash::Sha2::MultiDigest. Larger files are
+///			mapped into memory and hashed by one thread each, or by all threads in tree mode. Standard input, other files that cannot be mapped
+///			and files reporting a size of zero, such as those in /proc, are read in pieces. Small files are read to their end, even if they
+///			grew beyond the size they reported.
+/// 
+/// \since	1.0
+///
+void hashFiles(std::vector<FileResult> &files, const HashOptions &options);
+
+} // namespace Sha2Sum
+
+#endif // FILEHASHER_H
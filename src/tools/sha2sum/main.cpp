@@ -0,0 +1,446 @@
+#include <ctype.h>
+#include <errno.h>
+#include <fstream>
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "cryptolog.h"
+#include "filehasher.h"
+
+using namespace Sha2Sum;
+
+///
+/// \brief	The number of files hashed in parallel before their results are printed.
+/// 
+/// \since	1.0
+///
+static constexpr size_t windowSize = 4096;
+
+///
+/// \brief	Holds the command line settings.
+/// 
+/// \since	1.0
+///
+struct Settings
+{
+	HashOptions options;
+	std::string program;
+	bool binary = false;
+	bool check = false;
+	bool quiet = false;
+	bool status = false;
+};
+
+///
+/// \brief	Writes library log messages to stderr, so the checksum lines on stdout stay in the format of coreutils.
+/// 
+///			Debug messages are emitted for every hashed file in debug builds and are dropped.
+/// 
+/// \since	1.0
+///
+static void logToStderr(const Crypto::Log::Level level, const std::string &message)
+{
+	if (level != Crypto::Log::Level::Debug)
+	{
+		std::cerr << message << std::endl;
+	}
+}
+
+static void printUsage(const Settings &settings)
+{
+	std::cerr << "Usage: " << settings.program << " [options] [file...]" << std::endl
+			<< std::endl
+			<< "Prints or checks SHA2 checksums in the format of the coreutils sha*sum tools. Without files or with - standard input is read." << std::endl
+			<< std::endl
+			<< "  -a BITS   algorithm: 224, 256, 384 or 512 (default from the program name, else 256)" << std::endl
+			<< "  -b        read in binary mode, marked with * in the output" << std::endl
+			<< "  -t        read in text mode (default), which is the same on this platform" << std::endl
+			<< "  -c        read checksums from the files and check them" << std::endl
+			<< "  -q        do not print OK for each successfully verified file" << std::endl
+			<< "  -s        print nothing when checking, the exit status shows success" << std::endl
+			<< "  -T        tree mode: hash 1 MiB pieces of each file in parallel and hash their hash values;" << std::endl
+			<< "            the results differ from plain checksums and can only be checked in tree mode" << std::endl
+			<< "  -j COUNT  number of threads" << std::endl;
+}
+
+static uint32_t digestSizeOf(const unsigned long bits)
+{
+	uint32_t returnValue = 0;
+	
+	switch (bits)
+	{
+		case 224:
+			returnValue = SHA224_DIGEST_SIZE;
+			break;
+		case 256:
+			returnValue = SHA256_DIGEST_SIZE;
+			break;
+		case 384:
+			returnValue = SHA384_DIGEST_SIZE;
+			break;
+		case 512:
+			returnValue = SHA512_DIGEST_SIZE;
+			break;
+		default:
+			break;
+	}
+	
+	return returnValue;
+}
+
+static std::string toHex(const uint8_t *data, const size_t size)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string text;
+	
+	for (size_t byte = 0; byte < size; byte++)
+	{
+		text += digits[data[byte] >> 4];
+		text += digits[data[byte] & 0x0f];
+	}
+	
+	return text;
+}
+
+static bool needsEscaping(const std::string &name)
+{
+	return (name.find_first_of("\\\n\r") != std::string::npos);
+}
+
+///
+/// \brief	Escapes backslashes and line breaks in \a name like coreutils, which marks such lines with a leading backslash.
+/// 
+/// \since	1.0
+///
+static std::string escape(const std::string &name)
+{
+	std::string text;
+	
+	for (const char character : name)
+	{
+		if (character == '\\')
+		{
+			text += "\\\\";
+		}
+		else if (character == '\n')
+		{
+			text += "\\n";
+		}
+		else if (character == '\r')
+		{
+			text += "\\r";
+		}
+		else
+		{
+			text += character;
+		}
+	}
+	
+	return text;
+}
+
+static bool unescape(const std::string &text, std::string &name)
+{
+	bool returnValue = true;
+	
+	name.clear();
+	
+	for (size_t character = 0; returnValue && (character < text.size()); character++)
+	{
+		if (text[character] != '\\')
+		{
+			name += text[character];
+		}
+		else if ((character + 1) < text.size())
+		{
+			character++;
+			returnValue = (text[character] == '\\') || (text[character] == 'n') || (text[character] == 'r');
+			name += (text[character] == 'n') ? '\n' : (text[character] == 'r') ? '\r' : '\\';
+		}
+		else
+		{
+			returnValue = false;
+		}
+	}
+	
+	return returnValue;
+}
+
+///
+/// \brief	Parses a checksum \a line of the form <tt>[\\]HEX  NAME</tt> or <tt>[\\]HEX *NAME</tt>.
+/// 
+/// \since	1.0
+///
+static bool parseLine(const std::string &line, const uint32_t digestSize, std::string &digest, std::string &name)
+{
+	const bool escaped = !line.empty() && (line[0] == '\\');
+	const size_t start = escaped ? 1 : 0;
+	const size_t digestLength = digestSize * 2;
+	bool returnValue = (line.size() > (start + digestLength + 2));
+	
+	if (returnValue)
+	{
+		digest = line.substr(start, digestLength);
+		returnValue = (digest.find_first_not_of("0123456789abcdefABCDEF") == std::string::npos) && (line[start + digestLength] == ' ')
+				&& ((line[start + digestLength + 1] == ' ') || (line[start + digestLength + 1] == '*'));
+	}
+	
+	if (returnValue)
+	{
+		const std::string text = line.substr(start + digestLength + 2);
+		
+		if (escaped)
+		{
+			returnValue = unescape(text, name);
+		}
+		else
+		{
+			name = text;
+		}
+		
+		for (char &character : digest)
+		{
+			character = char(tolower(character));
+		}
+	}
+	
+	return returnValue;
+}
+
+static void printError(const Settings &settings, const FileResult &file)
+{
+	std::cerr << settings.program << ": " << file.name << ": " << strerror(file.error) << std::endl;
+}
+
+static bool printChecksums(const Settings &settings, const std::vector<std::string> &names)
+{
+	bool returnValue = true;
+	
+	for (size_t first = 0; first < names.size(); first += windowSize)
+	{
+		std::vector<FileResult> files(((names.size() - first) < windowSize) ? (names.size() - first) : windowSize);
+		
+		for (size_t file = 0; file < files.size(); file++)
+		{
+			files[file].name = names[first + file];
+		}
+		
+		hashFiles(files, settings.options);
+		
+		for (const FileResult &file : files)
+		{
+			if (file.error != 0)
+			{
+				printError(settings, file);
+				returnValue = false;
+			}
+			else
+			{
+				std::cout << (needsEscaping(file.name) ? "\\" : "") << toHex(file.digest, settings.options.digestSize) << ' '
+						<< (settings.binary ? '*' : ' ') << escape(file.name) << '\n';
+			}
+		}
+	}
+	
+	std::cout.flush();
+	
+	return returnValue;
+}
+
+static bool checkChecksums(const Settings &settings, const std::string &checkName)
+{
+	std::ifstream checkFile;
+	std::istream &input = (checkName == "-") ? std::cin : checkFile;
+	std::vector<std::string> names;
+	std::vector<std::string> expectedDigests;
+	std::string line;
+	size_t improperLines = 0;
+	size_t mismatches = 0;
+	size_t unreadable = 0;
+	bool returnValue = true;
+	
+	if (checkName != "-")
+	{
+		checkFile.open(checkName);
+	}
+	
+	if (!input)
+	{
+		std::cerr << settings.program << ": " << checkName << ": " << strerror(errno) << std::endl;
+		returnValue = false;
+	}
+	
+	while (returnValue && std::getline(input, line))
+	{
+		std::string digest;
+		std::string name;
+		
+		if (parseLine(line, settings.options.digestSize, digest, name))
+		{
+			names.push_back(name);
+			expectedDigests.push_back(digest);
+		}
+		else
+		{
+			improperLines++;
+		}
+	}
+	
+	for (size_t first = 0; returnValue && (first < names.size()); first += windowSize)
+	{
+		std::vector<FileResult> files(((names.size() - first) < windowSize) ? (names.size() - first) : windowSize);
+		
+		for (size_t file = 0; file < files.size(); file++)
+		{
+			files[file].name = names[first + file];
+		}
+		
+		hashFiles(files, settings.options);
+		
+		for (size_t file = 0; file < files.size(); file++)
+		{
+			const bool readable = (files[file].error == 0);
+			const bool matches = readable && (toHex(files[file].digest, settings.options.digestSize) == expectedDigests[first + file]);
+			
+			unreadable += readable ? 0 : 1;
+			mismatches += (readable && !matches) ? 1 : 0;
+			
+			if (!readable && !settings.status)
+			{
+				printError(settings, files[file]);
+			}
+			
+			if (!settings.status && (!matches || !settings.quiet))
+			{
+				std::cout << (needsEscaping(files[file].name) ? "\\" : "") << escape(files[file].name) << ": "
+						<< (matches ? "OK" : readable ? "FAILED" : "FAILED open or read") << '\n';
+			}
+		}
+	}
+	
+	std::cout.flush();
+	
+	if (returnValue && names.empty())
+	{
+		std::cerr << settings.program << ": " << checkName << ": no properly formatted checksum lines found" << std::endl;
+		returnValue = false;
+	}
+	else if (returnValue && !settings.status)
+	{
+		if (improperLines != 0)
+		{
+			std::cerr << settings.program << ": WARNING: " << improperLines << ((improperLines == 1) ? " line is" : " lines are")
+					<< " improperly formatted" << std::endl;
+		}
+		
+		if (unreadable != 0)
+		{
+			std::cerr << settings.program << ": WARNING: " << unreadable << " listed " << ((unreadable == 1) ? "file" : "files")
+					<< " could not be read" << std::endl;
+		}
+		
+		if (mismatches != 0)
+		{
+			std::cerr << settings.program << ": WARNING: " << mismatches << " computed " << ((mismatches == 1) ? "checksum" : "checksums")
+					<< " did NOT match" << std::endl;
+		}
+	}
+	
+	return returnValue && (mismatches == 0) && (unreadable == 0);
+}
+
+int main(int argc, char **argv)
+{
+	Settings settings;
+	bool valid = true;
+	int option = 0;
+	
+	Crypto::Log::setSink(logToStderr);
+	
+	// Installed as sha512sum etc. the tool defaults to the matching algorithm
+	settings.program = argv[0];
+	settings.program = settings.program.substr(settings.program.find_last_of('/') + 1);
+	
+	for (const unsigned long bits : {224ul, 256ul, 384ul, 512ul})
+	{
+		if (settings.program == ("sha" + std::to_string(bits) + "sum"))
+		{
+			settings.options.digestSize = digestSizeOf(bits);
+		}
+	}
+	
+	while (valid && ((option = getopt(argc, argv, "a:btcqsTj:h")) != -1))
+	{
+		switch (option)
+		{
+			case 'a':
+				settings.options.digestSize = digestSizeOf(strtoul(optarg, nullptr, 10));
+				valid = (settings.options.digestSize != 0);
+				break;
+			case 'b':
+				settings.binary = true;
+				break;
+			case 't':
+				settings.binary = false;
+				break;
+			case 'c':
+				settings.check = true;
+				break;
+			case 'q':
+				settings.quiet = true;
+				break;
+			case 's':
+				settings.status = true;
+				break;
+			case 'T':
+				settings.options.tree = true;
+				break;
+			case 'j':
+				valid = (atoi(optarg) > 0);
+#ifdef _OPENMP
+				omp_set_num_threads(atoi(optarg));
+#endif
+				break;
+			default:
+				valid = false;
+				break;
+		}
+	}
+	
+	std::vector<std::string> names(argv + optind, argv + argc);
+	bool success = false;
+	
+	if (names.empty())
+	{
+		names.push_back("-");
+	}
+	
+	if (!valid)
+	{
+		printUsage(settings);
+	}
+	else if (settings.check)
+	{
+		success = true;
+		
+		for (const std::string &name : names)
+		{
+			success = checkChecksums(settings, name) && success;
+		}
+	}
+	else
+	{
+		success = printChecksums(settings, names);
+	}
+	
+	return !valid ? 2 : success ? 0 : 1;
+}